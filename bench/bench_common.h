@@ -0,0 +1,65 @@
+#pragma once
+
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Command line and output handling shared by the benchmarks. Every benchmark takes its own options
+// plus --output, and prints one JSON document with its results.
+
+// Returns the argument after the current flag, throwing std::invalid_argument if there is none.
+using BenchValue = std::function<const char*()>;
+
+// Prints the usage line, the benchmark's own option lines and the options every benchmark takes.
+inline void PrintBenchUsage(const char* program, const char* arguments, const char* options) {
+	std::cout << "Usage: " << program << " " << arguments << "\n"
+	          << options
+	          << "  --output <file>    Write JSON results here instead of stdout" << std::endl;
+}
+
+// Walks the command line. parse(argument, value) handles the benchmark's own arguments and returns
+// false for ones it doesn't know; --output is stored in output. validate, if given, then checks
+// the options as a whole. Returns false after printing the problem and print_usage's text if an
+// argument is unknown or anything throws.
+inline bool ParseBenchArgs(int argc, char** argv, std::string& output,
+                           void (*print_usage)(const char*),
+                           const std::function<bool(const char*, const BenchValue&)>& parse,
+                           const std::function<void()>& validate = nullptr) {
+	try {
+		for (int i = 1; i < argc; ++i) {
+			const char* argument = argv[i];
+			BenchValue value     = [&]() -> const char* {
+				if (i + 1 >= argc) {
+					throw std::invalid_argument(std::string("Missing value for ") + argument);
+				}
+				return argv[++i];
+			};
+
+			if (std::string(argument) == "--output") {
+				output = value();
+			} else if (!parse(argument, value)) {
+				throw std::invalid_argument(std::string("Unknown argument ") + argument);
+			}
+		}
+		if (validate) validate();
+	} catch (const std::exception& e) {
+		std::cout << "Invalid arguments: " << e.what() << std::endl;
+		print_usage(argv[0]);
+		return false;
+	}
+	return true;
+}
+
+// Writes a benchmark's JSON results to output, or to stdout if it is empty.
+inline void WriteBenchJson(const std::string& output, const std::string& json) {
+	if (output.empty()) {
+		std::cout << json;
+		return;
+	}
+	std::ofstream file(output);
+	if (!file.is_open()) throw std::runtime_error("Failed to open file: " + output);
+	file << json;
+	if (!file) throw std::runtime_error("Failed to write file: " + output);
+}
@@ -0,0 +1,146 @@
+#include "bench_common.h"
+#include "frustum_culler.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Measures FrustumCuller alone, without a device: a fixed pseudo-random field of boxes around a
+// camera is culled repeatedly with every instruction set and thread count.
+struct BenchOptions {
+	uint32_t objects    = 500000;
+	uint32_t iterations = 200;
+	uint32_t warmup     = 10;
+	// 0 uses every hardware thread.
+	uint32_t threads = 0;
+	std::string output;
+};
+
+void PrintUsage(const char* program) {
+	PrintBenchUsage(
+	    program, "[options]",
+	    "  --objects <n>      Objects to cull (default: 500000)\n"
+	    "  --iterations <n>   Measured culls per configuration (default: 200)\n"
+	    "  --warmup <n>       Unmeasured culls before measuring (default: 10)\n"
+	    "  --threads <n>      Most worker threads to try (default: all hardware threads)\n");
+}
+
+void BuildScene(FrustumCuller& culler, uint32_t objects) {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.25f, 4.0f);
+	culler.Reserve(objects);
+	for (uint32_t i = 0; i < objects; ++i) {
+		glm::vec3 center(position(rng), position(rng) * 0.1f, position(rng));
+		glm::vec3 extents(size(rng), size(rng), size(rng));
+		culler.Add(center, extents, glm::length(extents));
+	}
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+
+	auto parse = [&](const char* argument, const BenchValue& value) {
+		if (!std::strcmp(argument, "--objects")) {
+			options.objects = std::stoul(value());
+		} else if (!std::strcmp(argument, "--iterations")) {
+			options.iterations = std::stoul(value());
+		} else if (!std::strcmp(argument, "--warmup")) {
+			options.warmup = std::stoul(value());
+		} else if (!std::strcmp(argument, "--threads")) {
+			options.threads = std::stoul(value());
+		} else {
+			return false;
+		}
+		return true;
+	};
+	auto validate = [&] {
+		if (options.objects == 0 || options.iterations == 0) {
+			throw std::invalid_argument("--objects and --iterations must be positive");
+		}
+	};
+	if (!ParseBenchArgs(argc, argv, options.output, PrintUsage, parse, validate)) {
+		return EXIT_FAILURE;
+	}
+
+	try {
+		FrustumCuller culler;
+		BuildScene(culler, options.objects);
+
+		// A camera in the middle of the field sees roughly a fifth of it.
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(0.0f, 0.0f, -100.0f),
+		                             glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 600.0f);
+		projection[1][1] *= -1.0f;
+		glm::mat4 view_projection = projection * view;
+
+		uint32_t max_threads = options.threads;
+		if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<uint32_t> thread_counts;
+		for (uint32_t count = 1; count < max_threads; count *= 2) thread_counts.push_back(count);
+		thread_counts.push_back(max_threads);
+
+		std::ostringstream results;
+		std::vector<uint32_t> visible;
+		bool first = true;
+		for (FrustumCuller::Isa isa : {FrustumCuller::Isa::eScalar, FrustumCuller::Isa::eSse,
+		                               FrustumCuller::Isa::eAvx2}) {
+			culler.SetIsa(isa);
+			// Unsupported instruction sets fall back to one already measured.
+			if (culler.GetIsa() != isa) continue;
+
+			for (uint32_t threads : thread_counts) {
+				JobSystem jobs(threads);
+				JobSystem* cull_jobs = threads > 1 ? &jobs : nullptr;
+				for (uint32_t i = 0; i < options.warmup; ++i) {
+					culler.Cull(view_projection, visible, cull_jobs);
+				}
+
+				auto start = std::chrono::steady_clock::now();
+				for (uint32_t i = 0; i < options.iterations; ++i) {
+					culler.Cull(view_projection, visible, cull_jobs);
+				}
+				double us = std::chrono::duration<double, std::micro>(
+				                std::chrono::steady_clock::now() - start)
+				                .count() /
+				            options.iterations;
+				double objects_per_us = options.objects / us;
+
+				std::cerr << FrustumCuller::IsaName(isa) << ", " << threads
+				          << " threads: " << objects_per_us << " objects/us (" << us
+				          << " us per cull, " << visible.size() << " visible)" << std::endl;
+
+				if (!first) results << ",\n";
+				first = false;
+				results << "    {\"isa\": \"" << FrustumCuller::IsaName(isa)
+				        << "\", \"threads\": " << threads << ", \"us_per_cull\": " << us
+				        << ", \"objects_per_us\": " << objects_per_us
+				        << ", \"visible\": " << visible.size() << "}";
+			}
+		}
+
+		std::ostringstream json;
+		json << "{\n"
+		     << "  \"objects\": " << options.objects << ",\n"
+		     << "  \"iterations\": " << options.iterations << ",\n"
+		     << "  \"best_isa\": \"" << FrustumCuller::IsaName(FrustumCuller::BestIsa()) << "\",\n"
+		     << "  \"results\": [\n"
+		     << results.str() << "\n  ]\n}\n";
+
+		WriteBenchJson(options.output, json.str());
+	} catch (const std::exception& e) {
+		std::cout << "Error occurred: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,214 @@
+#include "bench_common.h"
+#include "ecs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Measures the Registry alone, without a device: a position/velocity integration over every
+// entity, iterated per entity, per chunk and per chunk across threads, against the same update on
+// individually allocated objects visited in shuffled order.
+struct BenchOptions {
+	uint32_t entities   = 1000000;
+	uint32_t iterations = 20;
+	// 0 uses every hardware thread.
+	uint32_t threads = 0;
+	std::string output;
+};
+
+struct Position {
+	float x, y, z;
+};
+struct Velocity {
+	float x, y, z;
+};
+struct Health {
+	float value;
+};
+// Padding that makes objects in the baseline as large as a typical game object.
+struct Cold {
+	float data[28];
+};
+
+// The pointer-chasing baseline: every object is its own allocation with all its fields together.
+struct Object {
+	Position position;
+	Velocity velocity;
+	Health health;
+	Cold cold;
+};
+
+const float kDt = 1.0f / 60.0f;
+
+void PrintUsage(const char* program) {
+	PrintBenchUsage(
+	    program, "[options]",
+	    "  --entities <n>     Entities to create (default: 1000000)\n"
+	    "  --iterations <n>   Measured passes per case (default: 20)\n"
+	    "  --threads <n>      Most worker threads to try (default: all hardware threads)\n");
+}
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+	    .count();
+}
+
+// A quarter of the entities are static and have no velocity; half carry cold data too, so the
+// moving ones are spread over several archetypes.
+void Populate(Registry& registry, uint32_t count) {
+	for (uint32_t i = 0; i < count; ++i) {
+		Position position{float(i), 0.0f, 0.0f};
+		Velocity velocity{1.0f, 0.5f, 0.25f};
+		if (i % 4 == 3) {
+			registry.Create(position, Health{100.0f});
+		} else if (i % 2) {
+			registry.Create(position, velocity, Health{100.0f}, Cold{});
+		} else {
+			registry.Create(position, velocity, Health{100.0f});
+		}
+	}
+}
+
+struct Result {
+	const char* name;
+	uint32_t threads;
+	double ms;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+
+	auto parse = [&](const char* argument, const BenchValue& value) {
+		if (!std::strcmp(argument, "--entities")) {
+			options.entities = std::stoul(value());
+		} else if (!std::strcmp(argument, "--iterations")) {
+			options.iterations = std::stoul(value());
+		} else if (!std::strcmp(argument, "--threads")) {
+			options.threads = std::stoul(value());
+		} else {
+			return false;
+		}
+		return true;
+	};
+	auto validate = [&] {
+		if (options.entities == 0 || options.iterations == 0) {
+			throw std::invalid_argument("--entities and --iterations must be positive");
+		}
+	};
+	if (!ParseBenchArgs(argc, argv, options.output, PrintUsage, parse, validate)) {
+		return EXIT_FAILURE;
+	}
+
+	try {
+		uint32_t max_threads = options.threads;
+		if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<uint32_t> thread_counts;
+		for (uint32_t count = 1; count < max_threads; count *= 2) thread_counts.push_back(count);
+		thread_counts.push_back(max_threads);
+
+		auto start = std::chrono::steady_clock::now();
+		Registry registry;
+		Populate(registry, options.entities);
+		double build_ms = MsSince(start);
+		uint32_t moving = 0;
+		registry.ForEachChunk<const Velocity>(
+		    [&](uint32_t count, const Entity*, const Velocity*) { moving += count; });
+		std::cerr << "Created " << options.entities << " entities (" << moving << " moving) in "
+		          << registry.ArchetypeCount() << " archetypes in " << build_ms << " ms"
+		          << std::endl;
+
+		std::vector<std::unique_ptr<Object>> objects;
+		for (uint32_t i = 0; i < moving; ++i) {
+			objects.push_back(std::make_unique<Object>());
+			objects.back()->velocity = {1.0f, 0.5f, 0.25f};
+		}
+		std::shuffle(objects.begin(), objects.end(), std::mt19937(5));
+
+		std::vector<Result> results;
+		auto measure = [&](const char* name, uint32_t threads, auto&& pass) {
+			pass();
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < options.iterations; ++i) pass();
+			double ms = MsSince(start) / options.iterations;
+			std::cerr << "  " << name << ", " << threads << " threads: " << ms << " ms/pass"
+			          << std::endl;
+			results.push_back({name, threads, ms});
+		};
+
+		measure("pointers", 1, [&]() {
+			for (const std::unique_ptr<Object>& object : objects) {
+				object->position.x += object->velocity.x * kDt;
+				object->position.y += object->velocity.y * kDt;
+				object->position.z += object->velocity.z * kDt;
+			}
+		});
+		measure("for_each", 1, [&]() {
+			registry.ForEach<Position, const Velocity>(
+			    [](Entity, Position& position, const Velocity& velocity) {
+				    position.x += velocity.x * kDt;
+				    position.y += velocity.y * kDt;
+				    position.z += velocity.z * kDt;
+			    });
+		});
+
+		auto integrate = [](uint32_t count, const Entity*, Position* positions,
+		                    const Velocity* velocities) {
+			for (uint32_t i = 0; i < count; ++i) {
+				positions[i].x += velocities[i].x * kDt;
+				positions[i].y += velocities[i].y * kDt;
+				positions[i].z += velocities[i].z * kDt;
+			}
+		};
+		auto decay = [](uint32_t count, const Entity*, Health* health) {
+			for (uint32_t i = 0; i < count; ++i) health[i].value *= 0.999f;
+		};
+		for (uint32_t threads : thread_counts) {
+			JobSystem jobs(threads);
+			measure("chunks", threads, [&]() {
+				registry.ParallelForEachChunk<Position, const Velocity>(&jobs, integrate);
+			});
+
+			// Two systems over disjoint components share a phase and run side by side.
+			SystemSchedule schedule;
+			auto integrate_system = [&](Registry& registry, JobSystem* jobs) {
+				registry.ParallelForEachChunk<Position, const Velocity>(jobs, integrate);
+			};
+			schedule.Add("integrate", MaskOf<Velocity>(), MaskOf<Position>(), integrate_system);
+			schedule.Add("decay", 0, MaskOf<Health>(), [&](Registry& registry, JobSystem* jobs) {
+				registry.ParallelForEachChunk<Health>(jobs, decay);
+			});
+			measure("schedule", threads, [&]() { schedule.Run(registry, jobs); });
+		}
+
+		std::ostringstream json;
+		json << "{\n"
+		     << "  \"entities\": " << options.entities << ",\n"
+		     << "  \"moving\": " << moving << ",\n"
+		     << "  \"iterations\": " << options.iterations << ",\n"
+		     << "  \"build_ms\": " << build_ms << ",\n"
+		     << "  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); ++i) {
+			const Result& result = results[i];
+			json << "    {\"case\": \"" << result.name << "\", \"threads\": " << result.threads
+			     << ", \"ms_per_pass\": " << result.ms << ", \"entities_per_us\": "
+			     << (result.ms > 0.0 ? moving / (result.ms * 1000.0) : 0.0) << "}"
+			     << (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		json << "  ]\n}\n";
+
+		WriteBenchJson(options.output, json.str());
+	} catch (const std::exception& e) {
+		std::cout << "Error occurred: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+#include "asset_loader.h"
+#include "bench_common.h"
+#include "gltf_file.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Compares the two ways a glTF file reaches the GPU: Assimp (AssetLoader::Import, which also
+// optimizes the meshes) and GltfFile. Without a device, the upload is stood in for by writing
+// every byte into a scratch buffer the size of a staging chunk, one chunk at a time, as Uploader
+// does. Every run imports in a fresh process, so the peak resident set it reports is the
+// importer's own.
+struct BenchOptions {
+	std::string input;
+	// assimp, gltf or both.
+	std::string importer = "both";
+	uint32_t runs        = 3;
+	std::string output;
+};
+
+// Plain data, so a child process can hand it back through a pipe.
+struct ImportResult {
+	double load_ms      = 0.0;
+	double peak_rss_mib = 0.0;
+	uint64_t primitives = 0;
+	uint64_t vertices   = 0;
+	uint64_t triangles  = 0;
+	// Primitives uploaded without conversion; GltfFile only.
+	uint64_t zero_copy = 0;
+};
+
+void PrintUsage(const char* program) {
+	PrintBenchUsage(
+	    program, "<file.gltf|file.glb> [options]",
+	    "  --importer <name>  assimp, gltf or both (default: both)\n"
+	    "  --runs <n>         Imports per importer, each in a new process (default: 3)\n");
+}
+
+// Stands in for Uploader's staging ring.
+class Staging {
+public:
+	Staging() : chunk_(Uploader::kDefaultRingSize / 4) {}
+
+	void Upload(const void* data, vk::DeviceSize size) {
+		auto bytes = static_cast<const uint8_t*>(data);
+		Upload(size, [&](void* staging, vk::DeviceSize offset, vk::DeviceSize chunk) {
+			std::memcpy(staging, bytes + offset, chunk);
+		});
+	}
+
+	void Upload(vk::DeviceSize size, const Uploader::Fill& fill) {
+		for (vk::DeviceSize done = 0; done < size; done += chunk_.size()) {
+			vk::DeviceSize chunk = std::min<vk::DeviceSize>(size - done, chunk_.size());
+			fill(chunk_.data(), done, chunk);
+			checksum_ += chunk_[0];
+		}
+	}
+
+	uint64_t Checksum() const { return checksum_; }
+
+private:
+	std::vector<uint8_t> chunk_;
+	uint64_t checksum_ = 0;
+};
+
+double PeakRssMib() {
+#ifdef _WIN32
+	return 0.0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+// Keeps the staging writes from being optimized away.
+volatile uint64_t checksum_sink;
+
+ImportResult ImportAssimp(const std::string& path, Staging& staging) {
+	ImportResult result;
+	LoadedAsset asset = AssetLoader::Import(path);
+	if (!asset.error.empty()) throw std::runtime_error(asset.error);
+
+	for (const MeshData& mesh : asset.meshes) {
+		staging.Upload(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+		// Model narrows indices the same way.
+		if (mesh.vertices.size() <= std::numeric_limits<uint16_t>::max() + 1u) {
+			std::vector<uint16_t> indices(mesh.indices.begin(), mesh.indices.end());
+			staging.Upload(indices.data(), indices.size() * sizeof(uint16_t));
+		} else {
+			staging.Upload(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		}
+		result.vertices += mesh.vertices.size();
+		result.triangles += mesh.indices.size() / 3;
+	}
+	result.primitives = asset.meshes.size();
+	return result;
+}
+
+ImportResult ImportGltf(const std::string& path, Staging& staging) {
+	ImportResult result;
+	GltfFile file(path);
+	for (const MeshSource& mesh : file.Primitives()) {
+		vk::DeviceSize vertex_bytes = vk::DeviceSize(mesh.vertex_count) * sizeof(Vertex);
+		vk::DeviceSize index_bytes  = vk::DeviceSize(mesh.index_count) * mesh.index_size;
+		if (mesh.vertices) {
+			staging.Upload(mesh.vertices, vertex_bytes);
+		} else {
+			staging.Upload(vertex_bytes, mesh.fill_vertices);
+		}
+		if (mesh.indices) {
+			staging.Upload(mesh.indices, index_bytes);
+		} else {
+			staging.Upload(index_bytes, mesh.fill_indices);
+		}
+		result.vertices += mesh.vertex_count;
+		result.triangles += mesh.index_count / 3;
+	}
+	result.primitives = file.Primitives().size();
+	result.zero_copy  = file.ZeroCopyPrimitives();
+	return result;
+}
+
+ImportResult Import(const std::string& importer, const std::string& path) {
+	auto start = std::chrono::steady_clock::now();
+	Staging staging;
+	ImportResult result =
+	    importer == "assimp" ? ImportAssimp(path, staging) : ImportGltf(path, staging);
+	result.load_ms =
+	    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	result.peak_rss_mib = PeakRssMib();
+	checksum_sink       = staging.Checksum();
+	return result;
+}
+
+#ifndef _WIN32
+// Imports in a child process and reads its result back through a pipe.
+ImportResult ImportIsolated(const std::string& importer, const std::string& path) {
+	int fds[2];
+	if (pipe(fds) != 0) throw std::runtime_error("Failed to create a pipe");
+	pid_t pid = fork();
+	if (pid < 0) throw std::runtime_error("Failed to fork");
+	if (pid == 0) {
+		close(fds[0]);
+		ImportResult result;
+		int status = EXIT_SUCCESS;
+		try {
+			result = Import(importer, path);
+		} catch (const std::exception& e) {
+			std::cerr << importer << ": " << e.what() << std::endl;
+			status = EXIT_FAILURE;
+		}
+		bool sent = write(fds[1], &result, sizeof(result)) == ssize_t(sizeof(result));
+		_exit(sent ? status : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	ImportResult result;
+	bool received = read(fds[0], &result, sizeof(result)) == ssize_t(sizeof(result));
+	close(fds[0]);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if (!received || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+		throw std::runtime_error("Importing with " + importer + " failed");
+	}
+	return result;
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+
+	auto parse = [&](const char* argument, const BenchValue& value) {
+		if (!std::strcmp(argument, "--importer")) {
+			options.importer = value();
+		} else if (!std::strcmp(argument, "--runs")) {
+			options.runs = std::stoul(value());
+		} else if (argument[0] != '-' && options.input.empty()) {
+			options.input = argument;
+		} else {
+			return false;
+		}
+		return true;
+	};
+	auto validate = [&] {
+		if (options.input.empty()) throw std::invalid_argument("No input file");
+		if (options.importer != "assimp" && options.importer != "gltf" &&
+		    options.importer != "both") {
+			throw std::invalid_argument("Unknown importer " + options.importer);
+		}
+		if (options.runs == 0) throw std::invalid_argument("--runs must be positive");
+#ifdef _WIN32
+		// Without fork() every run shares one process, and so one peak.
+		if (options.importer == "both" || options.runs > 1) {
+			throw std::invalid_argument("Run one importer once per process on Windows");
+		}
+#endif
+	};
+	if (!ParseBenchArgs(argc, argv, options.output, PrintUsage, parse, validate)) {
+		return EXIT_FAILURE;
+	}
+
+	try {
+		std::vector<std::string> importers;
+		if (options.importer != "gltf") importers.push_back("assimp");
+		if (options.importer != "assimp") importers.push_back("gltf");
+
+		std::ostringstream results;
+		std::vector<ImportResult> best;
+		for (const std::string& importer : importers) {
+			// The first run may read the file from disk; the fastest shows the importer's cost.
+			ImportResult result;
+			for (uint32_t run = 0; run < options.runs; ++run) {
+#ifdef _WIN32
+				ImportResult current = Import(importer, options.input);
+#else
+				ImportResult current = ImportIsolated(importer, options.input);
+#endif
+				if (run == 0 || current.load_ms < result.load_ms) result = current;
+			}
+			best.push_back(result);
+
+			std::cerr << importer << ": " << result.load_ms << " ms, " << result.peak_rss_mib
+			          << " MiB peak RSS, " << result.primitives << " primitives, "
+			          << result.vertices << " vertices, " << result.triangles << " triangles";
+			if (importer == "gltf") std::cerr << ", " << result.zero_copy << " zero-copy";
+			std::cerr << std::endl;
+
+			if (!results.str().empty()) results << ",\n";
+			results << "    {\"importer\": \"" << importer << "\", \"load_ms\": " << result.load_ms
+			        << ", \"peak_rss_mib\": " << result.peak_rss_mib
+			        << ", \"primitives\": " << result.primitives
+			        << ", \"vertices\": " << result.vertices
+			        << ", \"triangles\": " << result.triangles
+			        << ", \"zero_copy_primitives\": " << result.zero_copy << "}";
+		}
+		if (best.size() == 2) {
+			std::cerr << "gltf vs assimp: " << best[0].load_ms / best[1].load_ms << "x faster, "
+			          << best[1].peak_rss_mib / best[0].peak_rss_mib << "x the peak RSS"
+			          << std::endl;
+		}
+
+		std::ostringstream json;
+		json << "{\n"
+		     << "  \"input\": \"" << options.input << "\",\n"
+		     << "  \"runs\": " << options.runs << ",\n"
+		     << "  \"results\": [\n"
+		     << results.str() << "\n  ]\n}\n";
+
+		WriteBenchJson(options.output, json.str());
+	} catch (const std::exception& e) {
+		std::cout << "Error occurred: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+#include "bench_common.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// Measures the JobSystem alone: the cost of scheduling and waiting on empty jobs, and how well a
+// compute-bound parallel-for scales with threads, with picked, fine and nested ranges. Efficiency
+// is the speedup over one thread divided by the thread count.
+struct BenchOptions {
+	uint32_t jobs       = 100000;
+	uint32_t elements   = 1 << 20;
+	uint32_t iterations = 10;
+	// 0 uses every hardware thread.
+	uint32_t threads = 0;
+	std::string output;
+};
+
+void PrintUsage(const char* program) {
+	PrintBenchUsage(
+	    program, "[options]",
+	    "  --jobs <n>         Empty jobs per scheduling pass (default: 100000)\n"
+	    "  --elements <n>     Elements per parallel-for pass (default: 1048576)\n"
+	    "  --iterations <n>   Measured passes per case (default: 10)\n"
+	    "  --threads <n>      Most threads to try (default: all hardware threads)\n");
+}
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+	    .count();
+}
+
+// A few hundred nanoseconds of arithmetic per element, with no memory traffic to speak of.
+float Work(uint32_t element) {
+	float value = float(element);
+	for (int i = 0; i < 64; ++i) value = std::sqrt(value + 1.0f);
+	return value;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+
+	auto parse = [&](const char* argument, const BenchValue& value) {
+		if (!std::strcmp(argument, "--jobs")) {
+			options.jobs = std::stoul(value());
+		} else if (!std::strcmp(argument, "--elements")) {
+			options.elements = std::stoul(value());
+		} else if (!std::strcmp(argument, "--iterations")) {
+			options.iterations = std::stoul(value());
+		} else if (!std::strcmp(argument, "--threads")) {
+			options.threads = std::stoul(value());
+		} else {
+			return false;
+		}
+		return true;
+	};
+	auto validate = [&] {
+		if (options.jobs == 0 || options.elements == 0 || options.iterations == 0) {
+			throw std::invalid_argument("--jobs, --elements and --iterations must be positive");
+		}
+	};
+	if (!ParseBenchArgs(argc, argv, options.output, PrintUsage, parse, validate)) {
+		return EXIT_FAILURE;
+	}
+
+	try {
+		uint32_t max_threads = options.threads;
+		if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<uint32_t> thread_counts;
+		for (uint32_t count = 1; count < max_threads; count *= 2) thread_counts.push_back(count);
+		thread_counts.push_back(max_threads);
+
+		std::vector<float> out(options.elements);
+		auto work = [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i) out[i] = Work(i);
+		};
+		// 64 outer ranges, each a parallel-for of its own that its thread helps with while waiting.
+		const uint32_t kOuter = 64;
+
+		auto nested = [&](JobSystem& jobs) {
+			jobs.ParallelFor(
+			    kOuter,
+			    [&](uint32_t outer_begin, uint32_t outer_end) {
+				    for (uint32_t outer = outer_begin; outer < outer_end; ++outer) {
+					    uint32_t begin = uint32_t(uint64_t(options.elements) * outer / kOuter);
+					    uint32_t end = uint32_t(uint64_t(options.elements) * (outer + 1) / kOuter);
+					    jobs.ParallelFor(end - begin, [&](uint32_t b, uint32_t e) {
+						    work(begin + b, begin + e);
+					    });
+				    }
+			    },
+			    1);
+		};
+
+		struct Case {
+			const char* name;
+			std::function<void(JobSystem&)> pass;
+		};
+		const Case cases[] = {
+		    {"parallel_for", [&](JobSystem& jobs) { jobs.ParallelFor(options.elements, work); }},
+		    {"parallel_for_grain_64",
+		     [&](JobSystem& jobs) { jobs.ParallelFor(options.elements, work, 64); }},
+		    {"nested", nested},
+		};
+
+		std::ostringstream results;
+		bool first = true;
+		std::vector<double> single_thread_ms(std::size(cases), 0.0);
+		for (uint32_t threads : thread_counts) {
+			JobSystem jobs(threads);
+
+			// Scheduling overhead: empty jobs queued from one thread, then waited on.
+			JobCounter counter;
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < options.iterations; ++i) {
+				for (uint32_t j = 0; j < options.jobs; ++j) jobs.Schedule([] {}, &counter);
+				jobs.Wait(counter);
+			}
+			double ns_per_job = MsSince(start) * 1e6 / (double(options.iterations) * options.jobs);
+			double stolen     = double(jobs.JobsStolen()) / std::max<uint64_t>(1, jobs.JobsRun());
+			std::cerr << threads << " threads: " << ns_per_job << " ns per empty job, "
+			          << stolen * 100.0 << "% stolen" << std::endl;
+			if (!first) results << ",\n";
+			first = false;
+			results << "    {\"case\": \"schedule_empty\", \"threads\": " << threads
+			        << ", \"ns_per_job\": " << ns_per_job << ", \"stolen_fraction\": " << stolen
+			        << "}";
+
+			for (size_t c = 0; c < std::size(cases); ++c) {
+				cases[c].pass(jobs);
+				start = std::chrono::steady_clock::now();
+				for (uint32_t i = 0; i < options.iterations; ++i) cases[c].pass(jobs);
+				double ms = MsSince(start) / options.iterations;
+				if (threads == 1) single_thread_ms[c] = ms;
+				double speedup    = single_thread_ms[c] > 0.0 ? single_thread_ms[c] / ms : 0.0;
+				double efficiency = speedup / threads;
+				std::cerr << "  " << cases[c].name << ": " << ms << " ms/pass, " << speedup
+				          << "x, " << efficiency * 100.0 << "% efficient" << std::endl;
+				results << ",\n    {\"case\": \"" << cases[c].name << "\", \"threads\": " << threads
+				        << ", \"ms_per_pass\": " << ms << ", \"speedup\": " << speedup
+				        << ", \"efficiency\": " << efficiency << "}";
+			}
+		}
+
+		std::ostringstream json;
+		json << "{\n"
+		     << "  \"jobs\": " << options.jobs << ",\n"
+		     << "  \"elements\": " << options.elements << ",\n"
+		     << "  \"iterations\": " << options.iterations << ",\n"
+		     << "  \"results\": [\n"
+		     << results.str() << "\n  ]\n}\n";
+
+		WriteBenchJson(options.output, json.str());
+	} catch (const std::exception& e) {
+		std::cout << "Error occurred: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
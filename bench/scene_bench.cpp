@@ -0,0 +1,177 @@
+#include "bench_common.h"
+#include "scene_graph.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Measures SceneGraph alone, without a device: a reproducible tree is built and updated with
+// increasing amounts of change, once per thread count.
+struct BenchOptions {
+	uint32_t nodes      = 1000000;
+	uint32_t iterations = 20;
+	// 0 uses every hardware thread.
+	uint32_t threads = 0;
+	std::string output;
+};
+
+// Each root gets kFanOut children, each of those kFanOut more, and so on, created level by level.
+const uint32_t kRoots  = 64;
+const uint32_t kFanOut = 4;
+
+void PrintUsage(const char* program) {
+	PrintBenchUsage(
+	    program, "[options]",
+	    "  --nodes <n>        Nodes in the tree (default: 1000000)\n"
+	    "  --iterations <n>   Measured updates per case (default: 20)\n"
+	    "  --threads <n>      Most worker threads to try (default: all hardware threads)\n");
+}
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+	    .count();
+}
+
+std::vector<NodeHandle> BuildTree(SceneGraph& scene, uint32_t count) {
+	std::vector<NodeHandle> nodes;
+	nodes.reserve(count);
+	scene.Reserve(count);
+	NodeTransform local;
+	local.position = glm::vec3(1.0f, 0.0f, 0.0f);
+	local.rotation = glm::angleAxis(0.1f, glm::vec3(0.0f, 1.0f, 0.0f));
+	for (uint32_t i = 0; i < count; ++i) {
+		NodeHandle parent = i < kRoots ? NodeHandle() : nodes[(i - kRoots) / kFanOut];
+		nodes.push_back(scene.Create(parent, local));
+	}
+	return nodes;
+}
+
+struct Case {
+	const char* name;
+	// Nodes whose local transform changes before every update; 0 changes nothing.
+	double touched_fraction;
+	// Nodes moved to a new parent before every update, forcing a re-sort.
+	uint32_t reparented;
+};
+
+const Case kCases[] = {
+    {"clean", 0.0, 0},
+    {"touch_0.1%", 0.001, 0},
+    {"touch_1%", 0.01, 0},
+    {"touch_all", 1.0, 0},
+    {"reparent_100", 0.0, 100},
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+
+	auto parse = [&](const char* argument, const BenchValue& value) {
+		if (!std::strcmp(argument, "--nodes")) {
+			options.nodes = std::stoul(value());
+		} else if (!std::strcmp(argument, "--iterations")) {
+			options.iterations = std::stoul(value());
+		} else if (!std::strcmp(argument, "--threads")) {
+			options.threads = std::stoul(value());
+		} else {
+			return false;
+		}
+		return true;
+	};
+	auto validate = [&] {
+		if (options.nodes <= kRoots || options.iterations == 0) {
+			throw std::invalid_argument(
+			    "--nodes must exceed the root count, --iterations be positive");
+		}
+	};
+	if (!ParseBenchArgs(argc, argv, options.output, PrintUsage, parse, validate)) {
+		return EXIT_FAILURE;
+	}
+
+	try {
+		uint32_t max_threads = options.threads;
+		if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<uint32_t> thread_counts;
+		for (uint32_t count = 1; count < max_threads; count *= 2) thread_counts.push_back(count);
+		thread_counts.push_back(max_threads);
+
+		std::ostringstream results;
+		bool first = true;
+		for (uint32_t threads : thread_counts) {
+			JobSystem jobs(threads);
+			JobSystem* update_jobs = threads > 1 ? &jobs : nullptr;
+
+			SceneGraph scene;
+			auto start                    = std::chrono::steady_clock::now();
+			std::vector<NodeHandle> nodes = BuildTree(scene, options.nodes);
+			double build_ms               = MsSince(start);
+			start                         = std::chrono::steady_clock::now();
+			scene.Update(update_jobs);
+			double first_update_ms = MsSince(start);
+			std::cerr << threads << " threads: built " << options.nodes << " nodes in "
+			          << scene.LevelCount() << " levels in " << build_ms << " ms, first update "
+			          << first_update_ms << " ms" << std::endl;
+
+			std::mt19937 rng(99);
+			std::uniform_int_distribution<uint32_t> pick(0, options.nodes - 1);
+			std::uniform_int_distribution<uint32_t> pick_leaf(options.nodes / 2, options.nodes - 1);
+			for (const Case& test : kCases) {
+				uint32_t touched = uint32_t(test.touched_fraction * options.nodes);
+				double total_ms  = 0.0;
+				uint64_t updated = 0;
+				for (uint32_t i = 0; i < options.iterations; ++i) {
+					glm::vec3 offset(float(i % 7), 0.0f, 0.0f);
+					if (touched == options.nodes) {
+						for (NodeHandle node : nodes) scene.SetPosition(node, offset);
+					} else {
+						for (uint32_t t = 0; t < touched; ++t) {
+							scene.SetPosition(nodes[pick(rng)], offset);
+						}
+					}
+					// Leaves under roots keep the hierarchy valid: a root is never a descendant.
+					for (uint32_t r = 0; r < test.reparented; ++r) {
+						scene.SetParent(nodes[pick_leaf(rng)], nodes[rng() % kRoots]);
+					}
+
+					start = std::chrono::steady_clock::now();
+					scene.Update(update_jobs);
+					total_ms += MsSince(start);
+					updated += scene.LastUpdateCount();
+				}
+				double ms           = total_ms / options.iterations;
+				double mean_updated = double(updated) / options.iterations;
+				std::cerr << "  " << test.name << ": " << ms << " ms/update, " << mean_updated
+				          << " world matrices recomputed" << std::endl;
+
+				if (!first) results << ",\n";
+				first = false;
+				results << "    {\"case\": \"" << test.name << "\", \"threads\": " << threads
+				        << ", \"ms_per_update\": " << ms << ", \"updated\": " << mean_updated
+				        << ", \"updated_per_us\": "
+				        << (ms > 0.0 ? mean_updated / (ms * 1000.0) : 0.0)
+				        << ", \"build_ms\": " << build_ms
+				        << ", \"first_update_ms\": " << first_update_ms << "}";
+			}
+		}
+
+		std::ostringstream json;
+		json << "{\n"
+		     << "  \"nodes\": " << options.nodes << ",\n"
+		     << "  \"iterations\": " << options.iterations << ",\n"
+		     << "  \"results\": [\n"
+		     << results.str() << "\n  ]\n}\n";
+
+		WriteBenchJson(options.output, json.str());
+	} catch (const std::exception& e) {
+		std::cout << "Error occurred: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
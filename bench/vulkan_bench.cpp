@@ -0,0 +1,341 @@
+#include "bench_common.h"
+#include "engine.h"
+#include "mesh_simplifier.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// A reproducible workload: every run of the same scene renders identical content at the same
+// resolution, so results are comparable across commits.
+struct BenchScene {
+	enum class Mesh { eTriangle, eCube, eSphere };
+
+	const char* name;
+	uint32_t width;
+	uint32_t height;
+	Mesh mesh;
+	// Instances are laid out on a square grid, one draw call each.
+	uint32_t instances;
+	// Distinct textures cycled through the instances; 0 draws everything untextured.
+	uint32_t textures = 0;
+	// Grids stacked on top of each other, cube against cube, so only the top one is visible.
+	uint32_t layers = 1;
+};
+
+const BenchScene kScenes[] = {
+    {"triangle", 800, 600, BenchScene::Mesh::eTriangle, 1},
+    {"triangle_1080p", 1920, 1080, BenchScene::Mesh::eTriangle, 1},
+    {"cubes_1k", 800, 600, BenchScene::Mesh::eCube, 1000},
+    {"cubes_10k", 800, 600, BenchScene::Mesh::eCube, 10000},
+    {"cubes_50k", 800, 600, BenchScene::Mesh::eCube, 50000},
+    // Neighbouring draws use different textures, which the bindless heap handles without any
+    // descriptor binds.
+    {"cubes_textured_10k", 800, 600, BenchScene::Mesh::eCube, 10000, 1024},
+    // Mostly hidden: the top layer occludes the seven below it.
+    {"cubes_dense_50k", 800, 600, BenchScene::Mesh::eCube, 50000, 0, 8},
+    // 6.5 million triangles in spheres split into meshlets, of which the half facing away from
+    // the camera is culled before it reaches the rasterizer.
+    {"spheres_clustered_100", 800, 600, BenchScene::Mesh::eSphere, 100},
+    // 160 million triangles at full detail, but most spheres cover a few dozen pixels and are
+    // drawn at one of their coarser LODs.
+    {"spheres_lod_2500", 800, 600, BenchScene::Mesh::eSphere, 2500},
+};
+
+struct BenchOptions {
+	std::string scene;
+	uint32_t frames = 300;
+	uint32_t warmup = 30;
+	std::string output;
+	bool pipeline_cache       = true;
+	uint32_t frames_in_flight = 2;
+	// 0 uses every hardware thread.
+	uint32_t record_threads = 0;
+	// Run every scene at 1, 2, 4, ... record threads up to the hardware thread count.
+	bool record_sweep = false;
+	// Every scene is run once per draw path.
+	std::vector<DrawPath> draw_paths = {DrawPath::eIndirect};
+	// GPU frustum and occlusion culling on the indirect path.
+	bool culling = true;
+	// Per meshlet culling of large models on the indirect path.
+	bool cluster_culling = true;
+	// EngineConfig::lod_threshold_pixels.
+	float lod_threshold = 1.0f;
+};
+
+const char* DrawPathName(DrawPath path) {
+	return path == DrawPath::eDirect ? "direct" : "indirect";
+}
+
+std::vector<DrawPath> ParseDrawPaths(const std::string& name) {
+	if (name == "direct") return {DrawPath::eDirect};
+	if (name == "indirect") return {DrawPath::eIndirect};
+	if (name == "both") return {DrawPath::eDirect, DrawPath::eIndirect};
+	throw std::invalid_argument("Unknown draw path: " + name);
+}
+
+std::string JsonEscape(const std::string& text) {
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+void PrintUsage(const char* program) {
+	PrintBenchUsage(
+	    program, "[options]",
+	    "  --scene <name>     Run a single scene (default: all)\n"
+	    "  --frames <n>       Measured frames per scene (default: 300)\n"
+	    "  --warmup <n>       Unmeasured frames before measuring (default: 30)\n"
+	    "  --no-pipeline-cache  Compile pipelines without the on-disk cache\n"
+	    "  --frames-in-flight <n>  Frames recorded ahead of the GPU, 1-3 (default: 2)\n"
+	    "  --record-threads <n>  Threads recording draws (default: all hardware threads)\n"
+	    "  --record-sweep     Run each scene with 1, 2, 4, ... up to all record threads\n"
+	    "  --draw-path <p>    direct, indirect or both (default: indirect)\n"
+	    "  --no-culling       Draw every object on the indirect path\n"
+	    "  --no-cluster-culling  Cull large models as a whole on the indirect path\n"
+	    "  --lod-threshold <px>  LOD error allowed on screen, 0 for none (default: 1)\n");
+	std::cout << "Scenes:";
+	for (const BenchScene& scene : kScenes) std::cout << " " << scene.name;
+	std::cout << std::endl;
+}
+
+void BuildScene(Engine& engine, const BenchScene& scene) {
+	if (scene.mesh == BenchScene::Mesh::eTriangle) {
+		engine.AddInstance(engine.AddModel(Model::Triangle()), glm::mat4(1.0f));
+		return;
+	}
+
+	// Small checkerboards, each tinted with its own color.
+	const uint32_t texture_size = 16;
+	std::vector<uint32_t> textures;
+	std::vector<uint8_t> pixels(texture_size * texture_size * 4);
+	for (uint32_t t = 0; t < scene.textures; ++t) {
+		uint8_t tint[3] = {uint8_t(64 + t * 37 % 192), uint8_t(64 + t * 91 % 192),
+		                   uint8_t(64 + t * 53 % 192)};
+		for (uint32_t i = 0; i < texture_size * texture_size; ++i) {
+			bool dark = ((i % texture_size) / 4 + (i / texture_size) / 4) % 2;
+			for (uint32_t c = 0; c < 3; ++c) pixels[i * 4 + c] = dark ? tint[c] / 2 : tint[c];
+			pixels[i * 4 + 3] = 255;
+		}
+		textures.push_back(engine.AddTexture(texture_size, texture_size, pixels.data()));
+	}
+
+	// Spheres go through the same optimization, LOD and meshlet builds as imported meshes.
+	const Model* model = nullptr;
+	if (scene.mesh == BenchScene::Mesh::eSphere) {
+		MeshData sphere = Model::Sphere(256, 128);
+		OptimizeMesh(sphere);
+		BuildLods(sphere);
+		sphere.meshlets = BuildMeshlets(sphere);
+		model           = engine.AddModel(sphere);
+	} else {
+		model = engine.AddModel(Model::Cube());
+	}
+	const float spacing = scene.layers > 1 ? 1.0f : 1.5f;
+	uint32_t per_layer  = (scene.instances + scene.layers - 1) / scene.layers;
+	uint32_t side       = uint32_t(std::ceil(std::sqrt(double(per_layer))));
+	float half_extent   = 0.5f * spacing * (side - 1);
+	for (uint32_t i = 0; i < scene.instances; ++i) {
+		uint32_t cell = i % per_layer;
+		glm::vec3 position(spacing * (cell % side) - half_extent, -spacing * float(i / per_layer),
+		                   spacing * (cell / side) - half_extent);
+		uint32_t texture = textures.empty() ? Engine::kWhiteTexture : textures[i % textures.size()];
+		engine.AddInstance(model, glm::translate(glm::mat4(1.0f), position), texture);
+	}
+
+	// Look down on the whole grid from above one edge.
+	float distance = std::max(half_extent, 2.0f) * 2.0f;
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, distance * 0.6f, distance), glm::vec3(0.0f),
+	                             glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), float(scene.width) / scene.height,
+	                                        0.1f, distance * 4);
+	projection[1][1] *= -1.0f;
+	engine.SetViewProjection(projection * view);
+}
+
+// Thread counts to run every scene with.
+std::vector<uint32_t> RecordThreadCounts(const BenchOptions& options) {
+	if (!options.record_sweep) return {options.record_threads};
+
+	uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<uint32_t> counts;
+	for (uint32_t count = 1; count < hardware; count *= 2) counts.push_back(count);
+	counts.push_back(hardware);
+	return counts;
+}
+
+// Renders one scene headless and writes its JSON object. Returns the device name for the report.
+std::string RunScene(const BenchScene& scene, const BenchOptions& options, DrawPath draw_path,
+                     uint32_t record_threads, std::ostream& json) {
+	EngineConfig config;
+	config.headless           = true;
+	config.width              = scene.width;
+	config.height             = scene.height;
+	config.collect_timings    = true;
+	config.use_pipeline_cache = options.pipeline_cache;
+	config.frames_in_flight   = options.frames_in_flight;
+	config.worker_threads     = record_threads;
+	config.draw_path          = draw_path;
+	config.frustum_culling    = options.culling;
+	config.occlusion_culling  = options.culling;
+	config.cluster_culling    = options.cluster_culling;
+	config.lod_threshold_pixels = options.lod_threshold;
+
+	Engine engine(config);
+	BuildScene(engine, scene);
+	for (uint32_t i = 0; i < options.warmup; ++i) engine.RenderFrame();
+	engine.WaitIdle();
+	engine.Stats().Clear();
+
+	for (uint32_t i = 0; i < options.frames; ++i) engine.RenderFrame();
+	engine.WaitIdle();
+
+	TimingSummary cpu    = engine.Stats().Summarize(&FrameTiming::cpu_ms);
+	TimingSummary update = engine.Stats().Summarize(&FrameTiming::update_ms);
+	// Recording alone, so the per-draw cost shows the dispatch overhead and not the scene update.
+	TimingSummary record = engine.Stats().Summarize(&FrameTiming::record_ms);
+	TimingSummary queued = engine.Stats().Summarize(&FrameTiming::queued_frames);
+	// The engine falls back to direct draws on devices without multi-draw indirect.
+	const char* path = DrawPathName(engine.Config().draw_path);
+	std::cerr << scene.name << " (" << path << ", " << engine.WorkerThreads()
+	          << " record threads): " << cpu.mean
+	          << " ms/frame cpu (p99 " << cpu.p99 << "), " << update.mean << " ms updating, "
+	          << record.mean << " ms recording, " << queued.mean
+	          << " frames queued on the GPU at submit" << std::endl;
+	// Only frames culled on the GPU have counters.
+	TimingSummary drawn = engine.Stats().Summarize(&FrameTiming::objects_drawn);
+	if (drawn.samples > 0) {
+		TimingSummary frustum   = engine.Stats().Summarize(&FrameTiming::objects_frustum_culled);
+		TimingSummary occlusion = engine.Stats().Summarize(&FrameTiming::objects_occlusion_culled);
+		std::cerr << "  " << drawn.mean << " objects drawn, " << frustum.mean
+		          << " frustum culled, " << occlusion.mean << " occlusion culled" << std::endl;
+	}
+	TimingSummary clusters = engine.Stats().Summarize(&FrameTiming::clusters_drawn);
+	if (clusters.samples > 0) {
+		auto mean = [&](double FrameTiming::*field) {
+			return engine.Stats().Summarize(field).mean;
+		};
+		std::cerr << "  " << clusters.mean << " clusters drawn, "
+		          << mean(&FrameTiming::clusters_frustum_culled) << " frustum culled, "
+		          << mean(&FrameTiming::clusters_backface_culled) << " backface culled, "
+		          << mean(&FrameTiming::clusters_occlusion_culled) << " occlusion culled"
+		          << std::endl;
+	}
+	// Counted wherever LODs are picked, on the CPU for direct draws or the GPU for indirect ones.
+	TimingSummary saved = engine.Stats().Summarize(&FrameTiming::lod_triangles_saved);
+	if (saved.samples > 0 && saved.max > 0.0) {
+		std::cerr << "  " << saved.mean / 1e6 << "M triangles per frame saved by LODs, "
+		          << saved.mean / cpu.mean / 1e3 << "M per second" << std::endl;
+	}
+
+	json << "    {\n"
+	     << "      \"name\": \"" << scene.name << "\",\n"
+	     << "      \"width\": " << scene.width << ",\n"
+	     << "      \"height\": " << scene.height << ",\n"
+	     << "      \"instances\": " << scene.instances << ",\n"
+	     << "      \"textures\": " << scene.textures << ",\n"
+	     << "      \"draw_path\": \"" << path << "\",\n"
+	     << "      \"gpu_built_draws\": " << (engine.GpuBuiltDraws() ? "true" : "false") << ",\n"
+	     << "      \"frustum_culling\": " << (engine.Config().frustum_culling ? "true" : "false")
+	     << ",\n"
+	     << "      \"occlusion_culling\": "
+	     << (engine.Config().occlusion_culling ? "true" : "false") << ",\n"
+	     << "      \"cluster_culling\": " << (engine.Config().cluster_culling ? "true" : "false")
+	     << ",\n"
+	     << "      \"lod_threshold_pixels\": " << engine.Config().lod_threshold_pixels << ",\n"
+	     << "      \"record_threads\": " << engine.WorkerThreads() << ",\n"
+	     << "      \"record_us_per_draw\": " << record.mean * 1000.0 / scene.instances << ",\n"
+	     << "      \"frames\": " << engine.Stats().Count() << ",\n"
+	     << "      \"pipeline_create_ms\": " << engine.PipelineCreateMs() << ",\n"
+	     << "      \"pipeline_cache_warm\": " << (engine.PipelineCacheWarm() ? "true" : "false")
+	     << ",\n"
+	     << "      \"timings_ms\": ";
+	engine.Stats().WriteJson(json, 6);
+
+	MemoryStats memory = engine.Allocator().Stats();
+	json << ",\n      \"memory\": {\"reserved\": " << memory.reserved
+	     << ", \"used\": " << memory.used << ", \"blocks\": " << memory.block_count
+	     << ", \"dedicated\": " << memory.dedicated_count
+	     << ", \"fragmentation\": " << memory.fragmentation << "}";
+	json << "\n    }";
+
+	return engine.DeviceName();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+
+	auto parse = [&](const char* argument, const BenchValue& value) {
+		if (!std::strcmp(argument, "--scene")) {
+			options.scene = value();
+		} else if (!std::strcmp(argument, "--frames")) {
+			options.frames = std::stoul(value());
+		} else if (!std::strcmp(argument, "--warmup")) {
+			options.warmup = std::stoul(value());
+		} else if (!std::strcmp(argument, "--no-pipeline-cache")) {
+			options.pipeline_cache = false;
+		} else if (!std::strcmp(argument, "--frames-in-flight")) {
+			options.frames_in_flight = std::stoul(value());
+		} else if (!std::strcmp(argument, "--record-threads")) {
+			options.record_threads = std::stoul(value());
+		} else if (!std::strcmp(argument, "--record-sweep")) {
+			options.record_sweep = true;
+		} else if (!std::strcmp(argument, "--draw-path")) {
+			options.draw_paths = ParseDrawPaths(value());
+		} else if (!std::strcmp(argument, "--no-culling")) {
+			options.culling = false;
+		} else if (!std::strcmp(argument, "--no-cluster-culling")) {
+			options.cluster_culling = false;
+		} else if (!std::strcmp(argument, "--lod-threshold")) {
+			options.lod_threshold = std::stof(value());
+		} else {
+			return false;
+		}
+		return true;
+	};
+	if (!ParseBenchArgs(argc, argv, options.output, PrintUsage, parse)) return EXIT_FAILURE;
+
+	try {
+		std::ostringstream scenes;
+		std::string device;
+		bool first = true;
+		for (const BenchScene& scene : kScenes) {
+			if (!options.scene.empty() && options.scene != scene.name) continue;
+			for (DrawPath draw_path : options.draw_paths) {
+				for (uint32_t record_threads : RecordThreadCounts(options)) {
+					if (!first) scenes << ",\n";
+					device = RunScene(scene, options, draw_path, record_threads, scenes);
+					first  = false;
+				}
+			}
+		}
+		if (first) throw std::runtime_error("Unknown scene: " + options.scene);
+
+		std::ostringstream json;
+		json << "{\n"
+		     << "  \"device\": \"" << JsonEscape(device) << "\",\n"
+		     << "  \"frames\": " << options.frames << ",\n"
+		     << "  \"warmup\": " << options.warmup << ",\n"
+		     << "  \"frames_in_flight\": " << options.frames_in_flight << ",\n"
+		     << "  \"scenes\": [\n"
+		     << scenes.str() << "\n  ]\n}\n";
+
+		WriteBenchJson(options.output, json.str());
+	} catch (const std::exception& e) {
+		std::cout << "Error occurred: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
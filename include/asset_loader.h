@@ -0,0 +1,54 @@
+#pragma once
+
+#include "job_system.h"
+#include "mesh_optimizer.h"
+#include "model.h"
+#include "mpsc_queue.h"
+
+// A mesh file parsed off the render thread.
+struct LoadedAsset {
+	uint64_t id = 0;
+	std::string path;
+	std::vector<MeshData> meshes;
+	std::vector<MaterialData> materials;
+	// Vertex cache behaviour of all meshes as the file had them and after optimization.
+	VertexCacheStats cache_before;
+	VertexCacheStats cache_after;
+	// Empty on success.
+	std::string error;
+	double load_ms = 0.0;
+};
+
+// Imports mesh files through Assimp as background jobs of a JobSystem. Jobs parse the file, build
+// vertex/index data and optimize it for the vertex cache, overdraw and vertex fetch; finished
+// assets are handed back through a lock-free completion queue that the render thread drains with
+// Poll(), so neither side ever blocks on the other.
+class AssetLoader {
+public:
+	explicit AssetLoader(JobSystem& jobs) : jobs_(jobs) {}
+	// Skips requests that haven't started and waits for the ones being parsed.
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// Queues a file for import and returns an id that identifies it in Poll() results.
+	uint64_t Load(const std::string& path);
+
+	// Moves one finished asset into out. Render thread only.
+	bool Poll(LoadedAsset& out) { return completed_.TryPop(out); }
+
+	// Requests queued or being parsed.
+	uint32_t Pending() const { return pending_.Pending(); }
+
+	// Parses a file synchronously on the calling thread.
+	static LoadedAsset Import(const std::string& path);
+
+private:
+	JobSystem& jobs_;
+	JobCounter pending_;
+	std::atomic<bool> stopping_{false};
+
+	MpscQueue<LoadedAsset> completed_;
+	uint64_t next_id_ = 1;
+};
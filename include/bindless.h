@@ -0,0 +1,118 @@
+#pragma once
+
+#include "graphics_headers.h"
+#include "memory_allocator.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+
+// A single descriptor set holding every sampled image, sampler and storage buffer the engine
+// uses, bound once per command buffer. Shaders index into its arrays with 32-bit indices that
+// arrive through push constants or storage buffers, so drawing with a different texture never
+// touches descriptor state. shaders/bindless.glsl declares the matching bindings.
+//
+// The set is created update-after-bind and partially bound: slots can be written while command
+// buffers using the set are pending, as long as those command buffers don't use that slot.
+// Slots are therefore written once, when added, and removed ones are only reused once every
+// frame that could reference them has completed. Thread safe.
+class BindlessHeap {
+public:
+	// Also the binding number of each array.
+	enum class Kind : uint32_t { eSampledImage = 0, eSampler = 1, eStorageBuffer = 2 };
+
+	static constexpr uint32_t kMaxSampledImages  = 1u << 16;
+	static constexpr uint32_t kMaxSamplers       = 256;
+	static constexpr uint32_t kMaxStorageBuffers = 1u << 14;
+
+	// The descriptor indexing features the heap relies on. Chain into vkCreateDevice.
+	static vk::PhysicalDeviceDescriptorIndexingFeaturesEXT RequiredFeatures();
+	static bool Supported(const vk::PhysicalDeviceDescriptorIndexingFeaturesEXT& features);
+
+	BindlessHeap(vk::PhysicalDevice physical_device, vk::Device device);
+	~BindlessHeap();
+
+	BindlessHeap(const BindlessHeap&) = delete;
+	BindlessHeap& operator=(const BindlessHeap&) = delete;
+
+	uint32_t AddImage(vk::ImageView view,
+	                  vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+	// Hands out an image slot with no descriptor yet, for indices that must be known before the
+	// image exists. Shaders must not sample it until SetImage() has been called; partially bound
+	// slots may stay unwritten as long as nothing reads them.
+	uint32_t ReserveImage();
+	// Writes the descriptor of a slot from ReserveImage(). Throws unless the slot is reserved and
+	// not written yet, so a slot is never rewritten while pending frames may sample it.
+	void SetImage(uint32_t index, vk::ImageView view,
+	              vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+	uint32_t AddSampler(vk::Sampler sampler);
+	uint32_t AddBuffer(vk::Buffer buffer, vk::DeviceSize offset = 0,
+	                   vk::DeviceSize range = VK_WHOLE_SIZE);
+
+	// Releases a slot. It is handed out again once frames up to the current one have completed.
+	void Remove(Kind kind, uint32_t index);
+
+	// Called at the start of every frame: frame is the frame about to be recorded and every frame
+	// before first_pending has completed on the GPU.
+	void BeginFrame(uint64_t frame, uint64_t first_pending);
+
+	uint32_t Capacity(Kind kind) const { return slots_[uint32_t(kind)].capacity; }
+	uint32_t Used(Kind kind) const;
+
+	vk::DescriptorSetLayout Layout() const { return layout_; }
+	vk::DescriptorSet Set() const { return set_; }
+	void Bind(vk::CommandBuffer cmd, vk::PipelineBindPoint bind_point,
+	          vk::PipelineLayout pipeline_layout) const;
+
+private:
+	static constexpr uint32_t kKindCount = 3;
+
+	struct Slots {
+		uint32_t capacity = 0;
+		// Slots below next have been handed out at least once.
+		uint32_t next = 0;
+		std::vector<uint32_t> free;
+	};
+
+	struct Retired {
+		Kind kind;
+		uint32_t index;
+		uint64_t frame;
+	};
+
+	uint32_t Allocate(Kind kind);
+	void WriteImage(uint32_t index, vk::ImageView view, vk::ImageLayout layout);
+
+	vk::Device device_;
+	vk::DescriptorSetLayout layout_;
+	vk::DescriptorPool pool_;
+	vk::DescriptorSet set_;
+
+	std::array<Slots, kKindCount> slots_;
+	// Image slots from ReserveImage() that SetImage() hasn't written yet.
+	std::unordered_set<uint32_t> reserved_images_;
+	std::deque<Retired> retired_;
+	uint64_t frame_ = 0;
+
+	mutable std::mutex mutex_;
+};
+
+// A buffer with its own memory, for shaders that reach it through the heap.
+struct BindlessBuffer {
+	vk::Buffer buffer;
+	Allocation memory;
+	vk::DeviceSize size = 0;
+	// Storage buffer slot in the heap, if registered.
+	std::optional<uint32_t> index;
+};
+
+// Creates a buffer of size bytes in memory with properties, registered in bindless if usage
+// includes eStorageBuffer.
+BindlessBuffer CreateBindlessBuffer(vk::Device device, MemoryAllocator& allocator,
+                                    BindlessHeap& bindless, vk::DeviceSize size,
+                                    vk::BufferUsageFlags usage,
+                                    vk::MemoryPropertyFlags properties);
+// Unregisters and destroys buffer, leaving it empty. Does nothing if it is empty already. Frames
+// that used it must have completed.
+void ReleaseBindlessBuffer(vk::Device device, MemoryAllocator& allocator, BindlessHeap& bindless,
+                           BindlessBuffer& buffer);
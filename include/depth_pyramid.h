@@ -0,0 +1,66 @@
+#pragma once
+
+#include "bindless.h"
+#include "graphics_headers.h"
+#include "memory_allocator.h"
+
+// Hierarchical-Z: a mip chain over the depth buffer where every texel holds the farthest depth
+// of the area it covers. An object whose nearest depth lies behind the texels under its screen
+// rectangle is hidden. The base level is the depth buffer size rounded down to powers of two,
+// so every further level halves exactly.
+//
+// The pyramid stays in eGeneral and is readable through the bindless heap at Texture() with the
+// nearest, clamped sampler at Sampler().
+class DepthPyramid {
+public:
+	DepthPyramid(vk::Device device, MemoryAllocator& allocator, BindlessHeap& bindless,
+	             vk::PipelineCache cache, vk::ImageView depth_view, vk::Extent2D depth_extent);
+	~DepthPyramid();
+
+	DepthPyramid(const DepthPyramid&) = delete;
+	DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+	// Rebuilds the pyramid for a new depth buffer, in a new Texture() slot. The GPU must be idle.
+	void Resize(vk::ImageView depth_view, vk::Extent2D depth_extent);
+
+	// Records the reduction of the depth buffer, which must be in eDepthStencilReadOnlyOptimal
+	// with its writes visible to compute shaders. Later compute reads see the result.
+	void Record(vk::CommandBuffer cmd) const;
+
+	uint32_t Texture() const { return texture_; }
+	uint32_t Sampler() const { return sampler_index_; }
+	vk::Extent2D Size() const { return size_; }
+	uint32_t LevelCount() const { return uint32_t(levels_.size()); }
+
+private:
+	static constexpr uint32_t kGroupSize = 8;
+
+	struct Level {
+		vk::ImageView view;
+		vk::Extent2D extent;
+		vk::DescriptorSet set;
+	};
+
+	void CreateImage(vk::ImageView depth_view, vk::Extent2D depth_extent);
+	void DestroyImage();
+
+	vk::Device device_;
+	MemoryAllocator& allocator_;
+	BindlessHeap& bindless_;
+
+	vk::Sampler sampler_;
+	uint32_t sampler_index_ = 0;
+	vk::DescriptorSetLayout set_layout_;
+	vk::PipelineLayout pipeline_layout_;
+	vk::Pipeline pipeline_;
+
+	vk::Extent2D size_;
+	vk::Image image_;
+	Allocation memory_;
+	// Every level, as sampled through the bindless heap.
+	vk::ImageView view_;
+	uint32_t texture_ = 0;
+	std::vector<Level> levels_;
+	// One set per level: the level below (or the depth buffer) and the level to write.
+	vk::DescriptorPool descriptor_pool_;
+};
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "job_system.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Refers to an entity of a Registry. Like NodeHandle, a stale handle is detected by its
+// generation after the entity is destroyed and its slot reused.
+struct Entity {
+	static constexpr uint32_t kInvalidIndex = ~0u;
+
+	uint32_t index      = kInvalidIndex;
+	uint32_t generation = 0;
+
+	explicit operator bool() const { return index != kInvalidIndex; }
+	bool operator==(const Entity& other) const {
+		return index == other.index && generation == other.generation;
+	}
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+// One bit per component type.
+using ComponentMask = uint64_t;
+constexpr uint32_t kMaxComponentTypes = 64;
+
+struct ComponentInfo {
+	uint32_t size;
+	uint32_t alignment;
+};
+
+// Assigns the next process-wide component type id. Throws past kMaxComponentTypes.
+uint32_t RegisterComponent(uint32_t size, uint32_t alignment);
+ComponentInfo GetComponentInfo(uint32_t id);
+
+// Components are plain data: chunks move them with memcpy and never run constructors or
+// destructors.
+template <typename T>
+uint32_t ComponentId() {
+	if constexpr (!std::is_same_v<T, std::remove_cv_t<T>>) {
+		// const T shares T's id.
+		return ComponentId<std::remove_cv_t<T>>();
+	} else {
+		static_assert(std::is_trivially_copyable_v<T>, "Components must be trivially copyable");
+		static_assert(alignof(T) <= 64, "Components can be aligned to at most 64 bytes");
+		static const uint32_t id = RegisterComponent(sizeof(T), alignof(T));
+		return id;
+	}
+}
+
+template <typename... Ts>
+ComponentMask MaskOf() {
+	return (ComponentMask(0) | ... | (ComponentMask(1) << ComponentId<Ts>()));
+}
+
+// All entities with exactly one set of component types. Storage is a list of fixed-size chunks;
+// within a chunk every component type is its own contiguous array, so iterating a few component
+// types streams through memory without touching the others. Every chunk but the last is full.
+class Archetype {
+public:
+	static constexpr size_t kChunkBytes = 16 * 1024;
+
+	explicit Archetype(ComponentMask mask);
+
+	ComponentMask Mask() const { return mask_; }
+	uint32_t ChunkCapacity() const { return capacity_; }
+	size_t ChunkCount() const { return chunks_.size(); }
+	uint32_t ChunkSize(size_t chunk) const { return chunks_[chunk].count; }
+	size_t EntityCount() const { return count_; }
+
+	Entity* Entities(size_t chunk) { return reinterpret_cast<Entity*>(chunks_[chunk].data->bytes); }
+	void* Column(size_t chunk, uint32_t component) {
+		return chunks_[chunk].data->bytes + offsets_[component];
+	}
+	template <typename T>
+	T* Column(size_t chunk) {
+		return static_cast<T*>(Column(chunk, ComponentId<T>()));
+	}
+
+	// Appends an entity with uninitialized components at chunk, row.
+	void Append(Entity entity, uint32_t& chunk, uint32_t& row);
+	// Fills the hole at chunk, row with the archetype's last entity and returns that entity, or
+	// an invalid one if the removed entity was the last.
+	Entity Remove(uint32_t chunk, uint32_t row);
+
+private:
+	struct alignas(64) ChunkData {
+		std::byte bytes[kChunkBytes];
+	};
+	struct Chunk {
+		std::unique_ptr<ChunkData> data;
+		uint32_t count = 0;
+	};
+
+	ComponentMask mask_;
+	std::vector<uint32_t> components_;
+	// Byte offset of each component's array within a chunk; entities come first, at 0.
+	std::array<uint32_t, kMaxComponentTypes> offsets_{};
+	uint32_t capacity_ = 0;
+	std::vector<Chunk> chunks_;
+	size_t count_ = 0;
+};
+
+// Entities and their components, grouped into archetypes.
+//
+// Structural changes (creating and destroying entities, adding and removing components) move
+// data between archetypes and must not overlap iteration or each other. Component values may be
+// read and written from any thread as long as no two threads write the same one.
+//
+// Mutable access through Get() or a query bumps the change version of the component type, so
+// consumers such as Engine can skip work while nothing they read has changed. Query types
+// written as const do not count as changes.
+class Registry {
+public:
+	Registry() = default;
+	Registry(const Registry&) = delete;
+	Registry& operator=(const Registry&) = delete;
+
+	template <typename... Ts>
+	Entity Create(const Ts&... components);
+	void Destroy(Entity entity);
+	bool Alive(Entity entity) const;
+
+	template <typename T>
+	bool Has(Entity entity) const;
+	template <typename T>
+	T& Get(Entity entity);
+	template <typename T>
+	const T& Get(Entity entity) const;
+	// Sets the component, moving the entity to a new archetype if it didn't have it.
+	template <typename T>
+	void Add(Entity entity, const T& component);
+	template <typename T>
+	void Remove(Entity entity);
+
+	// Calls fn(entity, Ts&...) for every entity that has all of Ts, chunk by chunk.
+	template <typename... Ts, typename Fn>
+	void ForEach(Fn&& fn);
+	// Calls fn(count, entities, Ts*...) once per chunk, for loops that want the raw arrays.
+	template <typename... Ts, typename Fn>
+	void ForEachChunk(Fn&& fn);
+	// ForEachChunk with the chunks spread over a job system; runs inline without one.
+	template <typename... Ts, typename Fn>
+	void ParallelForEachChunk(JobSystem* jobs, Fn&& fn);
+
+	size_t Size() const { return records_.size() - free_.size(); }
+	size_t ArchetypeCount() const { return archetypes_.size(); }
+	// Bumped by every structural change.
+	uint64_t StructureVersion() const { return structure_version_; }
+	template <typename T>
+	uint64_t ChangeVersion() const {
+		return change_versions_[ComponentId<T>()].load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Record {
+		Archetype* archetype = nullptr;
+		uint32_t chunk       = 0;
+		uint32_t row         = 0;
+		uint32_t generation  = 0;
+	};
+	struct ChunkRef {
+		Archetype* archetype;
+		uint32_t chunk;
+	};
+
+	const Record& Find(Entity entity) const;
+	Archetype& GetArchetype(ComponentMask mask);
+	// Creates the entity's slot in archetype; components are left for the caller to write.
+	Entity Allocate(Archetype& archetype);
+	// Moves entity to archetype, copying the components both have.
+	void Move(Entity entity, Archetype& archetype);
+	// Drops the entity's row and fixes up the record of the entity moved into its place.
+	void RemoveRow(const Record& record);
+	std::vector<ChunkRef> MatchingChunks(ComponentMask mask) const;
+
+	// Bumps the change version of every type in Ts not qualified const.
+	template <typename... Ts>
+	void MarkChanged() {
+		auto mark = [this](uint32_t id, bool is_const) {
+			if (!is_const) change_versions_[id].fetch_add(1, std::memory_order_relaxed);
+		};
+		(mark(ComponentId<Ts>(), std::is_const_v<Ts>), ...);
+	}
+
+	std::vector<Record> records_;
+	std::vector<uint32_t> free_;
+	std::vector<std::unique_ptr<Archetype>> archetypes_;
+	std::unordered_map<ComponentMask, Archetype*> archetype_by_mask_;
+	uint64_t structure_version_ = 0;
+	std::array<std::atomic<uint64_t>, kMaxComponentTypes> change_versions_{};
+};
+
+// Systems run in the order added, except that consecutive systems whose component access doesn't
+// conflict (neither writes what the other reads or writes) share a phase and run concurrently as
+// jobs. Every system is handed the job system for chunk-parallel queries of its own. Systems must
+// not change the registry's structure.
+class SystemSchedule {
+public:
+	using System = std::function<void(Registry& registry, JobSystem* jobs)>;
+
+	void Add(const char* name, ComponentMask reads, ComponentMask writes, System system);
+	void Run(Registry& registry, JobSystem& jobs);
+
+	uint32_t PhaseCount() const { return uint32_t(phases_.size()); }
+
+private:
+	struct Entry {
+		const char* name;
+		ComponentMask reads;
+		ComponentMask writes;
+		System system;
+	};
+
+	std::vector<Entry> systems_;
+	// Indices into systems_.
+	std::vector<std::vector<uint32_t>> phases_;
+};
+
+template <typename... Ts>
+Entity Registry::Create(const Ts&... components) {
+	Archetype& archetype = GetArchetype(MaskOf<Ts...>());
+	Entity entity        = Allocate(archetype);
+	const Record& record = records_[entity.index];
+	(std::memcpy(archetype.Column<Ts>(record.chunk) + record.row, &components, sizeof(Ts)), ...);
+	MarkChanged<Ts...>();
+	return entity;
+}
+
+template <typename T>
+bool Registry::Has(Entity entity) const {
+	return (Find(entity).archetype->Mask() & MaskOf<T>()) != 0;
+}
+
+template <typename T>
+T& Registry::Get(Entity entity) {
+	const Record& record = Find(entity);
+	if (!(record.archetype->Mask() & MaskOf<T>())) {
+		throw std::runtime_error("Entity has no such component");
+	}
+	MarkChanged<T>();
+	return record.archetype->Column<T>(record.chunk)[record.row];
+}
+
+template <typename T>
+const T& Registry::Get(Entity entity) const {
+	const Record& record = Find(entity);
+	if (!(record.archetype->Mask() & MaskOf<T>())) {
+		throw std::runtime_error("Entity has no such component");
+	}
+	return record.archetype->Column<T>(record.chunk)[record.row];
+}
+
+template <typename T>
+void Registry::Add(Entity entity, const T& component) {
+	ComponentMask mask = Find(entity).archetype->Mask();
+	if (!(mask & MaskOf<T>())) Move(entity, GetArchetype(mask | MaskOf<T>()));
+	Get<T>(entity) = component;
+}
+
+template <typename T>
+void Registry::Remove(Entity entity) {
+	ComponentMask mask = Find(entity).archetype->Mask();
+	if (mask & MaskOf<T>()) Move(entity, GetArchetype(mask & ~MaskOf<T>()));
+}
+
+template <typename... Ts, typename Fn>
+void Registry::ForEach(Fn&& fn) {
+	ForEachChunk<Ts...>([&](uint32_t count, const Entity* entities, Ts*... columns) {
+		for (uint32_t i = 0; i < count; ++i) fn(entities[i], columns[i]...);
+	});
+}
+
+template <typename... Ts, typename Fn>
+void Registry::ForEachChunk(Fn&& fn) {
+	MarkChanged<Ts...>();
+	for (const ChunkRef& ref : MatchingChunks(MaskOf<Ts...>())) {
+		fn(ref.archetype->ChunkSize(ref.chunk), ref.archetype->Entities(ref.chunk),
+		   ref.archetype->Column<Ts>(ref.chunk)...);
+	}
+}
+
+template <typename... Ts, typename Fn>
+void Registry::ParallelForEachChunk(JobSystem* jobs, Fn&& fn) {
+	if (!jobs || jobs->Size() == 1) {
+		ForEachChunk<Ts...>(fn);
+		return;
+	}
+	MarkChanged<Ts...>();
+	std::vector<ChunkRef> chunks = MatchingChunks(MaskOf<Ts...>());
+	jobs->ParallelFor(uint32_t(chunks.size()), [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			const ChunkRef& ref = chunks[i];
+			fn(ref.archetype->ChunkSize(ref.chunk), ref.archetype->Entities(ref.chunk),
+			   ref.archetype->Column<Ts>(ref.chunk)...);
+		}
+	});
+}
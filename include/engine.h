@@ -1,5 +1,363 @@
+#pragma once
+
+#include "asset_loader.h"
+#include "bindless.h"
+#include "depth_pyramid.h"
+#include "ecs.h"
+#include "frame_stats.h"
+#include "frustum_culler.h"
+#include "gpu_scene.h"
 #include "graphics_headers.h"
+#include "memory_allocator.h"
+#include "model.h"
+#include "pipeline_cache.h"
+#include "renderable.h"
+#include "scene_graph.h"
+#include "shader.h"
+#include "texture_streamer.h"
+#include "uploader.h"
+#include "virtual_texturing.h"
+#include "job_system.h"
+
+enum class DrawPath {
+	// One vkCmdDrawIndexed per instance, recorded by the CPU every frame.
+	eDirect,
+	// Instances live in GPU buffers (GpuScene) and are drawn with one indirect call per model.
+	eIndirect,
+};
+
+struct EngineConfig {
+	std::string application_name = "vulkanExamples";
+	uint32_t width                = 800;
+	uint32_t height               = 600;
+	// Render into offscreen images instead of a GLFW window and swapchain. No display server is
+	// touched, so this works on machines whose only Vulkan driver is a software ICD.
+	bool headless = false;
+	// Frames to render before Run() returns. 0 renders until the window is closed; headless runs
+	// always render at least one frame.
+	uint32_t frame_count = 0;
+	// When set, the last headless frame is copied back to the host and written here as a PPM.
+	std::string readback_path;
+	// Record per-frame CPU and GPU timings into Engine::Stats().
+	bool collect_timings = false;
+	// Reuse compiled pipelines across runs. An empty path uses PipelineCache::DefaultDirectory().
+	bool use_pipeline_cache = true;
+	std::string pipeline_cache_path;
+	// Frames the CPU may record ahead of the GPU, clamped to [1, kMaxFramesInFlight]. 1 waits for
+	// every frame to finish before recording the next.
+	uint32_t frames_in_flight = 2;
+	// Threads in the job system, including the render thread, shared by command recording,
+	// culling, transform updates and asset loading. 0 uses every hardware thread; 1 does
+	// everything inline, recording into the primary command buffer.
+	uint32_t worker_threads = 0;
+	// Falls back to eDirect on devices without multiDrawIndirect or drawIndirectFirstInstance.
+	DrawPath draw_path = DrawPath::eIndirect;
+	// Frustum culling runs in the compute pass that builds indirect draws, or on the CPU for
+	// direct draws. Occlusion tests against a depth pyramid of the previous frame and needs the
+	// draws built on the GPU.
+	bool frustum_culling   = true;
+	bool occlusion_culling = true;
+	// Models of at least GpuScene::kMinClusterTriangles triangles with meshlets are culled a
+	// meshlet at a time, also rejecting meshlets that face away. Needs the draws built on the GPU.
+	bool cluster_culling = true;
+	// Instances of models with LODs draw the coarsest one whose simplification error projects to
+	// at most this many pixels, picked per instance on the CPU for direct draws and in the culling
+	// pass for draws built on the GPU. 0 always draws full detail.
+	float lod_threshold_pixels = 1.0f;
+	// Page slots in the physical cache of virtual textures, 136x136 RGBA8 texels each. This is
+	// all the device memory their texels take, however large they are.
+	uint32_t virtual_texture_cache_pages = 256;
+};
+
+constexpr uint32_t kMaxFramesInFlight = 3;
 
 class Engine {
-	int x;
-};
\ No newline at end of file
+public:
+	explicit Engine(const EngineConfig& config);
+	~Engine();
+
+	Engine(const Engine&) = delete;
+	Engine& operator=(const Engine&) = delete;
+
+	// Renders frames until the configured frame count is reached or the window is closed.
+	void Run();
+	// Records and submits a single frame.
+	void RenderFrame();
+	// Blocks until the GPU is idle and folds outstanding GPU timings into Stats().
+	void WaitIdle();
+	// Uploads a mesh to device-local memory. The engine owns the returned model.
+	Model* AddModel(const MeshData& mesh);
+	// Uploads an RGBA8 texture and returns its index in the bindless heap.
+	uint32_t AddTexture(uint32_t width, uint32_t height, const void* pixels);
+	// Loads a KTX, DDS or KMG texture as a background job and returns its index in the bindless
+	// heap right away. It samples as white until its smallest mip levels arrive, then sharpens
+	// over the following frames as finer ones stream in (TextureStreamer).
+	uint32_t LoadTexture(const std::string& path);
+	// Maps a virtual texture cooked by vtcook and returns its texture index. Only the pages drawn
+	// are read, as background jobs, into a cache of EngineConfig::virtual_texture_cache_pages
+	// pages; missing pages sample a coarser level until they arrive (VirtualTexturing). Throws
+	// if the device can't store from fragment shaders, see VirtualTexturesSupported().
+	uint32_t LoadVirtualTexture(const std::string& path);
+	// Creates an entity that draws model with the given model-to-world transform and texture
+	// every frame, until it is destroyed or loses one of its renderable components.
+	Entity AddInstance(const Model* model, const glm::mat4& transform,
+	                   uint32_t texture = kWhiteTexture);
+	// Maps a file cooked by meshcook and uploads its meshes straight from the mapping, drawn with
+	// transform. Nothing is parsed, so this is quick enough to call synchronously.
+	std::vector<Entity> LoadCookedModel(const std::string& path, const glm::mat4& transform);
+	// Parses a glTF 2.0 scene (.gltf or .glb) and uploads its primitives straight from the file's
+	// buffers (GltfFile). Its nodes become scene graph nodes below parent, or roots without one,
+	// and each primitive an entity placed at its node.
+	std::vector<Entity> LoadGltf(const std::string& path, NodeHandle parent = {});
+	// Imports a mesh file as a background job. Once parsed, its meshes are uploaded over the
+	// following frames within a per-frame byte budget and drawn with transform.
+	uint64_t LoadModelAsync(const std::string& path, const glm::mat4& transform);
+	// Files still being parsed or uploaded.
+	size_t PendingAssets() const;
+	void SetViewProjection(const glm::mat4& view_projection) { view_projection_ = view_projection; }
+
+	// Copies the most recently rendered headless target to the host and writes it as a PPM.
+	void SaveFrame(const std::string& path);
+
+	const EngineConfig& Config() const { return config_; }
+	uint64_t FramesRendered() const { return frame_number_; }
+	FrameStats& Stats() { return stats_; }
+	const FrameStats& Stats() const { return stats_; }
+	std::string DeviceName() const;
+	// Wall time spent creating pipelines at startup, and whether a warm cache was available.
+	double PipelineCreateMs() const { return pipeline_create_ms_; }
+	bool PipelineCacheWarm() const { return pipeline_cache_ && pipeline_cache_->LoadedFromDisk(); }
+	// Threads in the job system, including the render thread.
+	uint32_t WorkerThreads() const { return jobs_->Size(); }
+	JobSystem& Jobs() { return *jobs_; }
+	bool VirtualTexturesSupported() const { return virtual_textures_supported_; }
+	// Null until the first virtual texture is loaded.
+	const VirtualTexturing* VirtualTextures() const { return virtual_texturing_.get(); }
+	// Whether indirect draw commands are written by a compute pass rather than the CPU.
+	bool GpuBuiltDraws() const { return gpu_scene_ && gpu_scene_->GpuCommands(); }
+	vk::Device Device() const { return device_; }
+	vk::PhysicalDevice PhysicalDevice() const { return physical_device_; }
+	MemoryAllocator& Allocator() { return *allocator_; }
+	Uploader& Uploads() { return *uploader_; }
+	BindlessHeap& Bindless() { return *bindless_; }
+	// Entities drawn every frame are the ones with all components in renderable.h.
+	Registry& Entities() { return registry_; }
+	// Hierarchy for entities with a SceneNodeComponent, updated at the start of every frame.
+	SceneGraph& Scene() { return scene_; }
+
+	// A 1x1 white texture, so untextured instances render with their shading alone.
+	static constexpr uint32_t kWhiteTexture = 0;
+
+private:
+	// A color target the render pass draws into: either a swapchain image or an offscreen image
+	// owned by the engine (in which case memory is set).
+	struct RenderTarget {
+		vk::Image image;
+		Allocation memory;
+		vk::ImageView view;
+		vk::Framebuffer framebuffer;
+	};
+
+	// Push constants of the mesh pipelines; shaders/draw_constants.glsl declares the same block.
+	struct DrawConstants {
+		glm::mat4 mvp;
+		uint32_t texture;
+		uint32_t sampler;
+		// Bindless index of the GpuScene object buffer; indirect draws only.
+		uint32_t objects;
+		// Bindless index of the frame's VirtualTexturing page table.
+		uint32_t virtual_textures;
+		// Bindless index of the frame's TextureStreamer residency buffer.
+		uint32_t texture_residency;
+	};
+
+	struct Texture {
+		vk::Image image;
+		Allocation memory;
+		vk::ImageView view;
+		uint32_t index;
+	};
+
+	// Secondary command buffers recorded by one worker of the record pool. The pool is only ever
+	// used by that worker, so recording needs no locking.
+	struct WorkerCommands {
+		vk::CommandPool pool;
+		std::vector<vk::CommandBuffer> buffers;
+		// Buffers handed out since the pool was last reset.
+		uint32_t used = 0;
+	};
+
+	// Everything a frame touches while it is being recorded or executed. Slots are used
+	// round-robin and only reused once their fence has signaled.
+	struct FrameData {
+		vk::CommandPool command_pool;
+		vk::CommandBuffer command_buffer;
+		// One entry per job system worker; empty when recording is single threaded.
+		std::vector<WorkerCommands> worker_commands;
+		vk::Fence in_flight;
+		vk::Semaphore image_available;
+		vk::Semaphore render_finished;
+		vk::QueryPool timestamps;
+		// Index into stats_ of the frame whose timestamps are still to be read back.
+		std::optional<size_t> pending_timing;
+	};
+
+	// Below this many draws, the cost of secondary command buffers outweighs parallel recording.
+	static constexpr size_t kMinParallelDraws = 256;
+	// Upload budget for asynchronously loaded meshes, so a large scene streams in over several
+	// frames instead of stalling one.
+	static constexpr vk::DeviceSize kAssetUploadBudget = 32ull << 20;
+	// The same for mip levels of loaded textures.
+	static constexpr vk::DeviceSize kTextureUploadBudget = 16ull << 20;
+
+	void InitWindow();
+	void CreateInstance();
+	void PickPhysicalDevice();
+	void CreateDevice();
+	void CreateSwapchain();
+	void CreateOffscreenTargets();
+	void CreateDepthTarget();
+	void CreateRenderPass();
+	void CreatePipeline();
+	void CreateFramebuffers();
+	void CreateCommandResources();
+	void CreateFrameResources();
+	// The default sampler and white texture every draw can fall back to.
+	void CreateDefaultTextures();
+
+	void DestroyTargets();
+	void DestroyDepthTarget();
+	void RecreateSwapchain();
+
+	// Uploads meshes finished by the asset loader, up to kAssetUploadBudget bytes.
+	void ProcessLoadedAssets();
+	// The texture of a material from the mesh file at model_path: texture resolved against the
+	// file's directory and loaded if TextureStreamer or VirtualTexturing reads it, kWhiteTexture
+	// otherwise.
+	uint32_t MaterialTexture(const std::string& model_path, const std::string& texture);
+	// Updates scene_ and copies the world matrices of moved nodes into their entities'
+	// TransformComponents.
+	void UpdateTransforms();
+	// Rebuilds instances_ from the renderable components if any of them changed.
+	void CollectRenderables();
+	void RecordCommandBuffer(FrameData& frame, const RenderTarget& target);
+	// Records the draws of the instances at visible_[begin, end) inside the render pass.
+	void RecordDraws(vk::CommandBuffer cmd, size_t begin, size_t end) const;
+	// Fills visible_ with the instances to draw directly this frame and visible_lods_ with the LOD
+	// to draw each with, and returns how long it took in milliseconds.
+	double CullInstances();
+	// Records every instance through the GpuScene of the given frame slot.
+	void RecordIndirectDraws(vk::CommandBuffer cmd, uint32_t slot) const;
+	// Reads back the GPU timestamps and cull counters of the frame last submitted from this
+	// slot. Its fence must have signaled.
+	void ResolveGpuTiming(FrameData& frame);
+	// Labels an object for validation messages and graphics debuggers. Compiled out without
+	// DEV_MODE.
+#ifdef DEV_MODE
+	void NameObject(vk::ObjectType type, uint64_t handle, const char* name);
+#else
+	void NameObject(vk::ObjectType, uint64_t, const char*) {}
+#endif
+	vk::CommandBuffer BeginOneTimeCommands();
+	void EndOneTimeCommands(vk::CommandBuffer cmd);
+
+	bool IsDeviceSuitable(vk::PhysicalDevice device) const;
+	std::optional<uint32_t> FindGraphicsQueueFamily(vk::PhysicalDevice device) const;
+	// A transfer-only queue family (DMA engine) if the device has one.
+	std::optional<uint32_t> FindTransferQueueFamily(vk::PhysicalDevice device) const;
+
+	EngineConfig config_;
+
+	GLFWwindow* window_ = nullptr;
+	bool framebuffer_resized_ = false;
+
+	vk::Instance instance_;
+#ifdef DEV_MODE
+	vk::DebugUtilsMessengerEXT debug_messenger_;
+	bool validation_enabled_ = false;
+#endif
+	vk::SurfaceKHR surface_;
+	vk::PhysicalDevice physical_device_;
+	vk::Device device_;
+	uint32_t graphics_family_ = 0;
+	vk::Queue graphics_queue_;
+	QueueRef transfer_queue_;
+	bool draw_indirect_count_ = false;
+	std::unique_ptr<MemoryAllocator> allocator_;
+	std::unique_ptr<Uploader> uploader_;
+	std::unique_ptr<BindlessHeap> bindless_;
+
+	vk::SwapchainKHR swapchain_;
+	vk::Format color_format_ = vk::Format::eR8G8B8A8Unorm;
+	vk::Extent2D extent_;
+	std::vector<RenderTarget> targets_;
+	// Fence of the frame currently rendering into each swapchain image.
+	std::vector<vk::Fence> images_in_flight_;
+	uint32_t last_target_ = 0;
+
+	vk::Format depth_format_ = vk::Format::eD32Sfloat;
+	vk::Image depth_image_;
+	Allocation depth_memory_;
+	vk::ImageView depth_view_;
+
+	std::unique_ptr<PipelineCache> pipeline_cache_;
+	double pipeline_create_ms_ = 0.0;
+
+	vk::RenderPass render_pass_;
+	vk::PipelineLayout pipeline_layout_;
+	vk::Pipeline pipeline_;
+	// Same state as pipeline_ with shaders/indirect.vert; only created for DrawPath::eIndirect.
+	vk::Pipeline indirect_pipeline_;
+
+	vk::CommandPool command_pool_;
+	std::vector<FrameData> frames_;
+	std::unique_ptr<JobSystem> jobs_;
+
+	double timestamp_period_ns_ = 0.0;
+	uint64_t timestamp_mask_    = 0;
+
+	std::vector<std::unique_ptr<Model>> models_;
+	Registry registry_;
+	SceneGraph scene_;
+	// Snapshot of the renderable components as of registry version instances_version_, with the
+	// transforms as of transforms_version_.
+	std::vector<DrawInstance> instances_;
+	uint64_t instances_version_  = ~0ull;
+	uint64_t transforms_version_ = ~0ull;
+	// Set when instances_ changed since gpu_scene_ or culler_ last saw it, or when only its
+	// transforms did, which keeps every instance's LOD state.
+	bool instances_changed_  = false;
+	bool transforms_changed_ = false;
+	std::unique_ptr<GpuScene> gpu_scene_;
+	// Direct draws: world bounds of instances_, rebuilt when they change, and the indices of the
+	// instances recorded this frame.
+	FrustumCuller culler_;
+	std::vector<uint32_t> visible_;
+	// The LOD each of instances_ was last drawn with, and each of visible_ is drawn with now.
+	std::vector<uint32_t> instance_lods_;
+	std::vector<uint32_t> visible_lods_;
+	// Full detail triangles visible_lods_ leaves out.
+	uint64_t lod_triangles_saved_ = 0;
+	// Built after every frame for occlusion culling in the next one.
+	std::unique_ptr<DepthPyramid> depth_pyramid_;
+	bool pyramid_valid_ = false;
+	glm::mat4 pyramid_view_projection_ = glm::mat4(1.0f);
+	std::vector<Texture> textures_;
+	vk::Sampler default_sampler_;
+	uint32_t default_sampler_index_ = 0;
+
+	std::unique_ptr<TextureStreamer> texture_streamer_;
+	// Residency buffer of the frame being recorded, pushed with every draw.
+	uint32_t texture_residency_ = TextureStreamer::kNoResidency;
+	bool virtual_textures_supported_ = false;
+	std::unique_ptr<VirtualTexturing> virtual_texturing_;
+	// Page table of the frame being recorded, pushed with every draw.
+	uint32_t virtual_texture_table_ = 0;
+	std::unique_ptr<AssetLoader> asset_loader_;
+	std::unordered_map<uint64_t, glm::mat4> asset_transforms_;
+	std::deque<LoadedAsset> loaded_assets_;
+	glm::mat4 view_projection_ = glm::mat4(1.0f);
+
+	FrameStats stats_;
+	uint64_t frame_number_ = 0;
+};
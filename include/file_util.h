@@ -0,0 +1,15 @@
+#pragma once
+
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+
+// Whether path ends in a dot and one of extensions, which are given without the dot and in lower
+// case. Case is ignored, so "Scene.GLB" has the extension "glb".
+bool HasExtension(const std::string& path, std::initializer_list<const char*> extensions);
+
+// Calls write with a binary stream to a temporary file next to path, then renames it over path, so
+// a failed or interrupted write never leaves a truncated file behind. Throws if the file can't be
+// written; whatever write throws is passed on, and either way the temporary file is removed.
+void WriteFileAtomically(const std::string& path, const std::function<void(std::ostream&)>& write);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// CPU and GPU durations of a single frame, in milliseconds, how far the CPU ran ahead and what
+// was culled.
+struct FrameTiming {
+	double cpu_ms     = 0.0;  // Engine::RenderFrame from start to finish
+	double wait_ms    = 0.0;  // blocked on the frame fence and swapchain acquire
+	double update_ms  = 0.0;  // asset, scene and culling updates and uploads before recording
+	double record_ms  = 0.0;  // command buffer recording only
+	double cull_ms    = 0.0;  // CPU culling and LODs, part of update_ms; zero when done on the GPU
+	double submit_ms  = 0.0;  // vkQueueSubmit
+	double present_ms = 0.0;  // vkQueuePresentKHR, zero when headless
+	double gpu_ms     = -1.0;  // timestamp delta; negative when the queue has no timestamps
+	// Earlier frames still executing on the GPU when this one was submitted. Above zero the CPU
+	// is recording while the GPU works instead of waiting for it.
+	double queued_frames = 0.0;
+	// Objects the culling pass let through or rejected, on the GPU or the CPU; negative when
+	// nothing was culled.
+	double objects_drawn            = -1.0;
+	double objects_frustum_culled   = -1.0;
+	double objects_occlusion_culled = -1.0;
+	// Meshlets of the objects culled per cluster; negative when there were none.
+	double clusters_drawn            = -1.0;
+	double clusters_frustum_culled   = -1.0;
+	double clusters_backface_culled  = -1.0;
+	double clusters_occlusion_culled = -1.0;
+	// Triangles of the drawn objects' full detail meshes left out by drawing coarser LODs;
+	// negative with LOD selection off.
+	double lod_triangles_saved = -1.0;
+};
+
+struct TimingSummary {
+	size_t samples = 0;
+	double mean    = 0.0;
+	double min     = 0.0;
+	double max     = 0.0;
+	double p50     = 0.0;
+	double p95     = 0.0;
+	double p99     = 0.0;
+};
+
+// Accumulates per-frame timings and reduces them to summary statistics.
+class FrameStats {
+public:
+	void Add(const FrameTiming& timing) { frames_.push_back(timing); }
+	void Clear() { frames_.clear(); }
+
+	size_t Count() const { return frames_.size(); }
+	FrameTiming& At(size_t index) { return frames_[index]; }
+	const std::vector<FrameTiming>& Frames() const { return frames_; }
+
+	// Summarizes one field over all frames. Negative samples (unavailable data) are skipped.
+	TimingSummary Summarize(double FrameTiming::*field) const;
+
+	// Writes a JSON object with one summary per FrameTiming field.
+	void WriteJson(std::ostream& out, int indent = 0) const;
+
+	static TimingSummary Summarize(std::vector<double> samples);
+	static void WriteJson(std::ostream& out, const TimingSummary& summary);
+
+private:
+	std::vector<FrameTiming> frames_;
+};
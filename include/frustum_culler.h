@@ -0,0 +1,66 @@
+#pragma once
+
+#include "graphics_headers.h"
+#include "job_system.h"
+
+// Frustum culling on the CPU, for draws recorded without the GPU culling pass.
+//
+// Every object is a world-space box (center and half extents) with a bounding sphere around the
+// same center, stored structure-of-arrays so one SIMD register holds a coordinate of 4 (SSE) or
+// 8 (AVX2) objects. An object is culled when either volume lies entirely behind one plane, which
+// keeps the sphere's cheap rejection of rotated objects and the box's tighter fit of flat ones.
+//
+// The instruction set is picked at runtime from what the CPU supports, so the AVX2 path is
+// compiled in regardless of -march.
+class FrustumCuller {
+public:
+	enum class Isa { eScalar, eSse, eAvx2 };
+
+	// Normalized planes bounding the clip volume of view_projection (Vulkan clip space, depth in
+	// [0, 1]): left, right, top, bottom, near, far. Points inside have dot(xyz, p) + w >= 0.
+	static void ExtractPlanes(const glm::mat4& view_projection, glm::vec4 planes[6]);
+
+	// World-space eye of a perspective view_projection; orthographic projections have none.
+	static std::optional<glm::vec3> ExtractEye(const glm::mat4& view_projection);
+
+	// The widest instruction set both compiled in and supported by this CPU.
+	static Isa BestIsa();
+	static const char* IsaName(Isa isa);
+
+	explicit FrustumCuller(Isa isa = BestIsa()) : isa_(isa) {}
+
+	Isa GetIsa() const { return isa_; }
+	// Falls back to the widest supported instruction set at or below isa.
+	void SetIsa(Isa isa);
+
+	void Clear();
+	void Reserve(size_t count);
+	// Appends an object and returns its index.
+	uint32_t Add(const glm::vec3& center, const glm::vec3& extents, float radius);
+	// Appends an object given its model-space bounds: a sphere (center in xyz, radius in w) with
+	// a box of the given half extents around the same center.
+	uint32_t Add(const glm::vec4& sphere, const glm::vec3& extents, const glm::mat4& transform);
+	void Set(uint32_t index, const glm::vec3& center, const glm::vec3& extents, float radius);
+	size_t Size() const { return center_x_.size(); }
+
+	// Replaces visible with the ascending indices of the objects inside the frustum of
+	// view_projection. With a job system, ranges of objects are culled as parallel jobs; only one
+	// thread may use the culler at a time.
+	void Cull(const glm::mat4& view_projection, std::vector<uint32_t>& visible,
+	          JobSystem* jobs = nullptr) const;
+
+private:
+	// Objects per job range; small enough to balance, large enough to amortize the hand-off.
+	static constexpr uint32_t kChunkSize = 8192;
+
+	// Writes the visible indices of [begin, end) to out and returns how many there were.
+	uint32_t CullRange(const float planes[6][4], uint32_t begin, uint32_t end,
+	                   uint32_t* out) const;
+
+	Isa isa_;
+	std::vector<float> center_x_, center_y_, center_z_;
+	std::vector<float> extent_x_, extent_y_, extent_z_;
+	std::vector<float> radius_;
+	// Visible count of each chunk of the last threaded Cull().
+	mutable std::vector<uint32_t> chunk_counts_;
+};
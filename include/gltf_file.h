@@ -0,0 +1,65 @@
+#pragma once
+
+#include "model.h"
+#include "scene_graph.h"
+
+#include <memory>
+
+namespace tinygltf {
+class Model;
+}
+
+// A node of a glTF scene, flattened so parents come before their children.
+struct GltfNode {
+	// Index of the parent in GltfFile::Nodes(), or -1 for a root of the scene.
+	int parent = -1;
+	NodeTransform local;
+	// Indices into GltfFile::Primitives() of the meshes drawn at this node.
+	std::vector<uint32_t> primitives;
+};
+
+// Whether path ends in .gltf or .glb.
+bool IsGltfFile(const std::string& path);
+
+// A glTF 2.0 scene, .gltf or .glb, parsed by tinygltf. Unlike the Assimp path nothing is built on
+// the CPU: each triangle primitive becomes a MeshSource that Model uploads straight from the
+// file's buffers. Primitives whose POSITION, NORMAL and TEXCOORD_0 are floats interleaved in one
+// buffer view in the Vertex layout, with 16- or 32-bit indices, are uploaded as they are;
+// anything else is converted while being written into the staging ring. Bounds come from the
+// POSITION accessor's min and max, so zero-copy primitives are never read on the CPU. Meshes are
+// not optimized and get no LODs or meshlets; cook them with meshcook for that.
+//
+// Missing normals are generated smooth, as Assimp's are, rather than flat as the spec asks.
+// Images other than external files are ignored, as are skins, morph targets, cameras and
+// animations.
+class GltfFile {
+public:
+	// Throws on a missing or malformed file, or one using sparse accessors.
+	explicit GltfFile(const std::string& path);
+	~GltfFile();
+
+	GltfFile(const GltfFile&) = delete;
+	GltfFile& operator=(const GltfFile&) = delete;
+
+	// Pointers and fill functions refer to the file and live as long as it.
+	const std::vector<MeshSource>& Primitives() const { return primitives_; }
+	// Base color texture paths are as the file gave them.
+	const std::vector<MaterialData>& Materials() const { return materials_; }
+	// Every node of the default scene, parents first.
+	const std::vector<GltfNode>& Nodes() const { return nodes_; }
+	// Primitives whose vertices and indices are both uploaded without conversion.
+	uint32_t ZeroCopyPrimitives() const { return zero_copy_; }
+
+private:
+	void LoadPrimitives();
+	void LoadMaterials();
+	void LoadNodes();
+
+	std::unique_ptr<tinygltf::Model> model_;
+	std::vector<MeshSource> primitives_;
+	// Primitives() of each glTF mesh.
+	std::vector<std::vector<uint32_t>> mesh_primitives_;
+	std::vector<MaterialData> materials_;
+	std::vector<GltfNode> nodes_;
+	uint32_t zero_copy_ = 0;
+};
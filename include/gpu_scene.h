@@ -0,0 +1,244 @@
+#pragma once
+
+#include "bindless.h"
+#include "depth_pyramid.h"
+#include "graphics_headers.h"
+#include "memory_allocator.h"
+#include "model.h"
+#include "uploader.h"
+
+// A model placed in the world, textured with an image from the bindless heap.
+struct DrawInstance {
+	const Model* model;
+	glm::mat4 transform;
+	uint32_t texture;
+	// Model-space bounding sphere and box half extents, as in BoundsComponent.
+	glm::vec4 bounds;
+	glm::vec3 extents;
+};
+
+// The draw list in GPU memory, drawn with one indirect call per model.
+//
+// Objects (transform, bounds, texture) are grouped into batches that share a model. Every batch
+// owns a range of VkDrawIndexedIndirectCommands, one per object, whose firstInstance is the
+// object index so the vertex shader can fetch its transform. With VK_KHR_draw_indirect_count a
+// compute pass culls the objects every frame and compacts the survivors' commands to the front
+// of each range; otherwise every object's command is built on the CPU whenever the draw list
+// changes, and nothing is culled.
+//
+// Large models split into meshlets are culled a cluster at a time instead. Their batches reserve
+// a command per object and cluster, and a second compute pass tests each cluster's bounding
+// sphere against the frustum and the depth pyramid and its normal cone against the eye, then
+// draws the survivors' index ranges.
+//
+// Models with several levels of detail have their LOD picked per object by projected error, in
+// whichever pass culls it, from the LOD it was drawn with in the previous frame so that objects
+// don't pop between two LODs. Objects drawn at a coarser LOD skip cluster culling. Commands
+// built on the CPU always draw full detail.
+//
+// Each frame in flight has its own copy of the buffers, brought up to date the next time its
+// slot is used after a change. shaders/scene.glsl declares the matching layouts.
+class GpuScene {
+public:
+	// std430 layouts shared with shaders/scene.glsl.
+	struct Object {
+		glm::mat4 transform;
+		// Bounding sphere in model space.
+		glm::vec4 bounds;
+		uint32_t batch;
+		uint32_t texture;
+		uint32_t padding[2];
+	};
+
+	struct Batch {
+		uint32_t index_count;
+		uint32_t first_index;
+		int32_t vertex_offset;
+		uint32_t first_command;
+		// The model's clusters, if its objects are culled per cluster; cluster_count is 0 if not.
+		uint32_t first_cluster;
+		uint32_t cluster_count;
+		// The model's LODs; lod_count is 1 for models without coarser ones.
+		uint32_t first_lod;
+		uint32_t lod_count;
+	};
+
+	// A meshlet as the cluster pass sees it: bounds and cone as in Meshlet, and the index range
+	// that draws it.
+	struct Cluster {
+		glm::vec4 bounds;
+		glm::vec4 cone;
+		uint32_t first_index;
+		uint32_t index_count;
+		uint32_t padding[2];
+	};
+
+	// Up to kGroupSize clusters of one object, culled by one workgroup of the cluster pass.
+	struct ClusterGroup {
+		uint32_t object;
+		uint32_t first_cluster;
+		uint32_t cluster_count;
+		uint32_t padding;
+	};
+
+	struct CullData {
+		glm::mat4 pyramid_view_projection;
+		glm::vec4 frustum[6];
+		// World-space eye of the frame being drawn, for the normal cone test and LOD selection.
+		glm::vec4 eye;
+		glm::vec2 pyramid_size;
+		uint32_t pyramid_levels;
+		uint32_t pyramid_texture;
+		uint32_t pyramid_sampler;
+		uint32_t flags;
+		// LodScale() of the frame being drawn and the LOD error allowed, in pixels.
+		float lod_scale;
+		float lod_threshold;
+	};
+
+	// What the culling pass tests against in one frame.
+	struct CullParams {
+		// Frustum culling with the planes of the frame being drawn.
+		bool frustum = false;
+		glm::mat4 view_projection;
+		// Occlusion culling against a depth pyramid, rendered with pyramid_view_projection.
+		const DepthPyramid* pyramid = nullptr;
+		glm::mat4 pyramid_view_projection;
+		// Clusters whose triangles all face away from the eye. Only perspective projections have
+		// an eye; with any other view_projection nothing is rejected this way.
+		bool backface = false;
+		// LOD selection, picking the coarsest LOD whose error projects to at most this many pixels
+		// on a viewport_height pixel high render. 0 draws full detail.
+		float lod_threshold      = 0.0f;
+		uint32_t viewport_height = 0;
+	};
+
+	// Objects and clusters counted by the culling passes of one frame. Objects culled per cluster
+	// count as drawn when their bounds pass, even if none of their clusters do.
+	struct CullStats {
+		uint32_t drawn;
+		uint32_t frustum_culled;
+		uint32_t occlusion_culled;
+		uint32_t clusters_drawn;
+		uint32_t clusters_frustum_culled;
+		uint32_t clusters_backface_culled;
+		uint32_t clusters_occlusion_culled;
+		// Full detail triangles of drawn objects left out by drawing coarser LODs. Summed on the
+		// host from per-LOD counts, so not part of the GPU's counters.
+		uint64_t lod_triangles_saved;
+	};
+
+	// Models with fewer triangles than this are culled as a whole.
+	static constexpr uint32_t kMinClusterTriangles = 8192;
+
+	// gpu_commands selects the compute pass and requires VK_KHR_draw_indirect_count. clusters
+	// enables the cluster pass for models with meshlets, which needs gpu_commands. Batches are
+	// split to stay within max_draw_count commands per indirect call.
+	GpuScene(vk::Device device, MemoryAllocator& allocator, Uploader& uploader,
+	         BindlessHeap& bindless, vk::PipelineCache cache, uint32_t frame_count,
+	         bool gpu_commands, bool clusters, uint32_t max_draw_count);
+	~GpuScene();
+
+	GpuScene(const GpuScene&) = delete;
+	GpuScene& operator=(const GpuScene&) = delete;
+
+	// Replaces the draw list. Slots pick up the change in their next Prepare().
+	void SetInstances(const std::vector<DrawInstance>& instances);
+	// Updates the transforms of the draw list, which must otherwise be the one last given to
+	// SetInstances, in the same order. Unlike SetInstances, objects keep their LOD state.
+	void UpdateTransforms(const std::vector<DrawInstance>& instances);
+	// Uploads the draw list to slot if it changed since the slot was last prepared. The frame
+	// that last used the slot must have completed.
+	void Prepare(uint32_t slot);
+
+	// Records the compute pass culling the objects and writing slot's draw commands. Must be
+	// outside a render pass; does nothing when commands are built on the CPU.
+	void RecordBuild(vk::CommandBuffer cmd, uint32_t slot, const CullParams& cull);
+	// Counters of the last build recorded for slot, once its frame has completed.
+	std::optional<CullStats> ReadStats(uint32_t slot);
+	// Records the indirect draws. The bound pipeline reads objects from the storage buffer at
+	// ObjectBuffer(slot) in the bindless heap.
+	void RecordDraws(vk::CommandBuffer cmd, uint32_t slot) const;
+	uint32_t ObjectBuffer(uint32_t slot) const { return slots_[slot].objects.index.value_or(0); }
+
+	bool GpuCommands() const { return gpu_commands_; }
+	uint32_t ObjectCount() const { return uint32_t(objects_.size()); }
+	uint32_t BatchCount() const { return uint32_t(batches_.size()); }
+	// Distinct clusters of the models culled per cluster.
+	uint32_t ClusterCount() const { return uint32_t(clusters_.size()); }
+
+private:
+	static constexpr uint32_t kGroupSize = 64;
+
+	using Buffer = BindlessBuffer;
+
+	struct Slot {
+		uint64_t version = 0;
+		Buffer objects;
+		Buffer batches;
+		Buffer clusters;
+		Buffer cluster_groups;
+		Buffer lods;
+		Buffer commands;
+		Buffer counts;
+		// Host visible: CullData written before every build, CullStats and the objects drawn at
+		// each LOD read back after it.
+		Buffer cull;
+		Buffer stats;
+		Buffer lod_counts;
+		bool stats_pending = false;
+		// Triangles saved by each LOD as of the slot's version, for its counts.
+		std::vector<uint32_t> lod_savings;
+	};
+
+	// A buffer frames in flight may still use, released once every slot has been prepared again.
+	struct Retired {
+		Buffer buffer;
+		uint32_t prepares_left;
+	};
+
+	// Grows buffer to hold at least size bytes. Contents are not preserved.
+	void Reserve(Buffer& buffer, vk::DeviceSize size, vk::BufferUsageFlags usage,
+	             vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal);
+	void Release(Buffer& buffer);
+
+	vk::Device device_;
+	MemoryAllocator& allocator_;
+	Uploader& uploader_;
+	BindlessHeap& bindless_;
+	bool gpu_commands_;
+	bool clusters_enabled_;
+	uint32_t max_draw_count_;
+
+	vk::PipelineLayout build_layout_;
+	vk::Pipeline build_pipeline_;
+	vk::PipelineLayout cluster_layout_;
+	vk::Pipeline cluster_pipeline_;
+
+	std::vector<Object> objects_;
+	// Per instance given to SetInstances, its index in objects_.
+	std::vector<uint32_t> instance_objects_;
+	std::vector<Batch> batches_;
+	std::vector<Cluster> clusters_;
+	std::vector<ClusterGroup> cluster_groups_;
+	// Uploaded as they are; shaders/scene.glsl declares the same layout.
+	std::vector<MeshLod> lods_;
+	// Per LOD, the triangles it leaves out of the full detail mesh.
+	std::vector<uint32_t> lod_savings_;
+	bool has_lods_ = false;
+	// Per batch: the model to bind and the most commands it may draw.
+	std::vector<const Model*> batch_models_;
+	std::vector<uint32_t> batch_sizes_;
+	uint32_t command_count_ = 0;
+	// Only filled when commands are built on the CPU.
+	std::vector<vk::DrawIndexedIndirectCommand> commands_;
+	uint64_t version_ = 1;
+
+	std::vector<Slot> slots_;
+	// The LOD each object was last drawn with, carried from frame to frame and so shared by every
+	// slot. Frames run in submission order, so each build sees the previous one's. Cleared by
+	// SetInstances, but not when only transforms change.
+	Buffer lod_states_;
+	bool reset_lod_states_ = false;
+	std::vector<Retired> retired_;
+};
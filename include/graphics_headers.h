@@ -1,7 +1,20 @@
-#include "vulkan.hpp"
+#pragma once
+
+// Every vk:: call dispatches through vk::defaultDispatchLoaderDynamic, see vulkan_loader.h.
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+// Older Vulkan-Hpp releases return pipelines without their vk::Result; CMake checks this too.
+#if VK_HEADER_VERSION < 140
+#error "Vulkan headers 1.2.140 or newer are required"
+#endif
 
 #include <GLFW/glfw3.h>
 
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
 #include <algorithm>
 #include <array>
 #include <cstdlib>
@@ -13,6 +26,19 @@
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-// #define DEV_MODE
\ No newline at end of file
+// Root that shaders and other runtime assets are resolved against. CMake points this at
+// RESOURCE_INSTALL_DIR when set, or at the source tree for uninstalled runs.
+#ifndef ENGINE_RESOURCE_DIR
+#define ENGINE_RESOURCE_DIR ""
+#endif
+
+// Compiled SPIR-V, produced by the build from shaders/*.
+#ifndef ENGINE_SHADER_DIR
+#define ENGINE_SHADER_DIR ENGINE_RESOURCE_DIR "shaders/"
+#endif
+
+// DEV_MODE is defined by the build (ENGINE_DEV_MODE, Debug configurations by default). It
+// compiles in validation layers, the debug messenger and object naming.
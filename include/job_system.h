@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tracks a group of scheduled jobs. Every job scheduled with a counter raises it by one and
+// lowers it when it finishes; JobSystem::Wait() returns once it is back at zero. A counter may be
+// reused after that.
+class JobCounter {
+public:
+	uint32_t Pending() const { return pending_.load(std::memory_order_acquire); }
+	bool Done() const { return Pending() == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<uint32_t> pending_{0};
+	std::mutex mutex_;
+	// First exception thrown by one of the jobs, rethrown by Wait().
+	std::exception_ptr error_;
+};
+
+// A fixed set of threads running jobs from per-thread work-stealing deques. A thread pushes and
+// pops the jobs it schedules at the back of its own deque, newest first while their data is still
+// in cache; idle threads steal the oldest jobs from the front of someone else's. Threads outside
+// the pool share the deque of worker 0.
+//
+// Waiting on a counter never idles the thread: it keeps running queued jobs until the counter
+// reaches zero, so jobs may schedule and wait on jobs of their own.
+//
+// Background jobs (file I/O, parsing) go to a separate queue that only pool threads take from,
+// after everything else, so a thread waiting on a frame's jobs never picks up a long one. Without
+// pool threads they run inline.
+class JobSystem {
+public:
+	using Job     = std::function<void()>;
+	using RangeFn = std::function<void(uint32_t begin, uint32_t end)>;
+
+	// Threads including the calling one; 0 picks one per hardware thread.
+	explicit JobSystem(uint32_t thread_count = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Pool threads plus one for the threads outside the pool.
+	uint32_t Size() const { return uint32_t(threads_.size()) + 1; }
+	// Index in [0, Size()) of the calling thread: its pool worker, or 0 outside the pool. Lets jobs
+	// keep per-worker state (command pools, scratch buffers); only one thread outside the pool
+	// may run jobs at a time for that to be safe.
+	uint32_t CurrentWorker() const;
+
+	// Queues job. With a counter, an exception it throws is rethrown by Wait(); without one, jobs
+	// must not throw.
+	void Schedule(Job job, JobCounter* counter = nullptr);
+	void ScheduleBackground(Job job, JobCounter* counter = nullptr);
+	// Runs other jobs until counter reaches zero, then rethrows the first exception of its jobs.
+	void Wait(JobCounter& counter);
+
+	// Calls fn on ranges covering [0, count) of at most grain elements, spread over the pool, and
+	// returns once all have run. A grain of 0 picks one that gives every thread a few ranges to
+	// balance with. Ranges are claimed from a shared cursor, so the calling thread works through
+	// them itself if the pool is busy.
+	void ParallelFor(uint32_t count, const RangeFn& fn, uint32_t grain = 0);
+
+	// Jobs run, and of those how many were taken from another thread's deque, since construction.
+	uint64_t JobsRun() const { return jobs_run_.load(std::memory_order_relaxed); }
+	uint64_t JobsStolen() const { return jobs_stolen_.load(std::memory_order_relaxed); }
+
+private:
+	// Ranges per thread when ParallelFor picks the grain.
+	static constexpr uint32_t kRangesPerThread = 4;
+
+	struct Entry {
+		Job job;
+		JobCounter* counter;
+	};
+	// One mutex per deque: owners and thieves rarely meet on the same one, so it is almost never
+	// contended.
+	struct Deque {
+		std::mutex mutex;
+		std::deque<Entry> jobs;
+	};
+
+	void WorkerLoop(uint32_t worker);
+	void Push(std::deque<Entry>& queue, std::mutex& mutex, Entry entry);
+	// Takes a job from worker's own deque, then from the others', and finally, if background is
+	// set, from the background queue.
+	bool Take(uint32_t worker, bool background, Entry& out);
+	void Execute(Entry& entry);
+
+	std::vector<std::thread> threads_;
+	// One per worker; deques_[0] belongs to the threads outside the pool.
+	std::vector<std::unique_ptr<Deque>> deques_;
+	Deque background_;
+
+	// Jobs queued and not yet taken, across every deque; sleeping threads wait for it to rise.
+	std::atomic<uint64_t> queued_{0};
+	std::atomic<uint32_t> sleeping_{0};
+	std::mutex sleep_mutex_;
+	std::condition_variable wake_;
+	bool stopping_ = false;
+
+	std::atomic<uint64_t> jobs_run_{0};
+	std::atomic<uint64_t> jobs_stolen_{0};
+};
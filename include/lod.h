@@ -0,0 +1,31 @@
+#pragma once
+
+#include "graphics_headers.h"
+
+// One level of detail of a mesh: the range of its index buffer that draws it, and how far its
+// surface may stray from the full detail mesh, in model space.
+struct MeshLod {
+	uint32_t first_index;
+	uint32_t index_count;
+	float error;
+};
+
+// A coarser LOD is only switched to once its projected error is this fraction of the threshold,
+// so objects hovering around a switching distance don't pop back and forth every frame.
+constexpr float kLodHysteresis = 0.75f;
+
+// Pixels that a world-space unit at unit distance from the eye spans in a render of a
+// perspective view_projection viewport_height pixels high. 0 for other projections.
+float LodScale(const glm::mat4& view_projection, uint32_t viewport_height);
+
+// Pixels that a model-space unit of an object spans where its bounding sphere comes closest to
+// the eye, given lod_scale from LodScale. Infinite with the eye inside the sphere.
+float LodPixelsPerUnit(const glm::mat4& transform, const glm::vec4& bounds, const glm::vec3& eye,
+                       float lod_scale);
+
+// The coarsest of lods (full detail first, errors growing) whose error projects to at most
+// threshold_pixels, given the LOD drawn last time: a finer LOD is picked as soon as current's
+// error exceeds the threshold, a coarser one only once it is within kLodHysteresis of it.
+// SelectLod in shaders/cull.glsl does the same on the GPU.
+uint32_t SelectLod(const std::vector<MeshLod>& lods, float pixels_per_unit,
+                   float threshold_pixels, uint32_t current);
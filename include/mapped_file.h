@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read-only into memory. Pages are read in by the OS on first touch, so
+// opening is cheap however large the file is.
+class MappedFile {
+public:
+	// Throws if the file can't be opened or mapped.
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const void* Data() const { return data_; }
+	size_t Size() const { return size_; }
+
+private:
+	void* data_  = nullptr;
+	size_t size_ = 0;
+#ifdef _WIN32
+	void* file_    = nullptr;
+	void* mapping_ = nullptr;
+#endif
+};
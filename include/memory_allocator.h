@@ -0,0 +1,127 @@
+#pragma once
+
+#include "graphics_headers.h"
+
+#include <memory>
+#include <mutex>
+#include <set>
+
+// Buffers and linear images are kept apart from optimal-tiling images so that neighbouring
+// sub-allocations never violate bufferImageGranularity.
+enum class ResourceTiling { eLinear, eOptimal };
+
+struct MemoryBlock;
+
+// A sub-range of a device memory block. Bind resources at memory + offset.
+struct Allocation {
+	vk::DeviceMemory memory;
+	vk::DeviceSize offset = 0;
+	vk::DeviceSize size   = 0;
+	// Host pointer to offset when the memory type is host visible, otherwise null.
+	void* mapped = nullptr;
+
+	// Bookkeeping owned by MemoryAllocator.
+	MemoryBlock* block = nullptr;
+	uint32_t order     = 0;
+
+	explicit operator bool() const { return bool(memory); }
+};
+
+struct MemoryStats {
+	vk::DeviceSize reserved  = 0;  // device memory held by blocks and dedicated allocations
+	vk::DeviceSize used      = 0;  // bytes requested by live allocations
+	vk::DeviceSize allocated = 0;  // bytes handed out, including buddy rounding
+	uint32_t block_count      = 0;
+	uint32_t dedicated_count  = 0;
+	uint32_t allocation_count = 0;
+	// 1 - largest free range / total free bytes across all blocks. 0 means every free byte is
+	// usable by a single allocation, values near 1 mean free space is scattered.
+	double fragmentation = 0.0;
+};
+
+// Sub-allocates resources out of large per-memory-type device memory blocks with a buddy
+// allocator, so the number of vkAllocateMemory calls stays far below maxMemoryAllocationCount.
+// Requests larger than half a block get a dedicated allocation. Thread safe.
+class MemoryAllocator {
+public:
+	static constexpr vk::DeviceSize kDefaultBlockSize = 64ull << 20;
+	static constexpr vk::DeviceSize kMinAllocation    = 256;
+
+	MemoryAllocator(vk::PhysicalDevice physical_device, vk::Device device,
+	                vk::DeviceSize block_size = kDefaultBlockSize);
+	~MemoryAllocator();
+
+	MemoryAllocator(const MemoryAllocator&) = delete;
+	MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+	Allocation Allocate(const vk::MemoryRequirements& requirements,
+	                    vk::MemoryPropertyFlags properties, ResourceTiling tiling);
+	void Free(Allocation& allocation);
+
+	// Allocate and bind memory for a resource in one step.
+	Allocation AllocateBuffer(vk::Buffer buffer, vk::MemoryPropertyFlags properties);
+	Allocation AllocateImage(vk::Image image, vk::MemoryPropertyFlags properties,
+	                         ResourceTiling tiling = ResourceTiling::eOptimal);
+
+	MemoryStats Stats() const;
+
+	uint32_t FindMemoryType(uint32_t type_bits, vk::MemoryPropertyFlags properties) const;
+
+private:
+	struct Pool {
+		uint32_t memory_type = 0;
+		ResourceTiling tiling;
+		vk::DeviceSize block_size = 0;
+		std::vector<std::unique_ptr<MemoryBlock>> blocks;
+	};
+
+	Pool& GetPool(uint32_t memory_type, ResourceTiling tiling);
+	MemoryBlock* CreateBlock(Pool& pool);
+	void DestroyBlock(MemoryBlock* block);
+	Allocation AllocateDedicated(const vk::MemoryRequirements& requirements, uint32_t memory_type);
+
+	vk::Device device_;
+	vk::PhysicalDeviceMemoryProperties memory_properties_;
+	vk::DeviceSize block_size_;
+	std::vector<Pool> pools_;
+
+	vk::DeviceSize used_            = 0;
+	vk::DeviceSize allocated_       = 0;
+	vk::DeviceSize dedicated_bytes_ = 0;
+	uint32_t dedicated_count_       = 0;
+	uint32_t allocation_count_      = 0;
+
+	mutable std::mutex mutex_;
+};
+
+// The free ranges of one block of device memory, as a binary buddy tree. Order 0 is
+// MemoryAllocator::kMinAllocation bytes; order n is kMinAllocation << n. Every free range sits in
+// the free list of its order, and ranges are naturally aligned to their own size within the
+// block. Not thread safe; MemoryAllocator locks around it.
+class BuddyBlock {
+public:
+	// Order of the smallest range that holds size bytes.
+	static uint32_t OrderFor(vk::DeviceSize size);
+	static vk::DeviceSize OrderSize(uint32_t order) {
+		return MemoryAllocator::kMinAllocation << order;
+	}
+
+	// A block of OrderSize(max_order) bytes, all free.
+	explicit BuddyBlock(uint32_t max_order);
+
+	uint32_t MaxOrder() const { return uint32_t(free_lists_.size()) - 1; }
+	bool CanAllocate(uint32_t order) const;
+	// Takes the lowest-addressed free range of the smallest order at or above order, splits it
+	// down to order, returning the upper halves to the free lists, and returns its offset. Throws
+	// unless CanAllocate(order).
+	vk::DeviceSize Allocate(uint32_t order);
+	// Returns a range, merging it with its buddy for as long as that is free too.
+	void Free(vk::DeviceSize offset, uint32_t order);
+
+	size_t FreeCount(uint32_t order) const { return free_lists_[order].size(); }
+	vk::DeviceSize FreeBytes() const;
+	vk::DeviceSize LargestFree() const;
+
+private:
+	std::vector<std::set<vk::DeviceSize>> free_lists_;
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "meshlet.h"
+#include "model.h"
+
+// The cooked mesh format written by meshcook. Everything a Model needs is stored in the layout it
+// is uploaded in, so loading is a mapping, a few range checks and copies into the staging ring:
+//
+//   MeshFileHeader
+//   MeshFileMesh[mesh_count]
+//   MeshFileMaterial[material_count]
+//   per mesh, each blob aligned to kMeshFileAlignment:
+//     Vertex[vertex_count]
+//     uint16_t or uint32_t[index_count], every level of detail
+//     MeshLod[lod_count], full detail first
+//     Meshlet[meshlet_count], uint32_t[meshlet_vertex_count], uint8_t[meshlet_triangle_bytes]
+//
+// Offsets are from the start of the file. Files are little-endian and only read by builds whose
+// Vertex, MeshLod and Meshlet layouts match; the version changes whenever any of them does.
+constexpr uint32_t kMeshFileMagic     = 0x4b4f4f43;  // "COOK"
+constexpr uint32_t kMeshFileVersion   = 3;
+constexpr uint32_t kMeshFileAlignment = 64;
+
+struct MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t mesh_count;
+	uint32_t material_count;
+	uint64_t file_size;
+};
+
+struct MeshFileMesh {
+	// Bounding sphere (center, radius) and half extents in model space, as in Model.
+	float bounds[4];
+	float extents[3];
+	// Index into the material table.
+	uint32_t material;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	// 2 or 4.
+	uint32_t index_size;
+	uint32_t meshlet_count;
+	uint32_t meshlet_vertex_count;
+	uint32_t meshlet_triangle_bytes;
+	// At least 1.
+	uint32_t lod_count;
+	uint64_t vertices_offset;
+	uint64_t indices_offset;
+	uint64_t lods_offset;
+	uint64_t meshlets_offset;
+	uint64_t meshlet_vertices_offset;
+	uint64_t meshlet_triangles_offset;
+};
+
+struct MeshFileMaterial {
+	char name[64];
+	float base_color[4];
+	// Path of the base color texture as the source file gave it, or empty.
+	char texture[256];
+};
+
+static_assert(sizeof(Vertex) == 32, "Vertex layout is part of the mesh file format");
+static_assert(sizeof(MeshLod) == 12, "MeshLod layout is part of the mesh file format");
+static_assert(sizeof(Meshlet) == 48, "Meshlet layout is part of the mesh file format");
+
+// One mesh of a MeshFile. Pointers refer to the mapping and live as long as the file.
+struct MeshFileView {
+	const MeshFileMesh* mesh;
+	const Vertex* vertices;
+	// mesh->index_size bytes each.
+	const void* indices;
+	const MeshLod* lods;
+	const Meshlet* meshlets;
+	const uint32_t* meshlet_vertices;
+	const uint8_t* meshlet_triangles;
+};
+
+// Whether path ends in .mesh.
+bool IsMeshFile(const std::string& path);
+
+// A cooked mesh file, mapped. Opening validates the header, that every table and blob lies
+// inside the file, and that every index, LOD and meshlet refers only to data that exists; vertex
+// data itself is never touched until it is used.
+class MeshFile {
+public:
+	// Throws on a missing, truncated, corrupt or foreign file, or one of another version.
+	explicit MeshFile(const std::string& path);
+
+	uint32_t MeshCount() const { return header_->mesh_count; }
+	MeshFileView Mesh(uint32_t index) const;
+	uint32_t MaterialCount() const { return header_->material_count; }
+	const MeshFileMaterial& Material(uint32_t index) const { return materials_[index]; }
+	size_t SizeBytes() const { return file_.Size(); }
+
+private:
+	MappedFile file_;
+	const MeshFileHeader* header_;
+	const MeshFileMesh* meshes_;
+	const MeshFileMaterial* materials_;
+};
+
+// Writes meshes and materials in the cooked format. Meshes refer to materials by index; their LODs
+// and meshlets are written as they are, so build them first.
+void WriteMeshFile(const std::string& path, const std::vector<MeshData>& meshes,
+                   const std::vector<MaterialData>& materials);
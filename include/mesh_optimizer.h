@@ -0,0 +1,55 @@
+#pragma once
+
+#include "model.h"
+
+// Entries of the post-transform vertex cache the optimizer targets and the analysis simulates. A
+// FIFO this size is a conservative model of current GPUs, whose caches are larger or batch
+// vertices per wave.
+constexpr uint32_t kVertexCacheSize = 16;
+
+// How well an index order reuses transformed vertices, from a FIFO cache simulation.
+struct VertexCacheStats {
+	uint64_t triangles   = 0;
+	uint64_t vertices    = 0;
+	uint64_t transformed = 0;
+
+	// Average cache miss ratio: vertices transformed per triangle. 0.5 is the ideal for a large
+	// regular grid, 3 means no reuse at all.
+	double Acmr() const { return triangles ? double(transformed) / triangles : 0.0; }
+	// Average transform to vertex ratio: how often each vertex is transformed. 1 is ideal.
+	double Atvr() const { return vertices ? double(transformed) / vertices : 0.0; }
+
+	void Add(const VertexCacheStats& other) {
+		triangles += other.triangles;
+		vertices += other.vertices;
+		transformed += other.transformed;
+	}
+};
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertex_count,
+                                    uint32_t cache_size = kVertexCacheSize);
+
+// Reorders triangles for post-transform vertex cache reuse (Tipsify: Sander, Nehab and Barczak,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007). Linear in the
+// triangle count.
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count,
+                         uint32_t cache_size = kVertexCacheSize);
+
+// Reorders the clusters of a cache optimized index list so that outward facing ones draw first,
+// which lets depth testing reject more of what is behind them from any view. Clusters are only
+// split where that keeps the ACMR within threshold times the input's.
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+                      float threshold = 1.05f, uint32_t cache_size = kVertexCacheSize);
+
+// Renumbers vertices in the order the indices first use them, so vertex fetches walk memory
+// forwards. Vertices no triangle uses are dropped.
+void OptimizeVertexFetch(MeshData& mesh);
+
+struct MeshOptimizationStats {
+	VertexCacheStats before;
+	VertexCacheStats after;
+};
+
+// Runs the passes above in order on an imported mesh, before its LODs are built. Rendering is
+// unchanged apart from the triangle order within the mesh.
+MeshOptimizationStats OptimizeMesh(MeshData& mesh);
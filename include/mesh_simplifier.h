@@ -0,0 +1,30 @@
+#pragma once
+
+#include "model.h"
+
+// Most levels of detail BuildLods gives a mesh, the full detail one included.
+constexpr uint32_t kMaxLods = 8;
+// Meshes with fewer triangles than this get no coarser LODs.
+constexpr uint32_t kMinLodTriangles = 256;
+
+// Simplifies the triangles of indices by quadric edge collapse (Garland and Heckbert, "Surface
+// Simplification Using Quadric Error Metrics", 1997) and returns the remaining ones, which index
+// the same vertices. Each collapse moves one vertex onto a neighbour, so no vertices are created.
+//
+// A collapse costs the area weighted squared distance of the merged surface to the planes of
+// the triangles it replaces, plus the squared change of normal and uv across that area, scaled
+// down so normals and uvs only steer collapses with similar geometric cost. Collapsing stops once
+// target_index_count is reached or the next collapse would cost more than target_error. Vertices
+// on open borders and uv or normal seams never move, so neither opens cracks.
+//
+// Errors are relative to the largest dimension of the mesh's bounding box. result_error, if set,
+// receives the largest error of any collapse done.
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices,
+                                   const std::vector<uint32_t>& indices, size_t target_index_count,
+                                   float target_error, float* result_error = nullptr);
+
+// Builds a chain of LODs for an optimized mesh without any yet, each simplified from the last to
+// reduction of its triangles and cache optimized. Their indices are appended to mesh.indices and
+// their ranges and model-space errors listed in mesh.lods after the full detail mesh. The chain
+// ends early once a step stops paying off.
+void BuildLods(MeshData& mesh, float reduction = 0.5f, uint32_t max_lods = kMaxLods);
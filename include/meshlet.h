@@ -0,0 +1,45 @@
+#pragma once
+
+#include "graphics_headers.h"
+
+struct MeshData;
+
+// A small cluster of a mesh's triangles, the unit later stages cull and draw. Its triangles index
+// into its own vertex list, which in turn indexes the mesh's vertices.
+//
+// Meshlets cover the mesh's triangles in index order, so a meshlet's triangles are also the
+// 3 * triangle_count indices of the mesh starting at triangle_offset. Cluster culling draws them
+// as that index range.
+struct Meshlet {
+	// First entry of the meshlet's vertices in MeshletData::vertices.
+	uint32_t vertex_offset;
+	// First byte of the meshlet's triangles in MeshletData::triangles, three per triangle.
+	uint32_t triangle_offset;
+	uint32_t vertex_count;
+	uint32_t triangle_count;
+	// Bounding sphere in model space: center in xyz, radius in w.
+	glm::vec4 bounds;
+	// Normal cone in model space: axis in xyz, and in w the sine of the widest angle between the
+	// axis and a triangle normal. Seen from an eye e, every triangle faces away when
+	//   dot(center - e, axis) >= w * length(center - e) + radius.
+	// w is 2 when the normals spread too far for that to ever hold.
+	glm::vec4 cone;
+};
+
+struct MeshletData {
+	std::vector<Meshlet> meshlets;
+	// Mesh vertex indices.
+	std::vector<uint32_t> vertices;
+	// Indices into the owning meshlet's vertices.
+	std::vector<uint8_t> triangles;
+};
+
+// Limits that suit both mesh shaders and compute-based cluster culling on common hardware.
+constexpr uint32_t kMeshletMaxVertices  = 64;
+constexpr uint32_t kMeshletMaxTriangles = 124;
+
+// Splits the mesh's full detail triangles into meshlets, in index order: a meshlet is closed as
+// soon as the next triangle would exceed either limit. Ordering the indices for locality first (as
+// the vertex cache optimization does) keeps meshlets compact.
+MeshletData BuildMeshlets(const MeshData& mesh, uint32_t max_vertices = kMeshletMaxVertices,
+                          uint32_t max_triangles = kMeshletMaxTriangles);
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "graphics_headers.h"
+#include "lod.h"
+#include "memory_allocator.h"
+#include "meshlet.h"
+#include "uploader.h"
+
+// Interleaved vertex layout shared by every mesh and the vertex shader.
+struct Vertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 uv;
+
+	static vk::VertexInputBindingDescription Binding();
+	static std::array<vk::VertexInputAttributeDescription, 3> Attributes();
+};
+
+// CPU-side mesh, as produced by generators and importers.
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	// Index into the materials of the asset the mesh came from.
+	uint32_t material = 0;
+	// As built by BuildMeshlets over the full detail indices; empty for meshes that weren't split.
+	MeshletData meshlets;
+	// Levels of detail as built by BuildLods, full detail first, each a range of indices. Empty
+	// for meshes with only their full detail, which is then every index.
+	std::vector<MeshLod> lods;
+};
+
+// CPU-side material, as produced by importers.
+struct MaterialData {
+	std::string name;
+	glm::vec4 base_color = glm::vec4(1.0f);
+	// Base color texture path as the source file gave it; empty if untextured.
+	std::string texture;
+};
+
+// A mesh whose data lives elsewhere, such as a parsed file's buffers, uploaded without first
+// being collected in a MeshData. Vertices and indices each come either from a pointer to data in
+// the layout uploaded, or from a fill function converting it straight into staging memory.
+struct MeshSource {
+	uint32_t vertex_count  = 0;
+	const Vertex* vertices = nullptr;
+	Uploader::Fill fill_vertices;
+	uint32_t index_count = 0;
+	// 2 or 4.
+	uint32_t index_size = 4;
+	const void* indices = nullptr;
+	Uploader::Fill fill_indices;
+	uint32_t material = 0;
+	// As in Model.
+	glm::vec4 bounds;
+	glm::vec3 extents;
+};
+
+struct MeshFileView;
+
+// A mesh resident in device-local memory: one interleaved vertex buffer and one index buffer
+// holding every level of detail. Indices are stored as 16 bit whenever the vertex count allows it.
+class Model {
+public:
+	Model(vk::Device device, MemoryAllocator& allocator, Uploader& uploader, const MeshData& mesh);
+	// Uploads a cooked mesh straight from its file mapping, which only has to stay mapped until
+	// the constructor returns.
+	Model(vk::Device device, MemoryAllocator& allocator, Uploader& uploader,
+	      const MeshFileView& mesh);
+	// Uploads from mesh's pointers or fill functions, which only have to stay valid until the
+	// constructor returns.
+	Model(vk::Device device, MemoryAllocator& allocator, Uploader& uploader,
+	      const MeshSource& mesh);
+	~Model();
+
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
+	// Binds the vertex and index buffers.
+	void Bind(vk::CommandBuffer cmd) const;
+	// Issues an indexed draw of one level of detail. Assumes Bind() was called.
+	void Draw(vk::CommandBuffer cmd, uint32_t instance_count = 1, uint32_t lod = 0) const;
+
+	uint32_t VertexCount() const { return vertex_count_; }
+	// Indices of the full detail mesh.
+	uint32_t IndexCount() const { return lods_[0].index_count; }
+	vk::IndexType IndexType() const { return index_type_; }
+	// Bounding sphere in model space: center in xyz, radius in w.
+	const glm::vec4& Bounds() const { return bounds_; }
+	// Half size of the bounding box, which is centered on the bounding sphere.
+	const glm::vec3& Extents() const { return extents_; }
+	// Meshlet bounds and index ranges, for cluster culling; empty if the mesh wasn't split.
+	const std::vector<Meshlet>& Meshlets() const { return meshlets_; }
+	// Levels of detail, full detail first; never empty.
+	const std::vector<MeshLod>& Lods() const { return lods_; }
+
+	// Bounding sphere centered on the bounding box of the vertices, and the box's half extents.
+	static void ComputeBounds(const std::vector<Vertex>& vertices, glm::vec4& bounds,
+	                          glm::vec3& extents);
+
+	static MeshData Triangle();
+	// Unit cube centered on the origin, with per-face normals.
+	static MeshData Cube();
+	// Sphere of diameter 1 centered on the origin, with 2 * segments * (rings - 1) triangles.
+	static MeshData Sphere(uint32_t segments, uint32_t rings);
+
+private:
+	// Creates both buffers, for index_bytes of indices.
+	void CreateBuffers(vk::DeviceSize index_bytes);
+	// Creates both buffers and queues their uploads.
+	void Upload(Uploader& uploader, const void* vertices, const void* indices,
+	            vk::DeviceSize index_bytes);
+
+	vk::Device device_;
+	MemoryAllocator& allocator_;
+
+	vk::Buffer vertex_buffer_;
+	Allocation vertex_memory_;
+	vk::Buffer index_buffer_;
+	Allocation index_memory_;
+
+	uint32_t vertex_count_    = 0;
+	// Of every level of detail.
+	uint32_t index_count_     = 0;
+	vk::IndexType index_type_ = vk::IndexType::eUint32;
+	glm::vec4 bounds_;
+	glm::vec3 extents_;
+	std::vector<Meshlet> meshlets_;
+	std::vector<MeshLod> lods_;
+};
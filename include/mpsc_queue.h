@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// Unbounded multi-producer single-consumer queue (Vyukov). Push is wait-free: one atomic
+// exchange and one store. TryPop may only be called from a single consumer thread and is
+// lock-free; it can briefly report empty while a producer is between its exchange and store.
+template <typename T>
+class MpscQueue {
+public:
+	MpscQueue() : head_(new Node()), tail_(head_.load(std::memory_order_relaxed)) {}
+	~MpscQueue() {
+		T discard;
+		while (TryPop(discard)) {
+		}
+		delete tail_;
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	void Push(T value) {
+		Node* node = new Node(std::move(value));
+		Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	bool TryPop(T& out) {
+		// tail_ is a consumed sentinel; its successor holds the oldest value.
+		Node* next = tail_->next.load(std::memory_order_acquire);
+		if (!next) return false;
+		out = std::move(next->value);
+		delete tail_;
+		tail_ = next;
+		return true;
+	}
+
+private:
+	struct Node {
+		Node() = default;
+		explicit Node(T&& v) : value(std::move(v)) {}
+
+		T value;
+		std::atomic<Node*> next{nullptr};
+	};
+
+	std::atomic<Node*> head_;
+	Node* tail_;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "graphics_headers.h"
+
+// A vk::PipelineCache that persists across runs. The on-disk blob is only fed back to the driver
+// when its header matches the current device's vendorID, deviceID and pipelineCacheUUID, so a
+// driver update or GPU swap silently starts from an empty cache instead of tripping the driver.
+class PipelineCache {
+public:
+	// An empty path picks the default location, see DefaultDirectory().
+	PipelineCache(vk::PhysicalDevice physical_device, vk::Device device,
+	              const std::string& path = std::string());
+	~PipelineCache();
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	vk::PipelineCache Handle() const { return cache_; }
+	const std::string& Path() const { return path_; }
+	// True when a valid blob for this device was found on disk.
+	bool LoadedFromDisk() const { return loaded_; }
+
+	// Writes the current cache contents to Path(). Called on destruction; failures are reported
+	// but not fatal since the cache is only an optimization.
+	void Save() const;
+
+	// RESOURCE_INSTALL_DIR/cache when the build was configured with one, otherwise the user's
+	// cache directory ($XDG_CACHE_HOME or ~/.cache, %LOCALAPPDATA% on Windows).
+	static std::string DefaultDirectory();
+
+private:
+	bool IsCompatible(const std::vector<char>& data) const;
+
+	vk::Device device_;
+	vk::PhysicalDeviceProperties properties_;
+	vk::PipelineCache cache_;
+	std::string path_;
+	bool loaded_ = false;
+};
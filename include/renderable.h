@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ecs.h"
+#include "model.h"
+#include "scene_graph.h"
+
+// Components of an entity Engine draws. An entity is drawn while it has all four; changing any of
+// them through the registry is picked up the next frame.
+
+struct MeshComponent {
+	const Model* model;
+};
+
+struct MaterialComponent {
+	// Index in the bindless heap.
+	uint32_t texture;
+};
+
+struct TransformComponent {
+	// Model to world.
+	glm::mat4 world;
+};
+
+// Model-space bounds, for culling: a sphere (xyz center, w radius) and the half extents of the box
+// around the same center.
+struct BoundsComponent {
+	glm::vec4 sphere;
+	glm::vec3 extents;
+};
+
+// Places the entity at a node of Engine::Scene(): its TransformComponent is overwritten with the
+// node's world matrix whenever the scene graph updates.
+struct SceneNodeComponent {
+	NodeHandle node;
+};
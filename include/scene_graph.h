@@ -0,0 +1,116 @@
+#pragma once
+
+#include "graphics_headers.h"
+#include "job_system.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+// Refers to a node of a SceneGraph. Handles stay valid while nodes around them are created,
+// destroyed or moved; once their node is destroyed they are detectably stale, even after its
+// slot is reused, because the slot's generation no longer matches.
+struct NodeHandle {
+	static constexpr uint32_t kInvalidIndex = ~0u;
+
+	uint32_t index      = kInvalidIndex;
+	uint32_t generation = 0;
+
+	explicit operator bool() const { return index != kInvalidIndex; }
+	bool operator==(const NodeHandle& other) const {
+		return index == other.index && generation == other.generation;
+	}
+	bool operator!=(const NodeHandle& other) const { return !(*this == other); }
+};
+
+// A node's transform relative to its parent, applied as scale, then rotation, then translation.
+struct NodeTransform {
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 scale    = glm::vec3(1.0f);
+};
+
+// A transform hierarchy stored data-oriented: every per-node attribute is its own contiguous
+// array, ordered by depth in the tree so every parent precedes its children. Update() then
+// computes world matrices in one forward sweep that only recomputes nodes whose local transform
+// changed, or that sit below one that did. Levels are swept in order, and the nodes within a level
+// are independent, so large levels are split into parallel jobs.
+//
+// Structural changes (creating nodes deeper than the deepest level so far, reparenting,
+// destroying) are batched: array order is restored once, by a stable sort on depth, in the next
+// Update(). World() reflects the last Update().
+class SceneGraph {
+public:
+	void Reserve(size_t count);
+
+	// Adds a node below parent, or a root without one. parent must be valid.
+	NodeHandle Create(NodeHandle parent = {}, const NodeTransform& local = {});
+	// Destroys node and, at the next Update(), everything below it.
+	void Destroy(NodeHandle node);
+	bool Valid(NodeHandle node) const;
+
+	// Moves node and its subtree below parent, or makes it a root. parent may not be node or one
+	// of its descendants.
+	void SetParent(NodeHandle node, NodeHandle parent);
+	NodeHandle Parent(NodeHandle node) const;
+
+	void SetLocal(NodeHandle node, const NodeTransform& local);
+	void SetPosition(NodeHandle node, const glm::vec3& position);
+	void SetRotation(NodeHandle node, const glm::quat& rotation);
+	void SetScale(NodeHandle node, const glm::vec3& scale);
+	NodeTransform Local(NodeHandle node) const;
+	const glm::mat4& World(NodeHandle node) const;
+
+	// Applies pending structural changes and recomputes the world matrices of dirty subtrees.
+	// With a job system, levels with many nodes are split into parallel jobs.
+	void Update(JobSystem* jobs = nullptr);
+
+	// Nodes in the arrays, including destroyed ones the next Update() removes.
+	size_t Size() const { return slot_.size(); }
+	uint32_t LevelCount() const { return uint32_t(level_begin_.size()) - 1; }
+	// World matrices recomputed by the last Update().
+	uint32_t LastUpdateCount() const { return last_update_count_; }
+
+	// Every world matrix in depth order, with the node each belongs to, as of the last Update().
+	const std::vector<glm::mat4>& WorldTransforms() const { return world_; }
+	NodeHandle HandleAt(uint32_t dense) const {
+		return {slot_[dense], slots_[slot_[dense]].generation};
+	}
+
+private:
+	static constexpr uint32_t kNone = ~0u;
+	// Nodes per job range when a level is split.
+	static constexpr uint32_t kChunkSize = 16384;
+
+	struct Slot {
+		// Position in the dense arrays, or kNone while the slot is free.
+		uint32_t dense      = kNone;
+		uint32_t generation = 0;
+	};
+
+	uint32_t Dense(NodeHandle node) const;
+	void MarkDirty(uint32_t dense);
+	// Propagates destruction to descendants, drops destroyed nodes and sorts the rest by depth.
+	void Restructure();
+	// Recomputes the world matrices of dense nodes [begin, end), all of one level, and returns
+	// how many were dirty.
+	uint32_t UpdateRange(uint32_t begin, uint32_t end);
+
+	std::vector<Slot> slots_;
+	std::vector<uint32_t> free_slots_;
+
+	// Dense, depth-ordered arrays. parent_ holds dense indices.
+	std::vector<uint32_t> slot_;
+	std::vector<uint32_t> parent_;
+	std::vector<uint32_t> depth_;
+	std::vector<uint8_t> dirty_;
+	std::vector<uint8_t> destroyed_;
+	std::vector<glm::vec3> local_position_;
+	std::vector<glm::quat> local_rotation_;
+	std::vector<glm::vec3> local_scale_;
+	std::vector<glm::mat4> world_;
+
+	// First dense index of every level, followed by Size(). Stale while restructure_ is set.
+	std::vector<uint32_t> level_begin_ = {0};
+	bool restructure_           = false;
+	uint32_t first_dirty_level_ = kNone;
+	uint32_t last_update_count_ = 0;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "graphics_headers.h"
+
+// Owns a vk::ShaderModule created from a SPIR-V binary on disk.
+class Shader {
+public:
+	Shader(vk::Device device, const std::string& path);
+	~Shader();
+
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
+	vk::ShaderModule Module() const { return module_; }
+
+	static std::vector<char> ReadFile(const std::string& path);
+
+private:
+	vk::Device device_;
+	vk::ShaderModule module_;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "graphics_headers.h"
+
+#include <memory>
+
+// One mip level of a TextureData: its size in texels and where its bytes are.
+struct TextureLevel {
+	uint32_t width;
+	uint32_t height;
+	size_t offset;
+	size_t size;
+};
+
+// The mip chain of a 2D texture, finest level first, in the layout vkCmdCopyBufferToImage takes
+// with tightly packed rows. Block-compressed levels are stored as blocks.
+struct TextureData {
+	vk::Format format = vk::Format::eUndefined;
+	// Bytes per texel, or per block of a block-compressed format.
+	uint32_t block_bytes = 0;
+	std::vector<TextureLevel> levels;
+	// Shared with whatever owns the bytes, so the parsed file needn't be copied.
+	std::shared_ptr<const uint8_t> data;
+
+	const uint8_t* Level(uint32_t level) const { return data.get() + levels[level].offset; }
+};
+
+// Whether path names a file LoadTextureFile reads, judging by its extension.
+bool IsTextureFile(const std::string& path);
+
+// Reads a 2D texture from a KTX, DDS or KMG file with gli, keeping its format and mip levels as
+// they are. Throws std::runtime_error if the file can't be read, isn't a 2D texture or has a
+// format Vulkan has no equivalent of.
+TextureData LoadTextureFile(const std::string& path);
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "bindless.h"
+#include "graphics_headers.h"
+#include "job_system.h"
+#include "memory_allocator.h"
+#include "mpsc_queue.h"
+#include "texture_file.h"
+#include "uploader.h"
+
+// Streams 2D textures from KTX, DDS and KMG files into the bindless heap, coarsest mips first.
+//
+// Files are parsed with gli as background jobs. Block-compressed data (BCn, ETC2/EAC, ASTC) is
+// uploaded as the file stores it when the device can sample that format, and decoded to RGBA8 on
+// the job otherwise (texture_transcoder.h). Load() hands out the texture's bindless index at once.
+// Update() then uploads the mip tail, every level of at most kTailSize texels a side, in one go,
+// followed by one finer level at a time. Materials therefore show up a frame after their file is
+// parsed and sharpen over the following frames. Levels too large for the staging ring are left
+// out, capping the texture's resolution.
+//
+// The index is written once, with a view of every level, when the image is created; frames in
+// flight may sample it, so it is never rewritten. Instead each frame in flight has a residency
+// buffer holding the finest level resident per bindless image slot, and
+// shaders/streamed_texture.glsl samples no finer than that, or the placeholder while nothing is
+// resident. Images the streamer doesn't own read 0 and sample every level.
+//
+// Render thread only, apart from the parse jobs.
+class TextureStreamer {
+public:
+	static constexpr uint32_t kTailSize = 64;
+	// Pushed in place of a residency buffer when there is no streamer.
+	static constexpr uint32_t kNoResidency = ~0u;
+	// The residency of textures without any resident level.
+	static constexpr float kNotResident = -1.0f;
+
+	// placeholder is the bindless image sampled in place of a texture until its first levels are
+	// resident.
+	TextureStreamer(vk::PhysicalDevice physical_device, vk::Device device,
+	                MemoryAllocator& allocator, Uploader& uploader, BindlessHeap& bindless,
+	                JobSystem& jobs, uint32_t frame_count, uint32_t placeholder);
+	// Skips files that haven't started parsing and waits for the ones being parsed. The device
+	// must be idle.
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// Queues path for loading and returns its index in the bindless heap. Loading the same path
+	// again returns the same index.
+	uint32_t Load(const std::string& path);
+	// Starts using parsed files, uploads levels, smallest step first across textures, until
+	// budget bytes are exceeded, and brings slot's residency buffer up to date. The frame that
+	// last used the slot must have completed, and the uploads must be submitted before the frame
+	// being recorded. Returns the bytes uploaded.
+	vk::DeviceSize Update(uint32_t slot, vk::DeviceSize budget);
+	// Bindless index of slot's residency buffer.
+	uint32_t ResidencyBuffer(uint32_t slot) const {
+		return frames_[slot].residency.index.value_or(0);
+	}
+
+	// Whether the device samples format with linear filtering, so it can be uploaded as it is.
+	bool Supports(vk::Format format) const;
+	// Textures being parsed, or with levels still to upload.
+	uint32_t Pending() const { return pending_.Pending() + uint32_t(streaming_.size()); }
+
+private:
+	struct Parsed {
+		uint32_t texture;
+		TextureData data;
+		// Empty on success.
+		std::string error;
+	};
+
+	struct Texture {
+		std::string path;
+		uint32_t index;
+		vk::Image image;
+		Allocation memory;
+		// Every level of the image, whether resident or not.
+		vk::ImageView view;
+		uint32_t level_count = 0;
+		// The finest level resident; level_count until the tail arrives.
+		uint32_t resident = 0;
+		// Released once every level is resident.
+		TextureData data;
+	};
+
+	struct Frame {
+		// Host visible: the placeholder's index, then a float per bindless image slot.
+		BindlessBuffer residency;
+		// Textures whose residency changed since the slot's buffer was written.
+		std::vector<uint32_t> dirty;
+	};
+
+	// Creates the image for a parsed texture, dropping levels the staging ring can't take.
+	void Create(Texture& texture, TextureData data);
+	// The levels the next Upload() covers: the tail if nothing is resident, else the next finer
+	// level.
+	uint32_t NextLevel(const Texture& texture) const;
+	vk::DeviceSize StepBytes(const Texture& texture) const;
+	void Upload(Texture& texture);
+	float* Residency(Frame& frame) const;
+
+	vk::PhysicalDevice physical_device_;
+	vk::Device device_;
+	MemoryAllocator& allocator_;
+	Uploader& uploader_;
+	BindlessHeap& bindless_;
+	JobSystem& jobs_;
+	uint32_t placeholder_;
+
+	JobCounter pending_;
+	std::atomic<bool> stopping_{false};
+	MpscQueue<Parsed> completed_;
+
+	std::vector<Texture> textures_;
+	std::unordered_map<std::string, uint32_t> by_path_;
+	// Textures with levels still to upload.
+	std::vector<uint32_t> streaming_;
+	std::vector<Frame> frames_;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "texture_file.h"
+
+// Whether TranscodeTexture decodes format: BC1-BC5, ETC2 and EAC, signed EAC included, and 24-bit
+// RGB. BC6H, BC7 and ASTC have no CPU decoder.
+bool CanTranscode(vk::Format format);
+
+// Decodes every level of texture to R8G8B8A8, for devices that can't sample its format: sRGB if
+// texture's format is, snorm for signed EAC and unorm otherwise. Channels the format lacks read as
+// 0, alpha as 1. Throws std::runtime_error if !CanTranscode(texture.format).
+TextureData TranscodeTexture(const TextureData& texture);
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "graphics_headers.h"
+#include "memory_allocator.h"
+
+#include <deque>
+
+struct QueueRef {
+	vk::Queue queue;
+	uint32_t family = 0;
+};
+
+// Streams data into device-local resources through a persistently mapped staging ring buffer.
+//
+// Copies are batched into command buffers that run on the dedicated transfer queue when the
+// device has one. In that case every destination goes through a queue family ownership transfer:
+// the transfer queue releases it and a small graphics-queue submission, waiting on the transfer
+// semaphore, acquires it. Work submitted to the graphics queue after Flush() therefore sees the
+// uploaded data without any further synchronization.
+//
+// Ring space is recycled once the batch that used it has completed; when the ring is full the
+// oldest batch is waited on. Not thread safe.
+class Uploader {
+public:
+	static constexpr vk::DeviceSize kDefaultRingSize = 32ull << 20;
+	// Buffer uploads are staged in chunks that start at multiples of this many bytes of the data.
+	static constexpr vk::DeviceSize kChunkAlignment = 256;
+
+	// Writes size bytes of an upload's data, starting offset bytes in, to staging.
+	using Fill = std::function<void(void* staging, vk::DeviceSize offset, vk::DeviceSize size)>;
+
+	// copy_offset_alignment is the device's optimalBufferCopyOffsetAlignment, which image uploads
+	// are staged at multiples of.
+	Uploader(vk::Device device, MemoryAllocator& allocator, QueueRef graphics, QueueRef transfer,
+	         vk::DeviceSize copy_offset_alignment = 1, vk::DeviceSize ring_size = kDefaultRingSize);
+	~Uploader();
+
+	Uploader(const Uploader&) = delete;
+	Uploader& operator=(const Uploader&) = delete;
+
+	// Copies size bytes to dst at dst_offset. dst must have been created with eTransferDst and
+	// exclusive sharing. dst_stage and dst_access describe how the graphics queue uses it next.
+	void UploadBuffer(vk::Buffer dst, vk::DeviceSize dst_offset, const void* data,
+	                  vk::DeviceSize size, vk::PipelineStageFlags dst_stage,
+	                  vk::AccessFlags dst_access);
+	// Like the above, but fill writes the data straight into staging memory one chunk at a time,
+	// for data converted on the way that would otherwise need a copy of its own.
+	void UploadBuffer(vk::Buffer dst, vk::DeviceSize dst_offset, vk::DeviceSize size,
+	                  const Fill& fill, vk::PipelineStageFlags dst_stage,
+	                  vk::AccessFlags dst_access);
+	// Copies one mip level (region.imageSubresource) of dst from data, which must hold size bytes
+	// laid out as region describes; region.bufferOffset is ignored. block_bytes is the size of a
+	// texel, or of a block of a block-compressed format. The level is transitioned from undefined
+	// to final_layout, so it must not hold anything worth keeping. size must not exceed
+	// MaxImageUpload().
+	void UploadImage(vk::Image dst, const vk::BufferImageCopy& region, const void* data,
+	                 vk::DeviceSize size, uint32_t block_bytes, vk::ImageLayout final_layout,
+	                 vk::PipelineStageFlags dst_stage, vk::AccessFlags dst_access);
+
+	// Submits everything recorded since the last flush.
+	void Flush();
+	// Flushes and blocks until every submitted upload has completed.
+	void WaitIdle();
+
+	bool UsesTransferQueue() const { return transfer_.family != graphics_.family; }
+	uint64_t BytesUploaded() const { return bytes_uploaded_; }
+	// The largest level UploadImage takes.
+	vk::DeviceSize MaxImageUpload() const { return ring_size_ / 2 - max_image_alignment_; }
+
+private:
+	static constexpr uint32_t kBatchCount = 4;
+	// Every texel block size, 1 to 32 bytes, divides this.
+	static constexpr vk::DeviceSize kBlockBytesMultiple = 96;
+
+	struct PendingBuffer {
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+		vk::PipelineStageFlags dst_stage;
+		vk::AccessFlags dst_access;
+	};
+
+	struct PendingImage {
+		vk::Image image;
+		vk::ImageSubresourceRange range;
+		vk::ImageLayout final_layout;
+		vk::PipelineStageFlags dst_stage;
+		vk::AccessFlags dst_access;
+	};
+
+	struct Batch {
+		vk::CommandPool transfer_pool;
+		vk::CommandPool acquire_pool;
+		vk::CommandBuffer transfer_cmd;
+		vk::CommandBuffer acquire_cmd;
+		vk::Semaphore transferred;
+		vk::Fence fence;
+		uint64_t ring_end = 0;
+		bool recording    = false;
+		std::vector<PendingBuffer> buffers;
+		std::vector<PendingImage> images;
+	};
+
+	Batch& BeginBatch();
+	// Reserves size bytes of ring space and returns its position. May flush and wait.
+	uint64_t Reserve(vk::DeviceSize size, vk::DeviceSize alignment);
+	bool RetireOldest();
+
+	vk::Device device_;
+	MemoryAllocator& allocator_;
+	QueueRef graphics_;
+	QueueRef transfer_;
+
+	vk::Buffer ring_buffer_;
+	Allocation ring_memory_;
+	vk::DeviceSize copy_offset_alignment_;
+	vk::DeviceSize ring_size_;
+	// The most any image upload is aligned to.
+	vk::DeviceSize max_image_alignment_;
+	// Monotonic ring positions; the physical offset is position % ring_size_.
+	uint64_t head_ = 0;
+	uint64_t tail_ = 0;
+
+	std::array<Batch, kBatchCount> batches_;
+	uint32_t current_ = 0;
+	std::deque<uint32_t> in_flight_;
+
+	uint64_t bytes_uploaded_ = 0;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "graphics_headers.h"
+#include "mapped_file.h"
+
+// The tiled format virtual textures stream from, written by vtcook. Every level of an RGBA8 mip
+// chain, down to the first that fits in a single page, is cut into square pages of
+// kVirtualPageSize texels. Each page is stored with a border of kVirtualPageBorder texels copied
+// from its neighbours, wrapping around the texture's edges, so bilinear filtering in the page
+// cache never reads from an unrelated page:
+//
+//   VirtualTextureHeader
+//   per level, finest first, per row of pages, top to bottom: kVirtualPageBytes per page
+//
+// Pages are stored uncompressed, so any page's offset follows from its level and position.
+constexpr uint32_t kVirtualTextureMagic   = 0x58455456;  // "VTEX"
+constexpr uint32_t kVirtualTextureVersion = 1;
+constexpr uint32_t kVirtualPageSize       = 128;
+constexpr uint32_t kVirtualPageBorder     = 4;
+// A page as stored and as placed in the cache: its texels and their border.
+constexpr uint32_t kVirtualPageStride = kVirtualPageSize + 2 * kVirtualPageBorder;
+constexpr size_t kVirtualPageBytes    = size_t(kVirtualPageStride) * kVirtualPageStride * 4;
+
+struct VirtualTextureHeader {
+	uint32_t magic;
+	uint32_t version;
+	// Of level 0, in texels.
+	uint32_t width;
+	uint32_t height;
+	uint32_t level_count;
+	// VkFormat: R8G8B8A8 UNORM or SRGB.
+	uint32_t format;
+	uint32_t page_size;
+	uint32_t page_border;
+};
+
+// One level of a virtual texture: its size in texels and in pages, and the index of its first
+// page among all of the texture's.
+struct VirtualLevel {
+	uint32_t width;
+	uint32_t height;
+	uint32_t pages_x;
+	uint32_t pages_y;
+	uint64_t first_page;
+};
+
+// The levels of a width x height virtual texture, finest first, down to the first one that fits
+// in a page.
+std::vector<VirtualLevel> VirtualLevels(uint32_t width, uint32_t height);
+
+// Whether path ends in .vtex.
+bool IsVirtualTextureFile(const std::string& path);
+
+// A virtual texture file, mapped. Opening validates the header and the file's size; pages are
+// only read when asked for, so opening costs the same whatever the texture's size.
+class VirtualTextureFile {
+public:
+	// Throws on a missing, truncated or foreign file, or one of another version.
+	explicit VirtualTextureFile(const std::string& path);
+
+	uint32_t Width() const { return header_->width; }
+	uint32_t Height() const { return header_->height; }
+	vk::Format Format() const { return vk::Format(header_->format); }
+	const std::vector<VirtualLevel>& Levels() const { return levels_; }
+	uint64_t PageCount() const { return levels_.back().first_page + 1; }
+	// kVirtualPageBytes of RGBA8 texels in rows of kVirtualPageStride, border included.
+	const uint8_t* Page(uint32_t level, uint32_t x, uint32_t y) const;
+
+private:
+	MappedFile file_;
+	const VirtualTextureHeader* header_;
+	std::vector<VirtualLevel> levels_;
+};
+
+// Fills texels with row y of level of a texture being written: max(1, width >> level) texels.
+using VirtualRowSource = std::function<void(uint32_t level, uint32_t y, uint32_t* texels)>;
+
+// Writes a width x height virtual texture whose texels come from source, level by level. Rows
+// are asked for a row of pages at a time, so the texture never has to fit in memory.
+void WriteVirtualTextureFile(const std::string& path, uint32_t width, uint32_t height,
+                             vk::Format format, const VirtualRowSource& source);
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "bindless.h"
+#include "graphics_headers.h"
+#include "job_system.h"
+#include "memory_allocator.h"
+#include "mpsc_queue.h"
+#include "virtual_texture_file.h"
+
+#include <list>
+#include <memory>
+#include <unordered_set>
+
+// Streams textures too large for device memory a page at a time, in a fixed amount of it.
+//
+// Every texture is a .vtex file (virtual_texture_file.h), mapped but never read as a whole. Its
+// pages live in a physical cache, one RGBA8 image of cache_pages page slots, whatever the
+// number or size of the textures. A page table in a storage buffer maps each page of each
+// texture to its cache slot, or to none, and shaders/virtual_texture.glsl samples through it,
+// falling back to the finest resident ancestor of a missing page. The coarsest level of every
+// texture is a single page, loaded when the texture is and never evicted, so every texel always
+// has one.
+//
+// While drawing, fragments also write the page they want into a feedback buffer, one jittered
+// pixel per kFeedbackScale x kFeedbackScale tile. Once the frame completes, Prepare() reads it
+// back: resident pages are marked used, and missing ones (with their missing ancestors) are
+// read from their files by background jobs, coarser levels and more requested pages first.
+// Loaded pages are copied into the cache, up to kMaxPageUploads per frame, in place of free or
+// least recently used slots; a slot that recent feedback still asked for is never evicted, so a
+// working set larger than the cache degrades to coarser levels instead of thrashing.
+//
+// Each frame in flight has its own page table, feedback buffer and staging buffer, reused once
+// its slot's fence has signaled. Render thread only, apart from the page reads.
+class VirtualTexturing {
+public:
+	// Set in the texture indices Load() returns, so shaders can tell them from bindless images.
+	static constexpr uint32_t kIndexBit = 1u << 31;
+	static constexpr uint32_t kFeedbackScale    = 8;
+	static constexpr uint32_t kMaxLoadsInFlight = 32;
+	static constexpr uint32_t kMaxPageUploads   = 16;
+	// Frames of feedback a cache slot must go unrequested for before it may be evicted.
+	static constexpr uint64_t kMinEvictionAge = 8;
+
+	// Page table header; shaders/virtual_texture.glsl declares the matching layout. The rest of
+	// the table is a uint array of texture blocks and page entries.
+	struct TableHeader {
+		// The cache is a grid of cache_columns page slots a row, cache_width x cache_height texels.
+		uint32_t cache_columns;
+		uint32_t cache_width;
+		uint32_t cache_height;
+		uint32_t feedback_buffer;
+		uint32_t feedback_width;
+		uint32_t feedback_height;
+		// The pixel of each feedback tile that writes this frame: x | y << 8.
+		uint32_t jitter;
+		uint32_t texture_count;
+	};
+
+	// cache_pages is clamped to what one image can hold. extent is the size of the frames drawn.
+	VirtualTexturing(vk::PhysicalDevice physical_device, vk::Device device,
+	                 MemoryAllocator& allocator, BindlessHeap& bindless, JobSystem& jobs,
+	                 uint32_t frame_count, uint32_t cache_pages, vk::Extent2D extent);
+	// Waits for the page reads in flight. The device must be idle.
+	~VirtualTexturing();
+
+	VirtualTexturing(const VirtualTexturing&) = delete;
+	VirtualTexturing& operator=(const VirtualTexturing&) = delete;
+
+	// Maps path and returns its texture index, with kIndexBit set. Its coarsest page is read
+	// right away and uploaded by the next frame. Loading the same path again returns the same
+	// index. Throws if the file is invalid or the cache can't hold another pinned page.
+	uint32_t Load(const std::string& path);
+	// Recreates the feedback buffers for frames of a new size. The device must be idle.
+	void Resize(vk::Extent2D extent);
+
+	// Reads the feedback slot's last frame wrote, queues page reads, places loaded pages in
+	// the cache and brings slot's page table up to date for frame_number. The frame that last
+	// used the slot must have completed.
+	void Prepare(uint32_t slot, uint64_t frame_number);
+	// Records the page copies placed by Prepare() and clears slot's feedback buffer. Must be
+	// outside a render pass, before the draws that sample virtual textures.
+	void RecordUploads(vk::CommandBuffer cmd, uint32_t slot);
+	// Makes the feedback written by the draws visible to the host. Must be outside a render
+	// pass, after them.
+	void RecordReadback(vk::CommandBuffer cmd) const;
+	// Bindless index of slot's page table.
+	uint32_t TableBuffer(uint32_t slot) const { return frames_[slot].table.index.value_or(0); }
+
+	uint32_t CapacityPages() const { return uint32_t(pages_.size()); }
+	uint32_t ResidentPages() const { return uint32_t(resident_.size()); }
+	// Pages the latest feedback asked for that aren't resident.
+	uint32_t WantedPages() const { return uint32_t(wanted_.size()); }
+	uint64_t PagesLoaded() const { return pages_loaded_; }
+	uint64_t PagesEvicted() const { return pages_evicted_; }
+	// Device memory of the cache image, fixed at creation.
+	vk::DeviceSize CacheBytes() const { return cache_memory_.size; }
+
+private:
+	static constexpr uint32_t kNoPage = ~0u;
+
+	using Buffer = BindlessBuffer;
+
+	struct Frame {
+		// Host visible: TableHeader and the table, the requests of the frame's fragments and
+		// the pages copied into the cache.
+		Buffer table;
+		Buffer feedback;
+		Buffer staging;
+		std::vector<vk::BufferImageCopy> copies;
+		// Table words changed since the slot's table was written, unless it needs all of them.
+		std::vector<uint32_t> dirty;
+		bool rewrite = true;
+		// The frame being prepared, and the one whose requests feedback holds.
+		uint64_t frame_number = 0;
+		std::optional<uint64_t> feedback_frame;
+	};
+
+	struct Texture {
+		std::string path;
+		std::unique_ptr<VirtualTextureFile> file;
+		// Offset of the texture's block in the table, its index without kIndexBit.
+		uint32_t block;
+		// Table offset of each level's first page entry.
+		std::vector<uint32_t> first_entry;
+	};
+
+	// A cache slot.
+	struct Page {
+		uint64_t key = ~0ull;
+		// Frame of the latest feedback that asked for the page.
+		uint64_t last_used = 0;
+		// Pinned pages are never evicted and aren't in lru_.
+		bool pinned = false;
+		std::list<uint32_t>::iterator lru;
+	};
+
+	struct LoadedPage {
+		uint64_t key;
+		std::vector<uint8_t> texels;
+	};
+
+	// Identifies a page of a texture; requests are deduplicated by it.
+	static uint64_t Key(uint32_t texture, uint32_t level, uint32_t x, uint32_t y) {
+		return uint64_t(texture) << 40 | uint64_t(level) << 32 | uint64_t(y) << 16 | x;
+	}
+	uint32_t& Entry(uint64_t key);
+	void SetEntry(uint64_t key, uint32_t value);
+
+	// Turns slot's feedback into wanted_ and marks the resident pages it asked for as used.
+	void ReadFeedback(Frame& frame);
+	void ScheduleLoads();
+	// Whether the least recently used unpinned page has gone unrequested long enough to evict.
+	bool OldestEvictable() const;
+	// Copies loaded into frame's staging buffer and points its entry at a cache slot, evicting
+	// the least recently used page if needed. Returns false if every slot is in use.
+	bool Place(Frame& frame, const LoadedPage& loaded, bool pinned);
+	void WriteTable(Frame& frame);
+
+	// Host visible and coherent.
+	void CreateBuffer(Buffer& buffer, vk::DeviceSize size, vk::BufferUsageFlags usage);
+	void Release(Buffer& buffer);
+
+	vk::Device device_;
+	MemoryAllocator& allocator_;
+	BindlessHeap& bindless_;
+	JobSystem& jobs_;
+
+	vk::Image cache_image_;
+	Allocation cache_memory_;
+	// The cache as UNORM and as sRGB, for textures of either format.
+	vk::ImageView unorm_view_;
+	vk::ImageView srgb_view_;
+	uint32_t unorm_index_ = 0;
+	uint32_t srgb_index_  = 0;
+	uint32_t cache_columns_;
+	vk::Extent2D cache_extent_;
+	bool cache_initialized_ = false;
+	vk::Extent2D feedback_extent_;
+
+	std::vector<Frame> frames_;
+	std::vector<Texture> textures_;
+	std::unordered_map<std::string, uint32_t> by_path_;
+	// CPU copy of the table after the header.
+	std::vector<uint32_t> table_;
+
+	std::vector<Page> pages_;
+	std::vector<uint32_t> free_pages_;
+	// Cache slots of unpinned pages, least recently used first.
+	std::list<uint32_t> lru_;
+	std::unordered_map<uint64_t, uint32_t> resident_;
+	// Pinned pages read by Load(), placed ahead of any other.
+	std::vector<LoadedPage> pinned_;
+	// Frame of the newest feedback read.
+	uint64_t latest_feedback_ = 0;
+
+	// Missing pages of the latest feedback, most urgent first.
+	std::vector<uint64_t> wanted_;
+	// Pages being read or in ready_, which are not read again.
+	std::unordered_set<uint64_t> loading_;
+	JobCounter pending_;
+	std::atomic<bool> stopping_{false};
+	MpscQueue<LoadedPage> completed_;
+	// Read but not yet placed, for lack of a free or evictable slot or over earlier frames'
+	// upload limits. Bounded by kMaxLoadsInFlight, as its pages stay in loading_.
+	std::vector<LoadedPage> ready_;
+
+	uint64_t pages_loaded_  = 0;
+	uint64_t pages_evicted_ = 0;
+};
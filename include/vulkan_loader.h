@@ -0,0 +1,24 @@
+#pragma once
+
+#include "graphics_headers.h"
+
+// Points the default vulkan.hpp dispatcher at the Vulkan loader.
+//
+// graphics_headers.h enables VULKAN_HPP_DISPATCH_LOADER_DYNAMIC, so every vk:: call goes through
+// vk::defaultDispatchLoaderDynamic. Device-level entry points are fetched with
+// vkGetDeviceProcAddr, so command buffer calls jump straight into the driver instead of through
+// the loader's trampolines. Without ENGINE_LINK_VULKAN the loader library itself is opened at
+// runtime and the binary has no link-time dependency on libvulkan.
+//
+// There is one dispatcher per process, so only one device can be in use at a time.
+namespace vulkan_loader {
+
+// Resolves the global commands (vkCreateInstance, vkEnumerateInstance*). Throws if the loader
+// library can't be found.
+void LoadGlobal();
+// Resolves instance-level commands, and device-level ones through the loader.
+void LoadInstance(vk::Instance instance);
+// Resolves device-level commands directly from the driver of device.
+void LoadDevice(vk::Instance instance, vk::Device device);
+
+}  // namespace vulkan_loader
@@ -0,0 +1,15 @@
+#ifndef BINDLESS_GLSL
+#define BINDLESS_GLSL
+
+// The descriptor set of BindlessHeap (include/bindless.h). Indices come from push constants or
+// storage buffers; wrap them in nonuniformEXT() when they can differ within a draw.
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform texture2D bindlessTextures[];
+layout(set = 0, binding = 1) uniform sampler bindlessSamplers[];
+
+// Binding 2 holds storage buffers. Their layout differs per use, so shaders declare it
+// themselves:
+//   layout(set = 0, binding = 2) readonly buffer Objects { Object objects[]; } bindlessObjects[];
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef CULL_GLSL
+#define CULL_GLSL
+
+// Visibility tests shared by the culling passes, against the CullData of GpuScene.
+#include "scene.glsl"
+
+// Kept in sync with kLodHysteresis in include/lod.h.
+const float LOD_HYSTERESIS = 0.75;
+
+// Largest factor transform scales any direction by.
+float MaxScale(mat4 transform) {
+    return max(length(transform[0].xyz), max(length(transform[1].xyz), length(transform[2].xyz)));
+}
+
+// Bounding sphere of model-space bounds under transform, in world space.
+void WorldSphere(mat4 transform, vec4 bounds, out vec3 center, out float radius) {
+    center = (transform * vec4(bounds.xyz, 1.0)).xyz;
+    radius = bounds.w * MaxScale(transform);
+}
+
+bool OutsideFrustum(CullData cull, vec3 center, float radius) {
+    for (int i = 0; i < 6; ++i) {
+        if (dot(cull.frustum[i].xyz, center) + cull.frustum[i].w < -radius) return true;
+    }
+    return false;
+}
+
+float PyramidDepth(CullData cull, vec2 uv, float level) {
+    return textureLod(sampler2D(bindlessTextures[cull.pyramidTexture],
+                                bindlessSamplers[cull.pyramidSampler]), uv, level).r;
+}
+
+// Conservative: projects the corners of the sphere's bounding box into the pyramid's frame and
+// compares their nearest depth with the farthest depth under their screen rectangle.
+bool Occluded(CullData cull, vec3 center, float radius) {
+    vec3 minimum = vec3(1.0);
+    vec3 maximum = vec3(-1.0);
+    for (int i = 0; i < 8; ++i) {
+        vec3 offset = vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0,
+                           (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = cull.pyramidViewProjection * vec4(center + radius * offset, 1.0);
+        // Reaching behind the camera, the rectangle is unbounded.
+        if (clip.w <= 0.0) return false;
+        vec3 ndc = clip.xyz / clip.w;
+        minimum = min(minimum, ndc);
+        maximum = max(maximum, ndc);
+    }
+    if (minimum.z <= 0.0) return false;
+
+    vec2 uvMin = clamp(minimum.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvMax = clamp(maximum.xy * 0.5 + 0.5, 0.0, 1.0);
+    // The level where the rectangle spans at most one texel, so its four corners cover it.
+    vec2 extent = (uvMax - uvMin) * cull.pyramidSize;
+    float level = ceil(log2(max(max(extent.x, extent.y), 1.0)));
+    level = min(level, float(cull.pyramidLevels - 1));
+
+    float depth = max(max(PyramidDepth(cull, uvMin, level),
+                          PyramidDepth(cull, vec2(uvMax.x, uvMin.y), level)),
+                      max(PyramidDepth(cull, vec2(uvMin.x, uvMax.y), level),
+                          PyramidDepth(cull, uvMax, level)));
+    return minimum.z > depth;
+}
+
+// The LOD of batch to draw an object with, given its world bounding sphere and the LOD it was
+// drawn with last. Mirrors LodPixelsPerUnit and SelectLod in src/lod.cpp: the coarsest LOD whose
+// error projects to at most lodThreshold pixels, refining at once but only coarsening once the
+// coarser LOD is well within the threshold.
+uint SelectLod(CullData cull, uint lodBuffer, Batch batch, mat4 transform, vec3 center,
+               float radius, uint current) {
+    float distance = length(center - cull.eye.xyz) - radius;
+    if (distance <= 0.0) return 0;
+    float pixelsPerUnit = cull.lodScale * MaxScale(transform) / distance;
+
+    uint fine = 0;
+    uint coarse = 0;
+    for (uint l = 1; l < batch.lodCount; ++l) {
+        float pixels = lodBuffers[lodBuffer].lods[batch.firstLod + l].error * pixelsPerUnit;
+        if (pixels <= cull.lodThreshold) fine = l;
+        if (pixels <= cull.lodThreshold * LOD_HYSTERESIS) coarse = l;
+    }
+    return current > fine ? fine : max(current, coarse);
+}
+
+#endif
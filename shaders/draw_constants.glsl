@@ -0,0 +1,17 @@
+#ifndef DRAW_CONSTANTS_GLSL
+#define DRAW_CONSTANTS_GLSL
+
+// Matches Engine::DrawConstants. Indirect draws only push the view-projection as mvp and take
+// their model matrix and texture from the object buffer.
+layout(push_constant) uniform DrawConstants {
+    mat4 mvp;
+    uint textureIndex;
+    uint samplerIndex;
+    uint objectBuffer;
+    // VirtualTexturing's page table for this frame; frag_virtual.frag only.
+    uint virtualTextures;
+    // TextureStreamer's residency buffer for this frame, or kNoTextureResidency.
+    uint textureResidency;
+} pc;
+
+#endif
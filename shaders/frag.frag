@@ -1,10 +1,18 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+#include "draw_constants.glsl"
+#include "streamed_texture.glsl"
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTexture;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    vec4 albedo = SampleTexture(fragTexture, fragUV, pc.samplerIndex, pc.textureResidency);
+    outColor = vec4(fragColor * albedo.rgb, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+#include "draw_constants.glsl"
+#include "streamed_texture.glsl"
+#include "virtual_texture.glsl"
+
+// frag.frag for devices that can store from fragment shaders, which also samples virtual
+// textures. Hidden fragments must not ask for pages, so depth is tested first.
+layout(early_fragment_tests) in;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 albedo;
+    if ((fragTexture & kVirtualTextureBit) != 0u) {
+        albedo = SampleVirtualTexture(fragTexture, fragUV, pc.samplerIndex, pc.virtualTextures);
+    } else {
+        albedo = SampleTexture(fragTexture, fragUV, pc.samplerIndex, pc.textureResidency);
+    }
+    outColor = vec4(fragColor * albedo.rgb, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "draw_constants.glsl"
+#include "scene.glsl"
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragTexture;
+
+void main() {
+    // Every indirect command draws one object, passed as its firstInstance.
+    Object object = objectBuffers[pc.objectBuffer].objects[gl_InstanceIndex];
+    gl_Position = pc.mvp * object.transform * vec4(inPosition, 1.0);
+    fragColor = inNormal * 0.5 + 0.5;
+    fragUV = inUV;
+    fragTexture = object.textureIndex;
+}
@@ -0,0 +1,113 @@
+#ifndef SCENE_GLSL
+#define SCENE_GLSL
+
+// Buffers of GpuScene (include/gpu_scene.h), accessed through the bindless storage buffer
+// binding. Shaders that write draw commands define SCENE_WRITE_COMMANDS first, so stages that
+// only draw don't declare writable buffers.
+#include "bindless.glsl"
+
+struct Object {
+    mat4 transform;
+    vec4 bounds;
+    uint batch;
+    uint textureIndex;
+    uint padding0;
+    uint padding1;
+};
+
+struct Batch {
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstCommand;
+    // Objects of batches with clusters are culled per cluster by cull_clusters.comp.
+    uint firstCluster;
+    uint clusterCount;
+    uint firstLod;
+    uint lodCount;
+};
+
+struct Cluster {
+    vec4 bounds;
+    // Normal cone: axis in xyz, sine of its spread in w (2 when it can't cull).
+    vec4 cone;
+    uint firstIndex;
+    uint indexCount;
+    uint padding0;
+    uint padding1;
+};
+
+// MeshLod (include/lod.h): an index range of the model and its error in model space.
+struct Lod {
+    uint firstIndex;
+    uint indexCount;
+    float error;
+};
+
+struct ClusterGroup {
+    uint object;
+    uint firstCluster;
+    uint clusterCount;
+    uint padding;
+};
+
+// VkDrawIndexedIndirectCommand.
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+const uint CULL_FRUSTUM = 1;
+const uint CULL_OCCLUSION = 2;
+const uint CULL_BACKFACE = 4;
+const uint CULL_LOD = 8;
+
+struct CullData {
+    // The frame the depth pyramid was rendered in, which is usually the previous one.
+    mat4 pyramidViewProjection;
+    // Normalized planes of the current frame, pointing inwards.
+    vec4 frustum[6];
+    // World-space eye of the current frame, set with CULL_BACKFACE or CULL_LOD.
+    vec4 eye;
+    vec2 pyramidSize;
+    uint pyramidLevels;
+    uint pyramidTexture;
+    uint pyramidSampler;
+    uint flags;
+    // Pixels a unit at unit distance spans, and the LOD error allowed in pixels, with CULL_LOD.
+    float lodScale;
+    float lodThreshold;
+};
+
+layout(set = 0, binding = 2) readonly buffer ObjectBuffer { Object objects[]; } objectBuffers[];
+layout(set = 0, binding = 2) readonly buffer BatchBuffer { Batch batches[]; } batchBuffers[];
+layout(set = 0, binding = 2) readonly buffer CullBuffer { CullData cull; } cullBuffers[];
+layout(set = 0, binding = 2) readonly buffer ClusterBuffer { Cluster clusters[]; } clusterBuffers[];
+layout(set = 0, binding = 2) readonly buffer ClusterGroupBuffer {
+    ClusterGroup groups[];
+} clusterGroupBuffers[];
+layout(set = 0, binding = 2) readonly buffer LodBuffer { Lod lods[]; } lodBuffers[];
+
+#ifdef SCENE_WRITE_COMMANDS
+layout(set = 0, binding = 2) writeonly buffer CommandBuffer {
+    DrawCommand commands[];
+} commandBuffers[];
+layout(set = 0, binding = 2) buffer CountBuffer { uint counts[]; } countBuffers[];
+layout(set = 0, binding = 2) buffer StatsBuffer {
+    uint drawn;
+    uint frustumCulled;
+    uint occlusionCulled;
+    uint clustersDrawn;
+    uint clustersFrustumCulled;
+    uint clustersBackfaceCulled;
+    uint clustersOcclusionCulled;
+} statsBuffers[];
+// The LOD every object was last drawn with, and how many objects each LOD drew this frame.
+layout(set = 0, binding = 2) buffer LodStateBuffer { uint lodStates[]; } lodStateBuffers[];
+layout(set = 0, binding = 2) buffer LodCountBuffer { uint lodCounts[]; } lodCountBuffers[];
+#endif
+
+#endif
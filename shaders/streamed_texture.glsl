@@ -0,0 +1,49 @@
+#ifndef STREAMED_TEXTURE_GLSL
+#define STREAMED_TEXTURE_GLSL
+
+// Sampling of bindless images whose finer mip levels may not be resident yet; see
+// TextureStreamer (include/texture_streamer.h). The residency buffer of the frame holds the
+// finest resident level of each image slot, negative while none is, and 0 for images that
+// aren't streamed.
+#include "bindless.glsl"
+
+const uint kNoTextureResidency = 0xffffffffu;
+
+layout(set = 0, binding = 2) readonly buffer TextureResidency {
+    // Sampled in place of images without a resident level.
+    uint placeholder;
+    float minLod[];
+} textureResidencies[];
+
+// texture() of bindless image textureIndex, but no finer than its finest resident level.
+// residency is the frame's residency buffer, or kNoTextureResidency to sample every level.
+vec4 SampleTexture(uint textureIndex, vec2 uv, uint samplerIndex, uint residency) {
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+    float minLod = 0.0;
+    if (residency != kNoTextureResidency) {
+        minLod = textureResidencies[residency].minLod[textureIndex];
+        if (minLod < 0.0) {
+            textureIndex = textureResidencies[residency].placeholder;
+            minLod = 0.0;
+        }
+    }
+
+    // Fragments of different draws can share a subgroup, so the index may diverge.
+    vec2 size = vec2(textureSize(sampler2D(bindlessTextures[nonuniformEXT(textureIndex)],
+                                           bindlessSamplers[samplerIndex]), 0));
+    if (minLod > 0.0) {
+        // Scale the gradients until even the shorter axis, which anisotropic filtering picks
+        // its level from, lands on the resident level; slightly past it, so rounding never
+        // reaches the finer one.
+        float lod = 0.5 * log2(max(min(dot(dx * size, dx * size), dot(dy * size, dy * size)),
+                                   1e-8));
+        float scale = exp2(max(minLod + 1.0 / 64.0 - lod, 0.0));
+        dx *= scale;
+        dy *= scale;
+    }
+    return textureGrad(sampler2D(bindlessTextures[nonuniformEXT(textureIndex)],
+                                 bindlessSamplers[samplerIndex]), uv, dx, dy);
+}
+
+#endif
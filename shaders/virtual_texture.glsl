@@ -0,0 +1,98 @@
+#ifndef VIRTUAL_TEXTURE_GLSL
+#define VIRTUAL_TEXTURE_GLSL
+
+// Sampling through the page table of VirtualTexturing (include/virtual_texturing.h). Texture
+// indices with kVirtualTextureBit set are the offset of a texture's block in the table:
+//   data[block]: level count, cache image, texture number for feedback, padding
+//   data[block + 4 + 4 * level]: width, height, pages a row, offset of the level's entries
+// Each entry holds the cache slot of its page, or kVirtualNoPage.
+#include "bindless.glsl"
+
+const uint kVirtualTextureBit = 0x80000000u;
+const uint kVirtualNoPage = 0xffffffffu;
+// As in include/virtual_texture_file.h.
+const uint kVirtualPageSize = 128u;
+const uint kVirtualPageBorder = 4u;
+const uint kVirtualPageStride = 136u;
+const uint kVirtualFeedbackScale = 8u;
+
+layout(set = 0, binding = 2) readonly buffer VirtualTextureTable {
+    uint cacheColumns;
+    uint cacheWidth;
+    uint cacheHeight;
+    uint feedbackBuffer;
+    uint feedbackWidth;
+    uint feedbackHeight;
+    uint jitter;
+    uint textureCount;
+    uint data[];
+} virtualTextureTables[];
+
+// Per feedback tile: texture number << 8 | level, page y << 16 | page x.
+layout(set = 0, binding = 2) writeonly buffer VirtualTextureFeedback {
+    uvec2 requests[];
+} virtualTextureFeedback[];
+
+// The page of level covering uv, which must be in [0, 1).
+uvec2 VirtualPage(uint table, uint block, uint level, vec2 uv, out vec2 texel) {
+    uint record = block + 4u + 4u * level;
+    uvec2 size = uvec2(virtualTextureTables[table].data[record],
+                       virtualTextureTables[table].data[record + 1u]);
+    texel = uv * vec2(size);
+    return min(uvec2(texel) / kVirtualPageSize, (size - 1u) / kVirtualPageSize);
+}
+
+// Samples the virtual texture textureIndex with repeat addressing, bilinearly from the level
+// whose texels are closest to a pixel apart, or from its finest resident ancestor. Every
+// kVirtualFeedbackScale x kVirtualFeedbackScale pixel tile also asks for the page it wants, from
+// the pixel the table's jitter picks this frame. Textures without any resident page read white.
+vec4 SampleVirtualTexture(uint textureIndex, vec2 uv, uint samplerIndex, uint table) {
+    uint block = textureIndex & ~kVirtualTextureBit;
+    uint levelCount = virtualTextureTables[table].data[block];
+    uint cacheTexture = virtualTextureTables[table].data[block + 1u];
+
+    vec2 size = vec2(virtualTextureTables[table].data[block + 4u],
+                     virtualTextureTables[table].data[block + 5u]);
+    vec2 dx = dFdx(uv * size);
+    vec2 dy = dFdy(uv * size);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+    uint level = uint(clamp(lod, 0.0, float(levelCount - 1u)));
+    vec2 wrapped = fract(uv);
+    vec2 texel;
+
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    uint jitter = virtualTextureTables[table].jitter;
+    if (all(equal(pixel % kVirtualFeedbackScale, uvec2(jitter & 0xffu, jitter >> 8)))) {
+        uvec2 page = VirtualPage(table, block, level, wrapped, texel);
+        uvec2 tile = pixel / kVirtualFeedbackScale;
+        uint feedback = virtualTextureTables[table].feedbackBuffer;
+        uint request = tile.y * virtualTextureTables[table].feedbackWidth + tile.x;
+        virtualTextureFeedback[feedback].requests[request] =
+            uvec2(virtualTextureTables[table].data[block + 2u] << 8 | level,
+                  page.y << 16 | page.x);
+    }
+
+    for (; level < levelCount; ++level) {
+        uvec2 page = VirtualPage(table, block, level, wrapped, texel);
+        uint record = block + 4u + 4u * level;
+        uint entry = virtualTextureTables[table].data[record + 3u] +
+                     page.y * virtualTextureTables[table].data[record + 2u] + page.x;
+        uint slot = virtualTextureTables[table].data[entry];
+        if (slot == kVirtualNoPage) continue;
+
+        // Pages sit in the cache with their borders, so filtering never crosses into another.
+        uint columns = virtualTextureTables[table].cacheColumns;
+        uvec2 origin = uvec2(slot % columns, slot / columns) * kVirtualPageStride +
+                       kVirtualPageBorder;
+        vec2 cacheTexel = vec2(origin) + texel - vec2(page * kVirtualPageSize);
+        vec2 cacheSize = vec2(virtualTextureTables[table].cacheWidth,
+                              virtualTextureTables[table].cacheHeight);
+        // Images picked per draw may differ within a subgroup.
+        return textureLod(sampler2D(bindlessTextures[nonuniformEXT(cacheTexture)],
+                                    bindlessSamplers[samplerIndex]),
+                          cacheTexel / cacheSize, 0.0);
+    }
+    return vec4(1.0);
+}
+
+#endif
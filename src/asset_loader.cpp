@@ -0,0 +1,113 @@
+#include "asset_loader.h"
+
+#include "mesh_simplifier.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/material.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <chrono>
+
+AssetLoader::~AssetLoader() {
+	stopping_ = true;
+	jobs_.Wait(pending_);
+}
+
+uint64_t AssetLoader::Load(const std::string& path) {
+	uint64_t id = next_id_++;
+	jobs_.ScheduleBackground(
+	    [this, id, path] {
+		    if (stopping_) return;
+		    LoadedAsset asset;
+		    try {
+			    asset = Import(path);
+		    } catch (const std::exception& e) {
+			    asset.path  = path;
+			    asset.error = e.what();
+		    }
+		    asset.id = id;
+		    completed_.Push(std::move(asset));
+	    },
+	    &pending_);
+	return id;
+}
+
+LoadedAsset AssetLoader::Import(const std::string& path) {
+	auto start = std::chrono::steady_clock::now();
+
+	LoadedAsset asset;
+	asset.path = path;
+
+	// Importers are not thread safe, so every call gets its own.
+	Assimp::Importer importer;
+	const aiScene* scene =
+	    importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
+	                                aiProcess_JoinIdenticalVertices |
+	                                aiProcess_PreTransformVertices | aiProcess_SortByPType);
+	if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode) {
+		asset.error = importer.GetErrorString();
+		return asset;
+	}
+
+	for (unsigned m = 0; m < scene->mNumMaterials; ++m) {
+		const aiMaterial* source = scene->mMaterials[m];
+		MaterialData material;
+		aiString text;
+		if (source->Get(AI_MATKEY_NAME, text) == AI_SUCCESS) material.name = text.C_Str();
+		aiColor4D color;
+		if (source->Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS) {
+			material.base_color = glm::vec4(color.r, color.g, color.b, color.a);
+		}
+		if (source->GetTexture(aiTextureType_DIFFUSE, 0, &text) == AI_SUCCESS) {
+			material.texture = text.C_Str();
+		}
+		asset.materials.push_back(std::move(material));
+	}
+
+	for (unsigned m = 0; m < scene->mNumMeshes; ++m) {
+		const aiMesh* source = scene->mMeshes[m];
+		if (!(source->mPrimitiveTypes & aiPrimitiveType_TRIANGLE)) continue;
+
+		MeshData mesh;
+		mesh.material = source->mMaterialIndex;
+		mesh.vertices.resize(source->mNumVertices);
+		for (unsigned v = 0; v < source->mNumVertices; ++v) {
+			Vertex& vertex = mesh.vertices[v];
+			const aiVector3D& p = source->mVertices[v];
+			vertex.position     = glm::vec3(p.x, p.y, p.z);
+			if (source->HasNormals()) {
+				const aiVector3D& n = source->mNormals[v];
+				vertex.normal       = glm::vec3(n.x, n.y, n.z);
+			} else {
+				vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			}
+			if (source->HasTextureCoords(0)) {
+				const aiVector3D& uv = source->mTextureCoords[0][v];
+				vertex.uv            = glm::vec2(uv.x, uv.y);
+			} else {
+				vertex.uv = glm::vec2(0.0f);
+			}
+		}
+
+		mesh.indices.reserve(size_t(source->mNumFaces) * 3);
+		for (unsigned f = 0; f < source->mNumFaces; ++f) {
+			const aiFace& face = source->mFaces[f];
+			if (face.mNumIndices != 3) continue;
+			mesh.indices.insert(mesh.indices.end(), face.mIndices, face.mIndices + 3);
+		}
+		if (mesh.indices.empty()) continue;
+		MeshOptimizationStats stats = OptimizeMesh(mesh);
+		asset.cache_before.Add(stats.before);
+		asset.cache_after.Add(stats.after);
+		BuildLods(mesh);
+		// Built over the optimized order, so each meshlet is a tight patch of the surface.
+		mesh.meshlets = BuildMeshlets(mesh);
+		asset.meshes.push_back(std::move(mesh));
+	}
+
+	if (asset.meshes.empty()) asset.error = "No triangle meshes in " + path;
+	asset.load_ms =
+	    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return asset;
+}
@@ -0,0 +1,197 @@
+#include "bindless.h"
+
+vk::PhysicalDeviceDescriptorIndexingFeaturesEXT BindlessHeap::RequiredFeatures() {
+	vk::PhysicalDeviceDescriptorIndexingFeaturesEXT features;
+	features.descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE;
+	features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	features.descriptorBindingUpdateUnusedWhilePending     = VK_TRUE;
+	features.descriptorBindingPartiallyBound               = VK_TRUE;
+	features.runtimeDescriptorArray                        = VK_TRUE;
+	features.shaderSampledImageArrayNonUniformIndexing     = VK_TRUE;
+	return features;
+}
+
+bool BindlessHeap::Supported(const vk::PhysicalDeviceDescriptorIndexingFeaturesEXT& features) {
+	return features.descriptorBindingSampledImageUpdateAfterBind &&
+	       features.descriptorBindingStorageBufferUpdateAfterBind &&
+	       features.descriptorBindingUpdateUnusedWhilePending &&
+	       features.descriptorBindingPartiallyBound && features.runtimeDescriptorArray &&
+	       features.shaderSampledImageArrayNonUniformIndexing;
+}
+
+BindlessHeap::BindlessHeap(vk::PhysicalDevice physical_device, vk::Device device)
+    : device_(device) {
+	using IndexingProperties = vk::PhysicalDeviceDescriptorIndexingPropertiesEXT;
+	auto properties =
+	    physical_device.getProperties2<vk::PhysicalDeviceProperties2, IndexingProperties>();
+	const IndexingProperties& limits = properties.get<IndexingProperties>();
+
+	Slots& images     = slots_[uint32_t(Kind::eSampledImage)];
+	Slots& samplers   = slots_[uint32_t(Kind::eSampler)];
+	Slots& buffers    = slots_[uint32_t(Kind::eStorageBuffer)];
+	images.capacity   = std::min({kMaxSampledImages,
+	                              limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+	                              limits.maxDescriptorSetUpdateAfterBindSampledImages});
+	samplers.capacity = std::min({kMaxSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+	                              limits.maxDescriptorSetUpdateAfterBindSamplers});
+	buffers.capacity  = std::min({kMaxStorageBuffers,
+	                              limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+	                              limits.maxDescriptorSetUpdateAfterBindStorageBuffers});
+	// The per-stage total is shared by all three arrays; images give way first.
+	uint32_t total = limits.maxPerStageUpdateAfterBindResources;
+	if (images.capacity + samplers.capacity + buffers.capacity > total) {
+		images.capacity = total - std::min(total, samplers.capacity + buffers.capacity);
+	}
+
+	const vk::DescriptorType types[kKindCount] = {vk::DescriptorType::eSampledImage,
+	                                              vk::DescriptorType::eSampler,
+	                                              vk::DescriptorType::eStorageBuffer};
+	std::array<vk::DescriptorSetLayoutBinding, kKindCount> bindings;
+	std::array<vk::DescriptorBindingFlagsEXT, kKindCount> binding_flags;
+	std::array<vk::DescriptorPoolSize, kKindCount> pool_sizes;
+	for (uint32_t i = 0; i < kKindCount; ++i) {
+		bindings[i] = vk::DescriptorSetLayoutBinding(i, types[i], slots_[i].capacity,
+		                                             vk::ShaderStageFlagBits::eAll);
+		binding_flags[i] = vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind |
+		                   vk::DescriptorBindingFlagBitsEXT::eUpdateUnusedWhilePending |
+		                   vk::DescriptorBindingFlagBitsEXT::ePartiallyBound;
+		pool_sizes[i] = vk::DescriptorPoolSize(types[i], slots_[i].capacity);
+	}
+
+	vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info(uint32_t(binding_flags.size()),
+	                                                            binding_flags.data());
+	layout_ = device_.createDescriptorSetLayout(
+	    vk::DescriptorSetLayoutCreateInfo()
+	        .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT)
+	        .setBindingCount(uint32_t(bindings.size()))
+	        .setPBindings(bindings.data())
+	        .setPNext(&flags_info));
+
+	pool_ = device_.createDescriptorPool(
+	    vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT, 1,
+	                                 uint32_t(pool_sizes.size()), pool_sizes.data()));
+	set_ = device_.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(pool_, 1, &layout_))[0];
+}
+
+BindlessHeap::~BindlessHeap() {
+	device_.destroyDescriptorPool(pool_);
+	device_.destroyDescriptorSetLayout(layout_);
+}
+
+uint32_t BindlessHeap::AddImage(vk::ImageView view, vk::ImageLayout layout) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint32_t index = Allocate(Kind::eSampledImage);
+	WriteImage(index, view, layout);
+	return index;
+}
+
+uint32_t BindlessHeap::ReserveImage() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint32_t index = Allocate(Kind::eSampledImage);
+	reserved_images_.insert(index);
+	return index;
+}
+
+void BindlessHeap::SetImage(uint32_t index, vk::ImageView view, vk::ImageLayout layout) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!reserved_images_.erase(index)) {
+		throw std::runtime_error("Bindless image slot " + std::to_string(index) +
+		                         " is not reserved or has been written already");
+	}
+	WriteImage(index, view, layout);
+}
+
+uint32_t BindlessHeap::AddSampler(vk::Sampler sampler) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint32_t index = Allocate(Kind::eSampler);
+	vk::DescriptorImageInfo info(sampler, nullptr, vk::ImageLayout::eUndefined);
+	device_.updateDescriptorSets(
+	    vk::WriteDescriptorSet(set_, uint32_t(Kind::eSampler), index, 1,
+	                           vk::DescriptorType::eSampler, &info),
+	    nullptr);
+	return index;
+}
+
+uint32_t BindlessHeap::AddBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint32_t index = Allocate(Kind::eStorageBuffer);
+	vk::DescriptorBufferInfo info(buffer, offset, range);
+	device_.updateDescriptorSets(vk::WriteDescriptorSet(set_, uint32_t(Kind::eStorageBuffer), index,
+	                                                    1, vk::DescriptorType::eStorageBuffer,
+	                                                    nullptr, &info),
+	                             nullptr);
+	return index;
+}
+
+void BindlessHeap::Remove(Kind kind, uint32_t index) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (kind == Kind::eSampledImage) reserved_images_.erase(index);
+	retired_.push_back({kind, index, frame_});
+}
+
+void BindlessHeap::BeginFrame(uint64_t frame, uint64_t first_pending) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	frame_ = frame;
+	while (!retired_.empty() && retired_.front().frame < first_pending) {
+		slots_[uint32_t(retired_.front().kind)].free.push_back(retired_.front().index);
+		retired_.pop_front();
+	}
+}
+
+uint32_t BindlessHeap::Used(Kind kind) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	const Slots& slots = slots_[uint32_t(kind)];
+	auto retired       = std::count_if(retired_.begin(), retired_.end(),
+	                                   [kind](const Retired& entry) { return entry.kind == kind; });
+	return slots.next - uint32_t(slots.free.size()) - uint32_t(retired);
+}
+
+void BindlessHeap::Bind(vk::CommandBuffer cmd, vk::PipelineBindPoint bind_point,
+                        vk::PipelineLayout pipeline_layout) const {
+	cmd.bindDescriptorSets(bind_point, pipeline_layout, 0, set_, nullptr);
+}
+
+uint32_t BindlessHeap::Allocate(Kind kind) {
+	Slots& slots = slots_[uint32_t(kind)];
+	if (!slots.free.empty()) {
+		uint32_t index = slots.free.back();
+		slots.free.pop_back();
+		return index;
+	}
+	if (slots.next == slots.capacity) throw std::runtime_error("Bindless descriptor heap is full");
+	return slots.next++;
+}
+
+void BindlessHeap::WriteImage(uint32_t index, vk::ImageView view, vk::ImageLayout layout) {
+	vk::DescriptorImageInfo info(nullptr, view, layout);
+	device_.updateDescriptorSets(
+	    vk::WriteDescriptorSet(set_, uint32_t(Kind::eSampledImage), index, 1,
+	                           vk::DescriptorType::eSampledImage, &info),
+	    nullptr);
+}
+
+BindlessBuffer CreateBindlessBuffer(vk::Device device, MemoryAllocator& allocator,
+                                    BindlessHeap& bindless, vk::DeviceSize size,
+                                    vk::BufferUsageFlags usage,
+                                    vk::MemoryPropertyFlags properties) {
+	BindlessBuffer buffer;
+	buffer.buffer = device.createBuffer(vk::BufferCreateInfo()
+	                                        .setSize(size)
+	                                        .setUsage(usage)
+	                                        .setSharingMode(vk::SharingMode::eExclusive));
+	buffer.memory = allocator.AllocateBuffer(buffer.buffer, properties);
+	buffer.size   = size;
+	if (usage & vk::BufferUsageFlagBits::eStorageBuffer) {
+		buffer.index = bindless.AddBuffer(buffer.buffer);
+	}
+	return buffer;
+}
+
+void ReleaseBindlessBuffer(vk::Device device, MemoryAllocator& allocator, BindlessHeap& bindless,
+                           BindlessBuffer& buffer) {
+	if (!buffer.buffer) return;
+	if (buffer.index) bindless.Remove(BindlessHeap::Kind::eStorageBuffer, *buffer.index);
+	device.destroyBuffer(buffer.buffer);
+	allocator.Free(buffer.memory);
+	buffer = BindlessBuffer();
+}
@@ -0,0 +1,168 @@
+#include "depth_pyramid.h"
+
+#include "shader.h"
+
+namespace {
+
+uint32_t PreviousPowerOfTwo(uint32_t value) {
+	uint32_t result = 1;
+	while (result * 2 <= value) result *= 2;
+	return result;
+}
+
+}  // namespace
+
+DepthPyramid::DepthPyramid(vk::Device device, MemoryAllocator& allocator, BindlessHeap& bindless,
+                           vk::PipelineCache cache, vk::ImageView depth_view,
+                           vk::Extent2D depth_extent)
+    : device_(device), allocator_(allocator), bindless_(bindless) {
+	sampler_ = device_.createSampler(vk::SamplerCreateInfo()
+	                                     .setMagFilter(vk::Filter::eNearest)
+	                                     .setMinFilter(vk::Filter::eNearest)
+	                                     .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+	                                     .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+	                                     .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+	                                     .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+	                                     .setMaxLod(VK_LOD_CLAMP_NONE));
+	sampler_index_ = bindless_.AddSampler(sampler_);
+
+	std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
+	    vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1,
+	                                   vk::ShaderStageFlagBits::eCompute, &sampler_),
+	    vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1,
+	                                   vk::ShaderStageFlagBits::eCompute)};
+	set_layout_ = device_.createDescriptorSetLayout(
+	    vk::DescriptorSetLayoutCreateInfo(vk::DescriptorSetLayoutCreateFlags(),
+	                                      uint32_t(bindings.size()), bindings.data()));
+	pipeline_layout_ = device_.createPipelineLayout(
+	    vk::PipelineLayoutCreateInfo().setSetLayoutCount(1).setPSetLayouts(&set_layout_));
+
+	Shader shader(device_, ENGINE_SHADER_DIR "depth_pyramid.spv");
+	auto pipeline = device_.createComputePipeline(
+	    cache, vk::ComputePipelineCreateInfo(
+	               vk::PipelineCreateFlags(),
+	               vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(),
+	                                                 vk::ShaderStageFlagBits::eCompute,
+	                                                 shader.Module(), "main"),
+	               pipeline_layout_));
+	if (pipeline.result != vk::Result::eSuccess) {
+		throw std::runtime_error("Failed to create the depth pyramid pipeline");
+	}
+	pipeline_ = pipeline.value;
+
+	CreateImage(depth_view, depth_extent);
+}
+
+DepthPyramid::~DepthPyramid() {
+	DestroyImage();
+	bindless_.Remove(BindlessHeap::Kind::eSampler, sampler_index_);
+	device_.destroyPipeline(pipeline_);
+	device_.destroyPipelineLayout(pipeline_layout_);
+	device_.destroyDescriptorSetLayout(set_layout_);
+	device_.destroySampler(sampler_);
+}
+
+void DepthPyramid::Resize(vk::ImageView depth_view, vk::Extent2D depth_extent) {
+	DestroyImage();
+	CreateImage(depth_view, depth_extent);
+}
+
+void DepthPyramid::Record(vk::CommandBuffer cmd) const {
+	// Every texel is rewritten, so the previous contents are discarded. Waiting on compute
+	// covers the culling pass that read them.
+	vk::ImageSubresourceRange all_levels(vk::ImageAspectFlagBits::eColor, 0, LevelCount(), 0, 1);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+	                    vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), nullptr,
+	                    nullptr,
+	                    vk::ImageMemoryBarrier(vk::AccessFlags(), vk::AccessFlagBits::eShaderWrite,
+	                                           vk::ImageLayout::eUndefined,
+	                                           vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED,
+	                                           VK_QUEUE_FAMILY_IGNORED, image_, all_levels));
+
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_);
+	for (const Level& level : levels_) {
+		cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout_, 0, level.set,
+		                       nullptr);
+		cmd.dispatch((level.extent.width + kGroupSize - 1) / kGroupSize,
+		             (level.extent.height + kGroupSize - 1) / kGroupSize, 1);
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+		                    vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(),
+		                    vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite,
+		                                      vk::AccessFlagBits::eShaderRead),
+		                    nullptr, nullptr);
+	}
+}
+
+void DepthPyramid::CreateImage(vk::ImageView depth_view, vk::Extent2D depth_extent) {
+	size_ = vk::Extent2D(PreviousPowerOfTwo(depth_extent.width),
+	                     PreviousPowerOfTwo(depth_extent.height));
+	uint32_t level_count = 1;
+	while ((std::max(size_.width, size_.height) >> level_count) > 0) ++level_count;
+
+	image_  = device_.createImage(
+	    vk::ImageCreateInfo()
+	        .setImageType(vk::ImageType::e2D)
+	        .setFormat(vk::Format::eR32Sfloat)
+	        .setExtent(vk::Extent3D(size_.width, size_.height, 1))
+	        .setMipLevels(level_count)
+	        .setArrayLayers(1)
+	        .setSamples(vk::SampleCountFlagBits::e1)
+	        .setTiling(vk::ImageTiling::eOptimal)
+	        .setUsage(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage)
+	        .setSharingMode(vk::SharingMode::eExclusive)
+	        .setInitialLayout(vk::ImageLayout::eUndefined));
+	memory_ = allocator_.AllocateImage(image_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	auto create_view = [&](uint32_t base_level, uint32_t count) {
+		return device_.createImageView(
+		    vk::ImageViewCreateInfo()
+		        .setImage(image_)
+		        .setViewType(vk::ImageViewType::e2D)
+		        .setFormat(vk::Format::eR32Sfloat)
+		        .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor,
+		                                                       base_level, count, 0, 1)));
+	};
+	view_ = create_view(0, level_count);
+	texture_ = bindless_.AddImage(view_, vk::ImageLayout::eGeneral);
+
+	vk::DescriptorPoolSize pool_sizes[] = {
+	    vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, level_count),
+	    vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, level_count)};
+	descriptor_pool_ = device_.createDescriptorPool(vk::DescriptorPoolCreateInfo(
+	    vk::DescriptorPoolCreateFlags(), level_count, 2, pool_sizes));
+	std::vector<vk::DescriptorSetLayout> layouts(level_count, set_layout_);
+	std::vector<vk::DescriptorSet> sets = device_.allocateDescriptorSets(
+	    vk::DescriptorSetAllocateInfo(descriptor_pool_, level_count, layouts.data()));
+
+	levels_.resize(level_count);
+	for (uint32_t i = 0; i < level_count; ++i) {
+		Level& level = levels_[i];
+		level.view   = create_view(i, 1);
+		level.extent =
+		    vk::Extent2D(std::max(size_.width >> i, 1u), std::max(size_.height >> i, 1u));
+		level.set    = sets[i];
+
+		vk::DescriptorImageInfo source =
+		    i == 0 ? vk::DescriptorImageInfo(nullptr, depth_view,
+		                                     vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+		           : vk::DescriptorImageInfo(nullptr, levels_[i - 1].view,
+		                                     vk::ImageLayout::eGeneral);
+		vk::DescriptorImageInfo destination(nullptr, level.view, vk::ImageLayout::eGeneral);
+		std::array<vk::WriteDescriptorSet, 2> writes = {
+		    vk::WriteDescriptorSet(level.set, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler,
+		                           &source),
+		    vk::WriteDescriptorSet(level.set, 1, 0, 1, vk::DescriptorType::eStorageImage,
+		                           &destination)};
+		device_.updateDescriptorSets(writes, nullptr);
+	}
+}
+
+void DepthPyramid::DestroyImage() {
+	bindless_.Remove(BindlessHeap::Kind::eSampledImage, texture_);
+	for (Level& level : levels_) device_.destroyImageView(level.view);
+	levels_.clear();
+	if (descriptor_pool_) device_.destroyDescriptorPool(descriptor_pool_);
+	device_.destroyImageView(view_);
+	device_.destroyImage(image_);
+	allocator_.Free(memory_);
+}
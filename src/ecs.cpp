@@ -0,0 +1,213 @@
+#include "ecs.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace {
+
+std::mutex component_mutex;
+std::vector<ComponentInfo>& ComponentInfos() {
+	static std::vector<ComponentInfo> infos;
+	return infos;
+}
+
+uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+uint32_t RegisterComponent(uint32_t size, uint32_t alignment) {
+	std::lock_guard<std::mutex> lock(component_mutex);
+	std::vector<ComponentInfo>& infos = ComponentInfos();
+	if (infos.size() == kMaxComponentTypes) throw std::runtime_error("Too many component types");
+	infos.push_back({size, alignment});
+	return uint32_t(infos.size() - 1);
+}
+
+ComponentInfo GetComponentInfo(uint32_t id) {
+	std::lock_guard<std::mutex> lock(component_mutex);
+	return ComponentInfos()[id];
+}
+
+Archetype::Archetype(ComponentMask mask) : mask_(mask) {
+	uint32_t row_bytes = sizeof(Entity);
+	std::vector<ComponentInfo> infos;
+	for (uint32_t id = 0; id < kMaxComponentTypes; ++id) {
+		if (!(mask & (ComponentMask(1) << id))) continue;
+		components_.push_back(id);
+		infos.push_back(GetComponentInfo(id));
+		row_bytes += infos.back().size;
+	}
+
+	// Start from what fits without padding and shrink until the aligned arrays fit too.
+	auto layout = [&](uint32_t capacity) {
+		uint32_t offset = capacity * uint32_t(sizeof(Entity));
+		for (size_t i = 0; i < components_.size(); ++i) {
+			offset                   = AlignUp(offset, infos[i].alignment);
+			offsets_[components_[i]] = offset;
+			offset += capacity * infos[i].size;
+		}
+		return offset;
+	};
+	capacity_ = uint32_t(kChunkBytes / row_bytes);
+	while (capacity_ > 0 && layout(capacity_) > kChunkBytes) --capacity_;
+	if (capacity_ == 0) throw std::runtime_error("Components too large for an archetype chunk");
+}
+
+void Archetype::Append(Entity entity, uint32_t& chunk, uint32_t& row) {
+	if (chunks_.empty() || chunks_.back().count == capacity_) {
+		chunks_.emplace_back();
+		chunks_.back().data = std::make_unique<ChunkData>();
+	}
+	chunk = uint32_t(chunks_.size() - 1);
+	row   = chunks_.back().count++;
+	Entities(chunk)[row] = entity;
+	++count_;
+}
+
+Entity Archetype::Remove(uint32_t chunk, uint32_t row) {
+	uint32_t last_chunk = uint32_t(chunks_.size() - 1);
+	uint32_t last_row   = chunks_.back().count - 1;
+	Entity moved;
+	if (chunk != last_chunk || row != last_row) {
+		moved                = Entities(last_chunk)[last_row];
+		Entities(chunk)[row] = moved;
+		for (uint32_t id : components_) {
+			uint32_t size = GetComponentInfo(id).size;
+			std::memcpy(static_cast<std::byte*>(Column(chunk, id)) + size_t(row) * size,
+			            static_cast<std::byte*>(Column(last_chunk, id)) + size_t(last_row) * size,
+			            size);
+		}
+	}
+	if (--chunks_.back().count == 0) chunks_.pop_back();
+	--count_;
+	return moved;
+}
+
+void Registry::Destroy(Entity entity) {
+	const Record& record = Find(entity);
+	RemoveRow(record);
+	Record& slot    = records_[entity.index];
+	slot.archetype  = nullptr;
+	++slot.generation;
+	free_.push_back(entity.index);
+	++structure_version_;
+}
+
+bool Registry::Alive(Entity entity) const {
+	return entity.index < records_.size() && records_[entity.index].archetype &&
+	       records_[entity.index].generation == entity.generation;
+}
+
+const Registry::Record& Registry::Find(Entity entity) const {
+	if (!Alive(entity)) throw std::runtime_error("Stale or invalid entity");
+	return records_[entity.index];
+}
+
+Archetype& Registry::GetArchetype(ComponentMask mask) {
+	auto found = archetype_by_mask_.find(mask);
+	if (found != archetype_by_mask_.end()) return *found->second;
+	archetypes_.push_back(std::make_unique<Archetype>(mask));
+	archetype_by_mask_.emplace(mask, archetypes_.back().get());
+	return *archetypes_.back();
+}
+
+Entity Registry::Allocate(Archetype& archetype) {
+	uint32_t index;
+	if (!free_.empty()) {
+		index = free_.back();
+		free_.pop_back();
+	} else {
+		index = uint32_t(records_.size());
+		records_.emplace_back();
+	}
+	Record& record = records_[index];
+	Entity entity{index, record.generation};
+	record.archetype = &archetype;
+	archetype.Append(entity, record.chunk, record.row);
+	++structure_version_;
+	return entity;
+}
+
+void Registry::Move(Entity entity, Archetype& archetype) {
+	Record old = Find(entity);
+	Record& record = records_[entity.index];
+	record.archetype = &archetype;
+	archetype.Append(entity, record.chunk, record.row);
+
+	ComponentMask shared = old.archetype->Mask() & archetype.Mask();
+	for (uint32_t id = 0; id < kMaxComponentTypes; ++id) {
+		if (!(shared & (ComponentMask(1) << id))) continue;
+		uint32_t size = GetComponentInfo(id).size;
+		std::memcpy(static_cast<std::byte*>(archetype.Column(record.chunk, id)) +
+		                size_t(record.row) * size,
+		            static_cast<std::byte*>(old.archetype->Column(old.chunk, id)) +
+		                size_t(old.row) * size,
+		            size);
+	}
+	RemoveRow(old);
+	++structure_version_;
+}
+
+void Registry::RemoveRow(const Record& record) {
+	Entity moved = record.archetype->Remove(record.chunk, record.row);
+	if (moved) {
+		records_[moved.index].chunk = record.chunk;
+		records_[moved.index].row   = record.row;
+	}
+}
+
+std::vector<Registry::ChunkRef> Registry::MatchingChunks(ComponentMask mask) const {
+	std::vector<ChunkRef> chunks;
+	for (const std::unique_ptr<Archetype>& archetype : archetypes_) {
+		if ((archetype->Mask() & mask) != mask) continue;
+		for (size_t chunk = 0; chunk < archetype->ChunkCount(); ++chunk) {
+			chunks.push_back({archetype.get(), uint32_t(chunk)});
+		}
+	}
+	return chunks;
+}
+
+void SystemSchedule::Add(const char* name, ComponentMask reads, ComponentMask writes,
+                         System system) {
+	uint32_t index = uint32_t(systems_.size());
+	systems_.push_back({name, reads, writes, std::move(system)});
+
+	auto conflicts = [&](uint32_t other) {
+		const Entry& a = systems_[index];
+		const Entry& b = systems_[other];
+		return (a.writes & (b.reads | b.writes)) || (b.writes & a.reads);
+	};
+	// Only the last phase can take it: joining an earlier one would reorder it past systems it
+	// may depend on.
+	if (!phases_.empty() &&
+	    std::none_of(phases_.back().begin(), phases_.back().end(), conflicts)) {
+		phases_.back().push_back(index);
+	} else {
+		phases_.push_back({index});
+	}
+}
+
+void SystemSchedule::Run(Registry& registry, JobSystem& jobs) {
+	for (const std::vector<uint32_t>& phase : phases_) {
+		JobCounter counter;
+		for (size_t i = 1; i < phase.size(); ++i) {
+			const System& system = systems_[phase[i]].system;
+			jobs.Schedule([&registry, &jobs, &system] { system(registry, &jobs); }, &counter);
+		}
+		// The first system runs here; waiting then helps with the rest.
+		std::exception_ptr error;
+		try {
+			systems_[phase[0]].system(registry, &jobs);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		try {
+			jobs.Wait(counter);
+		} catch (...) {
+			if (!error) error = std::current_exception();
+		}
+		if (error) std::rethrow_exception(error);
+	}
+}
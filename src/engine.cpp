@@ -1 +1,1506 @@
-#include "engine.h"
\ No newline at end of file
+#include "engine.h"
+#include "gltf_file.h"
+#include "mesh_file.h"
+
+#include "vulkan_loader.h"
+
+#include <chrono>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+// Descriptor indexing backs the bindless heap. It is core in Vulkan 1.2 but the engine targets
+// 1.1, so it is enabled as an extension.
+std::vector<const char*> DeviceExtensions(bool headless) {
+	std::vector<const char*> extensions = {VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME};
+	if (!headless) extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	return extensions;
+}
+
+bool HasDeviceExtension(vk::PhysicalDevice device, const char* name) {
+	for (const auto& extension : device.enumerateDeviceExtensionProperties()) {
+		if (std::string(extension.extensionName) == name) return true;
+	}
+	return false;
+}
+
+// Waits without a timeout, so anything but eSuccess means the wait didn't happen.
+void WaitForFence(vk::Device device, vk::Fence fence) {
+	if (device.waitForFences(fence, VK_TRUE, std::numeric_limits<uint64_t>::max()) !=
+	    vk::Result::eSuccess) {
+		throw std::runtime_error("Failed to wait for a frame fence");
+	}
+}
+
+vk::Pipeline CreateGraphicsPipeline(vk::Device device, vk::PipelineCache cache,
+                                    const vk::GraphicsPipelineCreateInfo& info) {
+	auto pipeline = device.createGraphicsPipeline(cache, info);
+	if (pipeline.result != vk::Result::eSuccess) {
+		throw std::runtime_error("Failed to create graphics pipeline");
+	}
+	return pipeline.value;
+}
+
+void FramebufferResizeCallback(GLFWwindow* window, int, int) {
+	auto flag = reinterpret_cast<bool*>(glfwGetWindowUserPointer(window));
+	*flag     = true;
+}
+
+#ifdef DEV_MODE
+// Newest first; older SDKs only ship the LunarG meta layer.
+const char* const kValidationLayers[] = {"VK_LAYER_KHRONOS_validation",
+                                         "VK_LAYER_LUNARG_standard_validation"};
+
+VKAPI_ATTR VkBool32 VKAPI_CALL DebugMessengerCallback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT,
+    const VkDebugUtilsMessengerCallbackDataEXT* data, void*) {
+	bool error = severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+	std::cerr << "validation " << (error ? "error" : "warning") << ": " << data->pMessage
+	          << std::endl;
+	return VK_FALSE;
+}
+
+// Validation is on by default in dev builds; ENGINE_VALIDATION=0 turns it off for a run.
+bool ValidationRequested() {
+	const char* value = std::getenv("ENGINE_VALIDATION");
+	return !value || std::string(value) != "0";
+}
+#endif
+
+}  // namespace
+
+Engine::Engine(const EngineConfig& config) : config_(config) {
+	if (config_.headless && config_.frame_count == 0) config_.frame_count = 1;
+	config_.frames_in_flight = std::clamp(config_.frames_in_flight, 1u, kMaxFramesInFlight);
+	jobs_                    = std::make_unique<JobSystem>(config_.worker_threads);
+
+	if (!config_.headless) InitWindow();
+	CreateInstance();
+	PickPhysicalDevice();
+	CreateDevice();
+	if (config_.headless) {
+		CreateOffscreenTargets();
+	} else {
+		CreateSwapchain();
+	}
+	CreateDepthTarget();
+	CreateRenderPass();
+	CreatePipeline();
+	CreateFramebuffers();
+	CreateCommandResources();
+	CreateFrameResources();
+	CreateDefaultTextures();
+}
+
+Engine::~Engine() {
+	if (device_) {
+		device_.waitIdle();
+
+		for (FrameData& frame : frames_) {
+			if (frame.timestamps) device_.destroyQueryPool(frame.timestamps);
+			device_.destroySemaphore(frame.render_finished);
+			device_.destroySemaphore(frame.image_available);
+			device_.destroyFence(frame.in_flight);
+			device_.destroyCommandPool(frame.command_pool);
+			for (WorkerCommands& commands : frame.worker_commands) {
+				device_.destroyCommandPool(commands.pool);
+			}
+		}
+		device_.destroyCommandPool(command_pool_);
+
+		// Waits for the files being parsed before the job system goes away.
+		asset_loader_.reset();
+		texture_streamer_.reset();
+		virtual_texturing_.reset();
+		jobs_.reset();
+		instances_.clear();
+		models_.clear();
+		uploader_.reset();
+		gpu_scene_.reset();
+		depth_pyramid_.reset();
+		for (Texture& texture : textures_) {
+			device_.destroyImageView(texture.view);
+			device_.destroyImage(texture.image);
+			allocator_->Free(texture.memory);
+		}
+		textures_.clear();
+		device_.destroySampler(default_sampler_);
+
+		DestroyTargets();
+		device_.destroyPipeline(pipeline_);
+		if (indirect_pipeline_) device_.destroyPipeline(indirect_pipeline_);
+		device_.destroyPipelineLayout(pipeline_layout_);
+		device_.destroyRenderPass(render_pass_);
+		bindless_.reset();
+		pipeline_cache_.reset();
+		allocator_.reset();
+		device_.destroy();
+	}
+
+	if (instance_) {
+#ifdef DEV_MODE
+		if (debug_messenger_) {
+			instance_.destroyDebugUtilsMessengerEXT(debug_messenger_);
+		}
+#endif
+		if (surface_) instance_.destroySurfaceKHR(surface_);
+		instance_.destroy();
+	}
+
+	if (window_) {
+		glfwDestroyWindow(window_);
+		glfwTerminate();
+	}
+}
+
+void Engine::Run() {
+	auto start = std::chrono::steady_clock::now();
+
+	while (config_.frame_count == 0 || frame_number_ < config_.frame_count) {
+		if (window_) {
+			if (glfwWindowShouldClose(window_)) break;
+			glfwPollEvents();
+		}
+		RenderFrame();
+	}
+	WaitIdle();
+
+	if (config_.headless) {
+		std::chrono::duration<double, std::milli> elapsed =
+		    std::chrono::steady_clock::now() - start;
+		std::cout << "Rendered " << frame_number_ << " frames in " << elapsed.count() << " ms ("
+		          << frame_number_ * 1000.0 / elapsed.count() << " fps)" << std::endl;
+
+		if (!config_.readback_path.empty()) SaveFrame(config_.readback_path);
+	}
+}
+
+void Engine::RenderFrame() {
+	using Clock = std::chrono::steady_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) {
+		return std::chrono::duration<double, std::milli>(b - a).count();
+	};
+
+	FrameTiming timing;
+	Clock::time_point frame_start = Clock::now();
+
+	// Only wait for the frame that last used this slot; the other slots keep the GPU busy while
+	// this one is recorded.
+	FrameData& frame = frames_[frame_number_ % frames_.size()];
+	WaitForFence(device_, frame.in_flight);
+	ResolveGpuTiming(frame);
+	// Frames complete in order, so everything up to this slot's previous frame is done.
+	uint64_t completed = frame_number_ >= frames_.size() ? frame_number_ - frames_.size() + 1 : 0;
+	bindless_->BeginFrame(frame_number_, completed);
+
+	uint32_t target_index;
+	if (config_.headless) {
+		target_index = static_cast<uint32_t>(frame_number_ % targets_.size());
+	} else {
+		try {
+			target_index =
+			    device_
+			        .acquireNextImageKHR(swapchain_, std::numeric_limits<uint64_t>::max(),
+			                             frame.image_available, nullptr)
+			        .value;
+		} catch (const vk::OutOfDateKHRError&) {
+			RecreateSwapchain();
+			return;
+		}
+
+		// The swapchain can hand out images in any order, so the image may still be in use by a
+		// different slot's frame.
+		vk::Fence& image_fence = images_in_flight_[target_index];
+		if (image_fence && image_fence != frame.in_flight) {
+			WaitForFence(device_, image_fence);
+		}
+		image_fence = frame.in_flight;
+	}
+	Clock::time_point update_start = Clock::now();
+	timing.wait_ms                 = ms(frame_start, update_start);
+
+	// Uploads queued since the last frame are submitted ahead of it on the graphics queue.
+	ProcessLoadedAssets();
+	uint32_t slot = uint32_t(frame_number_ % frames_.size());
+	if (texture_streamer_) {
+		texture_streamer_->Update(slot, kTextureUploadBudget);
+		texture_residency_ = texture_streamer_->ResidencyBuffer(slot);
+	}
+	UpdateTransforms();
+	CollectRenderables();
+	if (virtual_texturing_) {
+		virtual_texturing_->Prepare(slot, frame_number_);
+		virtual_texture_table_ = virtual_texturing_->TableBuffer(slot);
+	}
+	if (gpu_scene_) {
+		if (instances_changed_) {
+			gpu_scene_->SetInstances(instances_);
+		} else if (transforms_changed_) {
+			gpu_scene_->UpdateTransforms(instances_);
+		}
+		instances_changed_  = false;
+		transforms_changed_ = false;
+		gpu_scene_->Prepare(slot);
+	} else {
+		timing.cull_ms = CullInstances();
+		if (config_.frustum_culling) {
+			timing.objects_drawn          = double(visible_.size());
+			timing.objects_frustum_culled = double(instances_.size() - visible_.size());
+		}
+		if (config_.lod_threshold_pixels > 0.0f) {
+			timing.lod_triangles_saved = double(lod_triangles_saved_);
+		}
+	}
+	uploader_->Flush();
+
+	device_.resetFences(frame.in_flight);
+	device_.resetCommandPool(frame.command_pool, vk::CommandPoolResetFlags());
+	for (WorkerCommands& commands : frame.worker_commands) {
+		device_.resetCommandPool(commands.pool, vk::CommandPoolResetFlags());
+		commands.used = 0;
+	}
+	Clock::time_point record_start = Clock::now();
+	timing.update_ms               = ms(update_start, record_start);
+	RecordCommandBuffer(frame, targets_[target_index]);
+	timing.record_ms = ms(record_start, Clock::now());
+
+	vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	vk::SubmitInfo submit_info;
+	submit_info.setCommandBufferCount(1).setPCommandBuffers(&frame.command_buffer);
+	if (!config_.headless) {
+		submit_info.setWaitSemaphoreCount(1)
+		    .setPWaitSemaphores(&frame.image_available)
+		    .setPWaitDstStageMask(&wait_stage)
+		    .setSignalSemaphoreCount(1)
+		    .setPSignalSemaphores(&frame.render_finished);
+	}
+
+	// Earlier frames still executing when this one is submitted are the CPU/GPU overlap.
+	for (const FrameData& other : frames_) {
+		if (&other != &frame && device_.getFenceStatus(other.in_flight) == vk::Result::eNotReady) {
+			timing.queued_frames += 1.0;
+		}
+	}
+
+	Clock::time_point submit_start = Clock::now();
+	graphics_queue_.submit(submit_info, frame.in_flight);
+	Clock::time_point submit_end = Clock::now();
+	timing.submit_ms             = ms(submit_start, submit_end);
+
+	last_target_ = target_index;
+	++frame_number_;
+
+	if (!config_.headless) {
+		vk::PresentInfoKHR present_info;
+		present_info.setWaitSemaphoreCount(1)
+		    .setPWaitSemaphores(&frame.render_finished)
+		    .setSwapchainCount(1)
+		    .setPSwapchains(&swapchain_)
+		    .setPImageIndices(&target_index);
+
+		vk::Result result;
+		try {
+			result = graphics_queue_.presentKHR(present_info);
+		} catch (const vk::OutOfDateKHRError&) {
+			result = vk::Result::eErrorOutOfDateKHR;
+		}
+		timing.present_ms = ms(submit_end, Clock::now());
+
+		if (result != vk::Result::eSuccess || framebuffer_resized_) {
+			framebuffer_resized_ = false;
+			RecreateSwapchain();
+		}
+	}
+
+	timing.cpu_ms = ms(frame_start, Clock::now());
+	if (config_.collect_timings) {
+		frame.pending_timing = stats_.Count();
+		stats_.Add(timing);
+	}
+}
+
+Model* Engine::AddModel(const MeshData& mesh) {
+	models_.push_back(std::make_unique<Model>(device_, *allocator_, *uploader_, mesh));
+	return models_.back().get();
+}
+
+uint32_t Engine::AddTexture(uint32_t width, uint32_t height, const void* pixels) {
+	Texture texture;
+	texture.image  = device_.createImage(
+	    vk::ImageCreateInfo()
+	        .setImageType(vk::ImageType::e2D)
+	        .setFormat(vk::Format::eR8G8B8A8Unorm)
+	        .setExtent(vk::Extent3D(width, height, 1))
+	        .setMipLevels(1)
+	        .setArrayLayers(1)
+	        .setSamples(vk::SampleCountFlagBits::e1)
+	        .setTiling(vk::ImageTiling::eOptimal)
+	        .setUsage(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst)
+	        .setSharingMode(vk::SharingMode::eExclusive)
+	        .setInitialLayout(vk::ImageLayout::eUndefined));
+	texture.memory =
+	    allocator_->AllocateImage(texture.image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	vk::BufferImageCopy region;
+	region.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+	    .setImageExtent(vk::Extent3D(width, height, 1));
+	uploader_->UploadImage(texture.image, region, pixels, vk::DeviceSize(width) * height * 4, 4,
+	                       vk::ImageLayout::eShaderReadOnlyOptimal,
+	                       vk::PipelineStageFlagBits::eFragmentShader,
+	                       vk::AccessFlagBits::eShaderRead);
+
+	texture.view  = device_.createImageView(vk::ImageViewCreateInfo()
+	                                            .setImage(texture.image)
+	                                            .setViewType(vk::ImageViewType::e2D)
+	                                            .setFormat(vk::Format::eR8G8B8A8Unorm)
+	                                            .setSubresourceRange(vk::ImageSubresourceRange(
+	                                                vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
+	texture.index = bindless_->AddImage(texture.view);
+	textures_.push_back(texture);
+	return texture.index;
+}
+
+uint32_t Engine::LoadVirtualTexture(const std::string& path) {
+	if (!virtual_textures_supported_) {
+		throw std::runtime_error("Virtual textures need fragmentStoresAndAtomics: " + path);
+	}
+	if (!virtual_texturing_) {
+		virtual_texturing_ = std::make_unique<VirtualTexturing>(
+		    physical_device_, device_, *allocator_, *bindless_, *jobs_, config_.frames_in_flight,
+		    config_.virtual_texture_cache_pages, extent_);
+	}
+	return virtual_texturing_->Load(path);
+}
+
+uint32_t Engine::LoadTexture(const std::string& path) {
+	if (!texture_streamer_) {
+		texture_streamer_ =
+		    std::make_unique<TextureStreamer>(physical_device_, device_, *allocator_, *uploader_,
+		                                      *bindless_, *jobs_, config_.frames_in_flight,
+		                                      textures_[kWhiteTexture].index);
+	}
+	return texture_streamer_->Load(path);
+}
+
+Entity Engine::AddInstance(const Model* model, const glm::mat4& transform, uint32_t texture) {
+	return registry_.Create(MeshComponent{model}, MaterialComponent{texture},
+	                        TransformComponent{transform},
+	                        BoundsComponent{model->Bounds(), model->Extents()});
+}
+
+std::vector<Entity> Engine::LoadCookedModel(const std::string& path, const glm::mat4& transform) {
+	MeshFile file(path);
+	std::vector<Entity> entities;
+	for (uint32_t i = 0; i < file.MeshCount(); ++i) {
+		MeshFileView mesh = file.Mesh(i);
+		models_.push_back(std::make_unique<Model>(device_, *allocator_, *uploader_, mesh));
+		std::string texture;
+		if (mesh.mesh->material < file.MaterialCount()) {
+			const MeshFileMaterial& material = file.Material(mesh.mesh->material);
+			texture.assign(material.texture, strnlen(material.texture, sizeof(material.texture)));
+		}
+		entities.push_back(
+		    AddInstance(models_.back().get(), transform, MaterialTexture(path, texture)));
+	}
+	return entities;
+}
+
+std::vector<Entity> Engine::LoadGltf(const std::string& path, NodeHandle parent) {
+	GltfFile file(path);
+	std::vector<const Model*> models;
+	for (const MeshSource& primitive : file.Primitives()) {
+		models_.push_back(std::make_unique<Model>(device_, *allocator_, *uploader_, primitive));
+		models.push_back(models_.back().get());
+	}
+	std::vector<uint32_t> textures;
+	for (const MaterialData& material : file.Materials()) {
+		textures.push_back(MaterialTexture(path, material.texture));
+	}
+
+	// Parents come first, so their handles exist by the time their children are created.
+	std::vector<NodeHandle> nodes;
+	std::vector<Entity> entities;
+	for (const GltfNode& node : file.Nodes()) {
+		nodes.push_back(scene_.Create(node.parent < 0 ? parent : nodes[node.parent], node.local));
+		for (uint32_t primitive : node.primitives) {
+			const Model* model = models[primitive];
+			uint32_t material  = file.Primitives()[primitive].material;
+			uint32_t texture   = material < textures.size() ? textures[material] : kWhiteTexture;
+			// The transform is filled in from the node by the next scene graph update.
+			entities.push_back(registry_.Create(MeshComponent{model}, MaterialComponent{texture},
+			                                    TransformComponent{glm::mat4(1.0f)},
+			                                    BoundsComponent{model->Bounds(), model->Extents()},
+			                                    SceneNodeComponent{nodes.back()}));
+		}
+	}
+	return entities;
+}
+
+uint64_t Engine::LoadModelAsync(const std::string& path, const glm::mat4& transform) {
+	if (!asset_loader_) asset_loader_ = std::make_unique<AssetLoader>(*jobs_);
+	uint64_t id           = asset_loader_->Load(path);
+	asset_transforms_[id] = transform;
+	return id;
+}
+
+size_t Engine::PendingAssets() const { return asset_transforms_.size(); }
+
+void Engine::UpdateTransforms() {
+	scene_.Update(jobs_.get());
+	if (scene_.LastUpdateCount() == 0) return;
+
+	// Every node's entity is rewritten, which is a plain copy; frames that move nothing skip it.
+	registry_.ParallelForEachChunk<const SceneNodeComponent, TransformComponent>(
+	    jobs_.get(), [this](uint32_t count, const Entity*, const SceneNodeComponent* nodes,
+	                        TransformComponent* transforms) {
+		    for (uint32_t i = 0; i < count; ++i) transforms[i].world = scene_.World(nodes[i].node);
+	    });
+}
+
+void Engine::CollectRenderables() {
+	// Versions only grow, so their sum changes whenever one of them does.
+	uint64_t version = registry_.StructureVersion() + registry_.ChangeVersion<MeshComponent>() +
+	                   registry_.ChangeVersion<MaterialComponent>() +
+	                   registry_.ChangeVersion<BoundsComponent>();
+	uint64_t transforms_version = registry_.ChangeVersion<TransformComponent>();
+	if (version == instances_version_ && transforms_version == transforms_version_) return;
+
+	if (version == instances_version_) {
+		// The same entities in the same order, of which only the transforms are rewritten.
+		size_t next = 0;
+		auto move   = [this, &next](uint32_t count, const Entity*, const MeshComponent*,
+		                            const MaterialComponent*, const TransformComponent* transforms,
+		                            const BoundsComponent*) {
+			for (uint32_t i = 0; i < count; ++i) {
+				instances_[next++].transform = transforms[i].world;
+			}
+		};
+		registry_.ForEachChunk<const MeshComponent, const MaterialComponent,
+		                       const TransformComponent, const BoundsComponent>(move);
+		transforms_version_ = transforms_version;
+		transforms_changed_ = true;
+		return;
+	}
+
+	instances_.clear();
+	auto collect = [this](uint32_t count, const Entity*, const MeshComponent* meshes,
+	                      const MaterialComponent* materials, const TransformComponent* transforms,
+	                      const BoundsComponent* bounds) {
+		for (uint32_t i = 0; i < count; ++i) {
+			instances_.push_back({meshes[i].model, transforms[i].world, materials[i].texture,
+			                      bounds[i].sphere, bounds[i].extents});
+		}
+	};
+	// A read-only query, so it doesn't count as a change itself.
+	registry_.ForEachChunk<const MeshComponent, const MaterialComponent, const TransformComponent,
+	                       const BoundsComponent>(collect);
+	instances_version_  = version;
+	transforms_version_ = transforms_version;
+	instances_changed_  = true;
+}
+
+void Engine::ProcessLoadedAssets() {
+	if (!asset_loader_) return;
+
+	LoadedAsset asset;
+	while (asset_loader_->Poll(asset)) {
+		if (!asset.error.empty()) {
+			std::cerr << "Failed to load " << asset.path << ": " << asset.error << std::endl;
+			asset_transforms_.erase(asset.id);
+			continue;
+		}
+		loaded_assets_.push_back(std::move(asset));
+	}
+
+	vk::DeviceSize uploaded = 0;
+	while (!loaded_assets_.empty() && uploaded < kAssetUploadBudget) {
+		LoadedAsset& front = loaded_assets_.front();
+		const glm::mat4& transform = asset_transforms_[front.id];
+
+		while (!front.meshes.empty() && uploaded < kAssetUploadBudget) {
+			const MeshData& mesh = front.meshes.back();
+			uploaded +=
+			    mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(uint32_t);
+			std::string texture;
+			if (mesh.material < front.materials.size()) {
+				texture = front.materials[mesh.material].texture;
+			}
+			AddInstance(AddModel(mesh), transform, MaterialTexture(front.path, texture));
+			front.meshes.pop_back();
+		}
+
+		if (front.meshes.empty()) {
+			asset_transforms_.erase(front.id);
+			loaded_assets_.pop_front();
+		}
+	}
+}
+
+uint32_t Engine::MaterialTexture(const std::string& model_path, const std::string& texture) {
+	bool virtual_texture = IsVirtualTextureFile(texture) && virtual_textures_supported_;
+	if (!IsTextureFile(texture) && !virtual_texture) return kWhiteTexture;
+	size_t slash     = model_path.find_last_of("/\\");
+	std::string path = slash == std::string::npos ? texture
+	                                              : model_path.substr(0, slash + 1) + texture;
+	return virtual_texture ? LoadVirtualTexture(path) : LoadTexture(path);
+}
+
+void Engine::WaitIdle() {
+	device_.waitIdle();
+	for (FrameData& frame : frames_) ResolveGpuTiming(frame);
+}
+
+void Engine::ResolveGpuTiming(FrameData& frame) {
+	if (!frame.pending_timing) return;
+	size_t index = *frame.pending_timing;
+	frame.pending_timing.reset();
+
+	if (index >= stats_.Count()) return;
+	FrameTiming& timing = stats_.At(index);
+
+	if (gpu_scene_) {
+		if (auto cull = gpu_scene_->ReadStats(uint32_t(&frame - frames_.data()))) {
+			timing.objects_drawn            = cull->drawn;
+			timing.objects_frustum_culled   = cull->frustum_culled;
+			timing.objects_occlusion_culled = cull->occlusion_culled;
+			uint32_t clusters = cull->clusters_drawn + cull->clusters_frustum_culled +
+			                    cull->clusters_backface_culled + cull->clusters_occlusion_culled;
+			if (clusters > 0) {
+				timing.clusters_drawn            = cull->clusters_drawn;
+				timing.clusters_frustum_culled   = cull->clusters_frustum_culled;
+				timing.clusters_backface_culled  = cull->clusters_backface_culled;
+				timing.clusters_occlusion_culled = cull->clusters_occlusion_culled;
+			}
+			if (config_.lod_threshold_pixels > 0.0f) {
+				timing.lod_triangles_saved = double(cull->lod_triangles_saved);
+			}
+		}
+	}
+
+	if (!frame.timestamps) return;
+	std::array<uint64_t, 2> ticks;
+	vk::Result result = device_.getQueryPoolResults(
+	    frame.timestamps, 0, 2, sizeof(ticks), ticks.data(), sizeof(uint64_t),
+	    vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+	if (result != vk::Result::eSuccess) return;
+
+	uint64_t delta = (ticks[1] - ticks[0]) & timestamp_mask_;
+	timing.gpu_ms  = delta * timestamp_period_ns_ / 1e6;
+}
+
+void Engine::SaveFrame(const std::string& path) {
+	if (!config_.headless) throw std::runtime_error("SaveFrame is only supported in headless mode");
+	if (frame_number_ == 0) {
+		throw std::runtime_error("SaveFrame called before any frame was rendered");
+	}
+
+	device_.waitIdle();
+
+	vk::DeviceSize size = vk::DeviceSize(extent_.width) * extent_.height * 4;
+	vk::Buffer staging  = device_.createBuffer(vk::BufferCreateInfo()
+	                                              .setSize(size)
+	                                              .setUsage(vk::BufferUsageFlagBits::eTransferDst)
+	                                              .setSharingMode(vk::SharingMode::eExclusive));
+	Allocation memory   = allocator_->AllocateBuffer(
+	    staging,
+	    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+	// Targets are left in eTransferSrcOptimal by the render pass.
+	vk::CommandBuffer cmd = BeginOneTimeCommands();
+	vk::BufferImageCopy region;
+	region.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+	    .setImageExtent(vk::Extent3D(extent_.width, extent_.height, 1));
+	cmd.copyImageToBuffer(targets_[last_target_].image, vk::ImageLayout::eTransferSrcOptimal,
+	                      staging, region);
+	EndOneTimeCommands(cmd);
+
+	auto pixels = static_cast<const uint8_t*>(memory.mapped);
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		device_.destroyBuffer(staging);
+		allocator_->Free(memory);
+		throw std::runtime_error("Failed to open file: " + path);
+	}
+
+	file << "P6\n" << extent_.width << " " << extent_.height << "\n255\n";
+	bool swizzle = color_format_ == vk::Format::eB8G8R8A8Unorm;
+	for (uint32_t i = 0; i < extent_.width * extent_.height; ++i) {
+		const uint8_t* p = pixels + i * 4;
+		char rgb[3]      = {char(p[swizzle ? 2 : 0]), char(p[1]), char(p[swizzle ? 0 : 2])};
+		file.write(rgb, 3);
+	}
+
+	device_.destroyBuffer(staging);
+	allocator_->Free(memory);
+}
+
+void Engine::InitWindow() {
+	if (!glfwInit()) throw std::runtime_error("Failed to initialize GLFW");
+
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	window_ = glfwCreateWindow(config_.width, config_.height, config_.application_name.c_str(),
+	                           nullptr, nullptr);
+	if (!window_) throw std::runtime_error("Failed to create window");
+
+	glfwSetWindowUserPointer(window_, &framebuffer_resized_);
+	glfwSetFramebufferSizeCallback(window_, FramebufferResizeCallback);
+}
+
+void Engine::CreateInstance() {
+	vk::ApplicationInfo app_info(config_.application_name.c_str(), VK_MAKE_VERSION(1, 0, 0),
+	                             "vulkan-engine-test", VK_MAKE_VERSION(1, 0, 0),
+	                             VK_API_VERSION_1_1);
+
+	// Headless runs need no instance extensions at all, which keeps them working on ICDs and
+	// loaders built without any WSI support.
+	std::vector<const char*> extensions;
+	if (!config_.headless) {
+		uint32_t count     = 0;
+		const char** names = glfwGetRequiredInstanceExtensions(&count);
+		extensions.assign(names, names + count);
+	}
+
+	vulkan_loader::LoadGlobal();
+
+	vk::InstanceCreateInfo create_info;
+	std::vector<const char*> layers;
+#ifdef DEV_MODE
+	vk::DebugUtilsMessengerCreateInfoEXT messenger_info(
+	    vk::DebugUtilsMessengerCreateFlagsEXT(),
+	    vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning |
+	        vk::DebugUtilsMessageSeverityFlagBitsEXT::eError,
+	    vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral |
+	        vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation |
+	        vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance,
+	    DebugMessengerCallback);
+
+	if (ValidationRequested()) {
+		std::vector<vk::LayerProperties> available = vk::enumerateInstanceLayerProperties();
+		for (const char* name : kValidationLayers) {
+			auto found = std::find_if(available.begin(), available.end(),
+			                          [name](const vk::LayerProperties& layer) {
+				                          return std::string(layer.layerName) == name;
+			                          });
+			if (found != available.end()) {
+				layers.push_back(name);
+				break;
+			}
+		}
+		if (layers.empty()) {
+			std::cerr << "Validation requested but no validation layer is installed" << std::endl;
+		}
+		validation_enabled_ = !layers.empty();
+	}
+	if (validation_enabled_) {
+		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		// Chained so instance creation and destruction are validated as well.
+		create_info.setPNext(&messenger_info);
+	}
+#endif
+
+	instance_ = vk::createInstance(create_info.setPApplicationInfo(&app_info)
+	                                   .setEnabledLayerCount(uint32_t(layers.size()))
+	                                   .setPpEnabledLayerNames(layers.data())
+	                                   .setEnabledExtensionCount(uint32_t(extensions.size()))
+	                                   .setPpEnabledExtensionNames(extensions.data()));
+	vulkan_loader::LoadInstance(instance_);
+
+#ifdef DEV_MODE
+	if (validation_enabled_) {
+		debug_messenger_ = instance_.createDebugUtilsMessengerEXT(messenger_info);
+	}
+#endif
+
+	if (window_) {
+		VkSurfaceKHR surface;
+		if (glfwCreateWindowSurface(instance_, window_, nullptr, &surface) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create window surface");
+		}
+		surface_ = vk::SurfaceKHR(surface);
+	}
+}
+
+void Engine::PickPhysicalDevice() {
+	// Prefer real GPUs but fall back to whatever is suitable, which on GPU-less machines is a
+	// CPU implementation such as lavapipe or SwiftShader.
+	auto rank = [](vk::PhysicalDeviceType type) {
+		switch (type) {
+			case vk::PhysicalDeviceType::eDiscreteGpu:
+				return 4;
+			case vk::PhysicalDeviceType::eIntegratedGpu:
+				return 3;
+			case vk::PhysicalDeviceType::eVirtualGpu:
+				return 2;
+			case vk::PhysicalDeviceType::eCpu:
+				return 1;
+			default:
+				return 0;
+		}
+	};
+
+	int best_rank = -1;
+	for (vk::PhysicalDevice device : instance_.enumeratePhysicalDevices()) {
+		if (!IsDeviceSuitable(device)) continue;
+		int device_rank = rank(device.getProperties().deviceType);
+		if (device_rank > best_rank) {
+			best_rank        = device_rank;
+			physical_device_ = device;
+		}
+	}
+
+	if (!physical_device_) throw std::runtime_error("Failed to find a suitable GPU");
+	graphics_family_ = *FindGraphicsQueueFamily(physical_device_);
+}
+
+bool Engine::IsDeviceSuitable(vk::PhysicalDevice device) const {
+	if (!FindGraphicsQueueFamily(device)) return false;
+
+	std::vector<const char*> extensions = DeviceExtensions(config_.headless);
+	std::set<std::string> required(extensions.begin(), extensions.end());
+	for (const auto& extension : device.enumerateDeviceExtensionProperties()) {
+		required.erase(extension.extensionName);
+	}
+	if (!required.empty()) return false;
+
+	using IndexingFeatures = vk::PhysicalDeviceDescriptorIndexingFeaturesEXT;
+	auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, IndexingFeatures>();
+	if (!BindlessHeap::Supported(features.get<IndexingFeatures>())) return false;
+
+	if (config_.headless) return true;
+	return !device.getSurfaceFormatsKHR(surface_).empty() &&
+	       !device.getSurfacePresentModesKHR(surface_).empty();
+}
+
+std::optional<uint32_t> Engine::FindGraphicsQueueFamily(vk::PhysicalDevice device) const {
+	auto families = device.getQueueFamilyProperties();
+	for (uint32_t i = 0; i < families.size(); ++i) {
+		if (!(families[i].queueFlags & vk::QueueFlagBits::eGraphics)) continue;
+		// The graphics queue doubles as the present queue.
+		if (surface_ && !device.getSurfaceSupportKHR(i, surface_)) continue;
+		return i;
+	}
+	return std::nullopt;
+}
+
+std::optional<uint32_t> Engine::FindTransferQueueFamily(vk::PhysicalDevice device) const {
+	auto families = device.getQueueFamilyProperties();
+	for (uint32_t i = 0; i < families.size(); ++i) {
+		vk::QueueFlags flags = families[i].queueFlags;
+		if ((flags & vk::QueueFlagBits::eTransfer) &&
+		    !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+			return i;
+		}
+	}
+	return std::nullopt;
+}
+
+void Engine::CreateDevice() {
+	float priority = 1.0f;
+	vk::DeviceQueueCreateInfo queue_info(vk::DeviceQueueCreateFlags(), graphics_family_, 1,
+	                                     &priority);
+
+	std::vector<vk::DeviceQueueCreateInfo> queue_infos = {queue_info};
+	std::optional<uint32_t> transfer_family = FindTransferQueueFamily(physical_device_);
+	if (transfer_family) {
+		queue_infos.push_back(vk::DeviceQueueCreateInfo(vk::DeviceQueueCreateFlags(),
+		                                                *transfer_family, 1, &priority));
+	}
+
+	std::vector<const char*> extensions = DeviceExtensions(config_.headless);
+
+	vk::PhysicalDeviceFeatures features;
+	if (config_.draw_path == DrawPath::eIndirect) {
+		// One command per object needs multi-draw, and firstInstance carries the object index.
+		vk::PhysicalDeviceFeatures supported = physical_device_.getFeatures();
+		if (supported.multiDrawIndirect && supported.drawIndirectFirstInstance) {
+			features.multiDrawIndirect         = VK_TRUE;
+			features.drawIndirectFirstInstance = VK_TRUE;
+			draw_indirect_count_ =
+			    HasDeviceExtension(physical_device_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			if (draw_indirect_count_) {
+				extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			}
+		} else {
+			config_.draw_path = DrawPath::eDirect;
+		}
+	}
+	// Virtual textures report the pages they need from the fragment shader.
+	if (physical_device_.getFeatures().fragmentStoresAndAtomics) {
+		features.fragmentStoresAndAtomics = VK_TRUE;
+		virtual_textures_supported_       = true;
+	}
+	// The GPU culls in the compute pass that writes the draw commands and the CPU only for direct
+	// draws, so indirect commands built on the CPU are never culled.
+	bool gpu_built_draws = config_.draw_path == DrawPath::eIndirect && draw_indirect_count_;
+	if (!gpu_built_draws) config_.occlusion_culling = false;
+	if (config_.draw_path == DrawPath::eIndirect && !gpu_built_draws) {
+		config_.frustum_culling = false;
+	}
+	if (!gpu_built_draws) config_.cluster_culling = false;
+	vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features =
+	    BindlessHeap::RequiredFeatures();
+	device_ = physical_device_.createDevice(
+	    vk::DeviceCreateInfo()
+	        .setPNext(&indexing_features)
+	        .setQueueCreateInfoCount(uint32_t(queue_infos.size()))
+	        .setPQueueCreateInfos(queue_infos.data())
+	        .setEnabledExtensionCount(uint32_t(extensions.size()))
+	        .setPpEnabledExtensionNames(extensions.data())
+	        .setPEnabledFeatures(&features));
+	vulkan_loader::LoadDevice(instance_, device_);
+	graphics_queue_ = device_.getQueue(graphics_family_, 0);
+
+	// Without a dedicated transfer family uploads share the graphics queue.
+	transfer_queue_.family = transfer_family.value_or(graphics_family_);
+	transfer_queue_.queue  = device_.getQueue(transfer_queue_.family, 0);
+
+	allocator_ = std::make_unique<MemoryAllocator>(physical_device_, device_);
+	uploader_  = std::make_unique<Uploader>(
+	    device_, *allocator_, QueueRef{graphics_queue_, graphics_family_}, transfer_queue_,
+	    physical_device_.getProperties().limits.optimalBufferCopyOffsetAlignment);
+	bindless_  = std::make_unique<BindlessHeap>(physical_device_, device_);
+}
+
+void Engine::CreateSwapchain() {
+	auto capabilities = physical_device_.getSurfaceCapabilitiesKHR(surface_);
+	auto formats      = physical_device_.getSurfaceFormatsKHR(surface_);
+
+	vk::SurfaceFormatKHR format = formats[0];
+	for (const auto& candidate : formats) {
+		if (candidate.format == vk::Format::eB8G8R8A8Unorm &&
+		    candidate.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear) {
+			format = candidate;
+			break;
+		}
+	}
+	if (format.format == vk::Format::eUndefined) format.format = vk::Format::eB8G8R8A8Unorm;
+
+	if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+		extent_ = capabilities.currentExtent;
+	} else {
+		int width, height;
+		glfwGetFramebufferSize(window_, &width, &height);
+		extent_.width  = std::clamp(uint32_t(width), capabilities.minImageExtent.width,
+		                            capabilities.maxImageExtent.width);
+		extent_.height = std::clamp(uint32_t(height), capabilities.minImageExtent.height,
+		                            capabilities.maxImageExtent.height);
+	}
+
+	uint32_t image_count = capabilities.minImageCount + 1;
+	if (capabilities.maxImageCount > 0) {
+		image_count = std::min(image_count, capabilities.maxImageCount);
+	}
+
+	vk::SwapchainKHR old_swapchain = swapchain_;
+	swapchain_ = device_.createSwapchainKHR(
+	    vk::SwapchainCreateInfoKHR()
+	        .setSurface(surface_)
+	        .setMinImageCount(image_count)
+	        .setImageFormat(format.format)
+	        .setImageColorSpace(format.colorSpace)
+	        .setImageExtent(extent_)
+	        .setImageArrayLayers(1)
+	        .setImageUsage(vk::ImageUsageFlagBits::eColorAttachment)
+	        .setImageSharingMode(vk::SharingMode::eExclusive)
+	        .setPreTransform(capabilities.currentTransform)
+	        .setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
+	        .setPresentMode(vk::PresentModeKHR::eFifo)
+	        .setClipped(VK_TRUE)
+	        .setOldSwapchain(old_swapchain));
+	if (old_swapchain) device_.destroySwapchainKHR(old_swapchain);
+	color_format_ = format.format;
+
+	for (vk::Image image : device_.getSwapchainImagesKHR(swapchain_)) {
+		RenderTarget target;
+		target.image = image;
+		target.view  = device_.createImageView(
+		    vk::ImageViewCreateInfo()
+		        .setImage(image)
+		        .setViewType(vk::ImageViewType::e2D)
+		        .setFormat(color_format_)
+		        .setSubresourceRange(
+		            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
+		targets_.push_back(target);
+	}
+	images_in_flight_.assign(targets_.size(), vk::Fence());
+}
+
+void Engine::CreateOffscreenTargets() {
+	color_format_ = vk::Format::eR8G8B8A8Unorm;
+	extent_       = vk::Extent2D(config_.width, config_.height);
+
+	// One target per frame in flight, so a frame never renders into an image the GPU is still
+	// drawing to.
+	for (uint32_t i = 0; i < config_.frames_in_flight; ++i) {
+		RenderTarget target;
+		target.image = device_.createImage(
+		    vk::ImageCreateInfo()
+		        .setImageType(vk::ImageType::e2D)
+		        .setFormat(color_format_)
+		        .setExtent(vk::Extent3D(extent_.width, extent_.height, 1))
+		        .setMipLevels(1)
+		        .setArrayLayers(1)
+		        .setSamples(vk::SampleCountFlagBits::e1)
+		        .setTiling(vk::ImageTiling::eOptimal)
+		        .setUsage(vk::ImageUsageFlagBits::eColorAttachment |
+		                  vk::ImageUsageFlagBits::eTransferSrc)
+		        .setSharingMode(vk::SharingMode::eExclusive)
+		        .setInitialLayout(vk::ImageLayout::eUndefined));
+
+		target.memory =
+		    allocator_->AllocateImage(target.image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+		target.view = device_.createImageView(
+		    vk::ImageViewCreateInfo()
+		        .setImage(target.image)
+		        .setViewType(vk::ImageViewType::e2D)
+		        .setFormat(color_format_)
+		        .setSubresourceRange(
+		            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
+		targets_.push_back(target);
+	}
+}
+
+void Engine::CreateDepthTarget() {
+	const vk::Format candidates[] = {vk::Format::eD32Sfloat, vk::Format::eX8D24UnormPack32,
+	                                 vk::Format::eD16Unorm};
+	// The depth pyramid samples the depth buffer.
+	vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eDepthStencilAttachment;
+	vk::ImageUsageFlags usage       = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+	if (config_.occlusion_culling) {
+		required |= vk::FormatFeatureFlagBits::eSampledImage;
+		usage |= vk::ImageUsageFlagBits::eSampled;
+	}
+	depth_format_ = vk::Format::eUndefined;
+	for (vk::Format format : candidates) {
+		if ((physical_device_.getFormatProperties(format).optimalTilingFeatures & required) ==
+		    required) {
+			depth_format_ = format;
+			break;
+		}
+	}
+	if (depth_format_ == vk::Format::eUndefined) throw std::runtime_error("No depth format");
+
+	depth_image_ = device_.createImage(
+	    vk::ImageCreateInfo()
+	        .setImageType(vk::ImageType::e2D)
+	        .setFormat(depth_format_)
+	        .setExtent(vk::Extent3D(extent_.width, extent_.height, 1))
+	        .setMipLevels(1)
+	        .setArrayLayers(1)
+	        .setSamples(vk::SampleCountFlagBits::e1)
+	        .setTiling(vk::ImageTiling::eOptimal)
+	        .setUsage(usage)
+	        .setSharingMode(vk::SharingMode::eExclusive)
+	        .setInitialLayout(vk::ImageLayout::eUndefined));
+	depth_memory_ =
+	    allocator_->AllocateImage(depth_image_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	depth_view_   = device_.createImageView(
+	    vk::ImageViewCreateInfo()
+	        .setImage(depth_image_)
+	        .setViewType(vk::ImageViewType::e2D)
+	        .setFormat(depth_format_)
+	        .setSubresourceRange(
+	            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1)));
+	NameObject(vk::ObjectType::eImage, uint64_t(VkImage(depth_image_)), "depth");
+}
+
+void Engine::CreateRenderPass() {
+	// Offscreen targets end the pass ready to be copied out; swapchain images ready to present.
+	vk::ImageLayout final_layout = config_.headless ? vk::ImageLayout::eTransferSrcOptimal
+	                                                : vk::ImageLayout::ePresentSrcKHR;
+
+	vk::AttachmentDescription color_attachment(
+	    vk::AttachmentDescriptionFlags(), color_format_, vk::SampleCountFlagBits::e1,
+	    vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
+	    vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
+	    vk::ImageLayout::eUndefined, final_layout);
+
+	// Depth is only kept past the pass when the depth pyramid is built from it.
+	bool keep_depth = config_.occlusion_culling;
+	vk::AttachmentDescription depth_attachment(
+	    vk::AttachmentDescriptionFlags(), depth_format_, vk::SampleCountFlagBits::e1,
+	    vk::AttachmentLoadOp::eClear,
+	    keep_depth ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare,
+	    vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
+	    vk::ImageLayout::eUndefined,
+	    keep_depth ? vk::ImageLayout::eDepthStencilReadOnlyOptimal
+	               : vk::ImageLayout::eDepthStencilAttachmentOptimal);
+	std::array<vk::AttachmentDescription, 2> attachments = {color_attachment, depth_attachment};
+
+	vk::AttachmentReference color_ref(0, vk::ImageLayout::eColorAttachmentOptimal);
+	vk::AttachmentReference depth_ref(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+	vk::SubpassDescription subpass;
+	subpass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+	    .setColorAttachmentCount(1)
+	    .setPColorAttachments(&color_ref)
+	    .setPDepthStencilAttachment(&depth_ref);
+
+	// The depth buffer is shared by every frame, so the previous pass' depth writes and the
+	// depth pyramid's reads must finish before this pass clears it.
+	std::array<vk::SubpassDependency, 3> dependencies = {
+	    vk::SubpassDependency(VK_SUBPASS_EXTERNAL, 0,
+	                          vk::PipelineStageFlagBits::eColorAttachmentOutput |
+	                              vk::PipelineStageFlagBits::eLateFragmentTests |
+	                              vk::PipelineStageFlagBits::eComputeShader,
+	                          vk::PipelineStageFlagBits::eColorAttachmentOutput |
+	                              vk::PipelineStageFlagBits::eEarlyFragmentTests,
+	                          vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+	                          vk::AccessFlagBits::eColorAttachmentWrite |
+	                              vk::AccessFlagBits::eDepthStencilAttachmentWrite),
+	    vk::SubpassDependency(0, VK_SUBPASS_EXTERNAL,
+	                          vk::PipelineStageFlagBits::eColorAttachmentOutput,
+	                          vk::PipelineStageFlagBits::eTransfer,
+	                          vk::AccessFlagBits::eColorAttachmentWrite,
+	                          vk::AccessFlagBits::eTransferRead),
+	    vk::SubpassDependency(0, VK_SUBPASS_EXTERNAL, vk::PipelineStageFlagBits::eLateFragmentTests,
+	                          vk::PipelineStageFlagBits::eComputeShader,
+	                          vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+	                          vk::AccessFlagBits::eShaderRead)};
+
+	render_pass_ = device_.createRenderPass(vk::RenderPassCreateInfo()
+	                                            .setAttachmentCount(uint32_t(attachments.size()))
+	                                            .setPAttachments(attachments.data())
+	                                            .setSubpassCount(1)
+	                                            .setPSubpasses(&subpass)
+	                                            .setDependencyCount(uint32_t(dependencies.size()))
+	                                            .setPDependencies(dependencies.data()));
+}
+
+void Engine::CreatePipeline() {
+	auto start = std::chrono::steady_clock::now();
+	if (config_.use_pipeline_cache) {
+		pipeline_cache_ = std::make_unique<PipelineCache>(physical_device_, device_,
+		                                                  config_.pipeline_cache_path);
+	}
+	vk::PipelineCache cache = pipeline_cache_ ? pipeline_cache_->Handle() : vk::PipelineCache();
+
+	Shader vert(device_, ENGINE_SHADER_DIR "vert.spv");
+	// Only devices that can store from fragment shaders get the shader writing page requests.
+	Shader frag(device_, virtual_textures_supported_ ? ENGINE_SHADER_DIR "frag_virtual.spv"
+	                                                 : ENGINE_SHADER_DIR "frag.spv");
+
+	std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+	    vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(),
+	                                      vk::ShaderStageFlagBits::eVertex, vert.Module(), "main"),
+	    vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(),
+	                                      vk::ShaderStageFlagBits::eFragment, frag.Module(),
+	                                      "main")};
+
+	vk::VertexInputBindingDescription binding = Vertex::Binding();
+	auto attributes                           = Vertex::Attributes();
+	vk::PipelineVertexInputStateCreateInfo vertex_input(
+	    vk::PipelineVertexInputStateCreateFlags(), 1, &binding, uint32_t(attributes.size()),
+	    attributes.data());
+	vk::PipelineInputAssemblyStateCreateInfo input_assembly(
+	    vk::PipelineInputAssemblyStateCreateFlags(), vk::PrimitiveTopology::eTriangleList);
+
+	// Viewport and scissor are dynamic so swapchain resizes don't require a new pipeline.
+	vk::PipelineViewportStateCreateInfo viewport_state;
+	viewport_state.setViewportCount(1).setScissorCount(1);
+
+	vk::PipelineRasterizationStateCreateInfo rasterizer;
+	rasterizer.setPolygonMode(vk::PolygonMode::eFill)
+	    .setCullMode(vk::CullModeFlagBits::eBack)
+	    .setFrontFace(vk::FrontFace::eCounterClockwise)
+	    .setLineWidth(1.0f);
+
+	vk::PipelineMultisampleStateCreateInfo multisampling;
+	multisampling.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+	vk::PipelineDepthStencilStateCreateInfo depth_stencil;
+	depth_stencil.setDepthTestEnable(VK_TRUE)
+	    .setDepthWriteEnable(VK_TRUE)
+	    .setDepthCompareOp(vk::CompareOp::eLess);
+
+	vk::PipelineColorBlendAttachmentState blend_attachment;
+	blend_attachment.setColorWriteMask(
+	    vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+	    vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+	vk::PipelineColorBlendStateCreateInfo color_blend;
+	color_blend.setAttachmentCount(1).setPAttachments(&blend_attachment);
+
+	std::array<vk::DynamicState, 2> dynamic_states = {vk::DynamicState::eViewport,
+	                                                  vk::DynamicState::eScissor};
+	vk::PipelineDynamicStateCreateInfo dynamic_state(vk::PipelineDynamicStateCreateFlags(),
+	                                                 uint32_t(dynamic_states.size()),
+	                                                 dynamic_states.data());
+
+	vk::PushConstantRange push_constants(
+	    vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0,
+	    sizeof(DrawConstants));
+	vk::DescriptorSetLayout set_layout = bindless_->Layout();
+	pipeline_layout_ = device_.createPipelineLayout(vk::PipelineLayoutCreateInfo()
+	                                                    .setSetLayoutCount(1)
+	                                                    .setPSetLayouts(&set_layout)
+	                                                    .setPushConstantRangeCount(1)
+	                                                    .setPPushConstantRanges(&push_constants));
+
+	vk::GraphicsPipelineCreateInfo pipeline_info;
+	pipeline_info.setStageCount(uint32_t(stages.size()))
+	    .setPStages(stages.data())
+	    .setPVertexInputState(&vertex_input)
+	    .setPInputAssemblyState(&input_assembly)
+	    .setPViewportState(&viewport_state)
+	    .setPRasterizationState(&rasterizer)
+	    .setPMultisampleState(&multisampling)
+	    .setPDepthStencilState(&depth_stencil)
+	    .setPColorBlendState(&color_blend)
+	    .setPDynamicState(&dynamic_state)
+	    .setLayout(pipeline_layout_)
+	    .setRenderPass(render_pass_)
+	    .setSubpass(0);
+	pipeline_ = CreateGraphicsPipeline(device_, cache, pipeline_info);
+
+	if (config_.draw_path == DrawPath::eIndirect) {
+		Shader indirect_vert(device_, ENGINE_SHADER_DIR "indirect.spv");
+		stages[0].setModule(indirect_vert.Module());
+		indirect_pipeline_ = CreateGraphicsPipeline(device_, cache, pipeline_info);
+
+		uint32_t max_draw_count = physical_device_.getProperties().limits.maxDrawIndirectCount;
+		gpu_scene_ = std::make_unique<GpuScene>(device_, *allocator_, *uploader_, *bindless_, cache,
+		                                        config_.frames_in_flight, draw_indirect_count_,
+		                                        config_.cluster_culling, max_draw_count);
+	}
+	if (config_.occlusion_culling) {
+		depth_pyramid_ = std::make_unique<DepthPyramid>(device_, *allocator_, *bindless_, cache,
+		                                                depth_view_, extent_);
+	}
+
+	pipeline_create_ms_ =
+	    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	NameObject(vk::ObjectType::ePipeline, uint64_t(VkPipeline(pipeline_)), "mesh pipeline");
+	if (indirect_pipeline_) {
+		NameObject(vk::ObjectType::ePipeline, uint64_t(VkPipeline(indirect_pipeline_)),
+		           "indirect mesh pipeline");
+	}
+}
+
+#ifdef DEV_MODE
+void Engine::NameObject(vk::ObjectType type, uint64_t handle, const char* name) {
+	if (!validation_enabled_) return;
+	device_.setDebugUtilsObjectNameEXT(vk::DebugUtilsObjectNameInfoEXT(type, handle, name));
+}
+#endif
+
+void Engine::CreateFramebuffers() {
+	for (RenderTarget& target : targets_) {
+		std::array<vk::ImageView, 2> views = {target.view, depth_view_};
+		target.framebuffer = device_.createFramebuffer(
+		    vk::FramebufferCreateInfo()
+		        .setRenderPass(render_pass_)
+		        .setAttachmentCount(uint32_t(views.size()))
+		        .setPAttachments(views.data())
+		        .setWidth(extent_.width)
+		        .setHeight(extent_.height)
+		        .setLayers(1));
+	}
+}
+
+void Engine::CreateCommandResources() {
+	// Only used for one-time setup commands; per-frame recording goes through FrameData.
+	command_pool_ = device_.createCommandPool(vk::CommandPoolCreateInfo(
+	    vk::CommandPoolCreateFlagBits::eTransient, graphics_family_));
+}
+
+void Engine::CreateFrameResources() {
+	uint32_t valid_bits =
+	    physical_device_.getQueueFamilyProperties()[graphics_family_].timestampValidBits;
+	if (valid_bits > 0) {
+		timestamp_mask_      = valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+		timestamp_period_ns_ = physical_device_.getProperties().limits.timestampPeriod;
+	}
+
+	frames_.resize(config_.frames_in_flight);
+	for (FrameData& frame : frames_) {
+		// The whole pool is reset once the frame's fence has signalled, so nothing is freed
+		// individually.
+		frame.command_pool = device_.createCommandPool(vk::CommandPoolCreateInfo(
+		    vk::CommandPoolCreateFlagBits::eTransient, graphics_family_));
+		frame.command_buffer = device_.allocateCommandBuffers(vk::CommandBufferAllocateInfo(
+		    frame.command_pool, vk::CommandBufferLevel::ePrimary, 1))[0];
+		if (jobs_->Size() > 1) {
+			frame.worker_commands.resize(jobs_->Size());
+			for (WorkerCommands& commands : frame.worker_commands) {
+				commands.pool = device_.createCommandPool(vk::CommandPoolCreateInfo(
+				    vk::CommandPoolCreateFlagBits::eTransient, graphics_family_));
+			}
+		}
+
+		frame.image_available = device_.createSemaphore(vk::SemaphoreCreateInfo());
+		frame.render_finished = device_.createSemaphore(vk::SemaphoreCreateInfo());
+		frame.in_flight =
+		    device_.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+
+		if (valid_bits > 0) {
+			frame.timestamps = device_.createQueryPool(
+			    vk::QueryPoolCreateInfo(vk::QueryPoolCreateFlags(), vk::QueryType::eTimestamp, 2));
+		}
+
+		std::string slot = "frame " + std::to_string(&frame - frames_.data());
+		NameObject(vk::ObjectType::eCommandBuffer, uint64_t(VkCommandBuffer(frame.command_buffer)),
+		           (slot + " commands").c_str());
+		NameObject(vk::ObjectType::eFence, uint64_t(VkFence(frame.in_flight)),
+		           (slot + " in flight").c_str());
+	}
+}
+
+void Engine::CreateDefaultTextures() {
+	default_sampler_ = device_.createSampler(vk::SamplerCreateInfo()
+	                                             .setMagFilter(vk::Filter::eLinear)
+	                                             .setMinFilter(vk::Filter::eLinear)
+	                                             .setMipmapMode(vk::SamplerMipmapMode::eLinear)
+	                                             .setAddressModeU(vk::SamplerAddressMode::eRepeat)
+	                                             .setAddressModeV(vk::SamplerAddressMode::eRepeat)
+	                                             .setAddressModeW(vk::SamplerAddressMode::eRepeat)
+	                                             .setMaxLod(VK_LOD_CLAMP_NONE));
+	default_sampler_index_ = bindless_->AddSampler(default_sampler_);
+
+	const uint8_t white[4] = {255, 255, 255, 255};
+	if (AddTexture(1, 1, white) != kWhiteTexture) {
+		throw std::runtime_error("The white texture must be the first bindless image");
+	}
+}
+
+void Engine::DestroyTargets() {
+	for (RenderTarget& target : targets_) {
+		device_.destroyFramebuffer(target.framebuffer);
+		device_.destroyImageView(target.view);
+		if (target.memory) {
+			device_.destroyImage(target.image);
+			allocator_->Free(target.memory);
+		}
+	}
+	targets_.clear();
+
+	if (swapchain_) {
+		device_.destroySwapchainKHR(swapchain_);
+		swapchain_ = nullptr;
+	}
+
+	DestroyDepthTarget();
+}
+
+void Engine::DestroyDepthTarget() {
+	device_.destroyImageView(depth_view_);
+	device_.destroyImage(depth_image_);
+	allocator_->Free(depth_memory_);
+}
+
+void Engine::RecreateSwapchain() {
+	// A minimized window has a zero-sized framebuffer; wait until it is visible again.
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window_, &width, &height);
+	while (width == 0 || height == 0) {
+		glfwWaitEvents();
+		glfwGetFramebufferSize(window_, &width, &height);
+	}
+
+	device_.waitIdle();
+	for (RenderTarget& target : targets_) {
+		device_.destroyFramebuffer(target.framebuffer);
+		device_.destroyImageView(target.view);
+	}
+	targets_.clear();
+	DestroyDepthTarget();
+
+	CreateSwapchain();
+	CreateDepthTarget();
+	CreateFramebuffers();
+	if (depth_pyramid_) {
+		depth_pyramid_->Resize(depth_view_, extent_);
+		pyramid_valid_ = false;
+	}
+	if (virtual_texturing_) virtual_texturing_->Resize(extent_);
+}
+
+void Engine::RecordCommandBuffer(FrameData& frame, const RenderTarget& target) {
+	uint32_t slot         = uint32_t(&frame - frames_.data());
+	vk::CommandBuffer cmd = frame.command_buffer;
+	cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	if (frame.timestamps) {
+		cmd.resetQueryPool(frame.timestamps, 0, 2);
+		cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.timestamps, 0);
+	}
+	if (gpu_scene_) {
+		GpuScene::CullParams cull;
+		cull.frustum         = config_.frustum_culling;
+		cull.view_projection = view_projection_;
+		cull.backface        = config_.cluster_culling;
+		cull.lod_threshold   = config_.lod_threshold_pixels;
+		cull.viewport_height = extent_.height;
+		if (depth_pyramid_ && pyramid_valid_) {
+			cull.pyramid                 = depth_pyramid_.get();
+			cull.pyramid_view_projection = pyramid_view_projection_;
+		}
+		gpu_scene_->RecordBuild(cmd, slot, cull);
+	}
+	if (virtual_texturing_) virtual_texturing_->RecordUploads(cmd, slot);
+
+	// Large scenes are split into contiguous ranges recorded into secondary command buffers on
+	// the record pool; their order in the primary keeps the draw order unchanged. Indirect
+	// draws are a handful of commands and always recorded inline.
+	bool parallel = !gpu_scene_ && !frame.worker_commands.empty() &&
+	                visible_.size() >= kMinParallelDraws;
+
+	std::array<vk::ClearValue, 2> clear_values = {
+	    vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}),
+	    vk::ClearDepthStencilValue(1.0f, 0)};
+	cmd.beginRenderPass(vk::RenderPassBeginInfo(render_pass_, target.framebuffer,
+	                                            vk::Rect2D(vk::Offset2D(0, 0), extent_),
+	                                            uint32_t(clear_values.size()), clear_values.data()),
+	                    parallel ? vk::SubpassContents::eSecondaryCommandBuffers
+	                             : vk::SubpassContents::eInline);
+
+	if (parallel) {
+		uint32_t chunks = jobs_->Size();
+		std::vector<vk::CommandBuffer> secondaries(chunks);
+		vk::CommandBufferInheritanceInfo inheritance(render_pass_, 0, target.framebuffer);
+
+		auto record = [&](uint32_t chunk) {
+			// Command pools are per worker, so no two threads ever allocate from the same one.
+			WorkerCommands& commands = frame.worker_commands[jobs_->CurrentWorker()];
+			if (commands.used == commands.buffers.size()) {
+				vk::CommandBufferAllocateInfo info(commands.pool,
+				                                   vk::CommandBufferLevel::eSecondary, 1);
+				commands.buffers.push_back(device_.allocateCommandBuffers(info)[0]);
+			}
+			vk::CommandBuffer secondary = commands.buffers[commands.used++];
+
+			secondary.begin(vk::CommandBufferBeginInfo(
+			    vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+			        vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+			    &inheritance));
+			RecordDraws(secondary, visible_.size() * chunk / chunks,
+			            visible_.size() * (chunk + 1) / chunks);
+			secondary.end();
+			secondaries[chunk] = secondary;
+		};
+		jobs_->ParallelFor(
+		    chunks,
+		    [&](uint32_t begin, uint32_t end) {
+			    for (uint32_t chunk = begin; chunk < end; ++chunk) record(chunk);
+		    },
+		    1);
+		cmd.executeCommands(secondaries);
+	} else if (gpu_scene_) {
+		RecordIndirectDraws(cmd, slot);
+	} else {
+		RecordDraws(cmd, 0, visible_.size());
+	}
+
+	cmd.endRenderPass();
+	if (virtual_texturing_) virtual_texturing_->RecordReadback(cmd);
+	// Submission order puts the pyramid before the next frame's culling pass.
+	if (depth_pyramid_) {
+		depth_pyramid_->Record(cmd);
+		pyramid_valid_           = true;
+		pyramid_view_projection_ = view_projection_;
+	}
+	if (frame.timestamps) {
+		cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frame.timestamps, 1);
+	}
+	cmd.end();
+}
+
+void Engine::RecordDraws(vk::CommandBuffer cmd, size_t begin, size_t end) const {
+	// Secondary command buffers inherit no state, so every range binds its own.
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline_);
+	cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, float(extent_.width), float(extent_.height), 0.0f,
+	                                1.0f));
+	cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent_));
+	// Textures are picked by index, so one set stays bound for the whole range.
+	bindless_->Bind(cmd, vk::PipelineBindPoint::eGraphics, pipeline_layout_);
+	const Model* bound = nullptr;
+	for (size_t i = begin; i < end; ++i) {
+		const DrawInstance& instance = instances_[visible_[i]];
+		if (instance.model != bound) {
+			instance.model->Bind(cmd);
+			bound = instance.model;
+		}
+		DrawConstants constants{view_projection_ * instance.transform, instance.texture,
+		                        default_sampler_index_, 0, virtual_texture_table_,
+		                        texture_residency_};
+		cmd.pushConstants(pipeline_layout_,
+		                  vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0,
+		                  sizeof(constants), &constants);
+		instance.model->Draw(cmd, 1, visible_lods_[i]);
+	}
+}
+
+double Engine::CullInstances() {
+	auto start = std::chrono::steady_clock::now();
+	if ((instances_changed_ || transforms_changed_) && config_.frustum_culling) {
+		culler_.Clear();
+		culler_.Reserve(instances_.size());
+		for (const DrawInstance& instance : instances_) {
+			culler_.Add(instance.bounds, instance.extents, instance.transform);
+		}
+	} else if (instances_changed_) {
+		visible_.resize(instances_.size());
+		std::iota(visible_.begin(), visible_.end(), 0u);
+	}
+	if (instances_changed_) instance_lods_.assign(instances_.size(), 0);
+	instances_changed_  = false;
+	transforms_changed_ = false;
+	if (config_.frustum_culling) culler_.Cull(view_projection_, visible_, jobs_.get());
+
+	// Each instance's LOD is picked starting from the one it was last drawn with.
+	visible_lods_.assign(visible_.size(), 0);
+	lod_triangles_saved_         = 0;
+	std::optional<glm::vec3> eye = FrustumCuller::ExtractEye(view_projection_);
+	float lod_scale              = LodScale(view_projection_, extent_.height);
+	if (eye && lod_scale > 0.0f && config_.lod_threshold_pixels > 0.0f) {
+		for (size_t i = 0; i < visible_.size(); ++i) {
+			uint32_t index                   = visible_[i];
+			const DrawInstance& instance     = instances_[index];
+			const std::vector<MeshLod>& lods = instance.model->Lods();
+			if (lods.size() < 2) continue;
+			float pixels = LodPixelsPerUnit(instance.transform, instance.bounds, *eye, lod_scale);
+			uint32_t lod =
+			    SelectLod(lods, pixels, config_.lod_threshold_pixels, instance_lods_[index]);
+
+			instance_lods_[index] = lod;
+			visible_lods_[i]      = lod;
+			lod_triangles_saved_ += (lods[0].index_count - lods[lod].index_count) / 3;
+		}
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+	    .count();
+}
+
+void Engine::RecordIndirectDraws(vk::CommandBuffer cmd, uint32_t slot) const {
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, indirect_pipeline_);
+	cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, float(extent_.width), float(extent_.height), 0.0f,
+	                                1.0f));
+	cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent_));
+	bindless_->Bind(cmd, vk::PipelineBindPoint::eGraphics, pipeline_layout_);
+
+	DrawConstants constants{view_projection_, kWhiteTexture, default_sampler_index_,
+	                        gpu_scene_->ObjectBuffer(slot), virtual_texture_table_,
+	                        texture_residency_};
+	cmd.pushConstants(pipeline_layout_,
+	                  vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0,
+	                  sizeof(constants), &constants);
+	gpu_scene_->RecordDraws(cmd, slot);
+}
+
+vk::CommandBuffer Engine::BeginOneTimeCommands() {
+	vk::CommandBuffer cmd = device_.allocateCommandBuffers(vk::CommandBufferAllocateInfo(
+	    command_pool_, vk::CommandBufferLevel::ePrimary, 1))[0];
+	cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	return cmd;
+}
+
+void Engine::EndOneTimeCommands(vk::CommandBuffer cmd) {
+	cmd.end();
+	graphics_queue_.submit(vk::SubmitInfo().setCommandBufferCount(1).setPCommandBuffers(&cmd),
+	                       nullptr);
+	graphics_queue_.waitIdle();
+	device_.freeCommandBuffers(command_pool_, cmd);
+}
+
+std::string Engine::DeviceName() const {
+	return physical_device_.getProperties().deviceName;
+}
@@ -0,0 +1,35 @@
+#include "file_util.h"
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+bool HasExtension(const std::string& path, std::initializer_list<const char*> extensions) {
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos) return false;
+	std::string extension = path.substr(dot + 1);
+	for (char& c : extension) c = char(std::tolower(static_cast<unsigned char>(c)));
+	for (const char* candidate : extensions) {
+		if (extension == candidate) return true;
+	}
+	return false;
+}
+
+void WriteFileAtomically(const std::string& path, const std::function<void(std::ostream&)>& write) {
+	std::string temporary = path + ".tmp";
+	try {
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) throw std::runtime_error("Failed to open file: " + temporary);
+			write(file);
+			file.flush();
+			if (!file) throw std::runtime_error("Failed to write file: " + temporary);
+		}
+		std::filesystem::rename(temporary, path);
+	} catch (...) {
+		std::error_code error;
+		std::filesystem::remove(temporary, error);
+		throw;
+	}
+}
@@ -0,0 +1,75 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Nearest-rank percentile over an already sorted sample set.
+double Percentile(const std::vector<double>& sorted, double percentile) {
+	size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+	return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+}  // namespace
+
+TimingSummary FrameStats::Summarize(double FrameTiming::*field) const {
+	std::vector<double> samples;
+	samples.reserve(frames_.size());
+	for (const FrameTiming& frame : frames_) {
+		if (frame.*field >= 0.0) samples.push_back(frame.*field);
+	}
+	return Summarize(std::move(samples));
+}
+
+TimingSummary FrameStats::Summarize(std::vector<double> samples) {
+	TimingSummary summary;
+	if (samples.empty()) return summary;
+
+	std::sort(samples.begin(), samples.end());
+	summary.samples = samples.size();
+	summary.mean    = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	summary.min     = samples.front();
+	summary.max     = samples.back();
+	summary.p50     = Percentile(samples, 50.0);
+	summary.p95     = Percentile(samples, 95.0);
+	summary.p99     = Percentile(samples, 99.0);
+	return summary;
+}
+
+void FrameStats::WriteJson(std::ostream& out, const TimingSummary& summary) {
+	out << "{\"samples\": " << summary.samples << ", \"mean\": " << summary.mean
+	    << ", \"min\": " << summary.min << ", \"max\": " << summary.max
+	    << ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95
+	    << ", \"p99\": " << summary.p99 << "}";
+}
+
+void FrameStats::WriteJson(std::ostream& out, int indent) const {
+	const std::pair<const char*, double FrameTiming::*> fields[] = {
+	    {"cpu_frame_ms", &FrameTiming::cpu_ms},   {"wait_ms", &FrameTiming::wait_ms},
+	    {"update_ms", &FrameTiming::update_ms},   {"record_ms", &FrameTiming::record_ms},
+	    {"cull_ms", &FrameTiming::cull_ms},       {"submit_ms", &FrameTiming::submit_ms},
+	    {"present_ms", &FrameTiming::present_ms}, {"gpu_ms", &FrameTiming::gpu_ms},
+	    {"queued_frames", &FrameTiming::queued_frames},
+	    {"objects_drawn", &FrameTiming::objects_drawn},
+	    {"objects_frustum_culled", &FrameTiming::objects_frustum_culled},
+	    {"objects_occlusion_culled", &FrameTiming::objects_occlusion_culled},
+	    {"clusters_drawn", &FrameTiming::clusters_drawn},
+	    {"clusters_frustum_culled", &FrameTiming::clusters_frustum_culled},
+	    {"clusters_backface_culled", &FrameTiming::clusters_backface_culled},
+	    {"clusters_occlusion_culled", &FrameTiming::clusters_occlusion_culled},
+	    {"lod_triangles_saved", &FrameTiming::lod_triangles_saved}};
+
+	std::string pad(indent, ' ');
+	out << "{\n";
+	for (size_t i = 0; i < std::size(fields); ++i) {
+		out << pad << "  \"" << fields[i].first << "\": ";
+		WriteJson(out, Summarize(fields[i].second));
+		out << (i + 1 < std::size(fields) ? ",\n" : "\n");
+	}
+	out << pad << "}";
+}
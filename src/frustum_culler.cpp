@@ -0,0 +1,295 @@
+#include "frustum_culler.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define ENGINE_CULL_X86 1
+#endif
+
+// GCC and Clang compile a single function for AVX2 without enabling it for the whole file, so
+// the binary still runs on CPUs without it. MSVC always accepts the intrinsics.
+#if defined(ENGINE_CULL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ENGINE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ENGINE_TARGET_AVX2
+#endif
+
+namespace {
+
+struct Bounds {
+	const float* center_x;
+	const float* center_y;
+	const float* center_z;
+	const float* extent_x;
+	const float* extent_y;
+	const float* extent_z;
+	const float* radius;
+};
+
+// A plane rejects an object when its center is farther behind it than the nearer of the two
+// volumes reaches: the sphere's radius, or the box's extent projected on the normal. Sums are
+// grouped the way the SIMD paths add their lanes, so every path rounds alike and culls the same
+// objects.
+uint32_t CullScalar(const float planes[6][4], const Bounds& bounds, uint32_t begin, uint32_t end,
+                    uint32_t* out) {
+	uint32_t count = 0;
+	for (uint32_t i = begin; i < end; ++i) {
+		bool inside = true;
+		for (int p = 0; p < 6; ++p) {
+			const float* plane = planes[p];
+			float distance     = (plane[0] * bounds.center_x[i] + plane[1] * bounds.center_y[i]) +
+			                 (plane[2] * bounds.center_z[i] + plane[3]);
+			float reach = std::abs(plane[0]) * bounds.extent_x[i] +
+			              std::abs(plane[1]) * bounds.extent_y[i] +
+			              std::abs(plane[2]) * bounds.extent_z[i];
+			reach  = std::min(reach, bounds.radius[i]);
+			inside = inside && distance + reach >= 0.0f;
+		}
+		// Written unconditionally and kept only when visible, so there is no branch to mispredict.
+		out[count] = i;
+		count += inside;
+	}
+	return count;
+}
+
+#ifdef ENGINE_CULL_X86
+
+uint32_t CullSse(const float planes[6][4], const Bounds& bounds, uint32_t begin, uint32_t end,
+                 uint32_t* out) {
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	uint32_t count         = 0;
+	uint32_t i             = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 center_x = _mm_loadu_ps(bounds.center_x + i);
+		__m128 center_y = _mm_loadu_ps(bounds.center_y + i);
+		__m128 center_z = _mm_loadu_ps(bounds.center_z + i);
+		__m128 extent_x = _mm_loadu_ps(bounds.extent_x + i);
+		__m128 extent_y = _mm_loadu_ps(bounds.extent_y + i);
+		__m128 extent_z = _mm_loadu_ps(bounds.extent_z + i);
+		__m128 radius   = _mm_loadu_ps(bounds.radius + i);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; ++p) {
+			__m128 nx       = _mm_set1_ps(planes[p][0]);
+			__m128 ny       = _mm_set1_ps(planes[p][1]);
+			__m128 nz       = _mm_set1_ps(planes[p][2]);
+			__m128 distance = _mm_add_ps(
+			    _mm_add_ps(_mm_mul_ps(nx, center_x), _mm_mul_ps(ny, center_y)),
+			    _mm_add_ps(_mm_mul_ps(nz, center_z), _mm_set1_ps(planes[p][3])));
+			__m128 reach = _mm_add_ps(
+			    _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, nx), extent_x),
+			               _mm_mul_ps(_mm_andnot_ps(sign_mask, ny), extent_y)),
+			    _mm_mul_ps(_mm_andnot_ps(sign_mask, nz), extent_z));
+			reach   = _mm_min_ps(reach, radius);
+			outside = _mm_or_ps(outside,
+			                    _mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+		}
+
+		int visible = ~_mm_movemask_ps(outside);
+		for (uint32_t lane = 0; lane < 4; ++lane) {
+			out[count] = i + lane;
+			count += (visible >> lane) & 1;
+		}
+	}
+	return count + CullScalar(planes, bounds, i, end, out + count);
+}
+
+ENGINE_TARGET_AVX2 uint32_t CullAvx2(const float planes[6][4], const Bounds& bounds,
+                                     uint32_t begin, uint32_t end, uint32_t* out) {
+	const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+	uint32_t count         = 0;
+	uint32_t i             = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 center_x = _mm256_loadu_ps(bounds.center_x + i);
+		__m256 center_y = _mm256_loadu_ps(bounds.center_y + i);
+		__m256 center_z = _mm256_loadu_ps(bounds.center_z + i);
+		__m256 extent_x = _mm256_loadu_ps(bounds.extent_x + i);
+		__m256 extent_y = _mm256_loadu_ps(bounds.extent_y + i);
+		__m256 extent_z = _mm256_loadu_ps(bounds.extent_z + i);
+		__m256 radius   = _mm256_loadu_ps(bounds.radius + i);
+
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; ++p) {
+			__m256 nx       = _mm256_set1_ps(planes[p][0]);
+			__m256 ny       = _mm256_set1_ps(planes[p][1]);
+			__m256 nz       = _mm256_set1_ps(planes[p][2]);
+			__m256 distance = _mm256_add_ps(
+			    _mm256_add_ps(_mm256_mul_ps(nx, center_x), _mm256_mul_ps(ny, center_y)),
+			    _mm256_add_ps(_mm256_mul_ps(nz, center_z), _mm256_set1_ps(planes[p][3])));
+			__m256 reach = _mm256_add_ps(
+			    _mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign_mask, nx), extent_x),
+			                  _mm256_mul_ps(_mm256_andnot_ps(sign_mask, ny), extent_y)),
+			    _mm256_mul_ps(_mm256_andnot_ps(sign_mask, nz), extent_z));
+			reach   = _mm256_min_ps(reach, radius);
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, reach),
+			                                              _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+
+		int visible = ~_mm256_movemask_ps(outside);
+		for (uint32_t lane = 0; lane < 8; ++lane) {
+			out[count] = i + lane;
+			count += (visible >> lane) & 1;
+		}
+	}
+	return count + CullSse(planes, bounds, i, end, out + count);
+}
+
+#endif
+
+}  // namespace
+
+void FrustumCuller::ExtractPlanes(const glm::mat4& m, glm::vec4 planes[6]) {
+	// Gribb/Hartmann for a [0, 1] depth range, normalized so distances are in world units.
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; ++i) row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	planes[0] = row[3] + row[0];
+	planes[1] = row[3] - row[0];
+	planes[2] = row[3] + row[1];
+	planes[3] = row[3] - row[1];
+	planes[4] = row[2];
+	planes[5] = row[3] - row[2];
+	for (int i = 0; i < 6; ++i) planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+std::optional<glm::vec3> FrustumCuller::ExtractEye(const glm::mat4& m) {
+	// The eye is the one point the x, y and w rows all map to zero: their linear parts solved
+	// against their translations.
+	glm::mat3 xyw(glm::vec3(m[0][0], m[0][1], m[0][3]), glm::vec3(m[1][0], m[1][1], m[1][3]),
+	              glm::vec3(m[2][0], m[2][1], m[2][3]));
+	if (std::abs(glm::determinant(xyw)) < 1e-12f) return std::nullopt;
+	return glm::inverse(xyw) * -glm::vec3(m[3][0], m[3][1], m[3][3]);
+}
+
+FrustumCuller::Isa FrustumCuller::BestIsa() {
+#if defined(ENGINE_CULL_X86) && (defined(__GNUC__) || defined(__clang__))
+	if (__builtin_cpu_supports("avx2")) return Isa::eAvx2;
+	return Isa::eSse;
+#elif defined(ENGINE_CULL_X86)
+#ifdef __AVX2__
+	return Isa::eAvx2;
+#else
+	return Isa::eSse;
+#endif
+#else
+	return Isa::eScalar;
+#endif
+}
+
+const char* FrustumCuller::IsaName(Isa isa) {
+	switch (isa) {
+		case Isa::eScalar:
+			return "scalar";
+		case Isa::eSse:
+			return "sse";
+		case Isa::eAvx2:
+			return "avx2";
+	}
+	return "unknown";
+}
+
+void FrustumCuller::SetIsa(Isa isa) {
+	isa_ = Isa(std::min(uint32_t(isa), uint32_t(BestIsa())));
+}
+
+void FrustumCuller::Clear() {
+	for (std::vector<float>* array : {&center_x_, &center_y_, &center_z_, &extent_x_, &extent_y_,
+	                                  &extent_z_, &radius_}) {
+		array->clear();
+	}
+}
+
+void FrustumCuller::Reserve(size_t count) {
+	for (std::vector<float>* array : {&center_x_, &center_y_, &center_z_, &extent_x_, &extent_y_,
+	                                  &extent_z_, &radius_}) {
+		array->reserve(count);
+	}
+}
+
+uint32_t FrustumCuller::Add(const glm::vec3& center, const glm::vec3& extents, float radius) {
+	uint32_t index = uint32_t(Size());
+	for (std::vector<float>* array : {&center_x_, &center_y_, &center_z_, &extent_x_, &extent_y_,
+	                                  &extent_z_, &radius_}) {
+		array->push_back(0.0f);
+	}
+	Set(index, center, extents, radius);
+	return index;
+}
+
+uint32_t FrustumCuller::Add(const glm::vec4& sphere, const glm::vec3& extents,
+                            const glm::mat4& transform) {
+	// The world box encloses the transformed one: each axis gathers the absolute contribution of
+	// every rotated, scaled model axis. The sphere grows with the largest scale.
+	glm::mat3 linear(transform);
+	glm::mat3 absolute(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+	float scale = std::max({glm::length(linear[0]), glm::length(linear[1]),
+	                        glm::length(linear[2])});
+	return Add(glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f)), absolute * extents,
+	           sphere.w * scale);
+}
+
+void FrustumCuller::Set(uint32_t index, const glm::vec3& center, const glm::vec3& extents,
+                        float radius) {
+	center_x_[index] = center.x;
+	center_y_[index] = center.y;
+	center_z_[index] = center.z;
+	extent_x_[index] = extents.x;
+	extent_y_[index] = extents.y;
+	extent_z_[index] = extents.z;
+	radius_[index]   = radius;
+}
+
+void FrustumCuller::Cull(const glm::mat4& view_projection, std::vector<uint32_t>& visible,
+                         JobSystem* jobs) const {
+	glm::vec4 frustum[6];
+	ExtractPlanes(view_projection, frustum);
+	float planes[6][4];
+	for (int p = 0; p < 6; ++p) {
+		for (int c = 0; c < 4; ++c) planes[p][c] = frustum[p][c];
+	}
+
+	uint32_t count = uint32_t(Size());
+	visible.resize(count);
+	uint32_t chunks = (count + kChunkSize - 1) / kChunkSize;
+	if (!jobs || jobs->Size() == 1 || chunks <= 1) {
+		visible.resize(CullRange(planes, 0, count, visible.data()));
+		return;
+	}
+
+	chunk_counts_.resize(chunks);
+	jobs->ParallelFor(
+	    chunks,
+	    [&](uint32_t first_chunk, uint32_t last_chunk) {
+		    for (uint32_t chunk = first_chunk; chunk < last_chunk; ++chunk) {
+			    uint32_t begin       = chunk * kChunkSize;
+			    uint32_t end         = std::min(count, begin + kChunkSize);
+			    chunk_counts_[chunk] = CullRange(planes, begin, end, visible.data() + begin);
+		    }
+	    },
+	    1);
+
+	// Every chunk compacted into the front of its own range; close the gaps between them.
+	uint32_t total = chunk_counts_[0];
+	for (uint32_t chunk = 1; chunk < chunks; ++chunk) {
+		auto first = visible.begin() + size_t(chunk) * kChunkSize;
+		std::copy(first, first + chunk_counts_[chunk], visible.begin() + total);
+		total += chunk_counts_[chunk];
+	}
+	visible.resize(total);
+}
+
+uint32_t FrustumCuller::CullRange(const float planes[6][4], uint32_t begin, uint32_t end,
+                                  uint32_t* out) const {
+	Bounds bounds{center_x_.data(), center_y_.data(), center_z_.data(), extent_x_.data(),
+	              extent_y_.data(), extent_z_.data(), radius_.data()};
+	switch (isa_) {
+#ifdef ENGINE_CULL_X86
+		case Isa::eAvx2:
+			return CullAvx2(planes, bounds, begin, end, out);
+		case Isa::eSse:
+			return CullSse(planes, bounds, begin, end, out);
+#endif
+		default:
+			return CullScalar(planes, bounds, begin, end, out);
+	}
+}
@@ -0,0 +1,423 @@
+#include "gltf_file.h"
+
+#include "file_util.h"
+#include "mapped_file.h"
+
+// Images are streamed by TextureStreamer from the material's path, never decoded here.
+#define TINYGLTF_IMPLEMENTATION
+#define TINYGLTF_NO_STB_IMAGE
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#define TINYGLTF_NO_EXTERNAL_IMAGE
+#include <tiny_gltf.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+bool SkipImage(tinygltf::Image*, const int, std::string*, std::string*, int, int,
+               const unsigned char*, int, void*) {
+	return true;
+}
+
+// An accessor's elements in their buffer: element i starts i * stride bytes after data.
+struct AccessorView {
+	const uint8_t* data = nullptr;
+	size_t stride       = 0;
+	size_t count        = 0;
+	int component_type  = 0;
+	int components      = 0;
+	bool normalized     = false;
+};
+
+AccessorView View(const tinygltf::Model& model, int index, int components) {
+	if (index < 0 || size_t(index) >= model.accessors.size()) {
+		throw std::runtime_error("Invalid accessor index");
+	}
+	const tinygltf::Accessor& accessor = model.accessors[index];
+	if (accessor.sparse.isSparse) throw std::runtime_error("Sparse accessors are not supported");
+	if (accessor.bufferView < 0 || size_t(accessor.bufferView) >= model.bufferViews.size()) {
+		throw std::runtime_error("Accessor without a buffer view");
+	}
+	const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+	if (view.buffer < 0 || size_t(view.buffer) >= model.buffers.size()) {
+		throw std::runtime_error("Buffer view without a buffer");
+	}
+	const tinygltf::Buffer& buffer = model.buffers[view.buffer];
+
+	AccessorView result;
+	result.count          = accessor.count;
+	result.component_type = accessor.componentType;
+	result.components     = tinygltf::GetNumComponentsInType(uint32_t(accessor.type));
+	result.normalized     = accessor.normalized;
+	int component_size    = tinygltf::GetComponentSizeInBytes(uint32_t(accessor.componentType));
+	if (result.components != components || component_size <= 0) {
+		throw std::runtime_error("Unexpected accessor type");
+	}
+
+	size_t element = size_t(component_size) * result.components;
+	result.stride  = view.byteStride ? view.byteStride : element;
+	size_t end     = accessor.byteOffset;
+	if (result.count) end += result.stride * (result.count - 1) + element;
+	if (end > view.byteLength || view.byteOffset + view.byteLength > buffer.data.size()) {
+		throw std::runtime_error("Accessor out of its buffer's bounds");
+	}
+	result.data = buffer.data.data() + view.byteOffset + accessor.byteOffset;
+	return result;
+}
+
+// Component c of element i as a float, normalized integers mapped to [0, 1] or [-1, 1].
+float Read(const AccessorView& view, size_t i, int c) {
+	const uint8_t* element = view.data + i * view.stride;
+	switch (view.component_type) {
+		case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+			float value;
+			std::memcpy(&value, element + c * sizeof(float), sizeof(float));
+			return value;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+			float value = element[c];
+			return view.normalized ? value / 255.0f : value;
+		}
+		case TINYGLTF_COMPONENT_TYPE_BYTE: {
+			float value = int8_t(element[c]);
+			return view.normalized ? std::max(value / 127.0f, -1.0f) : value;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+			uint16_t value;
+			std::memcpy(&value, element + c * sizeof(value), sizeof(value));
+			return view.normalized ? value / 65535.0f : value;
+		}
+		case TINYGLTF_COMPONENT_TYPE_SHORT: {
+			int16_t value;
+			std::memcpy(&value, element + c * sizeof(value), sizeof(value));
+			return view.normalized ? std::max(value / 32767.0f, -1.0f) : value;
+		}
+		default:
+			return 0.0f;
+	}
+}
+
+glm::vec3 Read3(const AccessorView& view, size_t i) {
+	return glm::vec3(Read(view, i, 0), Read(view, i, 1), Read(view, i, 2));
+}
+
+uint32_t ReadIndex(const AccessorView& view, size_t i) {
+	const uint8_t* element = view.data + i * view.stride;
+	switch (view.component_type) {
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			return element[0];
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+			uint16_t value;
+			std::memcpy(&value, element, sizeof(value));
+			return value;
+		}
+		default: {
+			uint32_t value;
+			std::memcpy(&value, element, sizeof(value));
+			return value;
+		}
+	}
+}
+
+// Throws unless every index addresses one of vertex_count vertices. Indices are uploaded as the
+// file stores them, so an index past the end would make the GPU fetch outside the vertices.
+void CheckIndices(const AccessorView& indices, size_t vertex_count) {
+	for (size_t i = 0; i < indices.count; ++i) {
+		if (ReadIndex(indices, i) >= vertex_count) throw std::runtime_error("Index out of range");
+	}
+}
+
+// Area-weighted smooth normals. indices has no data for non-indexed primitives.
+std::vector<glm::vec3> GenerateNormals(const AccessorView& positions,
+                                       const AccessorView& indices) {
+	std::vector<glm::vec3> normals(positions.count, glm::vec3(0.0f));
+	size_t corners = indices.data ? indices.count : positions.count;
+	for (size_t t = 0; t + 2 < corners; t += 3) {
+		uint32_t triangle[3];
+		for (uint32_t k = 0; k < 3; ++k) {
+			triangle[k] = indices.data ? ReadIndex(indices, t + k) : uint32_t(t + k);
+			if (triangle[k] >= positions.count) throw std::runtime_error("Index out of range");
+		}
+		glm::vec3 a = Read3(positions, triangle[0]);
+		glm::vec3 normal =
+		    glm::cross(Read3(positions, triangle[1]) - a, Read3(positions, triangle[2]) - a);
+		for (uint32_t vertex : triangle) normals[vertex] += normal;
+	}
+	for (glm::vec3& normal : normals) {
+		float length = glm::length(normal);
+		normal       = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+	return normals;
+}
+
+// Writes whole vertices, interleaving and converting attributes. Uploader chunks start at
+// multiples of kChunkAlignment, so they never split one.
+Uploader::Fill VertexFill(const AccessorView& positions, const AccessorView& normals,
+                          const AccessorView& uvs,
+                          std::shared_ptr<const std::vector<glm::vec3>> generated_normals) {
+	static_assert(Uploader::kChunkAlignment % sizeof(Vertex) == 0, "chunks split vertices");
+	return [=](void* staging, vk::DeviceSize offset, vk::DeviceSize size) {
+		auto out    = static_cast<Vertex*>(staging);
+		size_t base = size_t(offset / sizeof(Vertex));
+		for (size_t i = 0; i < size / sizeof(Vertex); ++i) {
+			size_t v        = base + i;
+			out[i].position = Read3(positions, v);
+			out[i].normal   = generated_normals ? (*generated_normals)[v] : Read3(normals, v);
+			out[i].uv = uvs.data ? glm::vec2(Read(uvs, v, 0), Read(uvs, v, 1)) : glm::vec2(0.0f);
+		}
+	};
+}
+
+// Writes index_size byte indices; 0, 1, 2... if indices has no data.
+Uploader::Fill IndexFill(const AccessorView& indices, uint32_t index_size) {
+	return [=](void* staging, vk::DeviceSize offset, vk::DeviceSize size) {
+		size_t base = size_t(offset / index_size);
+		for (size_t i = 0; i < size / index_size; ++i) {
+			uint32_t index = indices.data ? ReadIndex(indices, base + i) : uint32_t(base + i);
+			if (index_size == 2) {
+				static_cast<uint16_t*>(staging)[i] = uint16_t(index);
+			} else {
+				static_cast<uint32_t*>(staging)[i] = index;
+			}
+		}
+	};
+}
+
+NodeTransform LocalTransform(const tinygltf::Node& node) {
+	NodeTransform local;
+	if (node.matrix.size() == 16) {
+		// The spec requires matrices to decompose into translation, rotation and scale.
+		glm::mat4 matrix = glm::mat4(glm::make_mat4(node.matrix.data()));
+		glm::vec3 x(matrix[0]), y(matrix[1]), z(matrix[2]);
+		local.position = glm::vec3(matrix[3]);
+		local.scale    = glm::vec3(glm::length(x), glm::length(y), glm::length(z));
+		if (glm::dot(glm::cross(x, y), z) < 0.0f) local.scale.x = -local.scale.x;
+		if (local.scale.x * local.scale.y * local.scale.z != 0.0f) {
+			local.rotation =
+			    glm::quat_cast(glm::mat3(x / local.scale.x, y / local.scale.y, z / local.scale.z));
+		}
+		return local;
+	}
+
+	const std::vector<double>& t = node.translation;
+	const std::vector<double>& r = node.rotation;
+	const std::vector<double>& s = node.scale;
+	if (t.size() == 3) local.position = glm::vec3(t[0], t[1], t[2]);
+	// Stored x, y, z, w.
+	if (r.size() == 4) {
+		local.rotation = glm::quat(float(r[3]), float(r[0]), float(r[1]), float(r[2]));
+	}
+	if (s.size() == 3) local.scale = glm::vec3(s[0], s[1], s[2]);
+	return local;
+}
+
+}  // namespace
+
+bool IsGltfFile(const std::string& path) {
+	return HasExtension(path, {"gltf", "glb"});
+}
+
+GltfFile::GltfFile(const std::string& path) : model_(std::make_unique<tinygltf::Model>()) {
+	tinygltf::TinyGLTF loader;
+	loader.SetImageLoader(SkipImage, nullptr);
+	size_t slash         = path.find_last_of("/\\");
+	std::string base_dir = slash == std::string::npos ? "" : path.substr(0, slash);
+
+	// Mapped rather than read into memory, so the only copy is the one tinygltf makes of a GLB's
+	// binary chunk, which primitives are then uploaded from.
+	std::string error, warning;
+	bool loaded;
+	{
+		MappedFile file(path);
+		if (file.Size() > std::numeric_limits<unsigned int>::max()) {
+			throw std::runtime_error("glTF file too large: " + path);
+		}
+		auto bytes  = static_cast<const unsigned char*>(file.Data());
+		auto length = static_cast<unsigned int>(file.Size());
+		if (length >= 4 && std::memcmp(bytes, "glTF", 4) == 0) {
+			loaded = loader.LoadBinaryFromMemory(model_.get(), &error, &warning, bytes, length,
+			                                     base_dir);
+		} else {
+			loaded = loader.LoadASCIIFromString(model_.get(), &error, &warning,
+			                                    reinterpret_cast<const char*>(bytes), length,
+			                                    base_dir);
+		}
+	}
+	if (!loaded) throw std::runtime_error("Failed to load " + path + ": " + error);
+	if (!warning.empty()) std::cerr << path << ": " << warning;
+
+	LoadPrimitives();
+	LoadMaterials();
+	LoadNodes();
+}
+
+GltfFile::~GltfFile() = default;
+
+void GltfFile::LoadPrimitives() {
+	const tinygltf::Model& model = *model_;
+	for (const tinygltf::Mesh& mesh : model.meshes) {
+		std::vector<uint32_t> indices;
+		for (const tinygltf::Primitive& primitive : mesh.primitives) {
+			auto position  = primitive.attributes.find("POSITION");
+			bool triangles = primitive.mode == TINYGLTF_MODE_TRIANGLES;
+			if (!triangles || position == primitive.attributes.end()) continue;
+			AccessorView positions = View(model, position->second, 3);
+			if (positions.count == 0) continue;
+
+			AccessorView normals, uvs, index_view;
+			auto normal = primitive.attributes.find("NORMAL");
+			auto uv     = primitive.attributes.find("TEXCOORD_0");
+			if (normal != primitive.attributes.end()) normals = View(model, normal->second, 3);
+			if (uv != primitive.attributes.end()) uvs = View(model, uv->second, 2);
+			if (primitive.indices >= 0) index_view = View(model, primitive.indices, 1);
+			if ((normals.data && normals.count != positions.count) ||
+			    (uvs.data && uvs.count != positions.count)) {
+				throw std::runtime_error("Vertex attributes of different lengths");
+			}
+			if (index_view.data) CheckIndices(index_view, positions.count);
+
+			MeshSource source;
+			source.vertex_count = uint32_t(positions.count);
+			// -1 for the default material, which is out of range like a missing one.
+			source.material = uint32_t(primitive.material);
+
+			// Whatever buffer views they are in, attributes at the right offsets from each other
+			// and with the right stride read as an array of Vertex.
+			auto packed = [](const AccessorView& view) {
+				return view.component_type == TINYGLTF_COMPONENT_TYPE_FLOAT &&
+				       view.stride == sizeof(Vertex);
+			};
+			bool interleaved = normals.data && uvs.data && packed(positions) && packed(normals) &&
+			                   packed(uvs) &&
+			                   normals.data == positions.data + offsetof(Vertex, normal) &&
+			                   uvs.data == positions.data + offsetof(Vertex, uv);
+			if (interleaved) {
+				source.vertices = reinterpret_cast<const Vertex*>(positions.data);
+			} else {
+				std::shared_ptr<const std::vector<glm::vec3>> generated;
+				if (!normals.data) {
+					generated = std::make_shared<std::vector<glm::vec3>>(
+					    GenerateNormals(positions, index_view));
+				}
+				source.fill_vertices = VertexFill(positions, normals, uvs, std::move(generated));
+			}
+
+			int index_type     = index_view.component_type;
+			int index_size     = tinygltf::GetComponentSizeInBytes(uint32_t(index_type));
+			source.index_count = uint32_t(index_view.data ? index_view.count : positions.count);
+			if (index_view.data && index_view.stride == size_t(index_size) &&
+			    (index_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ||
+			     index_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)) {
+				source.index_size = uint32_t(index_size);
+				source.indices    = index_view.data;
+			} else {
+				bool fits_16_bit    = positions.count <= std::numeric_limits<uint16_t>::max() + 1u;
+				source.index_size   = fits_16_bit ? 2 : 4;
+				source.fill_indices = IndexFill(index_view, source.index_size);
+			}
+			if (source.index_count == 0) continue;
+
+			// min and max are required on POSITION, so bounds don't need the vertices read.
+			const tinygltf::Accessor& accessor = model.accessors[position->second];
+			glm::vec3 min, max;
+			if (accessor.minValues.size() == 3 && accessor.maxValues.size() == 3) {
+				min = glm::vec3(glm::make_vec3(accessor.minValues.data()));
+				max = glm::vec3(glm::make_vec3(accessor.maxValues.data()));
+			} else {
+				min = max = Read3(positions, 0);
+				for (size_t i = 1; i < positions.count; ++i) {
+					min = glm::min(min, Read3(positions, i));
+					max = glm::max(max, Read3(positions, i));
+				}
+			}
+			// The box's circumscribed sphere: looser than Model::ComputeBounds, which reads every
+			// vertex.
+			source.extents = 0.5f * (max - min);
+			source.bounds  = glm::vec4(0.5f * (min + max), glm::length(source.extents));
+
+			if (source.vertices && source.indices) ++zero_copy_;
+			indices.push_back(uint32_t(primitives_.size()));
+			primitives_.push_back(std::move(source));
+		}
+		mesh_primitives_.push_back(std::move(indices));
+	}
+}
+
+void GltfFile::LoadMaterials() {
+	const tinygltf::Model& model = *model_;
+	for (const tinygltf::Material& source : model.materials) {
+		MaterialData material;
+		material.name = source.name;
+		const std::vector<double>& factor = source.pbrMetallicRoughness.baseColorFactor;
+		if (factor.size() == 4) {
+			material.base_color = glm::vec4(factor[0], factor[1], factor[2], factor[3]);
+		}
+
+		int texture = source.pbrMetallicRoughness.baseColorTexture.index;
+		if (texture >= 0 && size_t(texture) < model.textures.size()) {
+			// MSFT_texture_dds points at a DDS the streamer can load instead of the PNG or JPEG.
+			int image                         = model.textures[texture].source;
+			const tinygltf::ExtensionMap& ext = model.textures[texture].extensions;
+			auto dds                          = ext.find("MSFT_texture_dds");
+			if (dds != ext.end() && dds->second.Has("source")) {
+				image = dds->second.Get("source").GetNumberAsInt();
+			}
+			// Images in a buffer or a data URI have no path to stream from.
+			if (image >= 0 && size_t(image) < model.images.size() &&
+			    model.images[image].uri.compare(0, 5, "data:") != 0) {
+				material.texture = model.images[image].uri;
+			}
+		}
+		materials_.push_back(std::move(material));
+	}
+}
+
+void GltfFile::LoadNodes() {
+	const tinygltf::Model& model = *model_;
+	std::vector<int> roots;
+	size_t scene = model.defaultScene >= 0 ? size_t(model.defaultScene) : 0;
+	if (scene < model.scenes.size()) {
+		roots = model.scenes[scene].nodes;
+	} else {
+		// Without scenes, every node nothing refers to as a child is a root.
+		std::vector<bool> child(model.nodes.size());
+		for (const tinygltf::Node& node : model.nodes) {
+			for (int c : node.children) {
+				if (c >= 0 && size_t(c) < child.size()) child[c] = true;
+			}
+		}
+		for (size_t i = 0; i < child.size(); ++i) {
+			if (!child[i]) roots.push_back(int(i));
+		}
+	}
+
+	// Depth first, so every parent is emitted before its children. Entries are a node and the
+	// index of its parent in nodes_.
+	std::vector<std::pair<int, int>> stack;
+	for (auto root = roots.rbegin(); root != roots.rend(); ++root) stack.push_back({*root, -1});
+	std::vector<bool> visited(model.nodes.size());
+	while (!stack.empty()) {
+		auto [index, parent] = stack.back();
+		stack.pop_back();
+		if (index < 0 || size_t(index) >= model.nodes.size() || visited[index]) {
+			throw std::runtime_error("Invalid node hierarchy");
+		}
+		visited[index] = true;
+
+		const tinygltf::Node& source = model.nodes[index];
+		GltfNode node;
+		node.parent = parent;
+		node.local  = LocalTransform(source);
+		if (source.mesh >= 0 && size_t(source.mesh) < mesh_primitives_.size()) {
+			node.primitives = mesh_primitives_[source.mesh];
+		}
+		int self = int(nodes_.size());
+		nodes_.push_back(std::move(node));
+		for (auto child = source.children.rbegin(); child != source.children.rend(); ++child) {
+			stack.push_back({*child, self});
+		}
+	}
+}
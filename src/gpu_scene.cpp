@@ -0,0 +1,486 @@
+#include "gpu_scene.h"
+
+#include "frustum_culler.h"
+#include "shader.h"
+
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+// Push constants of shaders/build_draws.comp.
+struct BuildConstants {
+	uint32_t objects;
+	uint32_t batches;
+	uint32_t commands;
+	uint32_t counts;
+	uint32_t cull;
+	uint32_t stats;
+	uint32_t lods;
+	uint32_t lod_states;
+	uint32_t lod_counts;
+	uint32_t object_count;
+};
+
+// Push constants of shaders/cull_clusters.comp.
+struct ClusterConstants {
+	uint32_t objects;
+	uint32_t batches;
+	uint32_t clusters;
+	uint32_t groups;
+	uint32_t commands;
+	uint32_t counts;
+	uint32_t cull;
+	uint32_t stats;
+	uint32_t lods;
+	uint32_t lod_states;
+	uint32_t lod_counts;
+	uint32_t group_count;
+};
+
+// Flags of CullData, as in shaders/scene.glsl.
+constexpr uint32_t kCullFrustum   = 1;
+constexpr uint32_t kCullOcclusion = 2;
+constexpr uint32_t kCullBackface  = 4;
+constexpr uint32_t kCullLod       = 8;
+
+// The part of CullStats the culling passes count.
+const vk::DeviceSize kGpuStatsBytes = offsetof(GpuScene::CullStats, lod_triangles_saved);
+
+const vk::DeviceSize kCommandStride = sizeof(vk::DrawIndexedIndirectCommand);
+
+// Workgroups per row of a dispatch, within the smallest maxComputeWorkGroupCount allowed.
+constexpr uint32_t kMaxDispatchWidth = 65535;
+
+vk::Pipeline CreateComputePipeline(vk::Device device, vk::PipelineCache cache,
+                                   vk::PipelineLayout layout, const char* path) {
+	Shader shader(device, path);
+	auto pipeline = device.createComputePipeline(
+	    cache, vk::ComputePipelineCreateInfo(
+	               vk::PipelineCreateFlags(),
+	               vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(),
+	                                                 vk::ShaderStageFlagBits::eCompute,
+	                                                 shader.Module(), "main"),
+	               layout));
+	if (pipeline.result != vk::Result::eSuccess) {
+		throw std::runtime_error(std::string("Failed to create compute pipeline: ") + path);
+	}
+	return pipeline.value;
+}
+
+vk::PipelineLayout CreateLayout(vk::Device device, vk::DescriptorSetLayout set_layout,
+                                uint32_t constant_bytes) {
+	vk::PushConstantRange push_constants(vk::ShaderStageFlagBits::eCompute, 0, constant_bytes);
+	return device.createPipelineLayout(vk::PipelineLayoutCreateInfo()
+	                                       .setSetLayoutCount(1)
+	                                       .setPSetLayouts(&set_layout)
+	                                       .setPushConstantRangeCount(1)
+	                                       .setPPushConstantRanges(&push_constants));
+}
+
+}  // namespace
+
+GpuScene::GpuScene(vk::Device device, MemoryAllocator& allocator, Uploader& uploader,
+                   BindlessHeap& bindless, vk::PipelineCache cache, uint32_t frame_count,
+                   bool gpu_commands, bool clusters, uint32_t max_draw_count)
+    : device_(device),
+      allocator_(allocator),
+      uploader_(uploader),
+      bindless_(bindless),
+      gpu_commands_(gpu_commands),
+      clusters_enabled_(gpu_commands && clusters),
+      max_draw_count_(std::max(max_draw_count, 1u)),
+      slots_(frame_count) {
+	if (!gpu_commands_) return;
+
+	build_layout_   = CreateLayout(device_, bindless_.Layout(), sizeof(BuildConstants));
+	build_pipeline_ = CreateComputePipeline(device_, cache, build_layout_,
+	                                        ENGINE_SHADER_DIR "build_draws.spv");
+	if (clusters_enabled_) {
+		cluster_layout_   = CreateLayout(device_, bindless_.Layout(), sizeof(ClusterConstants));
+		cluster_pipeline_ = CreateComputePipeline(device_, cache, cluster_layout_,
+		                                          ENGINE_SHADER_DIR "cull_clusters.spv");
+	}
+
+	const vk::MemoryPropertyFlags host =
+	    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	for (Slot& slot : slots_) {
+		Reserve(slot.cull, sizeof(CullData), vk::BufferUsageFlagBits::eStorageBuffer, host);
+		Reserve(slot.stats, kGpuStatsBytes, vk::BufferUsageFlagBits::eStorageBuffer, host);
+	}
+}
+
+GpuScene::~GpuScene() {
+	for (Slot& slot : slots_) {
+		Release(slot.objects);
+		Release(slot.batches);
+		Release(slot.clusters);
+		Release(slot.cluster_groups);
+		Release(slot.lods);
+		Release(slot.commands);
+		Release(slot.counts);
+		Release(slot.cull);
+		Release(slot.stats);
+		Release(slot.lod_counts);
+	}
+	Release(lod_states_);
+	for (Retired& retired : retired_) Release(retired.buffer);
+	if (build_pipeline_) device_.destroyPipeline(build_pipeline_);
+	if (build_layout_) device_.destroyPipelineLayout(build_layout_);
+	if (cluster_pipeline_) device_.destroyPipeline(cluster_pipeline_);
+	if (cluster_layout_) device_.destroyPipelineLayout(cluster_layout_);
+}
+
+void GpuScene::SetInstances(const std::vector<DrawInstance>& instances) {
+	// Count the objects of every model, in order of first appearance.
+	std::unordered_map<const Model*, uint32_t> model_index;
+	std::vector<const Model*> models;
+	std::vector<uint32_t> model_objects;
+	for (const DrawInstance& instance : instances) {
+		auto inserted = model_index.emplace(instance.model, uint32_t(models.size()));
+		if (inserted.second) {
+			models.push_back(instance.model);
+			model_objects.push_back(0);
+		}
+		++model_objects[inserted.first->second];
+	}
+
+	// Large models with meshlets are culled per cluster, as long as one indirect call can draw
+	// every cluster of an object.
+	clusters_.clear();
+	std::vector<uint32_t> first_cluster(models.size(), 0);
+	std::vector<uint32_t> cluster_counts(models.size(), 0);
+	for (uint32_t m = 0; m < models.size(); ++m) {
+		const std::vector<Meshlet>& meshlets = models[m]->Meshlets();
+		if (!clusters_enabled_ || models[m]->IndexCount() / 3 < kMinClusterTriangles ||
+		    meshlets.size() < 2 || meshlets.size() > max_draw_count_) {
+			continue;
+		}
+		first_cluster[m]  = uint32_t(clusters_.size());
+		cluster_counts[m] = uint32_t(meshlets.size());
+		for (const Meshlet& meshlet : meshlets) {
+			clusters_.push_back({meshlet.bounds, meshlet.cone, meshlet.triangle_offset,
+			                     meshlet.triangle_count * 3, {}});
+		}
+	}
+
+	// Every model's LODs, which only the compute pass picks between.
+	lods_.clear();
+	lod_savings_.clear();
+	has_lods_ = false;
+	std::vector<uint32_t> first_lod(models.size());
+	for (uint32_t m = 0; m < models.size(); ++m) {
+		const std::vector<MeshLod>& lods = models[m]->Lods();
+		first_lod[m]                     = uint32_t(lods_.size());
+		has_lods_                        = has_lods_ || (gpu_commands_ && lods.size() > 1);
+		for (const MeshLod& lod : lods) {
+			lods_.push_back(lod);
+			lod_savings_.push_back((lods[0].index_count - lod.index_count) / 3);
+		}
+	}
+
+	// Lay out the batches; a model with more commands than one call may draw gets several.
+	batches_.clear();
+	batch_models_.clear();
+	batch_sizes_.clear();
+	std::vector<uint32_t> first_batch(models.size());
+	std::vector<uint32_t> batch_objects(models.size());
+	std::vector<uint32_t> batch_first_object;
+	uint32_t first_command = 0, first_object = 0;
+	for (uint32_t m = 0; m < models.size(); ++m) {
+		uint32_t commands_per_object = std::max(cluster_counts[m], 1u);
+		first_batch[m]               = uint32_t(batches_.size());
+		batch_objects[m]             = max_draw_count_ / commands_per_object;
+		for (uint32_t done = 0; done < model_objects[m];) {
+			uint32_t size = std::min(model_objects[m] - done, batch_objects[m]);
+			batches_.push_back({models[m]->IndexCount(), 0, 0, first_command, first_cluster[m],
+			                    cluster_counts[m], first_lod[m],
+			                    uint32_t(models[m]->Lods().size())});
+			batch_models_.push_back(models[m]);
+			batch_sizes_.push_back(size * commands_per_object);
+			batch_first_object.push_back(first_object);
+			first_command += size * commands_per_object;
+			first_object += size;
+			done += size;
+		}
+	}
+	command_count_ = first_command;
+
+	// A batch's objects are contiguous. Without clusters they are also in command order.
+	objects_.resize(instances.size());
+	instance_objects_.resize(instances.size());
+	cluster_groups_.clear();
+	std::vector<uint32_t> model_filled(models.size(), 0);
+	for (size_t i = 0; i < instances.size(); ++i) {
+		const DrawInstance& instance = instances[i];
+		uint32_t m                   = model_index[instance.model];
+		uint32_t position            = model_filled[m]++;
+		uint32_t batch               = first_batch[m] + position / batch_objects[m];
+		uint32_t index               = batch_first_object[batch] + position % batch_objects[m];
+		instance_objects_[i]         = index;
+		Object& object               = objects_[index];
+		object.transform  = instance.transform;
+		object.bounds     = instance.bounds;
+		object.batch      = batch;
+		object.texture    = instance.texture;
+
+		for (uint32_t c = 0; c < cluster_counts[m]; c += kGroupSize) {
+			cluster_groups_.push_back({index, first_cluster[m] + c,
+			                           std::min(cluster_counts[m] - c, kGroupSize), 0});
+		}
+	}
+
+	commands_.clear();
+	if (!gpu_commands_) {
+		commands_.reserve(objects_.size());
+		for (uint32_t i = 0; i < objects_.size(); ++i) {
+			const Batch& batch = batches_[objects_[i].batch];
+			commands_.push_back(vk::DrawIndexedIndirectCommand(batch.index_count, 1,
+			                                                   batch.first_index,
+			                                                   batch.vertex_offset, i));
+		}
+	}
+	reset_lod_states_ = true;
+	++version_;
+}
+
+void GpuScene::UpdateTransforms(const std::vector<DrawInstance>& instances) {
+	if (instances.size() != instance_objects_.size()) {
+		SetInstances(instances);
+		return;
+	}
+	for (size_t i = 0; i < instances.size(); ++i) {
+		objects_[instance_objects_[i]].transform = instances[i].transform;
+	}
+	++version_;
+}
+
+void GpuScene::Prepare(uint32_t slot_index) {
+	// Every frame submitted before a buffer was retired has completed once each slot has been
+	// prepared since.
+	for (size_t i = 0; i < retired_.size();) {
+		if (--retired_[i].prepares_left == 0) {
+			Release(retired_[i].buffer);
+			retired_.erase(retired_.begin() + i);
+		} else {
+			++i;
+		}
+	}
+
+	Slot& slot = slots_[slot_index];
+	if (slot.version == version_) return;
+	slot.version = version_;
+	if (objects_.empty()) return;
+
+	const vk::BufferUsageFlags storage =
+	    vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+	const vk::BufferUsageFlags indirect =
+	    vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst;
+	const vk::PipelineStageFlags readers =
+	    vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eComputeShader;
+
+	vk::DeviceSize object_bytes  = objects_.size() * sizeof(Object);
+	vk::DeviceSize command_bytes = command_count_ * kCommandStride;
+	Reserve(slot.objects, object_bytes, storage);
+	uploader_.UploadBuffer(slot.objects.buffer, 0, objects_.data(), object_bytes, readers,
+	                       vk::AccessFlagBits::eShaderRead);
+
+	if (gpu_commands_) {
+		vk::DeviceSize batch_bytes = batches_.size() * sizeof(Batch);
+		Reserve(slot.batches, batch_bytes, storage);
+		uploader_.UploadBuffer(slot.batches.buffer, 0, batches_.data(), batch_bytes,
+		                       vk::PipelineStageFlagBits::eComputeShader,
+		                       vk::AccessFlagBits::eShaderRead);
+		Reserve(slot.commands, command_bytes, storage | indirect);
+		Reserve(slot.counts, batches_.size() * sizeof(uint32_t), storage | indirect);
+
+		if (!cluster_groups_.empty()) {
+			vk::DeviceSize cluster_bytes = clusters_.size() * sizeof(Cluster);
+			vk::DeviceSize group_bytes   = cluster_groups_.size() * sizeof(ClusterGroup);
+			Reserve(slot.clusters, cluster_bytes, storage);
+			uploader_.UploadBuffer(slot.clusters.buffer, 0, clusters_.data(), cluster_bytes,
+			                       vk::PipelineStageFlagBits::eComputeShader,
+			                       vk::AccessFlagBits::eShaderRead);
+			Reserve(slot.cluster_groups, group_bytes, storage);
+			uploader_.UploadBuffer(slot.cluster_groups.buffer, 0, cluster_groups_.data(),
+			                       group_bytes, vk::PipelineStageFlagBits::eComputeShader,
+			                       vk::AccessFlagBits::eShaderRead);
+		}
+
+		slot.lod_savings.clear();
+		if (has_lods_) {
+			vk::DeviceSize lod_bytes = lods_.size() * sizeof(MeshLod);
+			Reserve(slot.lods, lod_bytes, storage);
+			uploader_.UploadBuffer(slot.lods.buffer, 0, lods_.data(), lod_bytes,
+			                       vk::PipelineStageFlagBits::eComputeShader,
+			                       vk::AccessFlagBits::eShaderRead);
+			Reserve(slot.lod_counts, lods_.size() * sizeof(uint32_t),
+			        vk::BufferUsageFlagBits::eStorageBuffer,
+			        vk::MemoryPropertyFlagBits::eHostVisible |
+			            vk::MemoryPropertyFlagBits::eHostCoherent);
+			slot.lod_savings = lod_savings_;
+
+			// Other slots' frames may still be using the states, so a buffer too small is retired
+			// rather than released.
+			vk::DeviceSize state_bytes = objects_.size() * sizeof(uint32_t);
+			if (state_bytes > lod_states_.size) {
+				vk::DeviceSize size = std::max(state_bytes, lod_states_.size * 2);
+				if (lod_states_.buffer) retired_.push_back({lod_states_, uint32_t(slots_.size())});
+				lod_states_ = Buffer();
+				Reserve(lod_states_, size, storage);
+			}
+		}
+	} else {
+		Reserve(slot.commands, command_bytes, indirect);
+		uploader_.UploadBuffer(slot.commands.buffer, 0, commands_.data(), command_bytes,
+		                       vk::PipelineStageFlagBits::eDrawIndirect,
+		                       vk::AccessFlagBits::eIndirectCommandRead);
+	}
+}
+
+void GpuScene::RecordBuild(vk::CommandBuffer cmd, uint32_t slot_index, const CullParams& cull) {
+	if (!gpu_commands_ || objects_.empty()) return;
+	Slot& slot = slots_[slot_index];
+
+	// The slot's previous frame has completed, so its host-visible buffers are free to reuse.
+	CullData data = {};
+	if (cull.frustum) {
+		data.flags |= kCullFrustum;
+		FrustumCuller::ExtractPlanes(cull.view_projection, data.frustum);
+	}
+	if (cull.pyramid) {
+		vk::Extent2D size = cull.pyramid->Size();
+		data.flags |= kCullOcclusion;
+		data.pyramid_view_projection = cull.pyramid_view_projection;
+		data.pyramid_size            = glm::vec2(size.width, size.height);
+		data.pyramid_levels          = cull.pyramid->LevelCount();
+		data.pyramid_texture         = cull.pyramid->Texture();
+		data.pyramid_sampler         = cull.pyramid->Sampler();
+	}
+	std::optional<glm::vec3> eye = FrustumCuller::ExtractEye(cull.view_projection);
+	if (eye) data.eye = glm::vec4(*eye, 1.0f);
+	if (eye && cull.backface) data.flags |= kCullBackface;
+	float lod_scale = LodScale(cull.view_projection, cull.viewport_height);
+	if (eye && has_lods_ && cull.lod_threshold > 0.0f && lod_scale > 0.0f) {
+		data.flags |= kCullLod;
+		data.lod_scale     = lod_scale;
+		data.lod_threshold = cull.lod_threshold;
+	}
+	std::memcpy(slot.cull.memory.mapped, &data, sizeof(data));
+	std::memset(slot.stats.memory.mapped, 0, kGpuStatsBytes);
+	if (has_lods_) std::memset(slot.lod_counts.memory.mapped, 0, lods_.size() * sizeof(uint32_t));
+	slot.stats_pending = true;
+
+	if (has_lods_ && reset_lod_states_) {
+		// Earlier frames' builds may still be writing the states being cleared.
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+		                    vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(),
+		                    vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite,
+		                                      vk::AccessFlagBits::eTransferWrite),
+		                    nullptr, nullptr);
+		cmd.fillBuffer(lod_states_.buffer, 0, objects_.size() * sizeof(uint32_t), 0);
+		reset_lod_states_ = false;
+	}
+	cmd.fillBuffer(slot.counts.buffer, 0, batches_.size() * sizeof(uint32_t), 0);
+	// Also orders this build's LOD states after the previous frame's, which wrote them last.
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer |
+	                        vk::PipelineStageFlagBits::eComputeShader,
+	                    vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(),
+	                    vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite |
+	                                          vk::AccessFlagBits::eShaderWrite,
+	                                      vk::AccessFlagBits::eShaderRead |
+	                                          vk::AccessFlagBits::eShaderWrite),
+	                    nullptr, nullptr);
+
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, build_pipeline_);
+	bindless_.Bind(cmd, vk::PipelineBindPoint::eCompute, build_layout_);
+	// LOD buffers only exist, and are only read, with has_lods_.
+	uint32_t lods       = slot.lods.index.value_or(0);
+	uint32_t lod_states = lod_states_.index.value_or(0);
+	uint32_t lod_counts = slot.lod_counts.index.value_or(0);
+	BuildConstants constants{*slot.objects.index, *slot.batches.index, *slot.commands.index,
+	                         *slot.counts.index, *slot.cull.index, *slot.stats.index, lods,
+	                         lod_states, lod_counts, ObjectCount()};
+	cmd.pushConstants(build_layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants),
+	                  &constants);
+	cmd.dispatch((ObjectCount() + kGroupSize - 1) / kGroupSize, 1, 1);
+
+	// Objects culled per cluster are skipped above. Both passes only append to their own batches'
+	// command ranges, so they need no barrier between them.
+	if (!cluster_groups_.empty()) {
+		cmd.bindPipeline(vk::PipelineBindPoint::eCompute, cluster_pipeline_);
+		bindless_.Bind(cmd, vk::PipelineBindPoint::eCompute, cluster_layout_);
+		ClusterConstants cluster_constants{
+		    *slot.objects.index, *slot.batches.index, *slot.clusters.index,
+		    *slot.cluster_groups.index, *slot.commands.index, *slot.counts.index,
+		    *slot.cull.index, *slot.stats.index, lods, lod_states, lod_counts,
+		    uint32_t(cluster_groups_.size())};
+		cmd.pushConstants(cluster_layout_, vk::ShaderStageFlagBits::eCompute, 0,
+		                  sizeof(cluster_constants), &cluster_constants);
+		// One workgroup per cluster group, in rows for scenes with more than a row's worth.
+		uint32_t groups = uint32_t(cluster_groups_.size());
+		uint32_t width  = std::min(groups, kMaxDispatchWidth);
+		cmd.dispatch(width, (groups + width - 1) / width, 1);
+	}
+
+	// The counters are read on the host once the frame's fence has signaled.
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+	                    vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eHost,
+	                    vk::DependencyFlags(),
+	                    vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite,
+	                                      vk::AccessFlagBits::eIndirectCommandRead |
+	                                          vk::AccessFlagBits::eHostRead),
+	                    nullptr, nullptr);
+}
+
+std::optional<GpuScene::CullStats> GpuScene::ReadStats(uint32_t slot_index) {
+	Slot& slot = slots_[slot_index];
+	if (!slot.stats_pending) return std::nullopt;
+	slot.stats_pending = false;
+
+	CullStats stats;
+	std::memcpy(&stats, slot.stats.memory.mapped, kGpuStatsBytes);
+	stats.lod_triangles_saved = 0;
+	if (!slot.lod_savings.empty()) {
+		auto counts = static_cast<const uint32_t*>(slot.lod_counts.memory.mapped);
+		for (size_t l = 0; l < slot.lod_savings.size(); ++l) {
+			stats.lod_triangles_saved += uint64_t(counts[l]) * slot.lod_savings[l];
+		}
+	}
+	return stats;
+}
+
+void GpuScene::RecordDraws(vk::CommandBuffer cmd, uint32_t slot_index) const {
+	if (objects_.empty()) return;
+	const Slot& slot = slots_[slot_index];
+
+	const Model* bound = nullptr;
+	for (uint32_t b = 0; b < batches_.size(); ++b) {
+		if (batch_models_[b] != bound) {
+			batch_models_[b]->Bind(cmd);
+			bound = batch_models_[b];
+		}
+		vk::DeviceSize offset = batches_[b].first_command * kCommandStride;
+		if (gpu_commands_) {
+			cmd.drawIndexedIndirectCountKHR(slot.commands.buffer, offset, slot.counts.buffer,
+			                                b * sizeof(uint32_t), batch_sizes_[b],
+			                                uint32_t(kCommandStride));
+		} else {
+			cmd.drawIndexedIndirect(slot.commands.buffer, offset, batch_sizes_[b],
+			                        uint32_t(kCommandStride));
+		}
+	}
+}
+
+void GpuScene::Reserve(Buffer& buffer, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                       vk::MemoryPropertyFlags properties) {
+	if (size <= buffer.size) return;
+	// Grow geometrically so a scene that streams in doesn't reallocate every frame.
+	size = std::max(size, buffer.size * 2);
+	Release(buffer);
+	buffer = CreateBindlessBuffer(device_, allocator_, bindless_, size, usage, properties);
+}
+
+void GpuScene::Release(Buffer& buffer) {
+	ReleaseBindlessBuffer(device_, allocator_, bindless_, buffer);
+}
@@ -0,0 +1,184 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+namespace {
+
+// The pool the calling thread belongs to, if any, and its worker index there.
+thread_local const JobSystem* current_system = nullptr;
+thread_local uint32_t current_worker         = 0;
+
+}  // namespace
+
+JobSystem::JobSystem(uint32_t thread_count) {
+	if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+	for (uint32_t i = 0; i < thread_count; ++i) deques_.push_back(std::make_unique<Deque>());
+	for (uint32_t i = 1; i < thread_count; ++i) {
+		threads_.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		stopping_ = true;
+	}
+	wake_.notify_all();
+	for (std::thread& thread : threads_) thread.join();
+}
+
+uint32_t JobSystem::CurrentWorker() const {
+	return current_system == this ? current_worker : 0;
+}
+
+void JobSystem::Schedule(Job job, JobCounter* counter) {
+	if (counter) counter->pending_.fetch_add(1, std::memory_order_relaxed);
+	Deque& deque = *deques_[CurrentWorker()];
+	Push(deque.jobs, deque.mutex, {std::move(job), counter});
+}
+
+void JobSystem::ScheduleBackground(Job job, JobCounter* counter) {
+	if (counter) counter->pending_.fetch_add(1, std::memory_order_relaxed);
+	Entry entry{std::move(job), counter};
+	if (threads_.empty()) {
+		Execute(entry);
+		return;
+	}
+	Push(background_.jobs, background_.mutex, std::move(entry));
+}
+
+void JobSystem::Push(std::deque<Entry>& queue, std::mutex& mutex, Entry entry) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(std::move(entry));
+	}
+	queued_.fetch_add(1);
+	// Sleepers check queued_ under sleep_mutex_, so taking it here means a thread about to sleep
+	// either sees the new job or is already waiting when notified.
+	if (sleeping_.load() > 0) {
+		{ std::lock_guard<std::mutex> lock(sleep_mutex_); }
+		wake_.notify_one();
+	}
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	uint32_t worker = CurrentWorker();
+	Entry entry;
+	while (!counter.Done()) {
+		if (Take(worker, false, entry)) {
+			Execute(entry);
+		} else {
+			// What is left is running on other threads.
+			std::this_thread::yield();
+		}
+	}
+
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(counter.mutex_);
+		std::swap(error, counter.error_);
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+void JobSystem::ParallelFor(uint32_t count, const RangeFn& fn, uint32_t grain) {
+	if (count == 0) return;
+	if (grain == 0) grain = std::max(1u, count / (Size() * kRangesPerThread));
+	uint32_t ranges = (count + grain - 1) / grain;
+	if (ranges == 1 || threads_.empty()) {
+		fn(0, count);
+		return;
+	}
+
+	std::atomic<uint32_t> next{0};
+	auto drain = [&] {
+		for (uint32_t range; (range = next.fetch_add(1, std::memory_order_relaxed)) < ranges;) {
+			uint32_t begin = range * grain;
+			fn(begin, std::min(count, begin + grain));
+		}
+	};
+	// One job per thread that could help; late ones find the cursor exhausted and return at once.
+	JobCounter counter;
+	uint32_t helpers = std::min(ranges, Size()) - 1;
+	for (uint32_t i = 0; i < helpers; ++i) Schedule(drain, &counter);
+
+	// The helpers refer to this frame, so they have to finish even if a range throws here.
+	std::exception_ptr error;
+	try {
+		drain();
+	} catch (...) {
+		error = std::current_exception();
+		next.store(ranges, std::memory_order_relaxed);
+	}
+	try {
+		Wait(counter);
+	} catch (...) {
+		if (!error) error = std::current_exception();
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+void JobSystem::WorkerLoop(uint32_t worker) {
+	current_system = this;
+	current_worker = worker;
+	Entry entry;
+	for (;;) {
+		if (Take(worker, true, entry)) {
+			Execute(entry);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex_);
+		sleeping_.fetch_add(1);
+		wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+		sleeping_.fetch_sub(1);
+		if (stopping_ && queued_.load() == 0) return;
+	}
+}
+
+bool JobSystem::Take(uint32_t worker, bool background, Entry& out) {
+	if (queued_.load(std::memory_order_relaxed) == 0) return false;
+
+	auto pop = [&](Deque& deque, bool back) {
+		std::lock_guard<std::mutex> lock(deque.mutex);
+		if (deque.jobs.empty()) return false;
+		if (back) {
+			out = std::move(deque.jobs.back());
+			deque.jobs.pop_back();
+		} else {
+			out = std::move(deque.jobs.front());
+			deque.jobs.pop_front();
+		}
+		queued_.fetch_sub(1);
+		return true;
+	};
+
+	if (pop(*deques_[worker], true)) return true;
+	// Victims in turn from the next worker on, so thieves spread over the deques.
+	uint32_t count = uint32_t(deques_.size());
+	for (uint32_t i = 1; i < count; ++i) {
+		if (pop(*deques_[(worker + i) % count], false)) {
+			jobs_stolen_.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return background && pop(background_, false);
+}
+
+void JobSystem::Execute(Entry& entry) {
+	JobCounter* counter = entry.counter;
+	if (counter) {
+		try {
+			entry.job();
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(counter->mutex_);
+			if (!counter->error_) counter->error_ = std::current_exception();
+		}
+	} else {
+		entry.job();
+	}
+	// Release the job's captures before the counter lets a waiter tear them down.
+	entry.job = nullptr;
+	jobs_run_.fetch_add(1, std::memory_order_relaxed);
+	if (counter) counter->pending_.fetch_sub(1, std::memory_order_acq_rel);
+}
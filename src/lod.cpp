@@ -0,0 +1,35 @@
+#include "lod.h"
+
+#include <limits>
+
+float LodScale(const glm::mat4& m, uint32_t viewport_height) {
+	// A perspective projection scales y by its focal length and puts the view depth in w, so the
+	// ratio of those rows' lengths is the focal length whatever the view's rotation.
+	float y = glm::length(glm::vec3(m[0][1], m[1][1], m[2][1]));
+	float w = glm::length(glm::vec3(m[0][3], m[1][3], m[2][3]));
+	if (w < 1e-6f) return 0.0f;
+	return 0.5f * float(viewport_height) * y / w;
+}
+
+float LodPixelsPerUnit(const glm::mat4& transform, const glm::vec4& bounds, const glm::vec3& eye,
+                       float lod_scale) {
+	glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(bounds), 1.0f));
+	float scale      = std::max(glm::length(glm::vec3(transform[0])),
+	                            std::max(glm::length(glm::vec3(transform[1])),
+	                                     glm::length(glm::vec3(transform[2]))));
+	float distance   = glm::length(center - eye) - bounds.w * scale;
+	if (distance <= 0.0f) return std::numeric_limits<float>::infinity();
+	return lod_scale * scale / distance;
+}
+
+uint32_t SelectLod(const std::vector<MeshLod>& lods, float pixels_per_unit,
+                   float threshold_pixels, uint32_t current) {
+	uint32_t fine = 0, coarse = 0;
+	for (uint32_t l = 1; l < lods.size(); ++l) {
+		float pixels = lods[l].error * pixels_per_unit;
+		if (pixels <= threshold_pixels) fine = l;
+		if (pixels <= threshold_pixels * kLodHysteresis) coarse = l;
+	}
+	if (current > fine) return fine;
+	return std::max(current, coarse);
+}
@@ -1,17 +1,108 @@
-#include "triangle.h"
+#include "engine.h"
+#include "gltf_file.h"
+#include "mesh_file.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 
+#include <cstring>
 #include <iostream>
 
-int main() {
-  Triangle triangle;
+namespace {
+
+void PrintUsage(const char* program) {
+  std::cout << "Usage: " << program << " [options]\n"
+            << "  --headless         Render offscreen without a window or swapchain\n"
+            << "  --frames <n>       Frames to render (default: until closed, 1 headless)\n"
+            << "  --width <px>       Render width (default: 800)\n"
+            << "  --height <px>      Render height (default: 600)\n"
+            << "  --output <file>    Headless only: write the last frame as a PPM\n"
+            << "  --model <file>     Load any mesh file Assimp reads asynchronously, or\n"
+            << "                     a .mesh file cooked by meshcook or a .gltf/.glb scene\n"
+            << "                     synchronously\n"
+            << "  --texture <file>   Texture the default triangle with a KTX, DDS or KMG file, or\n"
+            << "                     a .vtex virtual texture cooked by vtcook; not with --model\n"
+            << "  --cache-pages <n>  Pages in the virtual texture cache (default: 256)\n"
+            << "  --draw-path <p>    direct or indirect (default: indirect)\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  EngineConfig config;
+  std::vector<std::string> models;
+  std::string texture;
+
+  for (int i = 1; i < argc; ++i) {
+    auto value = [&]() -> const char* {
+      if (i + 1 >= argc) throw std::invalid_argument(std::string("Missing value for ") + argv[i]);
+      return argv[++i];
+    };
+
+    try {
+      if (!std::strcmp(argv[i], "--headless")) {
+        config.headless = true;
+      } else if (!std::strcmp(argv[i], "--frames")) {
+        config.frame_count = std::stoul(value());
+      } else if (!std::strcmp(argv[i], "--width")) {
+        config.width = std::stoul(value());
+      } else if (!std::strcmp(argv[i], "--height")) {
+        config.height = std::stoul(value());
+      } else if (!std::strcmp(argv[i], "--output")) {
+        config.readback_path = value();
+      } else if (!std::strcmp(argv[i], "--model")) {
+        models.push_back(value());
+      } else if (!std::strcmp(argv[i], "--texture")) {
+        texture = value();
+      } else if (!std::strcmp(argv[i], "--cache-pages")) {
+        config.virtual_texture_cache_pages = std::stoul(value());
+      } else if (!std::strcmp(argv[i], "--draw-path")) {
+        std::string path = value();
+        if (path != "direct" && path != "indirect") {
+          throw std::invalid_argument("Unknown draw path: " + path);
+        }
+        config.draw_path = path == "direct" ? DrawPath::eDirect : DrawPath::eIndirect;
+      } else {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } catch (const std::exception& e) {
+      std::cout << "Invalid arguments: " << e.what() << std::endl;
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Models bring their own materials, so there is nothing for the texture to go on.
+  if (!texture.empty() && !models.empty()) {
+    std::cout << "Invalid arguments: --texture can't be combined with --model" << std::endl;
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
 
   try {
-    triangle.Run();
+    Engine engine(config);
+    if (models.empty()) {
+      uint32_t index = Engine::kWhiteTexture;
+      if (IsVirtualTextureFile(texture)) {
+        index = engine.LoadVirtualTexture(texture);
+      } else if (!texture.empty()) {
+        index = engine.LoadTexture(texture);
+      }
+      engine.AddInstance(engine.AddModel(Model::Triangle()), glm::mat4(1.0f), index);
+    }
+    for (const std::string& model : models) {
+      if (IsMeshFile(model)) {
+        engine.LoadCookedModel(model, glm::mat4(1.0f));
+      } else if (IsGltfFile(model)) {
+        engine.LoadGltf(model);
+      } else {
+        engine.LoadModelAsync(model, glm::mat4(1.0f));
+      }
+    }
+    engine.Run();
   } catch (const std::exception& e) {
     std::cout << "Error occurred: " << e.what() << std::endl;
     return EXIT_FAILURE;
@@ -0,0 +1,68 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+	file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                    FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE) {
+		file_ = nullptr;
+		throw std::runtime_error("Failed to open file: " + path);
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+		CloseHandle(file_);
+		throw std::runtime_error("Empty or unreadable file: " + path);
+	}
+	size_    = size_t(size.QuadPart);
+	mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	data_    = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!data_) {
+		if (mapping_) CloseHandle(mapping_);
+		CloseHandle(file_);
+		throw std::runtime_error("Failed to map file: " + path);
+	}
+}
+
+MappedFile::~MappedFile() {
+	UnmapViewOfFile(data_);
+	CloseHandle(mapping_);
+	CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Failed to open file: " + path);
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close(fd);
+		throw std::runtime_error("Empty or unreadable file: " + path);
+	}
+	size_ = size_t(info.st_size);
+	data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file referenced on its own.
+	close(fd);
+	if (data_ == MAP_FAILED) {
+		data_ = nullptr;
+		throw std::runtime_error("Failed to map file: " + path);
+	}
+	// Uploads read the file front to back.
+	madvise(data_, size_, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() { munmap(data_, size_); }
+
+#endif
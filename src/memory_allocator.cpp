@@ -0,0 +1,268 @@
+#include "memory_allocator.h"
+
+// One vkAllocateMemory'd range, carved up by a BuddyBlock.
+struct MemoryBlock {
+	explicit MemoryBlock(uint32_t max_order) : buddy(max_order) {}
+
+	vk::DeviceMemory memory;
+	vk::DeviceSize size       = 0;
+	uint8_t* mapped           = nullptr;
+	uint32_t pool_index       = 0;
+	uint32_t live_allocations = 0;
+	BuddyBlock buddy;
+};
+
+uint32_t BuddyBlock::OrderFor(vk::DeviceSize size) {
+	uint32_t order = 0;
+	while (OrderSize(order) < size) ++order;
+	return order;
+}
+
+BuddyBlock::BuddyBlock(uint32_t max_order) : free_lists_(max_order + 1) {
+	free_lists_[max_order].insert(0);
+}
+
+bool BuddyBlock::CanAllocate(uint32_t order) const {
+	for (; order <= MaxOrder(); ++order) {
+		if (!free_lists_[order].empty()) return true;
+	}
+	return false;
+}
+
+vk::DeviceSize BuddyBlock::Allocate(uint32_t order) {
+	uint32_t found = order;
+	while (found <= MaxOrder() && free_lists_[found].empty()) ++found;
+	if (found > MaxOrder()) throw std::runtime_error("No free range in buddy block");
+
+	vk::DeviceSize offset = *free_lists_[found].begin();
+	free_lists_[found].erase(free_lists_[found].begin());
+	while (found > order) {
+		--found;
+		free_lists_[found].insert(offset + OrderSize(found));
+	}
+	return offset;
+}
+
+void BuddyBlock::Free(vk::DeviceSize offset, uint32_t order) {
+	while (order < MaxOrder()) {
+		vk::DeviceSize buddy = offset ^ OrderSize(order);
+		auto it              = free_lists_[order].find(buddy);
+		if (it == free_lists_[order].end()) break;
+		free_lists_[order].erase(it);
+		offset = std::min(offset, buddy);
+		++order;
+	}
+	free_lists_[order].insert(offset);
+}
+
+vk::DeviceSize BuddyBlock::FreeBytes() const {
+	vk::DeviceSize bytes = 0;
+	for (uint32_t order = 0; order <= MaxOrder(); ++order) {
+		bytes += free_lists_[order].size() * OrderSize(order);
+	}
+	return bytes;
+}
+
+vk::DeviceSize BuddyBlock::LargestFree() const {
+	for (uint32_t order = MaxOrder() + 1; order-- > 0;) {
+		if (!free_lists_[order].empty()) return OrderSize(order);
+	}
+	return 0;
+}
+
+MemoryAllocator::MemoryAllocator(vk::PhysicalDevice physical_device, vk::Device device,
+                                 vk::DeviceSize block_size)
+    : device_(device),
+      memory_properties_(physical_device.getMemoryProperties()),
+      block_size_(BuddyBlock::OrderSize(BuddyBlock::OrderFor(block_size))) {}
+
+MemoryAllocator::~MemoryAllocator() {
+	for (Pool& pool : pools_) {
+		for (auto& block : pool.blocks) {
+			if (block->mapped) device_.unmapMemory(block->memory);
+			device_.freeMemory(block->memory);
+		}
+	}
+}
+
+Allocation MemoryAllocator::Allocate(const vk::MemoryRequirements& requirements,
+                                     vk::MemoryPropertyFlags properties, ResourceTiling tiling) {
+	uint32_t memory_type = FindMemoryType(requirements.memoryTypeBits, properties);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// Buddy ranges are aligned to their own size, so rounding up to the alignment is enough.
+	vk::DeviceSize rounded = std::max(requirements.size, requirements.alignment);
+
+	Pool& pool = GetPool(memory_type, tiling);
+	if (rounded > pool.block_size / 2) return AllocateDedicated(requirements, memory_type);
+	uint32_t order = BuddyBlock::OrderFor(rounded);
+
+	MemoryBlock* block = nullptr;
+	for (auto& candidate : pool.blocks) {
+		if (candidate->buddy.CanAllocate(order)) {
+			block = candidate.get();
+			break;
+		}
+	}
+	if (!block) block = CreateBlock(pool);
+	vk::DeviceSize offset = block->buddy.Allocate(order);
+
+	Allocation allocation;
+	allocation.memory = block->memory;
+	allocation.offset = offset;
+	allocation.size   = requirements.size;
+	allocation.mapped = block->mapped ? block->mapped + offset : nullptr;
+	allocation.block  = block;
+	allocation.order  = order;
+
+	++block->live_allocations;
+	++allocation_count_;
+	used_ += requirements.size;
+	allocated_ += BuddyBlock::OrderSize(order);
+	return allocation;
+}
+
+void MemoryAllocator::Free(Allocation& allocation) {
+	if (!allocation) return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	--allocation_count_;
+	used_ -= allocation.size;
+
+	MemoryBlock* block = allocation.block;
+	if (!block) {
+		if (allocation.mapped) device_.unmapMemory(allocation.memory);
+		device_.freeMemory(allocation.memory);
+		--dedicated_count_;
+		dedicated_bytes_ -= allocation.size;
+		allocated_ -= allocation.size;
+		allocation = Allocation();
+		return;
+	}
+
+	allocated_ -= BuddyBlock::OrderSize(allocation.order);
+	block->buddy.Free(allocation.offset, allocation.order);
+	--block->live_allocations;
+
+	// Keep one empty block around per pool so alloc/free churn doesn't hit the driver.
+	Pool& pool = pools_[block->pool_index];
+	if (block->live_allocations == 0 && pool.blocks.size() > 1) DestroyBlock(block);
+
+	allocation = Allocation();
+}
+
+Allocation MemoryAllocator::AllocateBuffer(vk::Buffer buffer, vk::MemoryPropertyFlags properties) {
+	Allocation allocation = Allocate(device_.getBufferMemoryRequirements(buffer), properties,
+	                                 ResourceTiling::eLinear);
+	device_.bindBufferMemory(buffer, allocation.memory, allocation.offset);
+	return allocation;
+}
+
+Allocation MemoryAllocator::AllocateImage(vk::Image image, vk::MemoryPropertyFlags properties,
+                                          ResourceTiling tiling) {
+	Allocation allocation = Allocate(device_.getImageMemoryRequirements(image), properties, tiling);
+	device_.bindImageMemory(image, allocation.memory, allocation.offset);
+	return allocation;
+}
+
+MemoryStats MemoryAllocator::Stats() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	MemoryStats stats;
+	stats.used             = used_;
+	stats.allocated        = allocated_;
+	stats.reserved         = dedicated_bytes_;
+	stats.dedicated_count  = dedicated_count_;
+	stats.allocation_count = allocation_count_;
+
+	vk::DeviceSize free_bytes = 0, largest_free = 0;
+	for (const Pool& pool : pools_) {
+		for (const auto& block : pool.blocks) {
+			++stats.block_count;
+			stats.reserved += block->size;
+			free_bytes += block->buddy.FreeBytes();
+			largest_free = std::max(largest_free, block->buddy.LargestFree());
+		}
+	}
+	if (free_bytes > 0) stats.fragmentation = 1.0 - double(largest_free) / double(free_bytes);
+	return stats;
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t type_bits,
+                                         vk::MemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; ++i) {
+		if ((type_bits & (1u << i)) &&
+		    (memory_properties_.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+	throw std::runtime_error("Failed to find a suitable memory type");
+}
+
+MemoryAllocator::Pool& MemoryAllocator::GetPool(uint32_t memory_type, ResourceTiling tiling) {
+	for (Pool& pool : pools_) {
+		if (pool.memory_type == memory_type && pool.tiling == tiling) return pool;
+	}
+	// Small heaps (e.g. the 256 MiB device-local + host-visible heap on some GPUs) get smaller
+	// blocks so that a single block can't claim most of the heap.
+	uint32_t heap_index = memory_properties_.memoryTypes[memory_type].heapIndex;
+	vk::DeviceSize size = block_size_;
+	while (size > kMinAllocation && size > memory_properties_.memoryHeaps[heap_index].size / 8) {
+		size /= 2;
+	}
+
+	Pool pool;
+	pool.memory_type = memory_type;
+	pool.tiling      = tiling;
+	pool.block_size  = size;
+	pools_.push_back(std::move(pool));
+	return pools_.back();
+}
+
+MemoryBlock* MemoryAllocator::CreateBlock(Pool& pool) {
+	auto block    = std::make_unique<MemoryBlock>(BuddyBlock::OrderFor(pool.block_size));
+	block->memory =
+	    device_.allocateMemory(vk::MemoryAllocateInfo(pool.block_size, pool.memory_type));
+
+	block->size       = pool.block_size;
+	block->pool_index = uint32_t(&pool - pools_.data());
+
+	// Host-visible blocks stay mapped for their whole lifetime; memory can only be mapped once.
+	if (memory_properties_.memoryTypes[pool.memory_type].propertyFlags &
+	    vk::MemoryPropertyFlagBits::eHostVisible) {
+		block->mapped = static_cast<uint8_t*>(device_.mapMemory(block->memory, 0, VK_WHOLE_SIZE));
+	}
+
+	pool.blocks.push_back(std::move(block));
+	return pool.blocks.back().get();
+}
+
+void MemoryAllocator::DestroyBlock(MemoryBlock* block) {
+	Pool& pool = pools_[block->pool_index];
+	auto it    = std::find_if(pool.blocks.begin(), pool.blocks.end(),
+                           [block](const auto& candidate) { return candidate.get() == block; });
+	if (block->mapped) device_.unmapMemory(block->memory);
+	device_.freeMemory(block->memory);
+	pool.blocks.erase(it);
+}
+
+Allocation MemoryAllocator::AllocateDedicated(const vk::MemoryRequirements& requirements,
+                                              uint32_t memory_type) {
+	Allocation allocation;
+	allocation.size   = requirements.size;
+	allocation.memory =
+	    device_.allocateMemory(vk::MemoryAllocateInfo(allocation.size, memory_type));
+	if (memory_properties_.memoryTypes[memory_type].propertyFlags &
+	    vk::MemoryPropertyFlagBits::eHostVisible) {
+		allocation.mapped = device_.mapMemory(allocation.memory, 0, VK_WHOLE_SIZE);
+	}
+
+	++dedicated_count_;
+	++allocation_count_;
+	dedicated_bytes_ += requirements.size;
+	used_ += requirements.size;
+	allocated_ += requirements.size;
+	return allocation;
+}
@@ -0,0 +1,219 @@
+#include "mesh_file.h"
+
+#include "file_util.h"
+
+#include <cstring>
+
+namespace {
+
+uint64_t AlignUp(uint64_t value) {
+	return (value + kMeshFileAlignment - 1) / kMeshFileAlignment * kMeshFileAlignment;
+}
+
+// Whether count elements of size bytes at offset lie inside a file of file_size bytes.
+bool InFile(uint64_t offset, uint64_t count, uint64_t size, uint64_t file_size) {
+	return offset <= file_size && count <= (file_size - offset) / size;
+}
+
+void CopyString(char* out, size_t capacity, const std::string& value) {
+	std::memset(out, 0, capacity);
+	std::memcpy(out, value.data(), std::min(value.size(), capacity - 1));
+}
+
+}  // namespace
+
+bool IsMeshFile(const std::string& path) {
+	return HasExtension(path, {"mesh"});
+}
+
+MeshFile::MeshFile(const std::string& path) : file_(path) {
+	uint64_t size = file_.Size();
+	auto base     = static_cast<const uint8_t*>(file_.Data());
+	header_       = reinterpret_cast<const MeshFileHeader*>(base);
+	if (size < sizeof(MeshFileHeader) || header_->magic != kMeshFileMagic) {
+		throw std::runtime_error("Not a cooked mesh file: " + path);
+	}
+	if (header_->version != kMeshFileVersion) {
+		throw std::runtime_error("Cooked mesh file " + path + " has version " +
+		                         std::to_string(header_->version) + ", expected " +
+		                         std::to_string(kMeshFileVersion) + "; cook it again");
+	}
+	if (header_->file_size != size ||
+	    !InFile(sizeof(MeshFileHeader), header_->mesh_count, sizeof(MeshFileMesh), size)) {
+		throw std::runtime_error("Truncated cooked mesh file: " + path);
+	}
+	meshes_       = reinterpret_cast<const MeshFileMesh*>(base + sizeof(MeshFileHeader));
+	uint64_t next = sizeof(MeshFileHeader) + uint64_t(header_->mesh_count) * sizeof(MeshFileMesh);
+	if (!InFile(next, header_->material_count, sizeof(MeshFileMaterial), size)) {
+		throw std::runtime_error("Truncated cooked mesh file: " + path);
+	}
+	materials_ = reinterpret_cast<const MeshFileMaterial*>(base + next);
+
+	for (uint32_t i = 0; i < header_->mesh_count; ++i) {
+		const MeshFileMesh& mesh = meshes_[i];
+		bool valid = (mesh.index_size == 2 || mesh.index_size == 4) &&
+		             mesh.material < std::max(1u, header_->material_count) &&
+		             InFile(mesh.vertices_offset, mesh.vertex_count, sizeof(Vertex), size) &&
+		             InFile(mesh.indices_offset, mesh.index_count, mesh.index_size, size) &&
+		             mesh.lod_count > 0 &&
+		             InFile(mesh.lods_offset, mesh.lod_count, sizeof(MeshLod), size) &&
+		             InFile(mesh.meshlets_offset, mesh.meshlet_count, sizeof(Meshlet), size) &&
+		             InFile(mesh.meshlet_vertices_offset, mesh.meshlet_vertex_count, 4, size) &&
+		             InFile(mesh.meshlet_triangles_offset, mesh.meshlet_triangle_bytes, 1, size);
+		for (uint64_t offset : {mesh.vertices_offset, mesh.indices_offset, mesh.lods_offset,
+		                        mesh.meshlets_offset, mesh.meshlet_vertices_offset,
+		                        mesh.meshlet_triangles_offset}) {
+			valid = valid && offset % kMeshFileAlignment == 0;
+		}
+		if (!valid) throw std::runtime_error("Corrupt mesh table in " + path);
+		// LOD ranges feed draw calls as they are, so they are checked against the indices here.
+		auto lods = reinterpret_cast<const MeshLod*>(base + mesh.lods_offset);
+		for (uint32_t l = 0; l < mesh.lod_count; ++l) {
+			if (lods[l].first_index > mesh.index_count ||
+			    lods[l].index_count > mesh.index_count - lods[l].first_index) {
+				throw std::runtime_error("Corrupt LOD table in " + path);
+			}
+		}
+		// So are index values and meshlet ranges, which shaders and culling read unchecked.
+		const uint8_t* indices = base + mesh.indices_offset;
+		for (uint32_t j = 0; j < mesh.index_count; ++j) {
+			uint32_t index = 0;
+			std::memcpy(&index, indices + size_t(j) * mesh.index_size, mesh.index_size);
+			if (index >= mesh.vertex_count) {
+				throw std::runtime_error("Index out of range in " + path);
+			}
+		}
+		auto meshlets            = reinterpret_cast<const Meshlet*>(base + mesh.meshlets_offset);
+		auto meshlet_vertices    = reinterpret_cast<const uint32_t*>(base +
+		                                                             mesh.meshlet_vertices_offset);
+		const uint8_t* triangles = base + mesh.meshlet_triangles_offset;
+		for (uint32_t m = 0; m < mesh.meshlet_count; ++m) {
+			const Meshlet& meshlet = meshlets[m];
+			uint64_t vertex_end    = uint64_t(meshlet.vertex_offset) + meshlet.vertex_count;
+			uint64_t triangle_end  = meshlet.triangle_offset + 3 * uint64_t(meshlet.triangle_count);
+			// Cluster culling also draws a meshlet's triangles as that range of the indices.
+			if (vertex_end > mesh.meshlet_vertex_count ||
+			    triangle_end > mesh.meshlet_triangle_bytes || triangle_end > mesh.index_count) {
+				throw std::runtime_error("Corrupt meshlet table in " + path);
+			}
+			for (uint32_t v = 0; v < meshlet.vertex_count; ++v) {
+				if (meshlet_vertices[meshlet.vertex_offset + v] >= mesh.vertex_count) {
+					throw std::runtime_error("Corrupt meshlet table in " + path);
+				}
+			}
+			for (uint32_t t = 0; t < 3 * meshlet.triangle_count; ++t) {
+				if (triangles[meshlet.triangle_offset + t] >= meshlet.vertex_count) {
+					throw std::runtime_error("Corrupt meshlet table in " + path);
+				}
+			}
+		}
+	}
+}
+
+MeshFileView MeshFile::Mesh(uint32_t index) const {
+	const MeshFileMesh& mesh = meshes_[index];
+	auto base                = static_cast<const uint8_t*>(file_.Data());
+	return {&mesh,
+	        reinterpret_cast<const Vertex*>(base + mesh.vertices_offset),
+	        base + mesh.indices_offset,
+	        reinterpret_cast<const MeshLod*>(base + mesh.lods_offset),
+	        reinterpret_cast<const Meshlet*>(base + mesh.meshlets_offset),
+	        reinterpret_cast<const uint32_t*>(base + mesh.meshlet_vertices_offset),
+	        base + mesh.meshlet_triangles_offset};
+}
+
+void WriteMeshFile(const std::string& path, const std::vector<MeshData>& meshes,
+                   const std::vector<MaterialData>& materials) {
+	MeshFileHeader header{kMeshFileMagic, kMeshFileVersion, uint32_t(meshes.size()),
+	                      uint32_t(materials.size()), 0};
+
+	// Lay every blob out first; the tables at the front hold their offsets.
+	std::vector<MeshFileMesh> table(meshes.size());
+	std::vector<std::vector<MeshLod>> lods(meshes.size());
+	std::vector<std::vector<uint16_t>> short_indices(meshes.size());
+	uint64_t offset = sizeof(MeshFileHeader) + table.size() * sizeof(MeshFileMesh) +
+	                  materials.size() * sizeof(MeshFileMaterial);
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		const MeshData& mesh = meshes[i];
+		if (mesh.vertices.empty() || mesh.indices.empty()) throw std::runtime_error("Empty mesh");
+		if (mesh.material >= std::max<size_t>(1, materials.size())) {
+			throw std::runtime_error("Mesh material out of range");
+		}
+		MeshFileMesh& entry = table[i];
+		glm::vec4 bounds;
+		glm::vec3 extents;
+		Model::ComputeBounds(mesh.vertices, bounds, extents);
+		for (int c = 0; c < 4; ++c) entry.bounds[c] = bounds[c];
+		for (int c = 0; c < 3; ++c) entry.extents[c] = extents[c];
+		entry.material     = mesh.material;
+		entry.vertex_count = uint32_t(mesh.vertices.size());
+		entry.index_count  = uint32_t(mesh.indices.size());
+		// Stored the way Model uploads them, 16 bit whenever the vertex count allows it.
+		entry.index_size = 4;
+		if (mesh.vertices.size() <= std::numeric_limits<uint16_t>::max() + 1u) {
+			entry.index_size = 2;
+			short_indices[i].assign(mesh.indices.begin(), mesh.indices.end());
+		}
+
+		lods[i] = mesh.lods;
+		if (lods[i].empty()) lods[i].push_back({0, entry.index_count, 0.0f});
+		entry.lod_count = uint32_t(lods[i].size());
+
+		const MeshletData& meshlets  = mesh.meshlets;
+		entry.meshlet_count          = uint32_t(meshlets.meshlets.size());
+		entry.meshlet_vertex_count   = uint32_t(meshlets.vertices.size());
+		entry.meshlet_triangle_bytes = uint32_t(meshlets.triangles.size());
+
+		auto place = [&](uint64_t& field, uint64_t bytes) {
+			offset = AlignUp(offset);
+			field  = offset;
+			offset += bytes;
+		};
+		place(entry.vertices_offset, mesh.vertices.size() * sizeof(Vertex));
+		place(entry.indices_offset, mesh.indices.size() * entry.index_size);
+		place(entry.lods_offset, lods[i].size() * sizeof(MeshLod));
+		place(entry.meshlets_offset, meshlets.meshlets.size() * sizeof(Meshlet));
+		place(entry.meshlet_vertices_offset, meshlets.vertices.size() * sizeof(uint32_t));
+		place(entry.meshlet_triangles_offset, meshlets.triangles.size());
+	}
+	header.file_size = offset;
+
+	WriteFileAtomically(path, [&](std::ostream& file) {
+		// Blobs are laid out in write order, so the gap before each is less than the alignment.
+		uint64_t written = 0;
+
+		auto write = [&](const void* data, uint64_t bytes, uint64_t at) {
+			static const char kPadding[kMeshFileAlignment] = {};
+			file.write(kPadding, std::streamsize(at - written));
+			file.write(static_cast<const char*>(data), std::streamsize(bytes));
+			written = at + bytes;
+		};
+
+		write(&header, sizeof(header), 0);
+		write(table.data(), table.size() * sizeof(MeshFileMesh), written);
+		for (const MaterialData& material : materials) {
+			MeshFileMaterial entry;
+			CopyString(entry.name, sizeof(entry.name), material.name);
+			for (int c = 0; c < 4; ++c) entry.base_color[c] = material.base_color[c];
+			CopyString(entry.texture, sizeof(entry.texture), material.texture);
+			write(&entry, sizeof(entry), written);
+		}
+		for (size_t i = 0; i < meshes.size(); ++i) {
+			const MeshFileMesh& entry = table[i];
+			const void* indices       = entry.index_size == 2
+			                                ? static_cast<const void*>(short_indices[i].data())
+			                                : static_cast<const void*>(meshes[i].indices.data());
+			write(meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex),
+			      entry.vertices_offset);
+			write(indices, uint64_t(entry.index_count) * entry.index_size, entry.indices_offset);
+			write(lods[i].data(), lods[i].size() * sizeof(MeshLod), entry.lods_offset);
+			const MeshletData& meshlets = meshes[i].meshlets;
+			write(meshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(Meshlet),
+			      entry.meshlets_offset);
+			write(meshlets.vertices.data(), meshlets.vertices.size() * sizeof(uint32_t),
+			      entry.meshlet_vertices_offset);
+			write(meshlets.triangles.data(), meshlets.triangles.size(),
+			      entry.meshlet_triangles_offset);
+		}
+	});
+}
@@ -0,0 +1,237 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+const uint32_t kNone = ~0u;
+
+// A FIFO cache kept as per-vertex timestamps: a vertex stays cached until cache_size other
+// vertices have been transformed after it.
+class CacheSimulation {
+public:
+	CacheSimulation(size_t vertex_count, uint32_t cache_size)
+	    : timestamps_(vertex_count, 0), size_(cache_size), time_(cache_size + 1) {}
+
+	// Misses since the vertex was last transformed.
+	uint32_t Age(uint32_t vertex) const { return time_ - timestamps_[vertex]; }
+	// Returns 1 if the vertex had to be transformed.
+	uint32_t Access(uint32_t vertex) {
+		if (Age(vertex) <= size_) return 0;
+		timestamps_[vertex] = time_++;
+		return 1;
+	}
+	uint32_t AccessTriangle(const uint32_t* triangle) {
+		return Access(triangle[0]) + Access(triangle[1]) + Access(triangle[2]);
+	}
+	void Flush() { time_ += size_ + 1; }
+
+private:
+	std::vector<uint32_t> timestamps_;
+	uint32_t size_;
+	uint32_t time_;
+};
+
+// The triangles using each vertex, as ranges of one array.
+struct Adjacency {
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+
+	Adjacency(const std::vector<uint32_t>& indices, size_t triangle_count, size_t vertex_count)
+	    : offsets(vertex_count + 1, 0), triangles(triangle_count * 3) {
+		for (size_t i = 0; i < triangle_count * 3; ++i) ++offsets[indices[i] + 1];
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangle_count * 3; ++i) {
+			triangles[fill[indices[i]]++] = uint32_t(i / 3);
+		}
+	}
+
+	uint32_t Count(uint32_t vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+};
+
+}  // namespace
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertex_count,
+                                    uint32_t cache_size) {
+	VertexCacheStats stats;
+	stats.triangles = indices.size() / 3;
+	stats.vertices  = vertex_count;
+	CacheSimulation cache(vertex_count, cache_size);
+	for (size_t i = 0; i < stats.triangles * 3; ++i) stats.transformed += cache.Access(indices[i]);
+	return stats;
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size) {
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0) return;
+
+	Adjacency adjacency(indices, triangle_count, vertex_count);
+	// Triangles not yet emitted that use each vertex.
+	std::vector<uint32_t> live(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; ++v) live[v] = adjacency.Count(v);
+	std::vector<bool> emitted(triangle_count, false);
+	CacheSimulation cache(vertex_count, cache_size);
+
+	// Recently emitted vertices, to continue from when fanning around the last one hits a dead
+	// end; after those, vertices are scanned in order.
+	std::vector<uint32_t> dead_ends;
+	uint32_t scan = 0;
+	auto skip_dead_end = [&]() {
+		while (!dead_ends.empty()) {
+			uint32_t vertex = dead_ends.back();
+			dead_ends.pop_back();
+			if (live[vertex] > 0) return vertex;
+		}
+		for (; scan < vertex_count; ++scan) {
+			if (live[scan] > 0) return scan;
+		}
+		return kNone;
+	};
+
+	std::vector<uint32_t> result;
+	result.reserve(triangle_count * 3);
+	std::vector<uint32_t> candidates;
+	for (uint32_t fan = skip_dead_end(); fan != kNone;) {
+		// Emit every remaining triangle around the fanning vertex.
+		candidates.clear();
+		for (uint32_t a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; ++a) {
+			uint32_t triangle = adjacency.triangles[a];
+			if (emitted[triangle]) continue;
+			emitted[triangle] = true;
+			for (int corner = 0; corner < 3; ++corner) {
+				uint32_t vertex = indices[triangle * 3 + corner];
+				result.push_back(vertex);
+				dead_ends.push_back(vertex);
+				candidates.push_back(vertex);
+				--live[vertex];
+				cache.Access(vertex);
+			}
+		}
+
+		// Fan next around the oldest vertex that will still be cached once its own remaining
+		// triangles are emitted; any vertex with triangles left beats a dead end.
+		fan                   = kNone;
+		int64_t best_priority = -1;
+		for (uint32_t vertex : candidates) {
+			if (live[vertex] == 0) continue;
+			int64_t priority = 0;
+			if (cache.Age(vertex) + 2 * live[vertex] <= cache_size) priority = cache.Age(vertex);
+			if (priority > best_priority) {
+				best_priority = priority;
+				fan           = vertex;
+			}
+		}
+		if (fan == kNone) fan = skip_dead_end();
+	}
+	indices.swap(result);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+                      float threshold, uint32_t cache_size) {
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count < 2) return;
+	CacheSimulation cache(vertices.size(), cache_size);
+
+	// A triangle missing the cache with all three vertices starts a new patch of the mesh, which
+	// can move without costing any vertex reuse.
+	std::vector<uint32_t> patches;
+	for (size_t t = 0; t < triangle_count; ++t) {
+		if (cache.AccessTriangle(&indices[t * 3]) == 3 || t == 0) patches.push_back(uint32_t(t));
+	}
+	patches.push_back(uint32_t(triangle_count));
+
+	// Patches are split further wherever the part before the split, drawn from a cold cache, stays
+	// within threshold of the patch's own ACMR.
+	std::vector<uint32_t> clusters;
+	for (size_t p = 0; p + 1 < patches.size(); ++p) {
+		uint32_t begin = patches[p], end = patches[p + 1];
+		cache.Flush();
+		uint32_t misses = 0;
+		for (uint32_t t = begin; t < end; ++t) misses += cache.AccessTriangle(&indices[t * 3]);
+		double limit = threshold * double(misses) / (end - begin);
+
+		cache.Flush();
+		uint32_t cluster = begin;
+		misses           = 0;
+		for (uint32_t t = begin; t < end; ++t) {
+			misses += cache.AccessTriangle(&indices[t * 3]);
+			if (misses <= limit * (t - cluster + 1)) {
+				clusters.push_back(cluster);
+				cluster = t + 1;
+				misses  = 0;
+				cache.Flush();
+			}
+		}
+		if (cluster < end) clusters.push_back(cluster);
+	}
+	clusters.push_back(uint32_t(triangle_count));
+	size_t cluster_count = clusters.size() - 1;
+
+	// Sort by how far each cluster faces away from the center of the mesh. Clusters on the
+	// outside facing out are the ones most likely to hide others, whatever the view.
+	std::vector<glm::vec3> centroids(cluster_count, glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(cluster_count, glm::vec3(0.0f));
+	glm::vec3 mesh_centroid(0.0f);
+	float mesh_area = 0.0f;
+	for (size_t c = 0; c < cluster_count; ++c) {
+		float cluster_area = 0.0f;
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+			const glm::vec3& a = vertices[indices[t * 3 + 0]].position;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& d = vertices[indices[t * 3 + 2]].position;
+			glm::vec3 normal   = glm::cross(b - a, d - a);
+			float area         = glm::length(normal);
+			centroids[c] += (a + b + d) * (area / 3.0f);
+			normals[c] += normal;
+			cluster_area += area;
+		}
+		mesh_centroid += centroids[c];
+		mesh_area += cluster_area;
+		if (cluster_area > 0.0f) centroids[c] /= cluster_area;
+	}
+	if (mesh_area > 0.0f) mesh_centroid /= mesh_area;
+
+	std::vector<float> keys(cluster_count, 0.0f);
+	for (size_t c = 0; c < cluster_count; ++c) {
+		float length = glm::length(normals[c]);
+		if (length > 0.0f) keys[c] = glm::dot(centroids[c] - mesh_centroid, normals[c] / length);
+	}
+	std::vector<uint32_t> order(cluster_count);
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(),
+	                 [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(triangle_count * 3);
+	for (uint32_t c : order) {
+		result.insert(result.end(), indices.begin() + size_t(clusters[c]) * 3,
+		              indices.begin() + size_t(clusters[c + 1]) * 3);
+	}
+	indices.swap(result);
+}
+
+void OptimizeVertexFetch(MeshData& mesh) {
+	std::vector<uint32_t> remap(mesh.vertices.size(), kNone);
+	std::vector<Vertex> vertices;
+	vertices.reserve(mesh.vertices.size());
+	for (uint32_t& index : mesh.indices) {
+		if (remap[index] == kNone) {
+			remap[index] = uint32_t(vertices.size());
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices.swap(vertices);
+}
+
+MeshOptimizationStats OptimizeMesh(MeshData& mesh) {
+	MeshOptimizationStats stats;
+	stats.before = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	OptimizeOverdraw(mesh.indices, mesh.vertices);
+	OptimizeVertexFetch(mesh);
+	stats.after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+	return stats;
+}
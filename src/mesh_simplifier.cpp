@@ -0,0 +1,319 @@
+#include "mesh_simplifier.h"
+
+#include "mesh_optimizer.h"
+
+#include <cmath>
+#include <numeric>
+#include <unordered_set>
+
+namespace {
+
+// Scale of normals and uvs against positions normalized to the mesh's size: turning a normal
+// by 90 degrees costs as much as moving the surface by 7% of the mesh, shifting a uv by 0.1 as
+// much as moving it by 1%.
+constexpr float kNormalWeight = 0.05f;
+constexpr float kUvWeight     = 0.1f;
+constexpr int kAttributeCount = 5;
+
+// Most LOD error allowed per chain step, relative to the mesh's size.
+constexpr float kLodMaxError = 0.05f;
+// A step must keep at most this fraction of the previous LOD's triangles to be kept.
+constexpr float kLodMinReduction = 0.85f;
+// Each pass considers this fraction of the cheapest collapses, so collapses blocked by a
+// neighbour get another chance before far costlier ones go through.
+constexpr size_t kPassFraction = 3;
+
+// Area weighted squared distance to a set of planes, as a function of position:
+//   p^T A p + 2 b.p + c
+// with A symmetric and stored as its upper triangle.
+struct Quadric {
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+	double weight = 0.0;
+
+	// The plane through point with unit normal n.
+	void AddPlane(const glm::vec3& n, const glm::vec3& point, double w) {
+		double d = -double(glm::dot(n, point));
+		a00 += w * n.x * n.x;
+		a01 += w * n.x * n.y;
+		a02 += w * n.x * n.z;
+		a11 += w * n.y * n.y;
+		a12 += w * n.y * n.z;
+		a22 += w * n.z * n.z;
+		b0 += w * n.x * d;
+		b1 += w * n.y * d;
+		b2 += w * n.z * d;
+		c += w * d * d;
+		weight += w;
+	}
+
+	void Add(const Quadric& q) {
+		a00 += q.a00;
+		a01 += q.a01;
+		a02 += q.a02;
+		a11 += q.a11;
+		a12 += q.a12;
+		a22 += q.a22;
+		b0 += q.b0;
+		b1 += q.b1;
+		b2 += q.b2;
+		c += q.c;
+		weight += q.weight;
+	}
+
+	double Error(const glm::vec3& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		return x * (a00 * x + 2.0 * (a01 * y + a02 * z + b0)) +
+		       y * (a11 * y + 2.0 * (a12 * z + b1)) + z * (a22 * z + 2.0 * b2) + c;
+	}
+};
+
+// Area weighted squared distance to every attribute value merged into a vertex, as a function
+// of the attributes it ends up with.
+struct AttributeQuadric {
+	double sum[kAttributeCount] = {};
+	double squares              = 0.0;
+	double weight               = 0.0;
+
+	void AddValue(const float* attributes, double w) {
+		for (int i = 0; i < kAttributeCount; ++i) {
+			sum[i] += w * attributes[i];
+			squares += w * attributes[i] * attributes[i];
+		}
+		weight += w;
+	}
+
+	void Add(const AttributeQuadric& q) {
+		for (int i = 0; i < kAttributeCount; ++i) sum[i] += q.sum[i];
+		squares += q.squares;
+		weight += q.weight;
+	}
+
+	double Error(const float* attributes) const {
+		double error = squares;
+		for (int i = 0; i < kAttributeCount; ++i) {
+			error += attributes[i] * (weight * attributes[i] - 2.0 * sum[i]);
+		}
+		return error;
+	}
+};
+
+struct Collapse {
+	double cost;
+	uint32_t from;
+	uint32_t to;
+};
+
+uint64_t EdgeKey(uint32_t a, uint32_t b) { return uint64_t(a) << 32 | b; }
+
+}  // namespace
+
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices,
+                                   const std::vector<uint32_t>& indices, size_t target_index_count,
+                                   float target_error, float* result_error) {
+	size_t vertex_count = vertices.size();
+	std::vector<uint32_t> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+	if (result_error) *result_error = 0.0f;
+	if (result.size() <= target_index_count) return result;
+
+	// Positions in units of the mesh's size, attributes scaled to match.
+	glm::vec4 bounds;
+	glm::vec3 extents;
+	Model::ComputeBounds(vertices, bounds, extents);
+	float size = 2.0f * std::max(extents.x, std::max(extents.y, extents.z));
+	if (size <= 0.0f) return result;
+	std::vector<glm::vec3> positions(vertex_count);
+	std::vector<float> attributes(vertex_count * kAttributeCount);
+	for (size_t v = 0; v < vertex_count; ++v) {
+		positions[v]     = (vertices[v].position - glm::vec3(bounds)) / size;
+		float* attribute = &attributes[v * kAttributeCount];
+		for (int c = 0; c < 3; ++c) attribute[c] = vertices[v].normal[c] * kNormalWeight;
+		for (int c = 0; c < 2; ++c) attribute[3 + c] = vertices[v].uv[c] * kUvWeight;
+	}
+
+	// Vertices sharing a position with another are on a seam, and ones on an edge only one
+	// triangle uses are on a border. Moving either would tear the surface.
+	std::vector<bool> locked(vertex_count, false);
+	std::vector<uint32_t> order(vertex_count);
+	std::iota(order.begin(), order.end(), 0u);
+	auto position_less = [&](uint32_t a, uint32_t b) {
+		const glm::vec3 &p = vertices[a].position, &q = vertices[b].position;
+		return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+	};
+	std::sort(order.begin(), order.end(), position_less);
+	for (size_t i = 1; i < order.size(); ++i) {
+		if (vertices[order[i - 1]].position == vertices[order[i]].position) {
+			locked[order[i - 1]] = locked[order[i]] = true;
+		}
+	}
+	std::unordered_set<uint64_t> edges;
+	edges.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (int e = 0; e < 3; ++e) edges.insert(EdgeKey(result[i + e], result[i + (e + 1) % 3]));
+	}
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (int e = 0; e < 3; ++e) {
+			uint32_t a = result[i + e], b = result[i + (e + 1) % 3];
+			if (!edges.count(EdgeKey(b, a))) locked[a] = locked[b] = true;
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertex_count);
+	std::vector<AttributeQuadric> attribute_quadrics(vertex_count);
+	for (size_t i = 0; i < result.size(); i += 3) {
+		const glm::vec3& a = positions[result[i]];
+		glm::vec3 normal   = glm::cross(positions[result[i + 1]] - a, positions[result[i + 2]] - a);
+		float area         = glm::length(normal);
+		if (area <= 0.0f) continue;
+		normal /= area;
+		for (int corner = 0; corner < 3; ++corner) {
+			uint32_t v = result[i + corner];
+			quadrics[v].AddPlane(normal, a, area);
+			attribute_quadrics[v].AddValue(&attributes[v * kAttributeCount], area);
+		}
+	}
+
+	auto cost = [&](uint32_t from, uint32_t to) {
+		Quadric quadric = quadrics[from];
+		quadric.Add(quadrics[to]);
+		AttributeQuadric attribute = attribute_quadrics[from];
+		attribute.Add(attribute_quadrics[to]);
+		double error = quadric.Error(positions[to]) +
+		               attribute.Error(&attributes[size_t(to) * kAttributeCount]);
+		return quadric.weight > 0.0 ? std::max(error, 0.0) / quadric.weight : 0.0;
+	};
+
+	// Collapses in passes: cost every edge, then do the cheapest ones that touch disjoint parts
+	// of the mesh, so costs computed at the start of a pass stay exact.
+	double max_cost   = 0.0;
+	double cost_limit = double(target_error) * target_error;
+	std::vector<uint32_t> offsets(vertex_count + 1), adjacent;
+	std::vector<uint64_t> pass_edges;
+	std::vector<Collapse> collapses;
+	std::vector<bool> touched(vertex_count);
+	std::vector<uint32_t> remap(vertex_count);
+	std::iota(remap.begin(), remap.end(), 0u);
+	while (result.size() > target_index_count) {
+		size_t triangle_count = result.size() / 3;
+
+		// The triangles around each vertex.
+		std::fill(offsets.begin(), offsets.end(), 0u);
+		for (uint32_t v : result) ++offsets[v + 1];
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		adjacent.resize(result.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < result.size(); ++i) adjacent[fill[result[i]]++] = uint32_t(i / 3);
+
+		pass_edges.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int e = 0; e < 3; ++e) {
+				uint32_t a = result[i + e], b = result[i + (e + 1) % 3];
+				pass_edges.push_back(EdgeKey(std::min(a, b), std::max(a, b)));
+			}
+		}
+		std::sort(pass_edges.begin(), pass_edges.end());
+		pass_edges.erase(std::unique(pass_edges.begin(), pass_edges.end()), pass_edges.end());
+
+		collapses.clear();
+		for (uint64_t edge : pass_edges) {
+			uint32_t a = uint32_t(edge >> 32), b = uint32_t(edge);
+			double ab = locked[a] ? -1.0 : cost(a, b);
+			double ba = locked[b] ? -1.0 : cost(b, a);
+			if (ab < 0.0 && ba < 0.0) continue;
+			if (ba < 0.0 || (ab >= 0.0 && ab <= ba)) {
+				collapses.push_back({ab, a, b});
+			} else {
+				collapses.push_back({ba, b, a});
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(),
+		          [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		// Whether moving from onto to turns any triangle that survives the collapse over or
+		// leaves it without area.
+		auto flips = [&](uint32_t from, uint32_t to) {
+			for (uint32_t a = offsets[from]; a < offsets[from + 1]; ++a) {
+				const uint32_t* triangle = &result[size_t(adjacent[a]) * 3];
+				if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+				glm::vec3 corners[3], moved[3];
+				for (int c = 0; c < 3; ++c) {
+					corners[c] = positions[triangle[c]];
+					moved[c]   = triangle[c] == from ? positions[to] : corners[c];
+				}
+				glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				glm::vec3 after  = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+				if (glm::dot(before, after) <= 0.2f * glm::length(before) * glm::length(after)) {
+					return true;
+				}
+			}
+			return false;
+		};
+
+		size_t removable  = triangle_count - target_index_count / 3;
+		size_t considered = std::max<size_t>(collapses.size() / kPassFraction, 1);
+		size_t removed    = 0;
+		std::fill(touched.begin(), touched.end(), false);
+		for (size_t i = 0; i < std::min(considered, collapses.size()) && removed < removable; ++i) {
+			const Collapse& collapse = collapses[i];
+			if (collapse.cost > cost_limit) break;
+			if (touched[collapse.from] || touched[collapse.to]) continue;
+			if (flips(collapse.from, collapse.to)) continue;
+
+			// Everything around from changes shape, so none of it collapses again this pass.
+			for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; ++a) {
+				const uint32_t* triangle = &result[size_t(adjacent[a]) * 3];
+				bool shared              = false;
+				for (int c = 0; c < 3; ++c) {
+					touched[triangle[c]] = true;
+					shared               = shared || triangle[c] == collapse.to;
+				}
+				if (shared) ++removed;
+			}
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			attribute_quadrics[collapse.to].Add(attribute_quadrics[collapse.from]);
+			max_cost = std::max(max_cost, collapse.cost);
+		}
+		if (removed == 0) break;
+
+		size_t kept = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (a == b || b == c || c == a) continue;
+			result[kept++] = a;
+			result[kept++] = b;
+			result[kept++] = c;
+		}
+		result.resize(kept);
+	}
+
+	if (result_error) *result_error = float(std::sqrt(max_cost));
+	return result;
+}
+
+void BuildLods(MeshData& mesh, float reduction, uint32_t max_lods) {
+	mesh.lods = {{0, uint32_t(mesh.indices.size()), 0.0f}};
+	if (mesh.indices.size() / 3 < kMinLodTriangles) return;
+
+	glm::vec4 bounds;
+	glm::vec3 extents;
+	Model::ComputeBounds(mesh.vertices, bounds, extents);
+	float size = 2.0f * std::max(extents.x, std::max(extents.y, extents.z));
+
+	std::vector<uint32_t> previous = mesh.indices;
+	// Each step is simplified from the last, so at worst their errors add up.
+	float error = 0.0f;
+	while (mesh.lods.size() < max_lods && previous.size() / 3 >= kMinLodTriangles) {
+		size_t target = size_t(previous.size() / 3 * reduction) * 3;
+		float step_error;
+		std::vector<uint32_t> next =
+		    SimplifyMesh(mesh.vertices, previous, target, kLodMaxError, &step_error);
+		if (next.empty() || next.size() > previous.size() * kLodMinReduction) break;
+
+		OptimizeVertexCache(next, mesh.vertices.size());
+		error += step_error;
+		mesh.lods.push_back({uint32_t(mesh.indices.size()), uint32_t(next.size()), error * size});
+		mesh.indices.insert(mesh.indices.end(), next.begin(), next.end());
+		previous.swap(next);
+	}
+}
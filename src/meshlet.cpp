@@ -0,0 +1,91 @@
+#include "meshlet.h"
+
+#include "model.h"
+
+MeshletData BuildMeshlets(const MeshData& mesh, uint32_t max_vertices, uint32_t max_triangles) {
+	if (max_vertices == 0 || max_vertices > 255 || max_triangles == 0) {
+		throw std::runtime_error("Meshlet limits out of range");
+	}
+
+	MeshletData data;
+	// Local index of every mesh vertex in the open meshlet, or kUnused.
+	const uint8_t kUnused = 0xff;
+	std::vector<uint8_t> local(mesh.vertices.size(), kUnused);
+	Meshlet open{0, 0, 0, 0, glm::vec4(0.0f), glm::vec4(0.0f)};
+
+	auto close = [&]() {
+		if (open.triangle_count == 0) return;
+		const uint32_t* vertices = data.vertices.data() + open.vertex_offset;
+		glm::vec3 min = mesh.vertices[vertices[0]].position, max = min;
+		for (uint32_t i = 0; i < open.vertex_count; ++i) {
+			min = glm::min(min, mesh.vertices[vertices[i]].position);
+			max = glm::max(max, mesh.vertices[vertices[i]].position);
+			local[vertices[i]] = kUnused;
+		}
+		glm::vec3 center = 0.5f * (min + max);
+		float radius     = 0.0f;
+		for (uint32_t i = 0; i < open.vertex_count; ++i) {
+			radius = std::max(radius, glm::length(mesh.vertices[vertices[i]].position - center));
+		}
+		open.bounds = glm::vec4(center, radius);
+
+		// The cone axis averages the triangle normals; its spread is the least aligned one.
+		const uint8_t* triangles = data.triangles.data() + open.triangle_offset;
+		std::vector<glm::vec3> normals;
+		glm::vec3 axis(0.0f);
+		for (uint32_t t = 0; t < open.triangle_count; ++t) {
+			const glm::vec3& a = mesh.vertices[vertices[triangles[t * 3 + 0]]].position;
+			const glm::vec3& b = mesh.vertices[vertices[triangles[t * 3 + 1]]].position;
+			const glm::vec3& c = mesh.vertices[vertices[triangles[t * 3 + 2]]].position;
+			glm::vec3 normal   = glm::cross(b - a, c - a);
+			float area         = glm::length(normal);
+			// Degenerate triangles are never rasterized, so they don't constrain the cone.
+			if (area == 0.0f) continue;
+			normals.push_back(normal / area);
+			axis += normals.back();
+		}
+		float min_dot = -1.0f;
+		if (glm::length(axis) > 0.0f) {
+			axis    = glm::normalize(axis);
+			min_dot = 1.0f;
+			for (const glm::vec3& normal : normals) {
+				min_dot = std::min(min_dot, glm::dot(axis, normal));
+			}
+		}
+		float cutoff = min_dot > 0.0f ? std::sqrt(1.0f - min_dot * min_dot) : 2.0f;
+		open.cone    = glm::vec4(axis, cutoff);
+
+		data.meshlets.push_back(open);
+		open = {uint32_t(data.vertices.size()), uint32_t(data.triangles.size()), 0, 0,
+		        glm::vec4(0.0f), glm::vec4(0.0f)};
+	};
+
+	// Coarser LODs follow the full detail indices and are drawn whole.
+	size_t index_count = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].index_count;
+	for (size_t i = 0; i + 2 < index_count; i += 3) {
+		const uint32_t* triangle = &mesh.indices[i];
+		uint32_t new_vertices    = 0;
+		for (int corner = 0; corner < 3; ++corner) {
+			// Repeated corners of a degenerate triangle only count once.
+			bool repeated = (corner > 0 && triangle[corner] == triangle[0]) ||
+			                (corner > 1 && triangle[corner] == triangle[1]);
+			if (local[triangle[corner]] == kUnused && !repeated) ++new_vertices;
+		}
+		if (open.vertex_count + new_vertices > max_vertices ||
+		    open.triangle_count + 1 > max_triangles) {
+			close();
+		}
+
+		for (int corner = 0; corner < 3; ++corner) {
+			uint32_t vertex = triangle[corner];
+			if (local[vertex] == kUnused) {
+				local[vertex] = uint8_t(open.vertex_count++);
+				data.vertices.push_back(vertex);
+			}
+			data.triangles.push_back(local[vertex]);
+		}
+		++open.triangle_count;
+	}
+	close();
+	return data;
+}
@@ -1,5 +1,226 @@
 #include "model.h"
 
-class Model {
+#include "mesh_file.h"
 
-};
\ No newline at end of file
+#include <cstddef>
+
+vk::VertexInputBindingDescription Vertex::Binding() {
+	return vk::VertexInputBindingDescription(0, sizeof(Vertex), vk::VertexInputRate::eVertex);
+}
+
+std::array<vk::VertexInputAttributeDescription, 3> Vertex::Attributes() {
+	return {vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat,
+	                                            offsetof(Vertex, position)),
+	        vk::VertexInputAttributeDescription(1, 0, vk::Format::eR32G32B32Sfloat,
+	                                            offsetof(Vertex, normal)),
+	        vk::VertexInputAttributeDescription(2, 0, vk::Format::eR32G32Sfloat,
+	                                            offsetof(Vertex, uv))};
+}
+
+Model::Model(vk::Device device, MemoryAllocator& allocator, Uploader& uploader,
+             const MeshData& mesh)
+    : device_(device),
+      allocator_(allocator),
+      vertex_count_(uint32_t(mesh.vertices.size())),
+      index_count_(uint32_t(mesh.indices.size())),
+      meshlets_(mesh.meshlets.meshlets),
+      lods_(mesh.lods) {
+	if (mesh.vertices.empty() || mesh.indices.empty()) throw std::runtime_error("Empty mesh");
+	if (lods_.empty()) lods_.push_back({0, index_count_, 0.0f});
+	ComputeBounds(mesh.vertices, bounds_, extents_);
+
+	// Halve index bandwidth for meshes that fit in 16-bit indices.
+	std::vector<uint16_t> short_indices;
+	const void* index_data     = mesh.indices.data();
+	vk::DeviceSize index_bytes = mesh.indices.size() * sizeof(uint32_t);
+	if (vertex_count_ <= std::numeric_limits<uint16_t>::max() + 1u) {
+		index_type_ = vk::IndexType::eUint16;
+		short_indices.assign(mesh.indices.begin(), mesh.indices.end());
+		index_data  = short_indices.data();
+		index_bytes = short_indices.size() * sizeof(uint16_t);
+	}
+	Upload(uploader, mesh.vertices.data(), index_data, index_bytes);
+}
+
+Model::Model(vk::Device device, MemoryAllocator& allocator, Uploader& uploader,
+             const MeshFileView& mesh)
+    : device_(device),
+      allocator_(allocator),
+      vertex_count_(mesh.mesh->vertex_count),
+      index_count_(mesh.mesh->index_count),
+      meshlets_(mesh.meshlets, mesh.meshlets + mesh.mesh->meshlet_count),
+      lods_(mesh.lods, mesh.lods + mesh.mesh->lod_count) {
+	if (vertex_count_ == 0 || index_count_ == 0) throw std::runtime_error("Empty mesh");
+	const float* bounds  = mesh.mesh->bounds;
+	const float* extents = mesh.mesh->extents;
+	bounds_              = glm::vec4(bounds[0], bounds[1], bounds[2], bounds[3]);
+	extents_             = glm::vec3(extents[0], extents[1], extents[2]);
+
+	index_type_ = mesh.mesh->index_size == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+	Upload(uploader, mesh.vertices, mesh.indices,
+	       vk::DeviceSize(index_count_) * mesh.mesh->index_size);
+}
+
+Model::Model(vk::Device device, MemoryAllocator& allocator, Uploader& uploader,
+             const MeshSource& mesh)
+    : device_(device),
+      allocator_(allocator),
+      vertex_count_(mesh.vertex_count),
+      index_count_(mesh.index_count),
+      bounds_(mesh.bounds),
+      extents_(mesh.extents) {
+	if (vertex_count_ == 0 || index_count_ == 0) throw std::runtime_error("Empty mesh");
+	lods_.push_back({0, index_count_, 0.0f});
+	index_type_ = mesh.index_size == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+
+	vk::DeviceSize vertex_bytes = vk::DeviceSize(vertex_count_) * sizeof(Vertex);
+	vk::DeviceSize index_bytes  = vk::DeviceSize(index_count_) * mesh.index_size;
+	CreateBuffers(index_bytes);
+	if (mesh.vertices) {
+		uploader.UploadBuffer(vertex_buffer_, 0, mesh.vertices, vertex_bytes,
+		                      vk::PipelineStageFlagBits::eVertexInput,
+		                      vk::AccessFlagBits::eVertexAttributeRead);
+	} else {
+		uploader.UploadBuffer(vertex_buffer_, 0, vertex_bytes, mesh.fill_vertices,
+		                      vk::PipelineStageFlagBits::eVertexInput,
+		                      vk::AccessFlagBits::eVertexAttributeRead);
+	}
+	if (mesh.indices) {
+		uploader.UploadBuffer(index_buffer_, 0, mesh.indices, index_bytes,
+		                      vk::PipelineStageFlagBits::eVertexInput,
+		                      vk::AccessFlagBits::eIndexRead);
+	} else {
+		uploader.UploadBuffer(index_buffer_, 0, index_bytes, mesh.fill_indices,
+		                      vk::PipelineStageFlagBits::eVertexInput,
+		                      vk::AccessFlagBits::eIndexRead);
+	}
+}
+
+void Model::CreateBuffers(vk::DeviceSize index_bytes) {
+	vertex_buffer_ = device_.createBuffer(
+	    vk::BufferCreateInfo()
+	        .setSize(vk::DeviceSize(vertex_count_) * sizeof(Vertex))
+	        .setUsage(vk::BufferUsageFlagBits::eVertexBuffer |
+	                  vk::BufferUsageFlagBits::eTransferDst)
+	        .setSharingMode(vk::SharingMode::eExclusive));
+	vertex_memory_ =
+	    allocator_.AllocateBuffer(vertex_buffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	index_buffer_ = device_.createBuffer(
+	    vk::BufferCreateInfo()
+	        .setSize(index_bytes)
+	        .setUsage(vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst)
+	        .setSharingMode(vk::SharingMode::eExclusive));
+	index_memory_ =
+	    allocator_.AllocateBuffer(index_buffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+void Model::Upload(Uploader& uploader, const void* vertices, const void* indices,
+                   vk::DeviceSize index_bytes) {
+	CreateBuffers(index_bytes);
+	vk::DeviceSize vertex_bytes = vk::DeviceSize(vertex_count_) * sizeof(Vertex);
+	uploader.UploadBuffer(vertex_buffer_, 0, vertices, vertex_bytes,
+	                      vk::PipelineStageFlagBits::eVertexInput,
+	                      vk::AccessFlagBits::eVertexAttributeRead);
+	uploader.UploadBuffer(index_buffer_, 0, indices, index_bytes,
+	                      vk::PipelineStageFlagBits::eVertexInput, vk::AccessFlagBits::eIndexRead);
+}
+
+Model::~Model() {
+	device_.destroyBuffer(index_buffer_);
+	allocator_.Free(index_memory_);
+	device_.destroyBuffer(vertex_buffer_);
+	allocator_.Free(vertex_memory_);
+}
+
+void Model::Bind(vk::CommandBuffer cmd) const {
+	cmd.bindVertexBuffers(0, vertex_buffer_, vk::DeviceSize(0));
+	cmd.bindIndexBuffer(index_buffer_, 0, index_type_);
+}
+
+void Model::Draw(vk::CommandBuffer cmd, uint32_t instance_count, uint32_t lod) const {
+	const MeshLod& range = lods_[lod];
+	cmd.drawIndexed(range.index_count, instance_count, range.first_index, 0, 0);
+}
+
+void Model::ComputeBounds(const std::vector<Vertex>& vertices, glm::vec4& bounds,
+                          glm::vec3& extents) {
+	// Centered on the bounding box; not minimal, but cheap and tight enough for culling.
+	glm::vec3 min = vertices[0].position, max = min;
+	for (const Vertex& vertex : vertices) {
+		min = glm::min(min, vertex.position);
+		max = glm::max(max, vertex.position);
+	}
+	glm::vec3 center = 0.5f * (min + max);
+	float radius     = 0.0f;
+	for (const Vertex& vertex : vertices) {
+		radius = std::max(radius, glm::length(vertex.position - center));
+	}
+	bounds  = glm::vec4(center, radius);
+	extents = 0.5f * (max - min);
+}
+
+MeshData Model::Triangle() {
+	MeshData mesh;
+	glm::vec3 normal(0.0f, 0.0f, 1.0f);
+	mesh.vertices = {{{0.0f, -0.5f, 0.0f}, normal, {0.5f, 0.0f}},
+	                 {{-0.5f, 0.5f, 0.0f}, normal, {0.0f, 1.0f}},
+	                 {{0.5f, 0.5f, 0.0f}, normal, {1.0f, 1.0f}}};
+	mesh.indices  = {0, 1, 2};
+	return mesh;
+}
+
+MeshData Model::Cube() {
+	// Each face spans axes u and v with u x v = normal, so corners emitted in u/v order wind
+	// counter-clockwise when seen from outside.
+	struct Face {
+		glm::vec3 normal, u, v;
+	};
+	const Face faces[] = {
+	    {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},  {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+	    {{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},  {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+	    {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},  {{0, 0, -1}, {0, 1, 0}, {1, 0, 0}},
+	};
+	const glm::vec2 corners[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+
+	MeshData mesh;
+	for (const Face& face : faces) {
+		uint32_t base = uint32_t(mesh.vertices.size());
+		for (const glm::vec2& c : corners) {
+			glm::vec3 position = 0.5f * (face.normal + c.x * face.u + c.y * face.v);
+			mesh.vertices.push_back({position, face.normal, 0.5f * (c + 1.0f)});
+		}
+		mesh.indices.insert(mesh.indices.end(),
+		                    {base, base + 1, base + 2, base, base + 2, base + 3});
+	}
+	return mesh;
+}
+
+MeshData Model::Sphere(uint32_t segments, uint32_t rings) {
+	if (segments < 3 || rings < 2) throw std::runtime_error("Sphere needs 3 segments and 2 rings");
+
+	// A grid of rings + 1 rows from the top pole down, the seam and poles duplicated for the uvs.
+	MeshData mesh;
+	const float pi = 3.14159265358979f;
+	for (uint32_t r = 0; r <= rings; ++r) {
+		float phi = pi * r / rings;
+		for (uint32_t s = 0; s <= segments; ++s) {
+			float theta = 2.0f * pi * s / segments;
+			glm::vec3 normal(std::sin(phi) * std::cos(theta), std::cos(phi),
+			                 std::sin(phi) * std::sin(theta));
+			glm::vec2 uv(float(s) / segments, float(r) / rings);
+			mesh.vertices.push_back({0.5f * normal, normal, uv});
+		}
+	}
+
+	// Quads between neighbouring rows, minus the triangle that collapses at each pole.
+	for (uint32_t r = 0; r < rings; ++r) {
+		for (uint32_t s = 0; s < segments; ++s) {
+			uint32_t a = r * (segments + 1) + s, b = a + 1;
+			uint32_t c = a + segments + 1, d = c + 1;
+			if (r > 0) mesh.indices.insert(mesh.indices.end(), {a, b, c});
+			if (r + 1 < rings) mesh.indices.insert(mesh.indices.end(), {b, d, c});
+		}
+	}
+	return mesh;
+}
@@ -0,0 +1,97 @@
+#include "pipeline_cache.h"
+
+#include "file_util.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE, which every implementation must emit first.
+struct CacheHeader {
+	uint32_t header_size;
+	uint32_t header_version;
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint8_t uuid[VK_UUID_SIZE];
+};
+
+}  // namespace
+
+PipelineCache::PipelineCache(vk::PhysicalDevice physical_device, vk::Device device,
+                             const std::string& path)
+    : device_(device), properties_(physical_device.getProperties()), path_(path) {
+	if (path_.empty()) {
+		char name[64];
+		std::snprintf(name, sizeof(name), "pipeline_cache_%04x_%04x.bin", properties_.vendorID,
+		              properties_.deviceID);
+		path_ = DefaultDirectory() + name;
+	}
+
+	std::vector<char> data;
+	std::ifstream file(path_, std::ios::ate | std::ios::binary);
+	if (file.is_open()) {
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+	}
+
+	loaded_ = IsCompatible(data);
+	if (!loaded_) data.clear();
+
+	cache_ = device_.createPipelineCache(
+	    vk::PipelineCacheCreateInfo(vk::PipelineCacheCreateFlags(), data.size(), data.data()));
+}
+
+PipelineCache::~PipelineCache() {
+	if (!cache_) return;
+	Save();
+	device_.destroyPipelineCache(cache_);
+}
+
+void PipelineCache::Save() const {
+	std::vector<uint8_t> data = device_.getPipelineCacheData(cache_);
+	if (data.empty()) return;
+
+	std::error_code error;
+	std::filesystem::path target(path_);
+	if (target.has_parent_path()) std::filesystem::create_directories(target.parent_path(), error);
+
+	// Saved from the destructor too, so a failure is reported rather than thrown.
+	try {
+		WriteFileAtomically(path_, [&](std::ostream& file) {
+			file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+		});
+	} catch (const std::exception& e) {
+		std::cerr << "Failed to write pipeline cache: " << e.what() << std::endl;
+	}
+}
+
+std::string PipelineCache::DefaultDirectory() {
+#ifdef ENGINE_CACHE_DIR
+	return ENGINE_CACHE_DIR;
+#else
+#ifdef _WIN32
+	const char* base = std::getenv("LOCALAPPDATA");
+	if (base && *base) return std::string(base) + "\\vulkan-engine-test\\";
+#else
+	const char* base = std::getenv("XDG_CACHE_HOME");
+	if (base && *base) return std::string(base) + "/vulkan-engine-test/";
+	const char* home = std::getenv("HOME");
+	if (home && *home) return std::string(home) + "/.cache/vulkan-engine-test/";
+#endif
+	return std::string();
+#endif
+}
+
+bool PipelineCache::IsCompatible(const std::vector<char>& data) const {
+	CacheHeader header;
+	if (data.size() < sizeof(header)) return false;
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	return header.header_size >= sizeof(header) &&
+	       header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+	       header.vendor_id == properties_.vendorID && header.device_id == properties_.deviceID &&
+	       std::memcmp(header.uuid, properties_.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
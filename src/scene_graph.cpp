@@ -0,0 +1,259 @@
+#include "scene_graph.h"
+
+#include <atomic>
+
+namespace {
+
+glm::mat4 Compose(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	glm::mat3 basis = glm::mat3_cast(rotation);
+	return glm::mat4(glm::vec4(basis[0] * scale.x, 0.0f), glm::vec4(basis[1] * scale.y, 0.0f),
+	                 glm::vec4(basis[2] * scale.z, 0.0f), glm::vec4(position, 1.0f));
+}
+
+// Reorders values so the element at i moves to order[i].
+template <typename T>
+void Permute(std::vector<T>& values, const std::vector<uint32_t>& order, uint32_t count) {
+	std::vector<T> sorted(count);
+	for (size_t i = 0; i < values.size(); ++i) {
+		if (order[i] != ~0u) sorted[order[i]] = values[i];
+	}
+	values.swap(sorted);
+}
+
+}  // namespace
+
+void SceneGraph::Reserve(size_t count) {
+	slots_.reserve(count);
+	slot_.reserve(count);
+	parent_.reserve(count);
+	depth_.reserve(count);
+	dirty_.reserve(count);
+	destroyed_.reserve(count);
+	local_position_.reserve(count);
+	local_rotation_.reserve(count);
+	local_scale_.reserve(count);
+	world_.reserve(count);
+}
+
+NodeHandle SceneGraph::Create(NodeHandle parent, const NodeTransform& local) {
+	uint32_t parent_dense = kNone;
+	uint32_t depth        = 0;
+	if (parent) {
+		parent_dense = Dense(parent);
+		depth        = depth_[parent_dense] + 1;
+	}
+
+	uint32_t slot_index;
+	if (!free_slots_.empty()) {
+		slot_index = free_slots_.back();
+		free_slots_.pop_back();
+	} else {
+		slot_index = uint32_t(slots_.size());
+		slots_.emplace_back();
+	}
+	uint32_t dense           = uint32_t(slot_.size());
+	slots_[slot_index].dense = dense;
+
+	slot_.push_back(slot_index);
+	parent_.push_back(parent_dense);
+	depth_.push_back(depth);
+	dirty_.push_back(1);
+	destroyed_.push_back(0);
+	local_position_.push_back(local.position);
+	local_rotation_.push_back(local.rotation);
+	local_scale_.push_back(local.scale);
+	world_.emplace_back(1.0f);
+
+	// Appending to the deepest level, or starting the next one, keeps the arrays in depth order.
+	if (!restructure_ && depth + 1 == LevelCount()) {
+		level_begin_.back() = dense + 1;
+	} else if (!restructure_ && depth == LevelCount()) {
+		level_begin_.push_back(dense + 1);
+	} else {
+		restructure_ = true;
+	}
+	first_dirty_level_ = std::min(first_dirty_level_, depth);
+	return {slot_index, slots_[slot_index].generation};
+}
+
+void SceneGraph::Destroy(NodeHandle node) {
+	destroyed_[Dense(node)] = 1;
+	restructure_            = true;
+}
+
+bool SceneGraph::Valid(NodeHandle node) const {
+	if (node.index >= slots_.size()) return false;
+	const Slot& slot = slots_[node.index];
+	return slot.generation == node.generation && slot.dense != kNone && !destroyed_[slot.dense];
+}
+
+void SceneGraph::SetParent(NodeHandle node, NodeHandle parent) {
+	uint32_t dense        = Dense(node);
+	uint32_t parent_dense = parent ? Dense(parent) : kNone;
+	for (uint32_t ancestor = parent_dense; ancestor != kNone; ancestor = parent_[ancestor]) {
+		if (ancestor == dense) throw std::runtime_error("A node can't be moved below itself");
+	}
+	parent_[dense] = parent_dense;
+	// Depths below node change; Restructure() recomputes them from the parent links.
+	restructure_ = true;
+	MarkDirty(dense);
+}
+
+NodeHandle SceneGraph::Parent(NodeHandle node) const {
+	uint32_t parent = parent_[Dense(node)];
+	return parent == kNone ? NodeHandle() : HandleAt(parent);
+}
+
+void SceneGraph::SetLocal(NodeHandle node, const NodeTransform& local) {
+	uint32_t dense         = Dense(node);
+	local_position_[dense] = local.position;
+	local_rotation_[dense] = local.rotation;
+	local_scale_[dense]    = local.scale;
+	MarkDirty(dense);
+}
+
+void SceneGraph::SetPosition(NodeHandle node, const glm::vec3& position) {
+	uint32_t dense         = Dense(node);
+	local_position_[dense] = position;
+	MarkDirty(dense);
+}
+
+void SceneGraph::SetRotation(NodeHandle node, const glm::quat& rotation) {
+	uint32_t dense         = Dense(node);
+	local_rotation_[dense] = rotation;
+	MarkDirty(dense);
+}
+
+void SceneGraph::SetScale(NodeHandle node, const glm::vec3& scale) {
+	uint32_t dense      = Dense(node);
+	local_scale_[dense] = scale;
+	MarkDirty(dense);
+}
+
+NodeTransform SceneGraph::Local(NodeHandle node) const {
+	uint32_t dense = Dense(node);
+	return {local_position_[dense], local_rotation_[dense], local_scale_[dense]};
+}
+
+const glm::mat4& SceneGraph::World(NodeHandle node) const {
+	return world_[Dense(node)];
+}
+
+void SceneGraph::Update(JobSystem* jobs) {
+	if (restructure_) Restructure();
+	last_update_count_ = 0;
+	if (first_dirty_level_ >= LevelCount()) return;
+
+	// Levels above the first dirty one are untouched, and within the rest only flagged nodes and
+	// their descendants are recomputed.
+	for (uint32_t level = first_dirty_level_; level < LevelCount(); ++level) {
+		uint32_t begin = level_begin_[level];
+		uint32_t end   = level_begin_[level + 1];
+		uint32_t count = end - begin;
+		if (!jobs || jobs->Size() == 1 || count <= kChunkSize) {
+			last_update_count_ += UpdateRange(begin, end);
+			continue;
+		}
+		std::atomic<uint32_t> updated{0};
+		jobs->ParallelFor(
+		    count,
+		    [&](uint32_t range_begin, uint32_t range_end) {
+			    updated += UpdateRange(begin + range_begin, begin + range_end);
+		    },
+		    kChunkSize);
+		last_update_count_ += updated;
+	}
+
+	// Flags were read by the children on the next level, so they are only cleared now.
+	std::fill(dirty_.begin() + level_begin_[first_dirty_level_], dirty_.end(), uint8_t(0));
+	first_dirty_level_ = kNone;
+}
+
+uint32_t SceneGraph::Dense(NodeHandle node) const {
+	if (!Valid(node)) throw std::runtime_error("Stale or invalid scene node handle");
+	return slots_[node.index].dense;
+}
+
+void SceneGraph::MarkDirty(uint32_t dense) {
+	dirty_[dense]      = 1;
+	first_dirty_level_ = std::min(first_dirty_level_, depth_[dense]);
+}
+
+void SceneGraph::Restructure() {
+	uint32_t count = uint32_t(slot_.size());
+
+	// Depths and destruction both follow the parent links. Each node climbs until it reaches an
+	// ancestor already resolved, then resolves the chain top-down, so every node is visited
+	// once however the arrays are ordered.
+	std::vector<uint32_t> depth(count, kNone);
+	std::vector<uint32_t> chain;
+	uint32_t level_count = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		for (uint32_t node = i; node != kNone && depth[node] == kNone; node = parent_[node]) {
+			chain.push_back(node);
+		}
+		while (!chain.empty()) {
+			uint32_t node   = chain.back();
+			uint32_t parent = parent_[node];
+			chain.pop_back();
+			depth[node] = parent == kNone ? 0 : depth[parent] + 1;
+			if (parent != kNone && destroyed_[parent]) destroyed_[node] = 1;
+		}
+		if (!destroyed_[i]) level_count = std::max(level_count, depth[i] + 1);
+	}
+
+	// Stable counting sort of the survivors by depth; destroyed nodes free their slots.
+	level_begin_.assign(level_count + 1, 0);
+	for (uint32_t i = 0; i < count; ++i) {
+		if (!destroyed_[i]) ++level_begin_[depth[i] + 1];
+	}
+	for (uint32_t level = 0; level < level_count; ++level) {
+		level_begin_[level + 1] += level_begin_[level];
+	}
+	std::vector<uint32_t> order(count, kNone);
+	std::vector<uint32_t> next(level_begin_.begin(), level_begin_.end() - 1);
+	for (uint32_t i = 0; i < count; ++i) {
+		Slot& slot = slots_[slot_[i]];
+		if (destroyed_[i]) {
+			slot.dense = kNone;
+			++slot.generation;
+			free_slots_.push_back(slot_[i]);
+		} else {
+			order[i]   = next[depth[i]]++;
+			slot.dense = order[i];
+		}
+	}
+
+	uint32_t survivors = level_begin_.back();
+	for (uint32_t i = 0; i < count; ++i) {
+		if (order[i] != kNone && parent_[i] != kNone) parent_[i] = order[parent_[i]];
+	}
+	Permute(slot_, order, survivors);
+	Permute(parent_, order, survivors);
+	Permute(depth, order, survivors);
+	Permute(dirty_, order, survivors);
+	Permute(local_position_, order, survivors);
+	Permute(local_rotation_, order, survivors);
+	Permute(local_scale_, order, survivors);
+	Permute(world_, order, survivors);
+	depth_.swap(depth);
+	destroyed_.assign(survivors, 0);
+
+	restructure_ = false;
+	// Reparented nodes are flagged, but their depth was only known now.
+	first_dirty_level_ = 0;
+}
+
+uint32_t SceneGraph::UpdateRange(uint32_t begin, uint32_t end) {
+	uint32_t updated = 0;
+	for (uint32_t i = begin; i < end; ++i) {
+		uint32_t parent = parent_[i];
+		if (parent != kNone) dirty_[i] |= dirty_[parent];
+		if (!dirty_[i]) continue;
+
+		glm::mat4 local = Compose(local_position_[i], local_rotation_[i], local_scale_[i]);
+		world_[i]       = parent == kNone ? local : world_[parent] * local;
+		++updated;
+	}
+	return updated;
+}
@@ -1,5 +1,27 @@
 #include "shader.h"
 
-class Shader {
-    int x;
-};
\ No newline at end of file
+Shader::Shader(vk::Device device, const std::string& path) : device_(device) {
+	std::vector<char> code = ReadFile(path);
+	if (code.empty() || code.size() % sizeof(uint32_t) != 0) {
+		throw std::runtime_error("Invalid SPIR-V binary: " + path);
+	}
+
+	auto words = reinterpret_cast<const uint32_t*>(code.data());
+	module_    = device_.createShaderModule(
+	    vk::ShaderModuleCreateInfo().setCodeSize(code.size()).setPCode(words));
+}
+
+Shader::~Shader() {
+	if (module_) device_.destroyShaderModule(module_);
+}
+
+std::vector<char> Shader::ReadFile(const std::string& path) {
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) throw std::runtime_error("Failed to open file: " + path);
+
+	size_t size = static_cast<size_t>(file.tellg());
+	std::vector<char> buffer(size);
+	file.seekg(0);
+	file.read(buffer.data(), size);
+	return buffer;
+}
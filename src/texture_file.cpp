@@ -0,0 +1,45 @@
+#include "texture_file.h"
+
+#include "file_util.h"
+
+#include <gli/gli.hpp>
+
+// gli numbers its formats like VkFormat up to the last ASTC one; the formats after that (PVRTC,
+// ATC, legacy GL ones) have no Vulkan equivalent.
+static_assert(int(gli::FORMAT_RGBA8_UNORM_PACK8) == VK_FORMAT_R8G8B8A8_UNORM, "gli format");
+static_assert(int(gli::FORMAT_RGB_DXT1_UNORM_BLOCK8) == VK_FORMAT_BC1_RGB_UNORM_BLOCK,
+              "gli format");
+static_assert(int(gli::FORMAT_RGBA_BP_UNORM_BLOCK16) == VK_FORMAT_BC7_UNORM_BLOCK, "gli format");
+static_assert(int(gli::FORMAT_RGB_ETC2_UNORM_BLOCK8) == VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,
+              "gli format");
+static_assert(int(gli::FORMAT_RGBA_ASTC_12X12_SRGB_BLOCK16) == VK_FORMAT_ASTC_12x12_SRGB_BLOCK,
+              "gli format");
+
+bool IsTextureFile(const std::string& path) {
+	return HasExtension(path, {"ktx", "dds", "kmg"});
+}
+
+TextureData LoadTextureFile(const std::string& path) {
+	auto texture = std::make_shared<gli::texture>(gli::load(path));
+	if (texture->empty()) throw std::runtime_error("Failed to read texture: " + path);
+	if (texture->target() != gli::TARGET_2D) {
+		throw std::runtime_error("Only 2D textures are supported: " + path);
+	}
+	if (texture->format() > gli::FORMAT_RGBA_ASTC_12X12_SRGB_BLOCK16) {
+		throw std::runtime_error("Texture format has no Vulkan equivalent: " + path);
+	}
+
+	TextureData data;
+	data.format      = vk::Format(VkFormat(texture->format()));
+	data.block_bytes = uint32_t(gli::block_size(texture->format()));
+	// Levels of one layer and face are contiguous, finest first.
+	const uint8_t* base = static_cast<const uint8_t*>(texture->data(0, 0, 0));
+	for (size_t level = 0; level < texture->levels(); ++level) {
+		gli::texture::extent_type extent = texture->extent(level);
+		const uint8_t* bytes = static_cast<const uint8_t*>(texture->data(0, 0, level));
+		data.levels.push_back({uint32_t(extent.x), uint32_t(extent.y), size_t(bytes - base),
+		                       size_t(texture->size(level))});
+	}
+	data.data = std::shared_ptr<const uint8_t>(texture, base);
+	return data;
+}
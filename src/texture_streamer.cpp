@@ -0,0 +1,201 @@
+#include "texture_streamer.h"
+
+#include "texture_transcoder.h"
+
+#include <cstring>
+
+TextureStreamer::TextureStreamer(vk::PhysicalDevice physical_device, vk::Device device,
+                                 MemoryAllocator& allocator, Uploader& uploader,
+                                 BindlessHeap& bindless, JobSystem& jobs, uint32_t frame_count,
+                                 uint32_t placeholder)
+    : physical_device_(physical_device),
+      device_(device),
+      allocator_(allocator),
+      uploader_(uploader),
+      bindless_(bindless),
+      jobs_(jobs),
+      placeholder_(placeholder) {
+	// Zero for every slot: images that aren't streamed sample all their levels.
+	vk::DeviceSize size =
+	    sizeof(uint32_t) + bindless_.Capacity(BindlessHeap::Kind::eSampledImage) * sizeof(float);
+	frames_.resize(frame_count);
+	for (Frame& frame : frames_) {
+		frame.residency = CreateBindlessBuffer(
+		    device_, allocator_, bindless_, size, vk::BufferUsageFlagBits::eStorageBuffer,
+		    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		std::memset(frame.residency.memory.mapped, 0, size);
+		*static_cast<uint32_t*>(frame.residency.memory.mapped) = placeholder_;
+	}
+}
+
+TextureStreamer::~TextureStreamer() {
+	stopping_ = true;
+	jobs_.Wait(pending_);
+
+	for (Frame& frame : frames_) {
+		ReleaseBindlessBuffer(device_, allocator_, bindless_, frame.residency);
+	}
+	for (Texture& texture : textures_) {
+		if (!texture.image) continue;
+		device_.destroyImageView(texture.view);
+		device_.destroyImage(texture.image);
+		allocator_.Free(texture.memory);
+	}
+}
+
+uint32_t TextureStreamer::Load(const std::string& path) {
+	auto found = by_path_.find(path);
+	if (found != by_path_.end()) return textures_[found->second].index;
+
+	uint32_t id = uint32_t(textures_.size());
+	Texture texture;
+	texture.path  = path;
+	texture.index = bindless_.ReserveImage();
+	// No frame in flight can use an index handed out just now, so every slot's buffer may be
+	// written: draws recorded from here on sample the placeholder until levels arrive.
+	for (Frame& frame : frames_) Residency(frame)[texture.index] = kNotResident;
+	textures_.push_back(std::move(texture));
+	by_path_[path] = id;
+
+	jobs_.ScheduleBackground(
+	    [this, id, path] {
+		    if (stopping_) return;
+		    Parsed parsed;
+		    parsed.texture = id;
+		    try {
+			    parsed.data = LoadTextureFile(path);
+			    if (!Supports(parsed.data.format)) parsed.data = TranscodeTexture(parsed.data);
+		    } catch (const std::exception& e) {
+			    parsed.error = e.what();
+		    }
+		    completed_.Push(std::move(parsed));
+	    },
+	    &pending_);
+	return textures_[id].index;
+}
+
+vk::DeviceSize TextureStreamer::Update(uint32_t slot, vk::DeviceSize budget) {
+	Parsed parsed;
+	while (completed_.TryPop(parsed)) {
+		Texture& texture = textures_[parsed.texture];
+		if (!parsed.error.empty()) {
+			std::cerr << "Failed to load " << texture.path << ": " << parsed.error << std::endl;
+			continue;
+		}
+		Create(texture, std::move(parsed.data));
+		streaming_.push_back(parsed.texture);
+	}
+
+	// Whichever texture they belong to, tails go before finer levels and coarse levels before fine
+	// ones, so every material shows up before any of them sharpens.
+	auto smaller_step = [this](uint32_t a, uint32_t b) {
+		return StepBytes(textures_[a]) < StepBytes(textures_[b]);
+	};
+	vk::DeviceSize uploaded = 0;
+	while (!streaming_.empty() && uploaded < budget) {
+		auto next = std::min_element(streaming_.begin(), streaming_.end(), smaller_step);
+		Texture& texture = textures_[*next];
+		uploaded += StepBytes(texture);
+		Upload(texture);
+		for (Frame& frame : frames_) frame.dirty.push_back(*next);
+		if (texture.resident == 0) {
+			texture.data = TextureData();
+			streaming_.erase(next);
+		}
+	}
+
+	// The uploads above are submitted ahead of the frame this slot is recorded for.
+	Frame& frame     = frames_[slot];
+	float* residency = Residency(frame);
+	for (uint32_t id : frame.dirty) {
+		const Texture& texture   = textures_[id];
+		residency[texture.index] = float(texture.resident);
+	}
+	frame.dirty.clear();
+	return uploaded;
+}
+
+bool TextureStreamer::Supports(vk::Format format) const {
+	vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eSampledImage |
+	                                  vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+	return (physical_device_.getFormatProperties(format).optimalTilingFeatures & required) ==
+	       required;
+}
+
+void TextureStreamer::Create(Texture& texture, TextureData data) {
+	size_t dropped = 0;
+	while (dropped + 1 < data.levels.size() &&
+	       data.levels[dropped].size > uploader_.MaxImageUpload()) {
+		++dropped;
+	}
+	data.levels.erase(data.levels.begin(), data.levels.begin() + dropped);
+
+	const TextureLevel& top = data.levels[0];
+	texture.image  = device_.createImage(
+	    vk::ImageCreateInfo()
+	        .setImageType(vk::ImageType::e2D)
+	        .setFormat(data.format)
+	        .setExtent(vk::Extent3D(top.width, top.height, 1))
+	        .setMipLevels(uint32_t(data.levels.size()))
+	        .setArrayLayers(1)
+	        .setSamples(vk::SampleCountFlagBits::e1)
+	        .setTiling(vk::ImageTiling::eOptimal)
+	        .setUsage(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst)
+	        .setSharingMode(vk::SharingMode::eExclusive)
+	        .setInitialLayout(vk::ImageLayout::eUndefined));
+	texture.memory =
+	    allocator_.AllocateImage(texture.image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	texture.view = device_.createImageView(
+	    vk::ImageViewCreateInfo()
+	        .setImage(texture.image)
+	        .setViewType(vk::ImageViewType::e2D)
+	        .setFormat(data.format)
+	        .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0,
+	                                                       uint32_t(data.levels.size()), 0, 1)));
+	// Residency buffers still say kNotResident, so no frame samples the slot yet.
+	bindless_.SetImage(texture.index, texture.view);
+
+	texture.level_count = uint32_t(data.levels.size());
+	texture.resident    = texture.level_count;
+	texture.data        = std::move(data);
+}
+
+uint32_t TextureStreamer::NextLevel(const Texture& texture) const {
+	const std::vector<TextureLevel>& levels = texture.data.levels;
+	if (texture.resident < texture.level_count) return texture.resident - 1;
+	uint32_t level = uint32_t(levels.size()) - 1;
+	while (level > 0 && std::max(levels[level - 1].width, levels[level - 1].height) <= kTailSize) {
+		--level;
+	}
+	return level;
+}
+
+vk::DeviceSize TextureStreamer::StepBytes(const Texture& texture) const {
+	vk::DeviceSize bytes = 0;
+	for (uint32_t level = NextLevel(texture); level < texture.resident; ++level) {
+		bytes += texture.data.levels[level].size;
+	}
+	return bytes;
+}
+
+void TextureStreamer::Upload(Texture& texture) {
+	uint32_t first = NextLevel(texture);
+	for (uint32_t level = first; level < texture.resident; ++level) {
+		const TextureLevel& extent = texture.data.levels[level];
+		vk::BufferImageCopy region;
+		region
+		    .setImageSubresource(
+		        vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1))
+		    .setImageExtent(vk::Extent3D(extent.width, extent.height, 1));
+		uploader_.UploadImage(texture.image, region, texture.data.Level(level), extent.size,
+		                      texture.data.block_bytes, vk::ImageLayout::eShaderReadOnlyOptimal,
+		                      vk::PipelineStageFlagBits::eFragmentShader,
+		                      vk::AccessFlagBits::eShaderRead);
+	}
+	texture.resident = first;
+}
+
+float* TextureStreamer::Residency(Frame& frame) const {
+	return reinterpret_cast<float*>(static_cast<uint32_t*>(frame.residency.memory.mapped) + 1);
+}
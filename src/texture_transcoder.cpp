@@ -0,0 +1,484 @@
+#include "texture_transcoder.h"
+
+#include <cstring>
+
+namespace {
+
+enum class Codec {
+	eBc1,
+	eBc1Alpha,
+	eBc2,
+	eBc3,
+	eBc4,
+	eBc5,
+	eEtc2,
+	eEtc2Alpha1,
+	eEtc2Alpha,
+	eEacR,
+	eEacRg,
+	eEacRSigned,
+	eEacRgSigned,
+	eRgb,
+	eBgr,
+};
+
+// The R8G8B8A8 format a codec decodes to.
+constexpr vk::Format kUnorm = vk::Format::eR8G8B8A8Unorm;
+constexpr vk::Format kSrgb  = vk::Format::eR8G8B8A8Srgb;
+constexpr vk::Format kSnorm = vk::Format::eR8G8B8A8Snorm;
+
+struct SourceFormat {
+	Codec codec;
+	vk::Format target;
+};
+
+std::optional<SourceFormat> Classify(vk::Format format) {
+	switch (format) {
+		case vk::Format::eBc1RgbUnormBlock:
+			return SourceFormat{Codec::eBc1, kUnorm};
+		case vk::Format::eBc1RgbSrgbBlock:
+			return SourceFormat{Codec::eBc1, kSrgb};
+		case vk::Format::eBc1RgbaUnormBlock:
+			return SourceFormat{Codec::eBc1Alpha, kUnorm};
+		case vk::Format::eBc1RgbaSrgbBlock:
+			return SourceFormat{Codec::eBc1Alpha, kSrgb};
+		case vk::Format::eBc2UnormBlock:
+			return SourceFormat{Codec::eBc2, kUnorm};
+		case vk::Format::eBc2SrgbBlock:
+			return SourceFormat{Codec::eBc2, kSrgb};
+		case vk::Format::eBc3UnormBlock:
+			return SourceFormat{Codec::eBc3, kUnorm};
+		case vk::Format::eBc3SrgbBlock:
+			return SourceFormat{Codec::eBc3, kSrgb};
+		case vk::Format::eBc4UnormBlock:
+			return SourceFormat{Codec::eBc4, kUnorm};
+		case vk::Format::eBc5UnormBlock:
+			return SourceFormat{Codec::eBc5, kUnorm};
+		case vk::Format::eEtc2R8G8B8UnormBlock:
+			return SourceFormat{Codec::eEtc2, kUnorm};
+		case vk::Format::eEtc2R8G8B8SrgbBlock:
+			return SourceFormat{Codec::eEtc2, kSrgb};
+		case vk::Format::eEtc2R8G8B8A1UnormBlock:
+			return SourceFormat{Codec::eEtc2Alpha1, kUnorm};
+		case vk::Format::eEtc2R8G8B8A1SrgbBlock:
+			return SourceFormat{Codec::eEtc2Alpha1, kSrgb};
+		case vk::Format::eEtc2R8G8B8A8UnormBlock:
+			return SourceFormat{Codec::eEtc2Alpha, kUnorm};
+		case vk::Format::eEtc2R8G8B8A8SrgbBlock:
+			return SourceFormat{Codec::eEtc2Alpha, kSrgb};
+		case vk::Format::eEacR11UnormBlock:
+			return SourceFormat{Codec::eEacR, kUnorm};
+		case vk::Format::eEacR11G11UnormBlock:
+			return SourceFormat{Codec::eEacRg, kUnorm};
+		case vk::Format::eEacR11SnormBlock:
+			return SourceFormat{Codec::eEacRSigned, kSnorm};
+		case vk::Format::eEacR11G11SnormBlock:
+			return SourceFormat{Codec::eEacRgSigned, kSnorm};
+		case vk::Format::eR8G8B8Unorm:
+			return SourceFormat{Codec::eRgb, kUnorm};
+		case vk::Format::eR8G8B8Srgb:
+			return SourceFormat{Codec::eRgb, kSrgb};
+		case vk::Format::eB8G8R8Unorm:
+			return SourceFormat{Codec::eBgr, kUnorm};
+		case vk::Format::eB8G8R8Srgb:
+			return SourceFormat{Codec::eBgr, kSrgb};
+		default:
+			return std::nullopt;
+	}
+}
+
+// Bytes per 4x4 block, or per texel for the uncompressed codecs.
+size_t BlockBytes(Codec codec) {
+	switch (codec) {
+		case Codec::eBc1:
+		case Codec::eBc1Alpha:
+		case Codec::eBc4:
+		case Codec::eEtc2:
+		case Codec::eEtc2Alpha1:
+		case Codec::eEacR:
+		case Codec::eEacRSigned:
+			return 8;
+		case Codec::eRgb:
+		case Codec::eBgr:
+			return 3;
+		default:
+			return 16;
+	}
+}
+
+// A decoded 4x4 block, RGBA texels in rows.
+using Block = std::array<std::array<uint8_t, 4>, 16>;
+
+uint8_t Clamp8(int value) { return uint8_t(std::clamp(value, 0, 255)); }
+
+uint64_t LoadLittleEndian(const uint8_t* bytes) {
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; --i) value = value << 8 | bytes[i];
+	return value;
+}
+
+uint64_t LoadBigEndian(const uint8_t* bytes) {
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i) value = value << 8 | bytes[i];
+	return value;
+}
+
+// Bits high down to low of value.
+int Bits(uint64_t value, int high, int low) {
+	return int((value >> low) & ((1ull << (high - low + 1)) - 1));
+}
+
+int Extend(int value, int bits) { return value << (8 - bits) | value >> (2 * bits - 8); }
+
+// The color half of BC1-BC3. BC1 blocks with color0 <= color1 have three colors and black, which
+// is transparent in the formats with alpha; BC2 and BC3 always interpolate four.
+void DecodeBc1(const uint8_t* src, bool three_color, bool alpha, Block& out) {
+	int endpoints[2] = {src[0] | src[1] << 8, src[2] | src[3] << 8};
+	int palette[4][4];
+	for (int e = 0; e < 2; ++e) {
+		palette[e][0] = Extend(endpoints[e] >> 11, 5);
+		palette[e][1] = Extend(endpoints[e] >> 5 & 63, 6);
+		palette[e][2] = Extend(endpoints[e] & 31, 5);
+		palette[e][3] = 255;
+	}
+	bool four_color = !three_color || endpoints[0] > endpoints[1];
+	for (int c = 0; c < 3; ++c) {
+		if (four_color) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		} else {
+			palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = four_color || !alpha ? 255 : 0;
+
+	uint32_t indices = uint32_t(LoadLittleEndian(src) >> 32);
+	for (int p = 0; p < 16; ++p) {
+		const int* color = palette[indices >> (2 * p) & 3];
+		for (int c = 0; c < 4; ++c) out[p][c] = uint8_t(color[c]);
+	}
+}
+
+// BC2 alpha: four bits per texel.
+void DecodeBc2Alpha(const uint8_t* src, Block& out) {
+	uint64_t alpha = LoadLittleEndian(src);
+	for (int p = 0; p < 16; ++p) out[p][3] = uint8_t((alpha >> (4 * p) & 15) * 17);
+}
+
+// One channel of BC3 alpha, BC4 and BC5: two endpoints and 3-bit indices into the 6 or 8
+// values between them.
+void DecodeBc4(const uint8_t* src, int channel, Block& out) {
+	int a0 = src[0], a1 = src[1];
+	int values[8] = {a0, a1};
+	if (a0 > a1) {
+		for (int i = 1; i < 7; ++i) values[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+	} else {
+		for (int i = 1; i < 5; ++i) values[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+		values[6] = 0;
+		values[7] = 255;
+	}
+	uint64_t indices = LoadLittleEndian(src) >> 16;
+	for (int p = 0; p < 16; ++p) out[p][channel] = uint8_t(values[indices >> (3 * p) & 7]);
+}
+
+constexpr int kEtcModifiers[8][2] = {{2, 8},   {5, 17},  {9, 29},  {13, 42},
+                                     {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+constexpr int kEtcDistances[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+// ETC2 RGB, and the RGB of RGBA8 blocks. Punch-through blocks (RGB8A1) always use the
+// differential layout, whose bit instead says whether the block is opaque; if not, index 2 is
+// transparent black.
+void DecodeEtc2(const uint8_t* src, bool punch_through, Block& out) {
+	uint64_t block = LoadBigEndian(src);
+	bool differential = punch_through || Bits(block, 33, 33);
+	bool opaque       = !punch_through || Bits(block, 33, 33);
+
+	// Texel indices run down columns, most significant bits in the upper half.
+	auto index = [block](int x, int y) {
+		int i = x * 4 + y;
+		return Bits(block, 16 + i, 16 + i) << 1 | Bits(block, i, i);
+	};
+	auto store = [&out](int x, int y, int r, int g, int b) {
+		out[y * 4 + x] = {Clamp8(r), Clamp8(g), Clamp8(b), 255};
+	};
+	// T and H blocks pick one of four paint colors per texel.
+	auto paint = [&](const int (&colors)[4][3]) {
+		for (int y = 0; y < 4; ++y) {
+			for (int x = 0; x < 4; ++x) {
+				int i = index(x, y);
+				if (!opaque && i == 2) {
+					out[y * 4 + x] = {0, 0, 0, 0};
+				} else {
+					store(x, y, colors[i][0], colors[i][1], colors[i][2]);
+				}
+			}
+		}
+	};
+
+	int base[2][3];
+	if (differential) {
+		int r = Bits(block, 63, 59), g = Bits(block, 55, 51), b = Bits(block, 47, 43);
+		// The deltas are 3-bit two's complement; a sum out of 0..31 selects another mode.
+		auto delta = [block](int high) { return (Bits(block, high, high - 2) ^ 4) - 4; };
+		int dr = delta(58), dg = delta(50), db = delta(42);
+		if (r + dr < 0 || r + dr > 31) {
+			// T mode.
+			int c1[3] = {Extend(Bits(block, 60, 59) << 2 | Bits(block, 57, 56), 4),
+			             Extend(Bits(block, 55, 52), 4), Extend(Bits(block, 51, 48), 4)};
+			int c2[3] = {Extend(Bits(block, 47, 44), 4), Extend(Bits(block, 43, 40), 4),
+			             Extend(Bits(block, 39, 36), 4)};
+			int d     = kEtcDistances[Bits(block, 35, 34) << 1 | Bits(block, 32, 32)];
+			int colors[4][3];
+			for (int c = 0; c < 3; ++c) {
+				colors[0][c] = c1[c];
+				colors[1][c] = c2[c] + d;
+				colors[2][c] = c2[c];
+				colors[3][c] = c2[c] - d;
+			}
+			paint(colors);
+			return;
+		}
+		if (g + dg < 0 || g + dg > 31) {
+			// H mode; the order of the two colors holds the distance's lowest bit.
+			int c1[3] = {Extend(Bits(block, 62, 59), 4),
+			             Extend(Bits(block, 58, 56) << 1 | Bits(block, 52, 52), 4),
+			             Extend(Bits(block, 51, 51) << 3 | Bits(block, 49, 47), 4)};
+			int c2[3] = {Extend(Bits(block, 46, 43), 4), Extend(Bits(block, 42, 39), 4),
+			             Extend(Bits(block, 38, 35), 4)};
+			int order = (c1[0] << 16 | c1[1] << 8 | c1[2]) >= (c2[0] << 16 | c2[1] << 8 | c2[2]);
+			int d     = kEtcDistances[Bits(block, 34, 34) << 2 | Bits(block, 32, 32) << 1 | order];
+			int colors[4][3];
+			for (int c = 0; c < 3; ++c) {
+				colors[0][c] = c1[c] + d;
+				colors[1][c] = c1[c] - d;
+				colors[2][c] = c2[c] + d;
+				colors[3][c] = c2[c] - d;
+			}
+			paint(colors);
+			return;
+		}
+		if (b + db < 0 || b + db > 31) {
+			// Planar mode: a gradient from the origin color towards the horizontal and vertical
+			// ones, always opaque.
+			int o[3] = {Extend(Bits(block, 62, 57), 6),
+			            Extend(Bits(block, 56, 56) << 6 | Bits(block, 54, 49), 7),
+			            Extend(Bits(block, 48, 48) << 5 | Bits(block, 44, 43) << 3 |
+			                       Bits(block, 41, 39),
+			                   6)};
+			int h[3] = {Extend(Bits(block, 38, 34) << 1 | Bits(block, 32, 32), 6),
+			            Extend(Bits(block, 31, 25), 7), Extend(Bits(block, 24, 19), 6)};
+			int v[3] = {Extend(Bits(block, 18, 13), 6), Extend(Bits(block, 12, 6), 7),
+			            Extend(Bits(block, 5, 0), 6)};
+			for (int y = 0; y < 4; ++y) {
+				for (int x = 0; x < 4; ++x) {
+					int color[3];
+					for (int c = 0; c < 3; ++c) {
+						color[c] = (x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) / 4;
+					}
+					store(x, y, color[0], color[1], color[2]);
+				}
+			}
+			return;
+		}
+		int first[3]  = {r, g, b};
+		int second[3] = {r + dr, g + dg, b + db};
+		for (int c = 0; c < 3; ++c) {
+			base[0][c] = Extend(first[c], 5);
+			base[1][c] = Extend(second[c], 5);
+		}
+	} else {
+		for (int c = 0; c < 3; ++c) {
+			base[0][c] = Extend(Bits(block, 63 - 8 * c, 60 - 8 * c), 4);
+			base[1][c] = Extend(Bits(block, 59 - 8 * c, 56 - 8 * c), 4);
+		}
+	}
+
+	// Two 2x4 sub-blocks side by side, or 4x2 ones stacked if flipped, each with its own base
+	// color and modifier table.
+	int tables[2] = {Bits(block, 39, 37), Bits(block, 36, 34)};
+	bool flip     = Bits(block, 32, 32);
+	for (int y = 0; y < 4; ++y) {
+		for (int x = 0; x < 4; ++x) {
+			int half = flip ? y >= 2 : x >= 2;
+			int i    = index(x, y);
+			if (!opaque && i == 2) {
+				out[y * 4 + x] = {0, 0, 0, 0};
+				continue;
+			}
+			int modifier = kEtcModifiers[tables[half]][i & 1];
+			if (i >= 2) modifier = -modifier;
+			// Translucent blocks give up the small positive modifier to hit the base color exactly.
+			if (!opaque && i == 0) modifier = 0;
+			store(x, y, base[half][0] + modifier, base[half][1] + modifier,
+			      base[half][2] + modifier);
+		}
+	}
+}
+
+constexpr int kEacModifiers[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14},    {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12},    {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11},    {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10},    {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},     {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},     {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},     {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},      {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+// How the values of an EAC block are read: as the alpha of ETC2 RGBA8 blocks, or as an unsigned
+// or signed 11-bit R11/RG11 channel.
+enum class Eac { eAlpha, eUnsigned, eSigned };
+
+// One EAC channel. 11-bit values are kept to 8 bits; signed ones become two's complement bytes
+// of an snorm texel, -127 to 127.
+void DecodeEac(const uint8_t* src, Eac mode, int channel, Block& out) {
+	uint64_t block  = LoadBigEndian(src);
+	int base        = Bits(block, 63, 56);
+	int multiplier  = Bits(block, 55, 52);
+	const int* mods = kEacModifiers[Bits(block, 51, 48)];
+	// Signed bases are two's complement, with -128 read as -127.
+	if (mode == Eac::eSigned) base = std::max(int(int8_t(base)), -127);
+	for (int y = 0; y < 4; ++y) {
+		for (int x = 0; x < 4; ++x) {
+			int i        = x * 4 + y;
+			int modifier = mods[Bits(block, 47 - 3 * i, 45 - 3 * i)];
+			// 11-bit channels scale the modifier by 8, except that a zero multiplier means 1/8.
+			int step = multiplier ? multiplier * 8 : 1;
+			int value;
+			switch (mode) {
+				case Eac::eAlpha:
+					value = Clamp8(base + modifier * multiplier);
+					break;
+				case Eac::eUnsigned:
+					value = std::clamp(base * 8 + 4 + modifier * step, 0, 2047) >> 3;
+					break;
+				default:
+					value = std::clamp(base * 8 + modifier * step, -1023, 1023);
+					// Truncated towards zero, so the range stays symmetric.
+					value = value < 0 ? -(-value >> 3) : value >> 3;
+					break;
+			}
+			out[y * 4 + x][channel] = uint8_t(value);
+		}
+	}
+}
+
+void DecodeBlock(Codec codec, const uint8_t* src, Block& out) {
+	// Missing channels read as 0 and alpha as 1, which is 127 in snorm.
+	uint8_t one = codec == Codec::eEacRSigned || codec == Codec::eEacRgSigned ? 127 : 255;
+	for (std::array<uint8_t, 4>& texel : out) texel = {0, 0, 0, one};
+	switch (codec) {
+		case Codec::eBc1:
+			DecodeBc1(src, true, false, out);
+			break;
+		case Codec::eBc1Alpha:
+			DecodeBc1(src, true, true, out);
+			break;
+		case Codec::eBc2:
+			DecodeBc1(src + 8, false, false, out);
+			DecodeBc2Alpha(src, out);
+			break;
+		case Codec::eBc3:
+			DecodeBc1(src + 8, false, false, out);
+			DecodeBc4(src, 3, out);
+			break;
+		case Codec::eBc4:
+			DecodeBc4(src, 0, out);
+			break;
+		case Codec::eBc5:
+			DecodeBc4(src, 0, out);
+			DecodeBc4(src + 8, 1, out);
+			break;
+		case Codec::eEtc2:
+			DecodeEtc2(src, false, out);
+			break;
+		case Codec::eEtc2Alpha1:
+			DecodeEtc2(src, true, out);
+			break;
+		case Codec::eEtc2Alpha:
+			DecodeEtc2(src + 8, false, out);
+			DecodeEac(src, Eac::eAlpha, 3, out);
+			break;
+		case Codec::eEacR:
+			DecodeEac(src, Eac::eUnsigned, 0, out);
+			break;
+		case Codec::eEacRg:
+			DecodeEac(src, Eac::eUnsigned, 0, out);
+			DecodeEac(src + 8, Eac::eUnsigned, 1, out);
+			break;
+		case Codec::eEacRSigned:
+			DecodeEac(src, Eac::eSigned, 0, out);
+			break;
+		case Codec::eEacRgSigned:
+			DecodeEac(src, Eac::eSigned, 0, out);
+			DecodeEac(src + 8, Eac::eSigned, 1, out);
+			break;
+		default:
+			break;
+	}
+}
+
+void DecodeLevel(Codec codec, const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst) {
+	if (codec == Codec::eRgb || codec == Codec::eBgr) {
+		int red = codec == Codec::eRgb ? 0 : 2;
+		for (size_t t = 0; t < size_t(width) * height; ++t, src += 3, dst += 4) {
+			dst[0] = src[red];
+			dst[1] = src[1];
+			dst[2] = src[2 - red];
+			dst[3] = 255;
+		}
+		return;
+	}
+
+	uint32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	size_t block_bytes = BlockBytes(codec);
+	Block block;
+	for (uint32_t by = 0; by < blocks_y; ++by) {
+		for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+			DecodeBlock(codec, src + (size_t(by) * blocks_x + bx) * block_bytes, block);
+			// Blocks along the right and bottom edges hang over levels that aren't multiples of 4.
+			uint32_t columns = std::min(4u, width - bx * 4), rows = std::min(4u, height - by * 4);
+			for (uint32_t y = 0; y < rows; ++y) {
+				uint8_t* row = dst + ((size_t(by) * 4 + y) * width + bx * 4) * 4;
+				std::memcpy(row, block[y * 4].data(), columns * 4);
+			}
+		}
+	}
+}
+
+}  // namespace
+
+bool CanTranscode(vk::Format format) { return Classify(format).has_value(); }
+
+TextureData TranscodeTexture(const TextureData& texture) {
+	std::optional<SourceFormat> source = Classify(texture.format);
+	if (!source) {
+		throw std::runtime_error("No CPU decoder for texture format " +
+		                         std::to_string(int(texture.format)));
+	}
+
+	TextureData result;
+	result.format      = source->target;
+	result.block_bytes = 4;
+	size_t size        = 0;
+	for (const TextureLevel& level : texture.levels) {
+		size_t texels = size_t(level.width) * level.height;
+		size_t blocks = size_t((level.width + 3) / 4) * ((level.height + 3) / 4);
+		bool block_compressed = source->codec != Codec::eRgb && source->codec != Codec::eBgr;
+		if (level.size < (block_compressed ? blocks : texels) * BlockBytes(source->codec)) {
+			throw std::runtime_error("Texture level is smaller than its extent");
+		}
+		result.levels.push_back({level.width, level.height, size, texels * 4});
+		size += texels * 4;
+	}
+
+	auto bytes = std::make_shared<std::vector<uint8_t>>(size);
+	for (uint32_t l = 0; l < texture.levels.size(); ++l) {
+		DecodeLevel(source->codec, texture.Level(l), texture.levels[l].width,
+		            texture.levels[l].height, bytes->data() + result.levels[l].offset);
+	}
+	result.data = std::shared_ptr<const uint8_t>(bytes, bytes->data());
+	return result;
+}
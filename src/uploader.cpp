@@ -0,0 +1,285 @@
+#include "uploader.h"
+
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+Uploader::Uploader(vk::Device device, MemoryAllocator& allocator, QueueRef graphics,
+                   QueueRef transfer, vk::DeviceSize copy_offset_alignment,
+                   vk::DeviceSize ring_size)
+    : device_(device),
+      allocator_(allocator),
+      graphics_(graphics),
+      transfer_(transfer),
+      copy_offset_alignment_(std::max<vk::DeviceSize>(copy_offset_alignment, 1)),
+      ring_size_(ring_size),
+      max_image_alignment_(std::lcm(kBlockBytesMultiple, copy_offset_alignment_)) {
+	ring_buffer_ = device_.createBuffer(vk::BufferCreateInfo()
+	                                        .setSize(ring_size_)
+	                                        .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+	                                        .setSharingMode(vk::SharingMode::eExclusive));
+	ring_memory_ = allocator_.AllocateBuffer(
+	    ring_buffer_,
+	    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+	for (Batch& batch : batches_) {
+		batch.transfer_pool = device_.createCommandPool(
+		    vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient, transfer_.family));
+		batch.transfer_cmd = device_.allocateCommandBuffers(vk::CommandBufferAllocateInfo(
+		    batch.transfer_pool, vk::CommandBufferLevel::ePrimary, 1))[0];
+		if (UsesTransferQueue()) {
+			batch.acquire_pool = device_.createCommandPool(vk::CommandPoolCreateInfo(
+			    vk::CommandPoolCreateFlagBits::eTransient, graphics_.family));
+			batch.acquire_cmd = device_.allocateCommandBuffers(vk::CommandBufferAllocateInfo(
+			    batch.acquire_pool, vk::CommandBufferLevel::ePrimary, 1))[0];
+			batch.transferred = device_.createSemaphore(vk::SemaphoreCreateInfo());
+		}
+		batch.fence = device_.createFence(vk::FenceCreateInfo());
+	}
+}
+
+Uploader::~Uploader() {
+	WaitIdle();
+
+	for (Batch& batch : batches_) {
+		device_.destroyFence(batch.fence);
+		if (batch.transferred) device_.destroySemaphore(batch.transferred);
+		if (batch.acquire_pool) device_.destroyCommandPool(batch.acquire_pool);
+		device_.destroyCommandPool(batch.transfer_pool);
+	}
+	device_.destroyBuffer(ring_buffer_);
+	allocator_.Free(ring_memory_);
+}
+
+void Uploader::UploadBuffer(vk::Buffer dst, vk::DeviceSize dst_offset, const void* data,
+                            vk::DeviceSize size, vk::PipelineStageFlags dst_stage,
+                            vk::AccessFlags dst_access) {
+	auto bytes = static_cast<const uint8_t*>(data);
+	UploadBuffer(
+	    dst, dst_offset, size,
+	    [bytes](void* staging, vk::DeviceSize offset, vk::DeviceSize chunk) {
+		    std::memcpy(staging, bytes + offset, chunk);
+	    },
+	    dst_stage, dst_access);
+}
+
+void Uploader::UploadBuffer(vk::Buffer dst, vk::DeviceSize dst_offset, vk::DeviceSize size,
+                            const Fill& fill, vk::PipelineStageFlags dst_stage,
+                            vk::AccessFlags dst_access) {
+	// Large uploads are split so a single resource never needs the whole ring at once.
+	const vk::DeviceSize max_chunk =
+	    std::max(kChunkAlignment, ring_size_ / 4 / kChunkAlignment * kChunkAlignment);
+
+	for (vk::DeviceSize done = 0; done < size;) {
+		vk::DeviceSize chunk = std::min(size - done, max_chunk);
+		uint64_t position    = Reserve(chunk, 16);
+		fill(static_cast<uint8_t*>(ring_memory_.mapped) + position % ring_size_, done, chunk);
+
+		Batch& batch = BeginBatch();
+		batch.transfer_cmd.copyBuffer(
+		    ring_buffer_, dst, vk::BufferCopy(position % ring_size_, dst_offset + done, chunk));
+		done += chunk;
+	}
+
+	BeginBatch().buffers.push_back({dst, dst_offset, size, dst_stage, dst_access});
+	bytes_uploaded_ += size;
+}
+
+void Uploader::UploadImage(vk::Image dst, const vk::BufferImageCopy& region, const void* data,
+                           vk::DeviceSize size, uint32_t block_bytes,
+                           vk::ImageLayout final_layout, vk::PipelineStageFlags dst_stage,
+                           vk::AccessFlags dst_access) {
+	// Anything up to half the ring, less the most alignment padding, is guaranteed to fit once the
+	// ring has drained.
+	if (size > MaxImageUpload()) {
+		throw std::runtime_error("Image upload does not fit in the staging ring");
+	}
+	if (block_bytes == 0 || kBlockBytesMultiple % block_bytes != 0) {
+		throw std::runtime_error("Invalid texel block size for an image upload");
+	}
+
+	// Buffer offsets of image copies must be multiples of the texel block size, and of 4 on
+	// transfer-only queues; the device prefers multiples of its optimal copy alignment.
+	vk::DeviceSize alignment = std::lcm(std::lcm(vk::DeviceSize(block_bytes), vk::DeviceSize(4)),
+	                                    copy_offset_alignment_);
+	uint64_t position        = Reserve(size, alignment);
+	std::memcpy(static_cast<uint8_t*>(ring_memory_.mapped) + position % ring_size_, data, size);
+
+	const vk::ImageSubresourceLayers& layers = region.imageSubresource;
+	vk::ImageSubresourceRange range(layers.aspectMask, layers.mipLevel, 1, layers.baseArrayLayer,
+	                                layers.layerCount);
+
+	Batch& batch = BeginBatch();
+	batch.transfer_cmd.pipelineBarrier(
+	    vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+	    vk::DependencyFlags(), nullptr, nullptr,
+	    vk::ImageMemoryBarrier(vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite,
+	                           vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+	                           VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dst, range));
+
+	vk::BufferImageCopy copy = region;
+	copy.bufferOffset        = position % ring_size_;
+	batch.transfer_cmd.copyBufferToImage(ring_buffer_, dst, vk::ImageLayout::eTransferDstOptimal,
+	                                     copy);
+
+	batch.images.push_back({dst, range, final_layout, dst_stage, dst_access});
+	bytes_uploaded_ += size;
+}
+
+void Uploader::Flush() {
+	Batch& batch = batches_[current_];
+	if (!batch.recording) return;
+
+	vk::PipelineStageFlags dst_stages;
+	std::vector<vk::BufferMemoryBarrier> release, acquire;
+	std::vector<vk::ImageMemoryBarrier> release_images, acquire_images;
+	for (const PendingBuffer& pending : batch.buffers) {
+		dst_stages |= pending.dst_stage;
+		if (UsesTransferQueue()) {
+			release.push_back(vk::BufferMemoryBarrier(
+			    vk::AccessFlagBits::eTransferWrite, vk::AccessFlags(), transfer_.family,
+			    graphics_.family, pending.buffer, pending.offset, pending.size));
+			acquire.push_back(vk::BufferMemoryBarrier(
+			    vk::AccessFlags(), pending.dst_access, transfer_.family, graphics_.family,
+			    pending.buffer, pending.offset, pending.size));
+		} else {
+			release.push_back(vk::BufferMemoryBarrier(
+			    vk::AccessFlagBits::eTransferWrite, pending.dst_access, VK_QUEUE_FAMILY_IGNORED,
+			    VK_QUEUE_FAMILY_IGNORED, pending.buffer, pending.offset, pending.size));
+		}
+	}
+	// Images change layout as part of the same barriers; with a queue family transfer, release
+	// and acquire must name identical layouts.
+	for (const PendingImage& pending : batch.images) {
+		dst_stages |= pending.dst_stage;
+		if (UsesTransferQueue()) {
+			release_images.push_back(vk::ImageMemoryBarrier(
+			    vk::AccessFlagBits::eTransferWrite, vk::AccessFlags(),
+			    vk::ImageLayout::eTransferDstOptimal, pending.final_layout, transfer_.family,
+			    graphics_.family, pending.image, pending.range));
+			acquire_images.push_back(vk::ImageMemoryBarrier(
+			    vk::AccessFlags(), pending.dst_access, vk::ImageLayout::eTransferDstOptimal,
+			    pending.final_layout, transfer_.family, graphics_.family, pending.image,
+			    pending.range));
+		} else {
+			release_images.push_back(vk::ImageMemoryBarrier(
+			    vk::AccessFlagBits::eTransferWrite, pending.dst_access,
+			    vk::ImageLayout::eTransferDstOptimal, pending.final_layout, VK_QUEUE_FAMILY_IGNORED,
+			    VK_QUEUE_FAMILY_IGNORED, pending.image, pending.range));
+		}
+	}
+
+	if (UsesTransferQueue()) {
+		// Release on the transfer queue, acquire on the graphics queue once the copies are done.
+		batch.transfer_cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+		                                   vk::PipelineStageFlagBits::eBottomOfPipe,
+		                                   vk::DependencyFlags(), nullptr, release, release_images);
+		batch.transfer_cmd.end();
+		transfer_.queue.submit(vk::SubmitInfo()
+		                           .setCommandBufferCount(1)
+		                           .setPCommandBuffers(&batch.transfer_cmd)
+		                           .setSignalSemaphoreCount(1)
+		                           .setPSignalSemaphores(&batch.transferred),
+		                       nullptr);
+
+		batch.acquire_cmd.begin(
+		    vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		batch.acquire_cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, dst_stages,
+		                                  vk::DependencyFlags(), nullptr, acquire, acquire_images);
+		batch.acquire_cmd.end();
+
+		graphics_.queue.submit(vk::SubmitInfo()
+		                           .setWaitSemaphoreCount(1)
+		                           .setPWaitSemaphores(&batch.transferred)
+		                           .setPWaitDstStageMask(&dst_stages)
+		                           .setCommandBufferCount(1)
+		                           .setPCommandBuffers(&batch.acquire_cmd),
+		                       batch.fence);
+	} else {
+		batch.transfer_cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, dst_stages,
+		                                   vk::DependencyFlags(), nullptr, release, release_images);
+		batch.transfer_cmd.end();
+		graphics_.queue.submit(vk::SubmitInfo().setCommandBufferCount(1).setPCommandBuffers(
+		                           &batch.transfer_cmd),
+		                       batch.fence);
+	}
+
+	batch.recording = false;
+	batch.ring_end  = head_;
+	batch.buffers.clear();
+	batch.images.clear();
+	in_flight_.push_back(current_);
+	current_ = (current_ + 1) % kBatchCount;
+}
+
+void Uploader::WaitIdle() {
+	Flush();
+	while (RetireOldest()) {
+	}
+}
+
+Uploader::Batch& Uploader::BeginBatch() {
+	Batch& batch = batches_[current_];
+	if (batch.recording) return batch;
+
+	// Batches are reused round-robin, so the one we're about to reuse is the oldest in flight.
+	while (!in_flight_.empty() && in_flight_.front() != current_) RetireOldest();
+	if (!in_flight_.empty()) RetireOldest();
+
+	device_.resetCommandPool(batch.transfer_pool, vk::CommandPoolResetFlags());
+	if (batch.acquire_pool) {
+		device_.resetCommandPool(batch.acquire_pool, vk::CommandPoolResetFlags());
+	}
+	batch.transfer_cmd.begin(
+	    vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	batch.recording = true;
+	return batch;
+}
+
+uint64_t Uploader::Reserve(vk::DeviceSize size, vk::DeviceSize alignment) {
+	for (;;) {
+		// Alignment applies to the offset into the ring, whose size needn't be a multiple of it.
+		uint64_t lap      = head_ - head_ % ring_size_;
+		uint64_t position = lap + AlignUp(head_ - lap, alignment);
+		// Allocations never straddle the end of the ring; skip to the start instead.
+		if (position - lap + size > ring_size_) position = lap + ring_size_;
+
+		if (position + size - tail_ <= ring_size_) {
+			head_ = position + size;
+			return position;
+		}
+
+		// Out of space: wait for the oldest batch, submitting the current one first if it is
+		// the only thing holding ring space.
+		if (!RetireOldest()) {
+			Flush();
+			RetireOldest();
+		}
+	}
+}
+
+bool Uploader::RetireOldest() {
+	if (in_flight_.empty()) {
+		// Nothing outstanding: every reserved byte is either recorded in the current batch or
+		// already consumed.
+		if (!batches_[current_].recording) tail_ = head_;
+		return false;
+	}
+
+	Batch& batch = batches_[in_flight_.front()];
+	if (device_.waitForFences(batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()) !=
+	    vk::Result::eSuccess) {
+		throw std::runtime_error("Timed out waiting for an upload batch");
+	}
+	device_.resetFences(batch.fence);
+	tail_ = batch.ring_end;
+	in_flight_.pop_front();
+	return true;
+}
@@ -0,0 +1,98 @@
+#include "virtual_texture_file.h"
+
+#include "file_util.h"
+
+std::vector<VirtualLevel> VirtualLevels(uint32_t width, uint32_t height) {
+	std::vector<VirtualLevel> levels;
+	uint64_t first_page = 0;
+	for (uint32_t l = 0;; ++l) {
+		VirtualLevel level;
+		level.width      = std::max(1u, width >> l);
+		level.height     = std::max(1u, height >> l);
+		level.pages_x    = (level.width + kVirtualPageSize - 1) / kVirtualPageSize;
+		level.pages_y    = (level.height + kVirtualPageSize - 1) / kVirtualPageSize;
+		level.first_page = first_page;
+		levels.push_back(level);
+		first_page += uint64_t(level.pages_x) * level.pages_y;
+		if (level.pages_x == 1 && level.pages_y == 1) return levels;
+	}
+}
+
+bool IsVirtualTextureFile(const std::string& path) {
+	return HasExtension(path, {"vtex"});
+}
+
+VirtualTextureFile::VirtualTextureFile(const std::string& path) : file_(path) {
+	uint64_t size = file_.Size();
+	header_       = static_cast<const VirtualTextureHeader*>(file_.Data());
+	if (size < sizeof(VirtualTextureHeader) || header_->magic != kVirtualTextureMagic) {
+		throw std::runtime_error("Not a virtual texture file: " + path);
+	}
+	if (header_->version != kVirtualTextureVersion) {
+		throw std::runtime_error("Virtual texture file " + path + " has version " +
+		                         std::to_string(header_->version) + ", expected " +
+		                         std::to_string(kVirtualTextureVersion) + "; cook it again");
+	}
+	vk::Format format = vk::Format(header_->format);
+	if (header_->width == 0 || header_->height == 0 || header_->page_size != kVirtualPageSize ||
+	    header_->page_border != kVirtualPageBorder ||
+	    (format != vk::Format::eR8G8B8A8Unorm && format != vk::Format::eR8G8B8A8Srgb)) {
+		throw std::runtime_error("Unsupported virtual texture layout in " + path);
+	}
+	levels_ = VirtualLevels(header_->width, header_->height);
+	if (header_->level_count != levels_.size() ||
+	    (size - sizeof(VirtualTextureHeader)) / kVirtualPageBytes < PageCount()) {
+		throw std::runtime_error("Truncated virtual texture file: " + path);
+	}
+}
+
+const uint8_t* VirtualTextureFile::Page(uint32_t level, uint32_t x, uint32_t y) const {
+	const VirtualLevel& extent = levels_[level];
+	uint64_t page              = extent.first_page + uint64_t(y) * extent.pages_x + x;
+	return static_cast<const uint8_t*>(file_.Data()) + sizeof(VirtualTextureHeader) +
+	       page * kVirtualPageBytes;
+}
+
+void WriteVirtualTextureFile(const std::string& path, uint32_t width, uint32_t height,
+                             vk::Format format, const VirtualRowSource& source) {
+	if (width == 0 || height == 0) throw std::runtime_error("Empty virtual texture");
+	if (format != vk::Format::eR8G8B8A8Unorm && format != vk::Format::eR8G8B8A8Srgb) {
+		throw std::runtime_error("Virtual textures must be R8G8B8A8");
+	}
+	std::vector<VirtualLevel> levels = VirtualLevels(width, height);
+	VirtualTextureHeader header{kVirtualTextureMagic, kVirtualTextureVersion, width,
+	                            height, uint32_t(levels.size()), uint32_t(format),
+	                            kVirtualPageSize, kVirtualPageBorder};
+
+	WriteFileAtomically(path, [&](std::ostream& file) {
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		std::vector<uint32_t> band;
+		std::vector<uint32_t> page(kVirtualPageStride * kVirtualPageStride);
+		for (uint32_t l = 0; l < levels.size(); ++l) {
+			const VirtualLevel& level = levels[l];
+			band.resize(size_t(level.width) * kVirtualPageStride);
+			for (uint32_t py = 0; py < level.pages_y; ++py) {
+				// The rows this row of pages covers, borders included, wrapping around the top
+				// and bottom edges.
+				for (uint32_t row = 0; row < kVirtualPageStride; ++row) {
+					int64_t y = int64_t(py) * kVirtualPageSize + row - kVirtualPageBorder;
+					y         = (y % level.height + level.height) % level.height;
+					source(l, uint32_t(y), band.data() + size_t(row) * level.width);
+				}
+				for (uint32_t px = 0; px < level.pages_x; ++px) {
+					int64_t left = int64_t(px) * kVirtualPageSize - kVirtualPageBorder;
+					for (uint32_t row = 0; row < kVirtualPageStride; ++row) {
+						const uint32_t* texels = band.data() + size_t(row) * level.width;
+						for (uint32_t column = 0; column < kVirtualPageStride; ++column) {
+							int64_t x = (left + column) % level.width;
+							if (x < 0) x += level.width;
+							page[row * kVirtualPageStride + column] = texels[x];
+						}
+					}
+					file.write(reinterpret_cast<const char*>(page.data()), kVirtualPageBytes);
+				}
+			}
+		}
+	});
+}
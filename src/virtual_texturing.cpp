@@ -0,0 +1,413 @@
+#include "virtual_texturing.h"
+
+#include <cmath>
+#include <cstring>
+
+VirtualTexturing::VirtualTexturing(vk::PhysicalDevice physical_device, vk::Device device,
+                                   MemoryAllocator& allocator, BindlessHeap& bindless,
+                                   JobSystem& jobs, uint32_t frame_count, uint32_t cache_pages,
+                                   vk::Extent2D extent)
+    : device_(device), allocator_(allocator), bindless_(bindless), jobs_(jobs) {
+	uint32_t max_columns =
+	    physical_device.getProperties().limits.maxImageDimension2D / kVirtualPageStride;
+	// At least one page beside the first texture's pinned one.
+	cache_pages    = std::clamp(cache_pages, 2u, max_columns * max_columns);
+	cache_columns_ = std::min(max_columns, uint32_t(std::ceil(std::sqrt(double(cache_pages)))));
+	uint32_t rows  = (cache_pages + cache_columns_ - 1) / cache_columns_;
+	cache_extent_  = vk::Extent2D(cache_columns_ * kVirtualPageStride, rows * kVirtualPageStride);
+
+	// Mutable so that sRGB textures can sample the same pages through an sRGB view.
+	cache_image_  = device_.createImage(
+	    vk::ImageCreateInfo()
+	        .setFlags(vk::ImageCreateFlagBits::eMutableFormat)
+	        .setImageType(vk::ImageType::e2D)
+	        .setFormat(vk::Format::eR8G8B8A8Unorm)
+	        .setExtent(vk::Extent3D(cache_extent_.width, cache_extent_.height, 1))
+	        .setMipLevels(1)
+	        .setArrayLayers(1)
+	        .setSamples(vk::SampleCountFlagBits::e1)
+	        .setTiling(vk::ImageTiling::eOptimal)
+	        .setUsage(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst)
+	        .setSharingMode(vk::SharingMode::eExclusive)
+	        .setInitialLayout(vk::ImageLayout::eUndefined));
+	cache_memory_ =
+	    allocator_.AllocateImage(cache_image_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	auto create_view = [this](vk::Format format) {
+		return device_.createImageView(vk::ImageViewCreateInfo()
+		                                   .setImage(cache_image_)
+		                                   .setViewType(vk::ImageViewType::e2D)
+		                                   .setFormat(format)
+		                                   .setSubresourceRange(vk::ImageSubresourceRange(
+		                                       vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
+	};
+	unorm_view_  = create_view(vk::Format::eR8G8B8A8Unorm);
+	srgb_view_   = create_view(vk::Format::eR8G8B8A8Srgb);
+	unorm_index_ = bindless_.AddImage(unorm_view_);
+	srgb_index_  = bindless_.AddImage(srgb_view_);
+
+	pages_.resize(cache_pages);
+	for (uint32_t page = cache_pages; page-- > 0;) free_pages_.push_back(page);
+
+	frames_.resize(frame_count);
+	for (Frame& frame : frames_) {
+		CreateBuffer(frame.staging, kMaxPageUploads * kVirtualPageBytes,
+		             vk::BufferUsageFlagBits::eTransferSrc);
+	}
+	Resize(extent);
+}
+
+VirtualTexturing::~VirtualTexturing() {
+	stopping_ = true;
+	jobs_.Wait(pending_);
+
+	for (Frame& frame : frames_) {
+		Release(frame.table);
+		Release(frame.feedback);
+		Release(frame.staging);
+	}
+	bindless_.Remove(BindlessHeap::Kind::eSampledImage, unorm_index_);
+	bindless_.Remove(BindlessHeap::Kind::eSampledImage, srgb_index_);
+	device_.destroyImageView(unorm_view_);
+	device_.destroyImageView(srgb_view_);
+	device_.destroyImage(cache_image_);
+	allocator_.Free(cache_memory_);
+}
+
+uint32_t VirtualTexturing::Load(const std::string& path) {
+	auto found = by_path_.find(path);
+	if (found != by_path_.end()) return textures_[found->second].block | kIndexBit;
+
+	auto file = std::make_unique<VirtualTextureFile>(path);
+	if (textures_.size() + 2 > pages_.size()) {
+		throw std::runtime_error("The virtual texture cache of " + std::to_string(pages_.size()) +
+		                         " pages is too small to load " + path);
+	}
+	const std::vector<VirtualLevel>& levels = file->Levels();
+	// Feedback packs the texture and level into one word and the page position into another.
+	uint64_t table_size = table_.size() + 4 + 4 * levels.size() + file->PageCount();
+	if (levels[0].pages_x > 0x10000 || levels[0].pages_y > 0x10000 || levels.size() > 0xff ||
+	    table_size >= kIndexBit) {
+		throw std::runtime_error("Virtual texture too large: " + path);
+	}
+
+	uint32_t id = uint32_t(textures_.size());
+	Texture texture;
+	texture.path  = path;
+	texture.block = uint32_t(table_.size());
+	bool srgb     = file->Format() == vk::Format::eR8G8B8A8Srgb;
+	table_.insert(table_.end(),
+	              {uint32_t(levels.size()), srgb ? srgb_index_ : unorm_index_, id, 0u});
+	uint32_t entries = uint32_t(table_.size() + 4 * levels.size());
+	for (const VirtualLevel& level : levels) {
+		uint32_t first_entry = entries + uint32_t(level.first_page);
+		table_.insert(table_.end(), {level.width, level.height, level.pages_x, first_entry});
+		texture.first_entry.push_back(first_entry);
+	}
+	table_.resize(table_size, kNoPage);
+	for (Frame& frame : frames_) {
+		frame.rewrite = true;
+		frame.dirty.clear();
+	}
+
+	// The coarsest level is a single page, read here rather than by a job so that the texture
+	// can be drawn from the next frame on.
+	uint32_t last         = uint32_t(levels.size() - 1);
+	const uint8_t* texels = file->Page(last, 0, 0);
+	LoadedPage page{Key(id, last, 0, 0), std::vector<uint8_t>(texels, texels + kVirtualPageBytes)};
+	loading_.insert(page.key);
+	pinned_.push_back(std::move(page));
+
+	texture.file = std::move(file);
+	textures_.push_back(std::move(texture));
+	by_path_[path] = id;
+	return textures_[id].block | kIndexBit;
+}
+
+void VirtualTexturing::Resize(vk::Extent2D extent) {
+	feedback_extent_ = vk::Extent2D((extent.width + kFeedbackScale - 1) / kFeedbackScale,
+	                                (extent.height + kFeedbackScale - 1) / kFeedbackScale);
+	vk::DeviceSize size =
+	    vk::DeviceSize(feedback_extent_.width) * feedback_extent_.height * sizeof(glm::uvec2);
+	vk::BufferUsageFlags usage =
+	    vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+	for (Frame& frame : frames_) {
+		Release(frame.feedback);
+		CreateBuffer(frame.feedback, size, usage);
+		frame.feedback_frame.reset();
+	}
+}
+
+void VirtualTexturing::Prepare(uint32_t slot, uint64_t frame_number) {
+	Frame& frame       = frames_[slot];
+	frame.frame_number = frame_number;
+	frame.copies.clear();
+	if (frame.feedback_frame) ReadFeedback(frame);
+
+	// Pinned pages go first, whatever they evict; pages read since come in the order they were
+	// asked for. Once a page finds no slot, it and the ones after it wait in ready_ until a slot
+	// frees up, rather than being dropped and read again.
+	while (!pinned_.empty() && frame.copies.size() < kMaxPageUploads) {
+		loading_.erase(pinned_.back().key);
+		Place(frame, pinned_.back(), true);
+		pinned_.pop_back();
+	}
+	LoadedPage loaded;
+	while (completed_.TryPop(loaded)) ready_.push_back(std::move(loaded));
+	size_t placed = 0;
+	for (; placed < ready_.size() && frame.copies.size() < kMaxPageUploads; ++placed) {
+		if (!Place(frame, ready_[placed], false)) break;
+		loading_.erase(ready_[placed].key);
+	}
+	ready_.erase(ready_.begin(), ready_.begin() + placed);
+	// Reading more is pointless while nothing read could be placed.
+	if (!free_pages_.empty() || OldestEvictable()) ScheduleLoads();
+
+	WriteTable(frame);
+	// Cycles through every pixel of a tile over 64 frames, in an order that jumps around it.
+	uint32_t jitter = uint32_t(frame_number * 37 % (kFeedbackScale * kFeedbackScale));
+	TableHeader header{cache_columns_,
+	                   cache_extent_.width,
+	                   cache_extent_.height,
+	                   *frame.feedback.index,
+	                   feedback_extent_.width,
+	                   feedback_extent_.height,
+	                   (jitter % kFeedbackScale) | (jitter / kFeedbackScale) << 8,
+	                   uint32_t(textures_.size())};
+	std::memcpy(frame.table.memory.mapped, &header, sizeof(header));
+}
+
+void VirtualTexturing::RecordUploads(vk::CommandBuffer cmd, uint32_t slot) {
+	Frame& frame = frames_[slot];
+	vk::ImageSubresourceRange color(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+	if (!cache_initialized_) {
+		// Slots are only sampled once a copy has filled them.
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+		                    vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(),
+		                    nullptr, nullptr,
+		                    vk::ImageMemoryBarrier(
+		                        vk::AccessFlags(), vk::AccessFlagBits::eShaderRead,
+		                        vk::ImageLayout::eUndefined,
+		                        vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED,
+		                        VK_QUEUE_FAMILY_IGNORED, cache_image_, color));
+		cache_initialized_ = true;
+	}
+
+	if (!frame.copies.empty()) {
+		// Evicted slots may still be sampled by earlier frames, which the first barrier waits for
+		// as they were submitted before this one.
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+		                    vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), nullptr,
+		                    nullptr,
+		                    vk::ImageMemoryBarrier(
+		                        vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite,
+		                        vk::ImageLayout::eShaderReadOnlyOptimal,
+		                        vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED,
+		                        VK_QUEUE_FAMILY_IGNORED, cache_image_, color));
+		cmd.copyBufferToImage(frame.staging.buffer, cache_image_,
+		                      vk::ImageLayout::eTransferDstOptimal, frame.copies);
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+		                    vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(),
+		                    nullptr, nullptr,
+		                    vk::ImageMemoryBarrier(
+		                        vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+		                        vk::ImageLayout::eTransferDstOptimal,
+		                        vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED,
+		                        VK_QUEUE_FAMILY_IGNORED, cache_image_, color));
+		frame.copies.clear();
+	}
+
+	cmd.fillBuffer(frame.feedback.buffer, 0, VK_WHOLE_SIZE, kNoPage);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+	                    vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(),
+	                    vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite,
+	                                      vk::AccessFlagBits::eShaderWrite),
+	                    nullptr, nullptr);
+	frame.feedback_frame = frame.frame_number;
+}
+
+void VirtualTexturing::RecordReadback(vk::CommandBuffer cmd) const {
+	// The requests are read on the host once the frame's fence has signaled.
+	cmd.pipelineBarrier(
+	    vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eHost,
+	    vk::DependencyFlags(),
+	    vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead),
+	    nullptr, nullptr);
+}
+
+uint32_t& VirtualTexturing::Entry(uint64_t key) {
+	const Texture& texture = textures_[key >> 40];
+	uint32_t level         = uint32_t(key >> 32) & 0xff;
+	uint32_t y             = uint32_t(key >> 16) & 0xffff;
+	uint32_t x             = uint32_t(key) & 0xffff;
+	return table_[texture.first_entry[level] + y * texture.file->Levels()[level].pages_x + x];
+}
+
+void VirtualTexturing::SetEntry(uint64_t key, uint32_t value) {
+	uint32_t& entry = Entry(key);
+	entry           = value;
+	uint32_t index  = uint32_t(&entry - table_.data());
+	for (Frame& frame : frames_) {
+		if (!frame.rewrite) frame.dirty.push_back(index);
+	}
+}
+
+void VirtualTexturing::ReadFeedback(Frame& frame) {
+	uint64_t feedback_frame = *frame.feedback_frame;
+	frame.feedback_frame.reset();
+	latest_feedback_ = std::max(latest_feedback_, feedback_frame);
+
+	// Many tiles ask for the same page, so requests are counted before anything else.
+	std::unordered_map<uint64_t, uint32_t> requested;
+	auto requests = static_cast<const glm::uvec2*>(frame.feedback.memory.mapped);
+	size_t count  = size_t(feedback_extent_.width) * feedback_extent_.height;
+	for (size_t i = 0; i < count; ++i) {
+		glm::uvec2 request = requests[i];
+		if (request.x == kNoPage) continue;
+		uint32_t texture = request.x >> 8;
+		uint32_t level   = request.x & 0xff;
+		uint32_t x       = request.y & 0xffff;
+		uint32_t y       = request.y >> 16;
+		// Written by shaders, so checked before indexing anything with it.
+		if (texture >= textures_.size()) continue;
+		const std::vector<VirtualLevel>& levels = textures_[texture].file->Levels();
+		if (level >= levels.size() || x >= levels[level].pages_x || y >= levels[level].pages_y) {
+			continue;
+		}
+		++requested[Key(texture, level, x, y)];
+	}
+
+	// A missing page is drawn from its finest resident ancestor, so that one is in use too, and
+	// the missing ones between them are wanted as well.
+	std::unordered_map<uint64_t, uint32_t> missing;
+	for (const auto& [key, requests_of_key] : requested) {
+		uint32_t texture = uint32_t(key >> 40);
+		uint32_t level   = uint32_t(key >> 32) & 0xff;
+		uint32_t y       = uint32_t(key >> 16) & 0xffff;
+		uint32_t x       = uint32_t(key) & 0xffff;
+
+		const std::vector<VirtualLevel>& levels = textures_[texture].file->Levels();
+		for (; level < levels.size(); ++level) {
+			uint64_t ancestor = Key(texture, level, x, y);
+			auto resident     = resident_.find(ancestor);
+			if (resident != resident_.end()) {
+				Page& page     = pages_[resident->second];
+				page.last_used = feedback_frame;
+				if (!page.pinned) lru_.splice(lru_.end(), lru_, page.lru);
+				break;
+			}
+			missing[ancestor] += requests_of_key;
+			if (level + 1 < levels.size()) {
+				x = std::min(x / 2, levels[level + 1].pages_x - 1);
+				y = std::min(y / 2, levels[level + 1].pages_y - 1);
+			}
+		}
+	}
+
+	// Coarser pages first: they stand in for every finer page below them.
+	wanted_.clear();
+	for (const auto& entry : missing) wanted_.push_back(entry.first);
+	std::sort(wanted_.begin(), wanted_.end(), [&missing](uint64_t a, uint64_t b) {
+		uint32_t level_a = uint32_t(a >> 32) & 0xff;
+		uint32_t level_b = uint32_t(b >> 32) & 0xff;
+		if (level_a != level_b) return level_a > level_b;
+		return missing.at(a) > missing.at(b);
+	});
+}
+
+void VirtualTexturing::ScheduleLoads() {
+	for (uint64_t key : wanted_) {
+		if (loading_.size() >= kMaxLoadsInFlight) break;
+		if (loading_.count(key) || resident_.count(key)) continue;
+		loading_.insert(key);
+
+		const VirtualTextureFile* file = textures_[key >> 40].file.get();
+		jobs_.ScheduleBackground(
+		    [this, key, file] {
+			    if (stopping_) return;
+			    // Touching the mapping is what reads the page from disk, so it happens here.
+			    const uint8_t* texels = file->Page(uint32_t(key >> 32) & 0xff,
+			                                       uint32_t(key) & 0xffff,
+			                                       uint32_t(key >> 16) & 0xffff);
+			    completed_.Push(
+			        {key, std::vector<uint8_t>(texels, texels + kVirtualPageBytes)});
+		    },
+		    &pending_);
+	}
+}
+
+bool VirtualTexturing::OldestEvictable() const {
+	return !lru_.empty() && pages_[lru_.front()].last_used + kMinEvictionAge <= latest_feedback_;
+}
+
+bool VirtualTexturing::Place(Frame& frame, const LoadedPage& loaded, bool pinned) {
+	if (resident_.count(loaded.key)) return true;
+
+	uint32_t slot;
+	if (!free_pages_.empty()) {
+		slot = free_pages_.back();
+		free_pages_.pop_back();
+	} else {
+		if (lru_.empty() || (!pinned && !OldestEvictable())) return false;
+		slot         = lru_.front();
+		Page& victim = pages_[slot];
+		lru_.pop_front();
+		SetEntry(victim.key, kNoPage);
+		resident_.erase(victim.key);
+		++pages_evicted_;
+	}
+
+	Page& page     = pages_[slot];
+	page.key       = loaded.key;
+	page.last_used = latest_feedback_;
+	page.pinned    = pinned;
+	if (!pinned) page.lru = lru_.insert(lru_.end(), slot);
+	resident_[loaded.key] = slot;
+	SetEntry(loaded.key, slot);
+
+	vk::DeviceSize offset = frame.copies.size() * kVirtualPageBytes;
+	std::memcpy(static_cast<uint8_t*>(frame.staging.memory.mapped) + offset, loaded.texels.data(),
+	            kVirtualPageBytes);
+	vk::BufferImageCopy copy;
+	copy.setBufferOffset(offset)
+	    .setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+	    .setImageOffset(vk::Offset3D(int32_t(slot % cache_columns_ * kVirtualPageStride),
+	                                 int32_t(slot / cache_columns_ * kVirtualPageStride), 0))
+	    .setImageExtent(vk::Extent3D(kVirtualPageStride, kVirtualPageStride, 1));
+	frame.copies.push_back(copy);
+	++pages_loaded_;
+	return true;
+}
+
+void VirtualTexturing::WriteTable(Frame& frame) {
+	vk::DeviceSize size = sizeof(TableHeader) + table_.size() * sizeof(uint32_t);
+	if (frame.table.size < size) {
+		// Only this slot's frames read its table, and they have completed. Grown geometrically
+		// so that loading textures one by one doesn't reallocate every time.
+		vk::DeviceSize grown = std::max(size, frame.table.size * 2);
+		Release(frame.table);
+		CreateBuffer(frame.table, grown, vk::BufferUsageFlagBits::eStorageBuffer);
+		frame.rewrite = true;
+	}
+
+	auto words = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(frame.table.memory.mapped) +
+	                                         sizeof(TableHeader));
+	if (frame.rewrite) {
+		std::memcpy(words, table_.data(), table_.size() * sizeof(uint32_t));
+		frame.rewrite = false;
+	} else {
+		for (uint32_t index : frame.dirty) words[index] = table_[index];
+	}
+	frame.dirty.clear();
+}
+
+void VirtualTexturing::CreateBuffer(Buffer& buffer, vk::DeviceSize size,
+                                    vk::BufferUsageFlags usage) {
+	buffer = CreateBindlessBuffer(
+	    device_, allocator_, bindless_, size, usage,
+	    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+}
+
+void VirtualTexturing::Release(Buffer& buffer) {
+	ReleaseBindlessBuffer(device_, allocator_, bindless_, buffer);
+}
@@ -0,0 +1,65 @@
+#include "vulkan_loader.h"
+
+#ifndef ENGINE_LINK_VULKAN
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#endif
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace vulkan_loader {
+
+namespace {
+
+PFN_vkGetInstanceProcAddr get_instance_proc_addr = nullptr;
+
+PFN_vkGetInstanceProcAddr FindGetInstanceProcAddr() {
+#ifdef ENGINE_LINK_VULKAN
+	return ::vkGetInstanceProcAddr;
+#else
+	// The library stays loaded for the lifetime of the process.
+#if defined(_WIN32)
+	const char* const names[] = {"vulkan-1.dll"};
+	for (const char* name : names) {
+		if (HMODULE library = LoadLibraryA(name)) {
+			return PFN_vkGetInstanceProcAddr(GetProcAddress(library, "vkGetInstanceProcAddr"));
+		}
+	}
+#else
+#if defined(__APPLE__)
+	const char* const names[] = {"libvulkan.1.dylib", "libvulkan.dylib", "libMoltenVK.dylib"};
+#else
+	const char* const names[] = {"libvulkan.so.1", "libvulkan.so"};
+#endif
+	for (const char* name : names) {
+		if (void* library = dlopen(name, RTLD_NOW | RTLD_LOCAL)) {
+			return PFN_vkGetInstanceProcAddr(dlsym(library, "vkGetInstanceProcAddr"));
+		}
+	}
+#endif
+	return nullptr;
+#endif
+}
+
+}  // namespace
+
+void LoadGlobal() {
+	if (!get_instance_proc_addr) get_instance_proc_addr = FindGetInstanceProcAddr();
+	if (!get_instance_proc_addr) throw std::runtime_error("Failed to load the Vulkan library");
+	vk::defaultDispatchLoaderDynamic.init(VK_NULL_HANDLE, get_instance_proc_addr);
+}
+
+void LoadInstance(vk::Instance instance) {
+	vk::defaultDispatchLoaderDynamic.init(static_cast<VkInstance>(instance),
+	                                      get_instance_proc_addr);
+}
+
+void LoadDevice(vk::Instance instance, vk::Device device) {
+	vk::defaultDispatchLoaderDynamic.init(static_cast<VkInstance>(instance), get_instance_proc_addr,
+	                                      static_cast<VkDevice>(device));
+}
+
+}  // namespace vulkan_loader
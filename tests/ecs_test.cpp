@@ -0,0 +1,97 @@
+#include "ecs.h"
+#include "test.h"
+
+namespace {
+
+struct Position {
+	float x, y, z;
+};
+struct Velocity {
+	float x, y, z;
+};
+struct Tag {
+	uint32_t value;
+};
+// Large enough that only a few fit in a chunk, so moves cross chunk boundaries.
+struct Payload {
+	uint32_t values[256];
+};
+
+Position PositionOf(uint32_t i) { return {float(i), float(i) * 2.0f, -float(i)}; }
+Velocity VelocityOf(uint32_t i) { return {0.5f * i, 1.0f, float(i % 7)}; }
+
+bool Equal(const Position& a, const Position& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+bool Equal(const Velocity& a, const Velocity& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+
+// Adding and removing components moves entities between archetypes, and removing a row fills it
+// with the archetype's last entity; neither may lose or mix up any entity's data.
+void TestDataSurvivesArchetypeMoves() {
+	constexpr uint32_t kCount = 1000;
+	Registry registry;
+	std::vector<Entity> entities;
+	for (uint32_t i = 0; i < kCount; ++i) {
+		entities.push_back(registry.Create(PositionOf(i), VelocityOf(i)));
+	}
+
+	for (uint32_t i = 0; i < kCount; i += 2) registry.Add(entities[i], Tag{i});
+	for (uint32_t i = 0; i < kCount; i += 3) registry.Remove<Velocity>(entities[i]);
+	for (uint32_t i = 0; i < kCount; i += 5) {
+		Payload payload;
+		for (uint32_t v = 0; v < 256; ++v) payload.values[v] = i + v;
+		registry.Add(entities[i], payload);
+	}
+	for (uint32_t i = 0; i < kCount; i += 10) registry.Remove<Tag>(entities[i]);
+	for (uint32_t i = 7; i < kCount; i += 11) registry.Destroy(entities[i]);
+
+	uint32_t alive = 0;
+	for (uint32_t i = 0; i < kCount; ++i) {
+		Entity entity = entities[i];
+		if (i >= 7 && (i - 7) % 11 == 0) {
+			CHECK(!registry.Alive(entity));
+			continue;
+		}
+		++alive;
+		CHECK(registry.Alive(entity));
+		CHECK(Equal(registry.Get<Position>(entity), PositionOf(i)));
+		CHECK(registry.Has<Velocity>(entity) == (i % 3 != 0));
+		if (i % 3 != 0) CHECK(Equal(registry.Get<Velocity>(entity), VelocityOf(i)));
+		CHECK(registry.Has<Tag>(entity) == (i % 2 == 0 && i % 10 != 0));
+		if (registry.Has<Tag>(entity)) CHECK(registry.Get<Tag>(entity).value == i);
+		CHECK(registry.Has<Payload>(entity) == (i % 5 == 0));
+		if (i % 5 == 0) {
+			const Payload& payload = registry.Get<Payload>(entity);
+			bool intact            = true;
+			for (uint32_t v = 0; v < 256; ++v) intact = intact && payload.values[v] == i + v;
+			CHECK(intact);
+		}
+	}
+	CHECK(registry.Size() == alive);
+
+	// Queries see every entity exactly once, with the components it was left with.
+	uint32_t visited = 0;
+	registry.ForEach<const Position>([&](Entity entity, const Position& position) {
+		++visited;
+		CHECK(Equal(position, registry.Get<Position>(entity)));
+	});
+	CHECK(visited == alive);
+}
+
+// A destroyed entity's slot is reused under a new generation, and the old handle stays dead.
+void TestStaleHandles() {
+	Registry registry;
+	Entity first = registry.Create(Tag{1});
+	registry.Destroy(first);
+	Entity second = registry.Create(Tag{2});
+	CHECK(second.index == first.index);
+	CHECK(second != first);
+	CHECK(!registry.Alive(first));
+	CHECK(registry.Get<Tag>(second).value == 2);
+}
+
+}  // namespace
+
+int main() {
+	TestDataSurvivesArchetypeMoves();
+	TestStaleHandles();
+	return TestResult();
+}
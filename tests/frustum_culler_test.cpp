@@ -0,0 +1,99 @@
+#include "frustum_culler.h"
+#include "test.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+// A random perspective view from somewhere around the objects.
+glm::mat4 RandomView(std::mt19937& random) {
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> fov(0.3f, 2.0f);
+	std::uniform_real_distribution<float> aspect(0.5f, 2.5f);
+	glm::vec3 eye(position(random), position(random), position(random));
+	glm::vec3 target(position(random), position(random), position(random));
+	glm::mat4 projection = glm::perspective(fov(random), aspect(random), 0.1f, 80.0f);
+	return projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Random boxes and spheres, some degenerate, many of them straddling a plane of any view.
+FrustumCuller RandomObjects(std::mt19937& random, uint32_t count) {
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> extent(0.0f, 6.0f);
+	FrustumCuller culler(FrustumCuller::Isa::eScalar);
+	for (uint32_t i = 0; i < count; ++i) {
+		glm::vec3 center(position(random), position(random), position(random));
+		glm::vec3 extents(extent(random), extent(random), extent(random));
+		float radius = i % 5 == 0 ? 0.0f : glm::length(extents) * (0.5f + extent(random) / 12.0f);
+		culler.Add(center, extents, radius);
+	}
+	return culler;
+}
+
+// Every instruction set this CPU runs must cull exactly the objects the scalar path does, for
+// counts that leave tails of every length after the 4 and 8 wide loops, with and without jobs.
+void TestIsasAgree() {
+	std::mt19937 random(1234);
+	JobSystem jobs(4);
+	std::vector<FrustumCuller::Isa> isas;
+	for (FrustumCuller::Isa isa : {FrustumCuller::Isa::eSse, FrustumCuller::Isa::eAvx2}) {
+		FrustumCuller probe(FrustumCuller::Isa::eScalar);
+		probe.SetIsa(isa);
+		if (probe.GetIsa() == isa) isas.push_back(isa);
+	}
+	std::cout << "Comparing with scalar:";
+	for (FrustumCuller::Isa isa : isas) std::cout << " " << FrustumCuller::IsaName(isa);
+	std::cout << std::endl;
+
+	std::vector<uint32_t> counts;
+	for (uint32_t count = 0; count <= 33; ++count) counts.push_back(count);
+	for (uint32_t count : {1001u, 8191u, 8192u, 8193u, 20007u}) counts.push_back(count);
+
+	std::vector<uint32_t> expected, visible;
+	for (uint32_t count : counts) {
+		FrustumCuller culler = RandomObjects(random, count);
+		for (int view = 0; view < 8; ++view) {
+			glm::mat4 view_projection = RandomView(random);
+			culler.SetIsa(FrustumCuller::Isa::eScalar);
+			culler.Cull(view_projection, expected);
+			CHECK(std::is_sorted(expected.begin(), expected.end()));
+			for (FrustumCuller::Isa isa : isas) {
+				culler.SetIsa(isa);
+				culler.Cull(view_projection, visible);
+				CHECK(visible == expected);
+				culler.Cull(view_projection, visible, &jobs);
+				CHECK(visible == expected);
+			}
+		}
+	}
+}
+
+// Boxes in front of the camera are kept and those behind it culled, on every path this CPU runs.
+void TestKnownObjects() {
+	glm::mat4 view_projection = glm::perspective(1.0f, 1.0f, 0.1f, 100.0f) *
+	                            glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+	                                        glm::vec3(0.0f, 1.0f, 0.0f));
+	for (FrustumCuller::Isa isa :
+	     {FrustumCuller::Isa::eScalar, FrustumCuller::Isa::eSse, FrustumCuller::Isa::eAvx2}) {
+		FrustumCuller culler;
+		culler.SetIsa(isa);
+		for (uint32_t i = 0; i < 9; ++i) {
+			float z = i % 2 ? 10.0f : -10.0f;
+			culler.Add(glm::vec3(0.0f, 0.0f, z), glm::vec3(1.0f), 1.8f);
+		}
+		std::vector<uint32_t> visible;
+		culler.Cull(view_projection, visible);
+		CHECK(visible == std::vector<uint32_t>({0, 2, 4, 6, 8}));
+	}
+}
+
+}  // namespace
+
+int main() {
+	TestIsasAgree();
+	TestKnownObjects();
+	return TestResult();
+}
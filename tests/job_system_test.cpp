@@ -0,0 +1,94 @@
+#include "job_system.h"
+#include "test.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint32_t kThreads = 4;
+
+// Every job scheduled runs exactly once, whether its own thread runs it or another steals it.
+// Jobs that schedule and wait on jobs of their own fill several deques at once, which is when
+// threads steal.
+void TestNoLostOrDuplicatedJobs() {
+	constexpr uint32_t kOuter = 64;
+	constexpr uint32_t kInner = 256;
+	JobSystem jobs(kThreads);
+	std::vector<std::atomic<uint32_t>> runs(kOuter * (kInner + 1));
+
+	for (int pass = 0; pass < 4; ++pass) {
+		for (auto& count : runs) count.store(0);
+		uint64_t run_before = jobs.JobsRun();
+		JobCounter counter;
+		for (uint32_t outer = 0; outer < kOuter; ++outer) {
+			jobs.Schedule(
+			    [&, outer] {
+				    JobCounter inner_counter;
+				    for (uint32_t inner = 0; inner < kInner; ++inner) {
+					    jobs.Schedule([&, outer, inner] { ++runs[outer * (kInner + 1) + inner]; },
+					                  &inner_counter);
+				    }
+				    jobs.Wait(inner_counter);
+				    ++runs[outer * (kInner + 1) + kInner];
+			    },
+			    &counter);
+		}
+		jobs.Wait(counter);
+		CHECK(counter.Done());
+		CHECK(std::all_of(runs.begin(), runs.end(), [](const auto& count) { return count == 1; }));
+		CHECK(jobs.JobsRun() - run_before == runs.size());
+	}
+	CHECK(jobs.JobsStolen() <= jobs.JobsRun());
+}
+
+// ParallelFor hands out every element exactly once, in ranges no longer than the grain.
+void TestParallelForCoverage() {
+	JobSystem jobs(kThreads);
+	for (uint32_t count : {0u, 1u, 7u, 1000u, 100003u}) {
+		for (uint32_t grain : {0u, 1u, 64u}) {
+			std::vector<std::atomic<uint32_t>> seen(count);
+			std::atomic<bool> too_long{false};
+			jobs.ParallelFor(
+			    count,
+			    [&](uint32_t begin, uint32_t end) {
+				    if (grain && end - begin > grain) too_long = true;
+				    for (uint32_t i = begin; i < end; ++i) ++seen[i];
+			    },
+			    grain);
+			CHECK(!too_long);
+			CHECK(std::all_of(seen.begin(), seen.end(), [](const auto& n) { return n == 1; }));
+		}
+	}
+}
+
+// An exception thrown by a job comes back out of Wait() once the rest have run.
+void TestExceptionReachesWait() {
+	JobSystem jobs(kThreads);
+	JobCounter counter;
+	std::atomic<uint32_t> ran{0};
+	for (uint32_t i = 0; i < 100; ++i) {
+		jobs.Schedule(
+		    [&, i] {
+			    ++ran;
+			    if (i == 50) throw std::runtime_error("job failed");
+		    },
+		    &counter);
+	}
+	bool threw = false;
+	try {
+		jobs.Wait(counter);
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+	CHECK(ran == 100);
+}
+
+}  // namespace
+
+int main() {
+	TestNoLostOrDuplicatedJobs();
+	TestParallelForCoverage();
+	TestExceptionReachesWait();
+	return TestResult();
+}
@@ -0,0 +1,94 @@
+#include "memory_allocator.h"
+#include "test.h"
+
+namespace {
+
+void TestOrders() {
+	CHECK(BuddyBlock::OrderFor(1) == 0);
+	CHECK(BuddyBlock::OrderFor(MemoryAllocator::kMinAllocation) == 0);
+	CHECK(BuddyBlock::OrderFor(MemoryAllocator::kMinAllocation + 1) == 1);
+	CHECK(BuddyBlock::OrderSize(3) == MemoryAllocator::kMinAllocation * 8);
+}
+
+// Allocating splits the lowest free range down to the order asked for, leaving one free upper
+// half on every order in between.
+void TestSplit() {
+	BuddyBlock block(4);
+	CHECK(block.Allocate(0) == 0);
+	for (uint32_t order = 0; order < 4; ++order) CHECK(block.FreeCount(order) == 1);
+	CHECK(block.FreeCount(4) == 0);
+
+	CHECK(block.Allocate(1) == BuddyBlock::OrderSize(1));
+	CHECK(block.Allocate(0) == BuddyBlock::OrderSize(0));
+	CHECK(block.FreeCount(0) == 0);
+	CHECK(block.FreeCount(1) == 0);
+	CHECK(block.FreeBytes() == BuddyBlock::OrderSize(4) - BuddyBlock::OrderSize(2));
+	CHECK(block.LargestFree() == BuddyBlock::OrderSize(3));
+}
+
+// Freeing merges a range with its buddy only once both are free, and a block whose ranges are
+// all freed, in any order, is one free range again.
+void TestMerge() {
+	BuddyBlock block(2);
+	vk::DeviceSize offsets[4];
+	for (vk::DeviceSize& offset : offsets) offset = block.Allocate(0);
+	for (uint32_t i = 0; i < 4; ++i) CHECK(offsets[i] == i * BuddyBlock::OrderSize(0));
+	CHECK(!block.CanAllocate(0));
+	CHECK(block.FreeBytes() == 0);
+
+	bool threw = false;
+	try {
+		block.Allocate(0);
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	// The middle two are neighbours but not buddies.
+	block.Free(offsets[1], 0);
+	block.Free(offsets[2], 0);
+	CHECK(block.FreeCount(0) == 2);
+	CHECK(block.LargestFree() == BuddyBlock::OrderSize(0));
+	CHECK(!block.CanAllocate(1));
+
+	block.Free(offsets[0], 0);
+	CHECK(block.FreeCount(0) == 1);
+	CHECK(block.FreeCount(1) == 1);
+	CHECK(block.CanAllocate(1));
+
+	block.Free(offsets[3], 0);
+	CHECK(block.FreeCount(0) == 0);
+	CHECK(block.FreeCount(1) == 0);
+	CHECK(block.FreeCount(2) == 1);
+	CHECK(block.FreeBytes() == BuddyBlock::OrderSize(2));
+}
+
+// Mixed orders freed in reverse still coalesce completely.
+void TestMixedOrders() {
+	BuddyBlock block(6);
+	std::vector<std::pair<vk::DeviceSize, uint32_t>> live;
+	for (uint32_t order : {0u, 3u, 1u, 0u, 2u, 4u, 0u}) {
+		live.push_back({block.Allocate(order), order});
+		CHECK(live.back().first % BuddyBlock::OrderSize(order) == 0);
+	}
+	for (size_t i = 0; i < live.size(); ++i) {
+		for (size_t j = i + 1; j < live.size(); ++j) {
+			vk::DeviceSize end_i = live[i].first + BuddyBlock::OrderSize(live[i].second);
+			vk::DeviceSize end_j = live[j].first + BuddyBlock::OrderSize(live[j].second);
+			CHECK(end_i <= live[j].first || end_j <= live[i].first);
+		}
+	}
+	for (size_t i = live.size(); i-- > 0;) block.Free(live[i].first, live[i].second);
+	CHECK(block.FreeCount(6) == 1);
+	CHECK(block.FreeBytes() == BuddyBlock::OrderSize(6));
+}
+
+}  // namespace
+
+int main() {
+	TestOrders();
+	TestSplit();
+	TestMerge();
+	TestMixedOrders();
+	return TestResult();
+}
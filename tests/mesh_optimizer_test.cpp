@@ -0,0 +1,97 @@
+#include "mesh_optimizer.h"
+#include "test.h"
+#include "test_meshes.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+
+namespace {
+
+using Triangle = std::array<uint32_t, 3>;
+
+// The triangles of indices, each rotated to start at its smallest index so winding is kept, in
+// sorted order: equal for two index lists that draw the same triangles in any order.
+std::vector<Triangle> TriangleSet(const std::vector<uint32_t>& indices) {
+	std::vector<Triangle> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		Triangle t = {indices[i], indices[i + 1], indices[i + 2]};
+		std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+		triangles.push_back(t);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// The grid with its triangles shuffled, so the optimizers have locality to restore.
+MeshData MakeShuffledGrid(uint32_t size) {
+	MeshData mesh = MakeGrid(size);
+	std::vector<Triangle> triangles(mesh.indices.size() / 3);
+	std::memcpy(triangles.data(), mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+	std::shuffle(triangles.begin(), triangles.end(), std::mt19937(7));
+	std::memcpy(mesh.indices.data(), triangles.data(), mesh.indices.size() * sizeof(uint32_t));
+	return mesh;
+}
+
+// Tipsify only reorders triangles, and reorders them for fewer cache misses.
+void TestVertexCachePreservesTriangles() {
+	MeshData mesh                 = MakeShuffledGrid(64);
+	std::vector<Triangle> before  = TriangleSet(mesh.indices);
+	VertexCacheStats stats_before = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	CHECK(TriangleSet(mesh.indices) == before);
+	VertexCacheStats stats_after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+	CHECK(stats_after.Acmr() < stats_before.Acmr());
+}
+
+// Overdraw ordering moves whole clusters and stays within its ACMR threshold.
+void TestOverdrawPreservesTriangles() {
+	MeshData mesh = MakeShuffledGrid(64);
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	std::vector<Triangle> before = TriangleSet(mesh.indices);
+	double acmr_before           = AnalyzeVertexCache(mesh.indices, mesh.vertices.size()).Acmr();
+	OptimizeOverdraw(mesh.indices, mesh.vertices, 1.05f);
+	CHECK(TriangleSet(mesh.indices) == before);
+	double acmr_after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size()).Acmr();
+	CHECK(acmr_after <= acmr_before * 1.05 + 1e-9);
+}
+
+// The full pipeline also renumbers vertices, so its triangles are compared by the grid position
+// of their corners, and unused vertices are dropped.
+void TestOptimizeMeshPreservesTriangles() {
+	constexpr uint32_t kSize = 48;
+	MeshData mesh            = MakeShuffledGrid(kSize);
+	// One vertex no triangle uses.
+	Vertex unused = mesh.vertices.back();
+	unused.position.z += 100.0f;
+	mesh.vertices.push_back(unused);
+	std::vector<Triangle> before = TriangleSet(mesh.indices);
+
+	OptimizeMesh(mesh);
+	CHECK(mesh.vertices.size() == kSize * kSize);
+	std::vector<uint32_t> original;
+	for (uint32_t index : mesh.indices) {
+		const glm::vec3& position = mesh.vertices[index].position;
+		original.push_back(uint32_t(position.y) * kSize + uint32_t(position.x));
+	}
+	CHECK(TriangleSet(original) == before);
+
+	// Fetch order: vertices are first used in ascending order.
+	uint32_t next = 0;
+	bool ordered  = true;
+	for (uint32_t index : mesh.indices) {
+		if (index > next) ordered = false;
+		if (index == next) ++next;
+	}
+	CHECK(ordered);
+}
+
+}  // namespace
+
+int main() {
+	TestVertexCachePreservesTriangles();
+	TestOverdrawPreservesTriangles();
+	TestOptimizeMeshPreservesTriangles();
+	return TestResult();
+}
@@ -0,0 +1,66 @@
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "test.h"
+#include "test_meshes.h"
+
+#include <algorithm>
+
+namespace {
+
+// Every LOD after the first has fewer triangles and at least the error of the one before, all
+// ranges lie inside the indices, and the full detail LOD is the mesh as it was.
+void TestLodChain() {
+	MeshData mesh = MakeGrid(64);
+	OptimizeMesh(mesh);
+	std::vector<uint32_t> full = mesh.indices;
+	BuildLods(mesh);
+
+	CHECK(mesh.lods.size() > 2);
+	CHECK(mesh.lods.size() <= kMaxLods);
+	CHECK(mesh.lods[0].first_index == 0);
+	CHECK(mesh.lods[0].index_count == full.size());
+	CHECK(mesh.lods[0].error == 0.0f);
+	CHECK(std::equal(full.begin(), full.end(), mesh.indices.begin()));
+	for (size_t l = 0; l < mesh.lods.size(); ++l) {
+		const MeshLod& lod = mesh.lods[l];
+		CHECK(lod.index_count > 0 && lod.index_count % 3 == 0);
+		CHECK(uint64_t(lod.first_index) + lod.index_count <= mesh.indices.size());
+		if (l == 0) continue;
+		CHECK(lod.index_count < mesh.lods[l - 1].index_count);
+		CHECK(lod.error >= mesh.lods[l - 1].error);
+	}
+	for (uint32_t index : mesh.indices) CHECK(index < mesh.vertices.size());
+}
+
+// Meshes below kMinLodTriangles keep their full detail only.
+void TestSmallMeshHasOneLod() {
+	MeshData mesh = MakeGrid(8);
+	BuildLods(mesh);
+	CHECK(mesh.lods.size() == 1);
+	CHECK(mesh.lods[0].index_count == mesh.indices.size());
+}
+
+// Picking LODs for a shrinking projection never goes back to a finer one.
+void TestSelectLodMonotonic() {
+	MeshData mesh = MakeGrid(64);
+	OptimizeMesh(mesh);
+	BuildLods(mesh);
+	uint32_t current = 0;
+	bool monotonic   = true;
+	for (float pixels_per_unit = 1e4f; pixels_per_unit > 1e-2f; pixels_per_unit *= 0.8f) {
+		uint32_t next = SelectLod(mesh.lods, pixels_per_unit, 1.0f, current);
+		monotonic     = monotonic && next >= current && next < mesh.lods.size();
+		current       = next;
+	}
+	CHECK(monotonic);
+	CHECK(current == mesh.lods.size() - 1);
+}
+
+}  // namespace
+
+int main() {
+	TestLodChain();
+	TestSmallMeshHasOneLod();
+	TestSelectLodMonotonic();
+	return TestResult();
+}
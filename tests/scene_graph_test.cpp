@@ -0,0 +1,124 @@
+#include "scene_graph.h"
+#include "test.h"
+
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+// Whether every node's parent precedes it in the depth-ordered arrays Update() sweeps.
+bool ParentsFirst(const SceneGraph& graph) {
+	std::unordered_map<uint32_t, uint32_t> dense_of;
+	for (uint32_t i = 0; i < graph.Size(); ++i) dense_of[graph.HandleAt(i).index] = i;
+	for (uint32_t i = 0; i < graph.Size(); ++i) {
+		NodeHandle parent = graph.Parent(graph.HandleAt(i));
+		if (parent && dense_of.at(parent.index) >= i) return false;
+	}
+	return true;
+}
+
+bool Near(const glm::vec3& a, const glm::vec3& b) {
+	return glm::all(glm::lessThan(glm::abs(a - b), glm::vec3(1e-5f)));
+}
+
+glm::vec3 WorldPosition(const SceneGraph& graph, NodeHandle node) {
+	return glm::vec3(graph.World(node)[3]);
+}
+
+NodeTransform At(const glm::vec3& position) {
+	NodeTransform transform;
+	transform.position = position;
+	return transform;
+}
+
+// Reparenting a subtree below a node that sits after it in the arrays, and deeper, must leave
+// every parent before its children again and compose world matrices through the new parent.
+void TestReparent() {
+	SceneGraph graph;
+	NodeHandle a = graph.Create({}, At(glm::vec3(1.0f, 0.0f, 0.0f)));
+	NodeHandle b = graph.Create(a, At(glm::vec3(1.0f, 0.0f, 0.0f)));
+	NodeHandle c = graph.Create(b, At(glm::vec3(1.0f, 0.0f, 0.0f)));
+	NodeHandle d = graph.Create({}, At(glm::vec3(0.0f, 10.0f, 0.0f)));
+	NodeHandle e = graph.Create(d, At(glm::vec3(0.0f, 1.0f, 0.0f)));
+	NodeHandle f = graph.Create(e, At(glm::vec3(0.0f, 1.0f, 0.0f)));
+	graph.Update();
+	CHECK(ParentsFirst(graph));
+	CHECK(Near(WorldPosition(graph, c), glm::vec3(3.0f, 0.0f, 0.0f)));
+
+	graph.SetParent(a, f);
+	graph.Update();
+	CHECK(ParentsFirst(graph));
+	CHECK(graph.Parent(a) == f);
+	CHECK(graph.LevelCount() == 6);
+	CHECK(Near(WorldPosition(graph, a), glm::vec3(1.0f, 12.0f, 0.0f)));
+	CHECK(Near(WorldPosition(graph, c), glm::vec3(3.0f, 12.0f, 0.0f)));
+
+	// Back up to a root, then the old root below it, which moves every other node down a level.
+	graph.SetParent(c, {});
+	graph.Update();
+	CHECK(ParentsFirst(graph));
+	CHECK(!graph.Parent(c));
+	CHECK(Near(WorldPosition(graph, c), glm::vec3(1.0f, 0.0f, 0.0f)));
+	graph.SetParent(d, c);
+	graph.Update();
+	CHECK(ParentsFirst(graph));
+	CHECK(Near(WorldPosition(graph, f), glm::vec3(1.0f, 12.0f, 0.0f)));
+
+	bool threw = false;
+	try {
+		graph.SetParent(c, f);
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+// Many random moves and destructions, checked after each Update().
+void TestRandomRestructure() {
+	SceneGraph graph;
+	std::vector<NodeHandle> nodes;
+	uint32_t state = 12345;
+
+	auto next = [&state](uint32_t range) {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) % range;
+	};
+	for (uint32_t i = 0; i < 500; ++i) {
+		NodeHandle parent = nodes.empty() || next(4) == 0 ? NodeHandle() : nodes[next(i)];
+		nodes.push_back(graph.Create(parent, At(glm::vec3(1.0f, 0.0f, 0.0f))));
+	}
+	for (int round = 0; round < 20; ++round) {
+		for (int move = 0; move < 25; ++move) {
+			NodeHandle node   = nodes[next(uint32_t(nodes.size()))];
+			NodeHandle parent = nodes[next(uint32_t(nodes.size()))];
+			if (!graph.Valid(node) || !graph.Valid(parent)) continue;
+			try {
+				graph.SetParent(node, parent);
+			} catch (const std::runtime_error&) {
+				// parent was node or below it.
+			}
+		}
+		NodeHandle doomed = nodes[next(uint32_t(nodes.size()))];
+		if (graph.Valid(doomed) && next(2) == 0) graph.Destroy(doomed);
+		graph.Update();
+		CHECK(ParentsFirst(graph));
+
+		// A node's world x counts itself and its ancestors, each 1 along x.
+		bool composed = true;
+		for (NodeHandle node : nodes) {
+			if (!graph.Valid(node)) continue;
+			float depth = 1.0f;
+			for (NodeHandle up = graph.Parent(node); up; up = graph.Parent(up)) depth += 1.0f;
+			composed = composed && std::abs(WorldPosition(graph, node).x - depth) < 1e-3f;
+		}
+		CHECK(composed);
+	}
+}
+
+}  // namespace
+
+int main() {
+	TestReparent();
+	TestRandomRestructure();
+	return TestResult();
+}
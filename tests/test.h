@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// The little each test executable needs to run under ctest: CHECK reports a failed condition with
+// its location and carries on, and main() returns TestResult() so any failure fails the test.
+inline int& TestFailures() {
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition)                                                                     \
+	do {                                                                                     \
+		if (!(condition)) {                                                                  \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+			++TestFailures();                                                                \
+		}                                                                                    \
+	} while (0)
+
+inline int TestResult() {
+	if (TestFailures()) std::cerr << TestFailures() << " checks failed" << std::endl;
+	return TestFailures() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "model.h"
+
+#include <cmath>
+
+// A gently curved height field of size x size vertices, two triangles per cell in row order.
+// Vertex positions are unique, so tests can tell vertices apart after they are renumbered: the
+// vertex at column x, row y sits at (x, y, height).
+inline MeshData MakeGrid(uint32_t size) {
+	MeshData mesh;
+	for (uint32_t y = 0; y < size; ++y) {
+		for (uint32_t x = 0; x < size; ++x) {
+			Vertex vertex;
+			float height    = 0.5f * std::sin(0.3f * x) * std::cos(0.2f * y);
+			vertex.position = glm::vec3(float(x), float(y), height);
+			vertex.normal   = glm::vec3(0.0f, 0.0f, 1.0f);
+			vertex.uv       = glm::vec2(float(x), float(y)) / float(size - 1);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	for (uint32_t y = 0; y + 1 < size; ++y) {
+		for (uint32_t x = 0; x + 1 < size; ++x) {
+			uint32_t corner = y * size + x;
+			mesh.indices.insert(mesh.indices.end(), {corner, corner + 1, corner + size});
+			mesh.indices.insert(mesh.indices.end(), {corner + 1, corner + size + 1, corner + size});
+		}
+	}
+	return mesh;
+}
@@ -0,0 +1,142 @@
+#include "test.h"
+#include "texture_transcoder.h"
+
+#include <cstring>
+
+namespace {
+
+// A 4x4 block and the texels it decodes to, worked out from the format specifications (the
+// Khronos Data Format Specification for ETC2 and EAC, the Direct3D one for BC1). Blocks are chosen
+// so that every interpolation lands on an exact value.
+struct Vector {
+	const char* name;
+	vk::Format format;
+	std::vector<uint8_t> block;
+	// In rows, RGBA; signed formats decode to two's complement bytes.
+	std::array<std::array<int, 4>, 16> texels;
+};
+
+// BC1 blocks index texels two bits each, row by row; 0xe4 runs through indices 0 to 3. ETC2 and
+// EAC blocks index them down columns. The ETC2 blocks paint texel (x, y) with index (x + 2y) % 4;
+// the EAC ones use modifier (4x + y) % 8.
+const Vector kVectors[] = {
+	{"BC1 four colors",
+	 vk::Format::eBc1RgbUnormBlock,
+	 {0x1f, 0x06, 0x1f, 0x00, 0xe4, 0xe4, 0xe4, 0xe4},
+	 {{{0, 195, 255, 255}, {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255},
+	   {0, 195, 255, 255}, {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255},
+	   {0, 195, 255, 255}, {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255},
+	   {0, 195, 255, 255}, {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255}}}},
+	{"BC1 three colors and opaque black",
+	 vk::Format::eBc1RgbUnormBlock,
+	 {0x1f, 0x00, 0x1f, 0x04, 0xe4, 0xe4, 0xe4, 0xe4},
+	 {{{0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255}, {0, 0, 0, 255},
+	   {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255}, {0, 0, 0, 255},
+	   {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255}, {0, 0, 0, 255},
+	   {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255}, {0, 0, 0, 255}}}},
+	{"BC1 punch-through",
+	 vk::Format::eBc1RgbaUnormBlock,
+	 {0x1f, 0x00, 0x1f, 0x04, 0xe4, 0xe4, 0xe4, 0xe4},
+	 {{{0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255}, {0, 0, 0, 0},
+	   {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255}, {0, 0, 0, 0},
+	   {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255}, {0, 0, 0, 0},
+	   {0, 0, 255, 255}, {0, 130, 255, 255}, {0, 65, 255, 255}, {0, 0, 0, 0}}}},
+	{"ETC2 T mode",
+	 vk::Format::eEtc2R8G8B8UnormBlock,
+	 {0xfb, 0x00, 0x08, 0xf6, 0x55, 0xaa, 0xf0, 0xf0},
+	 {{{255, 0, 0, 255}, {11, 147, 255, 255}, {0, 136, 255, 255}, {0, 125, 244, 255},
+	   {0, 136, 255, 255}, {0, 125, 244, 255}, {255, 0, 0, 255}, {11, 147, 255, 255},
+	   {255, 0, 0, 255}, {11, 147, 255, 255}, {0, 136, 255, 255}, {0, 125, 244, 255},
+	   {0, 136, 255, 255}, {0, 125, 244, 255}, {255, 0, 0, 255}, {11, 147, 255, 255}}}},
+	{"ETC2 H mode",
+	 vk::Format::eEtc2R8G8B8UnormBlock,
+	 {0x63, 0x05, 0x1c, 0xf6, 0x55, 0xaa, 0xf0, 0xf0},
+	 {{{236, 134, 66, 255}, {172, 70, 2, 255}, {83, 185, 255, 255}, {19, 121, 206, 255},
+	   {83, 185, 255, 255}, {19, 121, 206, 255}, {236, 134, 66, 255}, {172, 70, 2, 255},
+	   {236, 134, 66, 255}, {172, 70, 2, 255}, {83, 185, 255, 255}, {19, 121, 206, 255},
+	   {83, 185, 255, 255}, {19, 121, 206, 255}, {236, 134, 66, 255}, {172, 70, 2, 255}}}},
+	{"ETC2 planar mode",
+	 vk::Format::eEtc2R8G8B8UnormBlock,
+	 {0x21, 0x00, 0x0c, 0x62, 0x41, 0x41, 0x18, 0x38},
+	 {{{65, 129, 32, 255}, {98, 113, 65, 255}, {130, 97, 97, 255}, {163, 80, 130, 255},
+	   {57, 145, 81, 255}, {89, 129, 113, 255}, {122, 113, 146, 255}, {154, 96, 178, 255},
+	   {49, 161, 130, 255}, {81, 145, 162, 255}, {114, 129, 195, 255}, {146, 112, 227, 255},
+	   {40, 177, 178, 255}, {73, 161, 211, 255}, {105, 145, 243, 255}, {138, 128, 255, 255}}}},
+	{"ETC2 punch-through",
+	 vk::Format::eEtc2R8G8B8A1UnormBlock,
+	 {0xa1, 0x57, 0x28, 0x30, 0x55, 0xaa, 0xf0, 0xf0},
+	 {{{165, 82, 41, 255}, {182, 99, 58, 255}, {0, 0, 0, 0}, {113, 14, 0, 255},
+	   {0, 0, 0, 0}, {148, 65, 24, 255}, {173, 74, 41, 255}, {233, 134, 101, 255},
+	   {165, 82, 41, 255}, {182, 99, 58, 255}, {0, 0, 0, 0}, {113, 14, 0, 255},
+	   {0, 0, 0, 0}, {148, 65, 24, 255}, {173, 74, 41, 255}, {233, 134, 101, 255}}}},
+	{"EAC signed R11",
+	 vk::Format::eEacR11SnormBlock,
+	 {0x9c, 0x3d, 0x05, 0x39, 0x77, 0x05, 0x39, 0x77},
+	 {{{-103, 0, 0, 127}, {-100, 0, 0, 127}, {-103, 0, 0, 127}, {-100, 0, 0, 127},
+	   {-106, 0, 0, 127}, {-97, 0, 0, 127}, {-106, 0, 0, 127}, {-97, 0, 0, 127},
+	   {-109, 0, 0, 127}, {-94, 0, 0, 127}, {-109, 0, 0, 127}, {-94, 0, 0, 127},
+	   {-127, 0, 0, 127}, {-73, 0, 0, 127}, {-127, 0, 0, 127}, {-73, 0, 0, 127}}}},
+	{"EAC signed R11, base -128",
+	 vk::Format::eEacR11SnormBlock,
+	 {0x80, 0x00, 0x05, 0x39, 0x77, 0x05, 0x39, 0x77},
+	 {{{-127, 0, 0, 127}, {-126, 0, 0, 127}, {-127, 0, 0, 127}, {-126, 0, 0, 127},
+	   {-127, 0, 0, 127}, {-126, 0, 0, 127}, {-127, 0, 0, 127}, {-126, 0, 0, 127},
+	   {-127, 0, 0, 127}, {-126, 0, 0, 127}, {-127, 0, 0, 127}, {-126, 0, 0, 127},
+	   {-127, 0, 0, 127}, {-125, 0, 0, 127}, {-127, 0, 0, 127}, {-125, 0, 0, 127}}}},
+};
+
+TextureData SingleBlock(vk::Format format, const std::vector<uint8_t>& block) {
+	auto bytes = std::make_shared<std::vector<uint8_t>>(block);
+	TextureData texture;
+	texture.format = format;
+	texture.levels.push_back({4, 4, 0, bytes->size()});
+	texture.data = std::shared_ptr<const uint8_t>(bytes, bytes->data());
+	return texture;
+}
+
+void TestKnownBlocks() {
+	for (const Vector& vector : kVectors) {
+		CHECK(CanTranscode(vector.format));
+		TextureData decoded = TranscodeTexture(SingleBlock(vector.format, vector.block));
+		CHECK(decoded.levels.size() == 1);
+		CHECK(decoded.levels[0].size == 64);
+		bool match = true;
+		for (int t = 0; t < 16; ++t) {
+			for (int c = 0; c < 4; ++c) {
+				match = match && decoded.Level(0)[t * 4 + c] == uint8_t(vector.texels[t][c]);
+			}
+		}
+		if (!match) std::cerr << "Mismatch decoding " << vector.name << std::endl;
+		CHECK(match);
+	}
+}
+
+void TestTargetFormats() {
+	std::vector<uint8_t> block(8, 0);
+	CHECK(TranscodeTexture(SingleBlock(vk::Format::eBc1RgbUnormBlock, block)).format ==
+	      vk::Format::eR8G8B8A8Unorm);
+	CHECK(TranscodeTexture(SingleBlock(vk::Format::eEtc2R8G8B8SrgbBlock, block)).format ==
+	      vk::Format::eR8G8B8A8Srgb);
+	CHECK(TranscodeTexture(SingleBlock(vk::Format::eEacR11SnormBlock, block)).format ==
+	      vk::Format::eR8G8B8A8Snorm);
+}
+
+void TestUnsupportedFormat() {
+	CHECK(!CanTranscode(vk::Format::eBc7UnormBlock));
+	bool threw = false;
+	try {
+		TranscodeTexture(SingleBlock(vk::Format::eBc7UnormBlock, std::vector<uint8_t>(16, 0)));
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+}  // namespace
+
+int main() {
+	TestKnownBlocks();
+	TestTargetFormats();
+	TestUnsupportedFormat();
+	return TestResult();
+}
@@ -0,0 +1,125 @@
+#include "asset_loader.h"
+#include "mesh_file.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Converts anything Assimp reads into the cooked format Engine::LoadCookedModel maps. Cooking
+// moves the parse, vertex conversion, mesh optimization, LOD and meshlet builds offline, so
+// loading at runtime only maps the file and copies it into the staging ring.
+struct CookOptions {
+	std::string input;
+	std::string output;
+	// Also time loading the cooked file against importing the source.
+	bool compare = false;
+};
+
+void PrintUsage(const char* program) {
+	std::cout << "Usage: " << program << " <input> <output.mesh> [options]\n"
+	          << "  --compare          Time loading the cooked file against importing the input"
+	          << std::endl;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+	    .count();
+}
+
+// Keeps the reads below from being optimized away.
+volatile uint64_t checksum_sink;
+
+// Opens a cooked file and reads every byte Model would upload from it, as a stand-in for a load
+// without a device.
+double TimeCookedLoad(const std::string& path) {
+	auto start = std::chrono::steady_clock::now();
+	MeshFile file(path);
+	uint64_t checksum = 0;
+	for (uint32_t i = 0; i < file.MeshCount(); ++i) {
+		MeshFileView mesh = file.Mesh(i);
+
+		auto sum = [&](const void* data, uint64_t bytes) {
+			auto words = static_cast<const uint32_t*>(data);
+			for (uint64_t w = 0; w < bytes / 4; ++w) checksum += words[w];
+		};
+		sum(mesh.vertices, uint64_t(mesh.mesh->vertex_count) * sizeof(Vertex));
+		sum(mesh.indices, uint64_t(mesh.mesh->index_count) * mesh.mesh->index_size);
+	}
+	checksum_sink = checksum;
+	return MillisecondsSince(start);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	CookOptions options;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!std::strcmp(argv[i], "--compare")) {
+			options.compare = true;
+		} else if (argv[i][0] == '-' || !options.output.empty()) {
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		} else if (options.input.empty()) {
+			options.input = argv[i];
+		} else {
+			options.output = argv[i];
+		}
+	}
+	if (options.output.empty()) {
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	try {
+		LoadedAsset asset = AssetLoader::Import(options.input);
+		if (!asset.error.empty()) {
+			throw std::runtime_error("Failed to import " + options.input + ": " + asset.error);
+		}
+		if (asset.meshes.empty()) {
+			throw std::runtime_error("No triangle meshes in " + options.input);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		WriteMeshFile(options.output, asset.meshes, asset.materials);
+		double cook_ms = MillisecondsSince(start);
+
+		MeshFile file(options.output);
+		uint64_t vertices = 0, triangles = 0, lod_triangles = 0, meshlets = 0;
+		for (uint32_t i = 0; i < file.MeshCount(); ++i) {
+			MeshFileView view        = file.Mesh(i);
+			const MeshFileMesh& mesh = *view.mesh;
+			vertices += mesh.vertex_count;
+			triangles += view.lods[0].index_count / 3;
+			lod_triangles += (mesh.index_count - view.lods[0].index_count) / 3;
+			meshlets += mesh.meshlet_count;
+		}
+		std::cout << options.output << ": " << file.MeshCount() << " meshes, "
+		          << file.MaterialCount() << " materials, " << vertices << " vertices, "
+		          << triangles << " triangles (" << lod_triangles << " more in coarser LODs), "
+		          << meshlets << " meshlets, " << file.SizeBytes() / 1024 << " KiB" << std::endl;
+		std::cout << "Imported in " << asset.load_ms << " ms, cooked in " << cook_ms << " ms"
+		          << std::endl;
+		std::cout << "Vertex cache (" << kVertexCacheSize << " entries): ACMR "
+		          << asset.cache_before.Acmr() << " -> " << asset.cache_after.Acmr() << ", ATVR "
+		          << asset.cache_before.Atvr() << " -> " << asset.cache_after.Atvr() << std::endl;
+
+		if (options.compare) {
+			// The first load may fault pages in from disk; the best of a few shows the mapped cost.
+			double cooked_ms = TimeCookedLoad(options.output);
+			for (int run = 0; run < 4; ++run) {
+				cooked_ms = std::min(cooked_ms, TimeCookedLoad(options.output));
+			}
+			double import_ms = std::min(asset.load_ms, AssetLoader::Import(options.input).load_ms);
+			std::cout << "Load: " << import_ms << " ms importing, " << cooked_ms
+			          << " ms from the cooked file (" << import_ms / cooked_ms << "x)" << std::endl;
+		}
+	} catch (const std::exception& e) {
+		std::cout << "Error occurred: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+#include "texture_file.h"
+#include "texture_transcoder.h"
+#include "virtual_texture_file.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace {
+
+// Cuts a texture into the pages Engine::LoadVirtualTexture streams. The source is either a KTX
+// or DDS file, whose top level is decoded to RGBA8 if needed and box filtered down to a full mip
+// chain in memory, or a procedural checkerboard generated a row at a time, so datasets far larger
+// than memory can be made for testing.
+struct CookOptions {
+	std::string input;
+	std::string output;
+	// Texels a side of the procedural texture; 0 reads input instead.
+	uint32_t checker = 0;
+	bool srgb        = false;
+};
+
+void PrintUsage(const char* program) {
+	std::cout << "Usage: " << program << " <input.ktx|input.dds> <output.vtex>\n"
+	          << "       " << program << " --checker <texels> <output.vtex>\n"
+	          << "  --checker <texels>  Generate a square checkerboard this many texels a side\n"
+	          << "  --srgb              Mark the checkerboard's texels as sRGB" << std::endl;
+}
+
+uint32_t Pack(glm::vec3 color) {
+	glm::uvec3 c = glm::uvec3(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+	return c.r | c.g << 8 | c.b << 16 | 0xff000000u;
+}
+
+// The full mip chain of a decoded texture, RGBA8.
+class MipChain {
+public:
+	explicit MipChain(const TextureData& texture) {
+		const TextureLevel& top = texture.levels[0];
+		std::vector<VirtualLevel> extents = VirtualLevels(top.width, top.height);
+		levels_.resize(extents.size());
+		widths_.resize(extents.size());
+		levels_[0].resize(size_t(top.width) * top.height);
+		std::memcpy(levels_[0].data(), texture.Level(0), levels_[0].size() * 4);
+		widths_[0] = top.width;
+
+		for (size_t l = 1; l < extents.size(); ++l) {
+			const std::vector<uint32_t>& parent = levels_[l - 1];
+			uint32_t parent_width  = extents[l - 1].width;
+			uint32_t parent_height = extents[l - 1].height;
+			widths_[l]             = extents[l].width;
+			levels_[l].resize(size_t(extents[l].width) * extents[l].height);
+			// Odd sizes repeat the last row or column.
+			auto at = [&](uint32_t x, uint32_t y) {
+				return parent[size_t(std::min(y, parent_height - 1)) * parent_width +
+				              std::min(x, parent_width - 1)];
+			};
+			for (uint32_t y = 0; y < extents[l].height; ++y) {
+				for (uint32_t x = 0; x < extents[l].width; ++x) {
+					uint32_t sum[4] = {};
+					for (uint32_t texel : {at(2 * x, 2 * y), at(2 * x + 1, 2 * y),
+					                       at(2 * x, 2 * y + 1), at(2 * x + 1, 2 * y + 1)}) {
+						for (int c = 0; c < 4; ++c) sum[c] += (texel >> (8 * c)) & 0xff;
+					}
+					uint32_t average = 0;
+					for (int c = 0; c < 4; ++c) average |= ((sum[c] + 2) / 4) << (8 * c);
+					levels_[l][size_t(y) * extents[l].width + x] = average;
+				}
+			}
+		}
+	}
+
+	void Row(uint32_t level, uint32_t y, uint32_t* texels) const {
+		std::memcpy(texels, levels_[level].data() + size_t(y) * widths_[level],
+		            size_t(widths_[level]) * 4);
+	}
+
+private:
+	std::vector<std::vector<uint32_t>> levels_;
+	std::vector<uint32_t> widths_;
+};
+
+// Cells of kCellSize texels in colors hashed from their position, each a checkerboard of
+// kSquareSize texel squares. Every level is computed exactly from the level 0 texels it covers,
+// without reading the level above, so any row of any level costs the same.
+class Checkerboard {
+public:
+	static constexpr uint32_t kCellSize   = 1024;
+	static constexpr uint32_t kSquareSize = 32;
+
+	explicit Checkerboard(uint32_t size) : size_(size) {}
+
+	void Row(uint32_t level, uint32_t y, uint32_t* texels) const {
+		uint32_t width     = std::max(1u, size_ >> level);
+		uint64_t footprint = uint64_t(1) << level;
+		uint64_t cells     = (size_ + kCellSize - 1) / kCellSize;
+		for (uint32_t x = 0; x < width; ++x) {
+			uint64_t base_x = x * footprint;
+			uint64_t base_y = y * footprint;
+			if (footprint < kSquareSize) {
+				bool dark      = ((base_x / kSquareSize + base_y / kSquareSize) & 1) != 0;
+				glm::vec3 cell = Cell(base_x / kCellSize, base_y / kCellSize);
+				texels[x]      = Pack(cell * (dark ? 0.75f : 1.0f));
+			} else if (footprint < kCellSize) {
+				texels[x] = Pack(Cell(base_x / kCellSize, base_y / kCellSize) * 0.875f);
+			} else {
+				// The texel covers whole cells: average them.
+				uint64_t first_x = base_x / kCellSize;
+				uint64_t first_y = base_y / kCellSize;
+				uint64_t last_x  = std::min(cells, (base_x + footprint) / kCellSize);
+				uint64_t last_y  = std::min(cells, (base_y + footprint) / kCellSize);
+				glm::vec3 sum(0.0f);
+				for (uint64_t cy = first_y; cy < last_y; ++cy) {
+					for (uint64_t cx = first_x; cx < last_x; ++cx) sum += Cell(cx, cy);
+				}
+				float count = float(std::max<uint64_t>(1, (last_x - first_x) * (last_y - first_y)));
+				texels[x]   = Pack(sum / count * 0.875f);
+			}
+		}
+	}
+
+private:
+	static glm::vec3 Cell(uint64_t x, uint64_t y) {
+		uint32_t hash = uint32_t(x * 73856093u) ^ uint32_t(y * 19349663u);
+		hash          = (hash ^ (hash >> 16)) * 0x45d9f3bu;
+		hash          = (hash ^ (hash >> 16)) * 0x45d9f3bu;
+		hash ^= hash >> 16;
+		// Kept away from black so the squares stay visible.
+		return glm::vec3(hash & 0xff, (hash >> 8) & 0xff, (hash >> 16) & 0xff) / 255.0f * 0.75f +
+		       0.25f;
+	}
+
+	uint32_t size_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	CookOptions options;
+
+	try {
+		for (int i = 1; i < argc; ++i) {
+			if (!std::strcmp(argv[i], "--checker")) {
+				if (i + 1 >= argc) throw std::invalid_argument("Missing value for --checker");
+				options.checker = std::stoul(argv[++i]);
+				if (options.checker == 0) throw std::invalid_argument("--checker must be positive");
+			} else if (!std::strcmp(argv[i], "--srgb")) {
+				options.srgb = true;
+			} else if (argv[i][0] == '-' || !options.output.empty()) {
+				throw std::invalid_argument(std::string("Unexpected argument ") + argv[i]);
+			} else if (options.input.empty() && !options.checker) {
+				options.input = argv[i];
+			} else {
+				options.output = argv[i];
+			}
+		}
+		if (options.output.empty()) throw std::invalid_argument("No output file");
+		if (options.checker && !options.input.empty()) {
+			throw std::invalid_argument("--checker takes no input file");
+		}
+	} catch (const std::exception& e) {
+		std::cout << "Invalid arguments: " << e.what() << std::endl;
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	try {
+		auto start = std::chrono::steady_clock::now();
+		uint32_t width;
+		uint32_t height;
+		vk::Format format;
+		VirtualRowSource source;
+		std::unique_ptr<MipChain> chain;
+		if (options.checker) {
+			width  = options.checker;
+			height = options.checker;
+			format = options.srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+			source = [checker = Checkerboard(options.checker)](uint32_t level, uint32_t y,
+			                                                    uint32_t* texels) {
+				checker.Row(level, y, texels);
+			};
+		} else {
+			TextureData texture = LoadTextureFile(options.input);
+			if (texture.format != vk::Format::eR8G8B8A8Unorm &&
+			    texture.format != vk::Format::eR8G8B8A8Srgb) {
+				texture = TranscodeTexture(texture);
+			}
+			// Mips are averaged as unsigned bytes.
+			if (texture.format == vk::Format::eR8G8B8A8Snorm) {
+				throw std::runtime_error("Signed textures can't be cooked into virtual textures");
+			}
+			width  = texture.levels[0].width;
+			height = texture.levels[0].height;
+			format = texture.format;
+			chain  = std::make_unique<MipChain>(texture);
+			source = [&chain](uint32_t level, uint32_t y, uint32_t* texels) {
+				chain->Row(level, y, texels);
+			};
+		}
+
+		WriteVirtualTextureFile(options.output, width, height, format, source);
+		VirtualTextureFile file(options.output);
+		double seconds =
+		    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << options.output << ": " << width << "x" << height << ", "
+		          << file.Levels().size() << " levels, " << file.PageCount() << " pages, "
+		          << file.PageCount() * kVirtualPageBytes / double(1 << 20) << " MiB in "
+		          << seconds << " s" << std::endl;
+	} catch (const std::exception& e) {
+		std::cout << "Error occurred: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}